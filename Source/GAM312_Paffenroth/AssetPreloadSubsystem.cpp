@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AssetPreloadSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/AssetManager.h"
+#include "PSOPrecache.h"
+
+void UAssetPreloadSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UAssetPreloadSubsystem::OnPostLoadMap);
+	StartPreload();
+}
+
+void UAssetPreloadSubsystem::Deinitialize()
+{
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+
+	if (PreloadHandle.IsValid())
+	{
+		PreloadHandle->ReleaseHandle();
+		PreloadHandle.Reset();
+	}
+
+	Super::Deinitialize();
+}
+
+void UAssetPreloadSubsystem::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	StartPreload();
+}
+
+void UAssetPreloadSubsystem::StartPreload()
+{
+	// Already loading, or everything is resident from an earlier pass
+	if (PreloadHandle.IsValid() && (PreloadHandle->IsLoadingInProgress() || bComplete)) return;
+
+	TArray<FSoftObjectPath> ToLoad;
+	for (const FSoftObjectPath& Path : PreloadAssets)
+	{
+		if (Path.IsValid())
+		{
+			ToLoad.Add(Path);
+		}
+	}
+	if (ToLoad.Num() == 0)
+	{
+		OnHandleComplete();
+		return;
+	}
+
+	StartTime = FPlatformTime::Seconds();
+	bComplete = false;
+
+	FStreamableManager& Streamable = UAssetManager::GetStreamableManager();
+	PreloadHandle = Streamable.RequestAsyncLoad(
+		ToLoad,
+		FStreamableDelegate::CreateUObject(this, &UAssetPreloadSubsystem::OnHandleComplete),
+		FStreamableManager::AsyncLoadHighPriority,
+		true);
+
+	if (PreloadHandle.IsValid())
+	{
+		PreloadHandle->BindUpdateDelegate(FStreamableUpdateDelegate::CreateUObject(this, &UAssetPreloadSubsystem::OnHandleUpdate));
+	}
+}
+
+float UAssetPreloadSubsystem::GetProgress() const
+{
+	if (bComplete) return 1.f;
+	return PreloadHandle.IsValid() ? PreloadHandle->GetProgress() : 0.f;
+}
+
+void UAssetPreloadSubsystem::OnHandleUpdate(TSharedRef<FStreamableHandle> Handle)
+{
+	OnPreloadProgress.Broadcast(Handle->GetProgress());
+}
+
+void UAssetPreloadSubsystem::OnHandleComplete()
+{
+	bComplete = true;
+
+	if (PreloadHandle.IsValid())
+	{
+		TArray<UObject*> Loaded;
+		PreloadHandle->GetLoadedAssets(Loaded);
+
+		for (UObject* Asset : Loaded)
+		{
+			if (UClass* Class = Cast<UClass>(Asset))
+			{
+				PrecacheClass(Class);
+			}
+		}
+
+		UE_LOG(LogGAM312, Log, TEXT("Preloaded %d assets in %.1f ms"), Loaded.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}
+
+	OnPreloadProgress.Broadcast(1.f);
+	OnPreloadComplete.Broadcast();
+}
+
+void UAssetPreloadSubsystem::PrecacheClass(UClass* Class)
+{
+	if (!IsComponentPSOPrecachingEnabled()) return;
+
+	const AActor* DefaultActor = Cast<AActor>(Class->GetDefaultObject());
+	if (!DefaultActor) return;
+
+	// Native mesh components on the class default carry the Blueprint's mesh and materials
+	TInlineComponentArray<UStaticMeshComponent*> Meshes;
+	DefaultActor->GetComponents(Meshes);
+
+	for (UStaticMeshComponent* MeshComp : Meshes)
+	{
+		if (MeshComp->GetStaticMesh())
+		{
+			MeshComp->PrecachePSOs();
+		}
+	}
+}
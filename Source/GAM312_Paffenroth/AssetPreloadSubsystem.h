@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Engine/StreamableManager.h"
+#include "AssetPreloadSubsystem.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnPreloadProgress, float, Progress);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FOnPreloadComplete);
+
+/**
+ * Loads building and resource classes in the background at startup and after each
+ * map load, then precaches their pipeline states, so the first build does not hitch.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UAssetPreloadSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// Starts loading every configured asset that is not already resident
+	UFUNCTION(BlueprintCallable, Category = "Preload")
+		void StartPreload();
+
+	// Fraction of the preload that has finished, 0 to 1
+	UFUNCTION(BlueprintPure, Category = "Preload")
+		float GetProgress() const;
+
+	UFUNCTION(BlueprintPure, Category = "Preload")
+		bool IsComplete() const { return bComplete; }
+
+	// Fired as the preload advances, for loading screens
+	UPROPERTY(BlueprintAssignable, Category = "Preload")
+		FOnPreloadProgress OnPreloadProgress;
+
+	UPROPERTY(BlueprintAssignable, Category = "Preload")
+		FOnPreloadComplete OnPreloadComplete;
+
+	// Assets to load, usually Blueprint classes such as /Game/Building/Floor_BP.Floor_BP_C
+	UPROPERTY(Config)
+		TArray<FSoftObjectPath> PreloadAssets;
+
+private:
+	void OnPostLoadMap(UWorld* LoadedWorld);
+
+	void OnHandleUpdate(TSharedRef<FStreamableHandle> Handle);
+
+	void OnHandleComplete();
+
+	// Requests pipeline state precaching for the meshes of a loaded class
+	void PrecacheClass(UClass* Class);
+
+	// Keeps the loaded assets referenced for the lifetime of the game instance
+	TSharedPtr<FStreamableHandle> PreloadHandle;
+
+	FDelegateHandle PostLoadMapHandle;
+
+	double StartTime = 0.0;
+
+	bool bComplete = false;
+};
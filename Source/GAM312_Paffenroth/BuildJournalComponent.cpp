@@ -0,0 +1,445 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildJournalComponent.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "PlayerChar.h"
+#include "BuildingPart.h"
+#include "BuildingRegistrySubsystem.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Build Journal Undo"), STAT_BuildJournalUndo, STATGROUP_GAM312);
+DECLARE_CYCLE_STAT(TEXT("Build Journal Redo"), STAT_BuildJournalRedo, STATGROUP_GAM312);
+
+FArchive& operator<<(FArchive& Ar, FBuildJournalRecord& Record)
+{
+	uint8 Op = (uint8)Record.Op;
+
+	Ar << Op;
+	Ar << Record.Flags;
+	Ar << Record.ClassIndex;
+	Ar << Record.BuildingId;
+	Ar << Record.Handle;
+	Ar << Record.Location;
+	Ar << Record.Yaw;
+	Ar << Record.Health;
+	Ar << Record.BuildingDelta;
+
+	Record.Op = (EBuildJournalOp)Op;
+	return Ar;
+}
+
+UBuildJournalComponent::UBuildJournalComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	// Needed for the server requests from remote clients
+	SetIsReplicatedByDefault(true);
+}
+
+void UBuildJournalComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Player = Cast<APlayerChar>(GetOwner());
+	Reset();
+}
+
+void UBuildJournalComponent::Reset()
+{
+	if (Records.Num() != FMath::Max(MaxRecords, 1))
+	{
+		Records.SetNum(FMath::Max(MaxRecords, 1));
+	}
+
+	Begin = 0;
+	Applied = 0;
+	Total = 0;
+	bInBatch = false;
+	bBatchStarted = false;
+}
+
+int32 UBuildJournalComponent::ClassIndexFor(UClass* Class)
+{
+	const int32 Existing = Classes.Find(Class);
+	if (Existing != INDEX_NONE) return Existing;
+
+	// Records hold a byte, so the journal only tells that many classes apart
+	if (Classes.Num() > MAX_uint8)
+	{
+		UE_LOG(LogGAM312, Warning, TEXT("Build journal of %s already refers to %d part classes; %s is not journaled"),
+			*GetNameSafe(GetOwner()), Classes.Num(), *GetNameSafe(Class));
+		return INDEX_NONE;
+	}
+	return Classes.Add(Class);
+}
+
+void UBuildJournalComponent::RecordPlace(const ABuildingPart* Part, int32 BuildingId)
+{
+	if (!Part || !GetOwner()->HasAuthority()) return;
+
+	const int32 ClassIndex = ClassIndexFor(Part->GetClass());
+	if (ClassIndex == INDEX_NONE) return;
+
+	FBuildJournalRecord Record;
+	Record.Op = EBuildJournalOp::Place;
+	Record.ClassIndex = (uint8)ClassIndex;
+	Record.BuildingId = (int8)BuildingId;
+	Record.Handle = Part->Handle;
+	Record.Location = FVector3f(Part->GetActorLocation());
+	Record.Yaw = Part->GetActorRotation().Yaw;
+	Record.BuildingDelta = BuildingId != INDEX_NONE ? -1 : 0;
+	Push(Record);
+}
+
+void UBuildJournalComponent::RecordRemove(const ABuildingPart* Part, int32 BuildingId)
+{
+	if (!Part || !GetOwner()->HasAuthority()) return;
+
+	const int32 ClassIndex = ClassIndexFor(Part->GetClass());
+	if (ClassIndex == INDEX_NONE) return;
+
+	FBuildJournalRecord Record;
+	Record.Op = EBuildJournalOp::Remove;
+	Record.ClassIndex = (uint8)ClassIndex;
+	Record.BuildingId = (int8)BuildingId;
+	Record.Handle = Part->Handle;
+	Record.Location = FVector3f(Part->GetActorLocation());
+	Record.Yaw = Part->GetActorRotation().Yaw;
+	Record.BuildingDelta = BuildingId != INDEX_NONE ? 1 : 0;
+
+	// Brought back at the health it had when removed
+	UBuildingRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UBuildingRegistrySubsystem>();
+	const int32 Index = Registry ? Registry->ToDense(Part->Handle) : INDEX_NONE;
+	Record.Health = Index != INDEX_NONE ? Registry->GetStore().Health[Index] : -1.f;
+
+	Push(Record);
+}
+
+void UBuildJournalComponent::BeginBatch()
+{
+	bInBatch = true;
+	bBatchStarted = false;
+}
+
+void UBuildJournalComponent::EndBatch()
+{
+	bInBatch = false;
+	bBatchStarted = false;
+}
+
+void UBuildJournalComponent::Push(FBuildJournalRecord Record)
+{
+	if (Records.Num() == 0) return;
+
+	// A new change makes the undone steps unreachable
+	Total = Applied;
+
+	if (!bBatchStarted)
+	{
+		Record.Flags |= BuildJournalFlags::StepStart;
+		bBatchStarted = bInBatch;
+	}
+
+	while (Total >= Records.Num())
+	{
+		DropOldestStep();
+	}
+
+	At(Total) = Record;
+	++Total;
+	++Applied;
+}
+
+void UBuildJournalComponent::DropOldestStep()
+{
+	do
+	{
+		Begin = (Begin + 1) % Records.Num();
+		--Total;
+		Applied = FMath::Max(Applied - 1, 0);
+	}
+	while (Total > 0 && !(At(0).Flags & BuildJournalFlags::StepStart));
+}
+
+int32 UBuildJournalComponent::GetUndoStepSize() const
+{
+	int32 Size = 0;
+	for (int32 Offset = Applied - 1; Offset >= 0; --Offset)
+	{
+		++Size;
+		if (At(Offset).Flags & BuildJournalFlags::StepStart) break;
+	}
+	return Size;
+}
+
+bool UBuildJournalComponent::Undo()
+{
+	if (!GetOwner()->HasAuthority())
+	{
+		ServerUndo();
+		return true;
+	}
+
+	if (!CanUndo()) return false;
+
+	SCOPE_CYCLE_COUNTER(STAT_BuildJournalUndo);
+
+	// Newest first, so parts come off before the parts they rest on. A part that has
+	// since decayed is skipped rather than stopping the rest of the step.
+	bool bComplete = true;
+	while (Applied > 0)
+	{
+		FBuildJournalRecord& Record = At(--Applied);
+		bComplete &= Apply(Record, true);
+
+		if (Record.Flags & BuildJournalFlags::StepStart) break;
+	}
+	return bComplete;
+}
+
+bool UBuildJournalComponent::Redo()
+{
+	if (!GetOwner()->HasAuthority())
+	{
+		ServerRedo();
+		return true;
+	}
+
+	if (!CanRedo()) return false;
+
+	SCOPE_CYCLE_COUNTER(STAT_BuildJournalRedo);
+
+	// Oldest first, so supports are back before the parts that need them
+	bool bComplete = true;
+	do
+	{
+		bComplete &= Apply(At(Applied++), false);
+	}
+	while (Applied < Total && !(At(Applied).Flags & BuildJournalFlags::StepStart));
+
+	return bComplete;
+}
+
+void UBuildJournalComponent::ServerUndo_Implementation()
+{
+	Undo();
+}
+
+void UBuildJournalComponent::ServerRedo_Implementation()
+{
+	Redo();
+}
+
+bool UBuildJournalComponent::Apply(FBuildJournalRecord& Record, bool bReverse)
+{
+	const int32 Delta = bReverse ? -Record.BuildingDelta : Record.BuildingDelta;
+	const bool bSpawn = (Record.Op == EBuildJournalOp::Place) != bReverse;
+
+	return bSpawn ? SpawnPart(Record, Delta) : RemovePart(Record, Delta);
+}
+
+bool UBuildJournalComponent::SpawnPart(FBuildJournalRecord& Record, int32 BuildingDelta)
+{
+	UClass* Class = Classes.IsValidIndex(Record.ClassIndex) ? Classes[Record.ClassIndex].Get() : nullptr;
+	if (!Class || !Player) return false;
+
+	int32* Kits = Player->BuildingArray.IsValidIndex(Record.BuildingId) ? &Player->BuildingArray[Record.BuildingId] : nullptr;
+	if (BuildingDelta < 0 && (!Kits || *Kits + BuildingDelta < 0))
+	{
+		return false;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = Player;
+	SpawnParams.Instigator = Player;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	ABuildingPart* Part = GetWorld()->SpawnActor<ABuildingPart>(Class, FVector(Record.Location), FRotator(0.f, Record.Yaw, 0.f), SpawnParams);
+	if (!Part) return false;
+
+	// Something may have been built in the spot since
+	TArray<FBuildingPartHandle> Supports;
+	if (!Player->ValidatePlacement(Part, Part->GetActorTransform(), &Supports))
+	{
+		Part->Destroy();
+		return false;
+	}
+
+	Part->OnPlaced(Supports);
+	Record.Handle = Part->Handle;
+	Record.Flags &= ~BuildJournalFlags::FindByLocation;
+
+	// Undo and redo must not repair a damaged part
+	UBuildingRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UBuildingRegistrySubsystem>();
+	const int32 Index = Registry ? Registry->ToDense(Part->Handle) : INDEX_NONE;
+	if (Index != INDEX_NONE && Record.Health >= 0.f)
+	{
+		FBuildingPartStore& Store = Registry->GetStore();
+		Store.Health[Index] = FMath::Min(Record.Health, Store.MaxHealth[Index]);
+		Part->SetDamageAmount(1.f - Store.Health[Index] / Store.MaxHealth[Index]);
+	}
+
+	if (Kits)
+	{
+		*Kits += BuildingDelta;
+	}
+	return true;
+}
+
+bool UBuildJournalComponent::RemovePart(FBuildJournalRecord& Record, int32 BuildingDelta)
+{
+	ABuildingPart* Part = ResolvePart(Record);
+	if (!Part || !Player) return false;
+
+	UBuildingRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UBuildingRegistrySubsystem>();
+	const int32 Index = Registry ? Registry->ToDense(Part->Handle) : INDEX_NONE;
+	Record.Health = Index != INDEX_NONE ? Registry->GetStore().Health[Index] : -1.f;
+
+	Part->Destroy();
+	Record.Handle.Reset();
+
+	if (Player->BuildingArray.IsValidIndex(Record.BuildingId))
+	{
+		Player->BuildingArray[Record.BuildingId] += BuildingDelta;
+	}
+	return true;
+}
+
+ABuildingPart* UBuildJournalComponent::ResolvePart(const FBuildJournalRecord& Record) const
+{
+	UBuildingRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UBuildingRegistrySubsystem>();
+	UClass* Class = Classes.IsValidIndex(Record.ClassIndex) ? Classes[Record.ClassIndex].Get() : nullptr;
+	if (!Registry || !Class) return nullptr;
+
+	ABuildingPart* Part = Registry->GetActor(Record.Handle);
+	if (!Part && (Record.Flags & BuildJournalFlags::FindByLocation))
+	{
+		const EBuildingPartType Type = Class->GetDefaultObject<ABuildingPart>()->PartType;
+		Part = Registry->GetActor(Registry->FindNearest(FVector(Record.Location), Type, 1.f));
+	}
+
+	return (Part && Part->GetClass() == Class) ? Part : nullptr;
+}
+
+void UBuildJournalComponent::SerializeJournal(FArchive& Ar)
+{
+	int32 Version = 1;
+	Ar << Version;
+
+	TArray<FString> ClassPaths;
+	if (Ar.IsSaving())
+	{
+		for (UClass* Class : Classes)
+		{
+			ClassPaths.Add(Class ? Class->GetPathName() : FString());
+		}
+	}
+	Ar << ClassPaths;
+
+	int32 NumRecords = Total;
+	int32 NumApplied = Applied;
+	Ar << NumRecords;
+	Ar << NumApplied;
+
+	if (Ar.IsSaving())
+	{
+		// Oldest first, so the file does not depend on where the ring wrapped
+		for (int32 Offset = 0; Offset < Total; ++Offset)
+		{
+			FBuildJournalRecord Record = At(Offset);
+			Ar << Record;
+		}
+		return;
+	}
+
+	Reset();
+	Classes.Reset();
+	for (const FString& ClassPath : ClassPaths)
+	{
+		Classes.Add(FSoftClassPath(ClassPath).TryLoadClass<ABuildingPart>());
+	}
+
+	// A smaller ring keeps only the newest records
+	const int32 Skipped = FMath::Max(NumRecords - Records.Num(), 0);
+	for (int32 i = 0; i < NumRecords && !Ar.IsError(); ++i)
+	{
+		FBuildJournalRecord Record;
+		Ar << Record;
+
+		if (i < Skipped) continue;
+
+		Record.Handle.Reset();
+		if (i < NumApplied && Record.Op == EBuildJournalOp::Place)
+		{
+			Record.Flags |= BuildJournalFlags::FindByLocation;
+		}
+		if (i == Skipped)
+		{
+			Record.Flags |= BuildJournalFlags::StepStart;
+		}
+		At(Total++) = Record;
+	}
+	Applied = FMath::Clamp(NumApplied - Skipped, 0, Total);
+}
+
+// Benchmark helper: "Building.JournalBench <Parts>" places a grid of parts in front of the
+// first player as one journaled batch, then times undoing and redoing the whole batch.
+// Leaves the player's kits and parts as they were.
+GAM312_BENCH_COMMAND(GBuildJournalBenchCmd, "Building.JournalBench",
+	"Times undo and redo of a batch placement. Usage: Building.JournalBench <Parts>")
+{
+	APlayerChar* Player = Cast<APlayerChar>(UGameplayStatics::GetPlayerCharacter(World, 0));
+	if (!Player || !Player->HasAuthority() || !Player->BuildJournal) return;
+
+	const int32 BuildingId = 0;
+	UClass* PartClass = Player->GetBuildPartClass(BuildingId).LoadSynchronous();
+	if (!PartClass || !Player->BuildingArray.IsValidIndex(BuildingId)) return;
+
+	const int32 Parts = GAM312Bench::Count(Args, 0, 500);
+	const int32 Side = FMath::CeilToInt(FMath::Sqrt((float)Parts));
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = Player;
+	SpawnParams.Instigator = Player;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	const FVector Origin = Player->GetActorLocation() + Player->GetActorForwardVector() * 500.f;
+	FVector Spacing = FVector::ZeroVector;
+
+	UBuildJournalComponent* Journal = Player->BuildJournal;
+	Journal->BeginBatch();
+	for (int32 i = 0; i < Parts; ++i)
+	{
+		const FVector Location = Origin + FVector((i % Side) * Spacing.X, (i / Side) * Spacing.Y, 0.f);
+		ABuildingPart* Part = World->SpawnActor<ABuildingPart>(PartClass, Location, FRotator::ZeroRotator, SpawnParams);
+		if (!Part) continue;
+
+		if (Spacing.IsZero())
+		{
+			Spacing = Part->GetLocalExtents() * Part->GetActorScale3D().GetAbs() * 2.f;
+		}
+
+		Part->OnPlaced();
+		Journal->RecordPlace(Part, BuildingId);
+	}
+	Journal->EndBatch();
+
+	const int32 StepSize = Journal->GetUndoStepSize();
+
+	// The parts were placed without spending kits, so each undo leaves the player Parts kits up
+	const double UndoStart = FPlatformTime::Seconds();
+	Journal->Undo();
+	const double UndoMs = GAM312Bench::MsSince(UndoStart);
+
+	const double RedoStart = FPlatformTime::Seconds();
+	const bool bRedone = Journal->Redo();
+	const double RedoMs = GAM312Bench::MsSince(RedoStart);
+
+	Journal->Undo();
+	Player->BuildingArray[BuildingId] -= Parts;
+
+	UE_LOG(LogGAM312, Log, TEXT("Building.JournalBench: undid %d parts in %.2f ms, redid them in %.2f ms%s."),
+		StepSize, UndoMs, RedoMs, bRedone ? TEXT("") : TEXT(" (some no longer fit)"));
+}
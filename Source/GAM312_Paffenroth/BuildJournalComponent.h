@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "BuildingPartHandle.h"
+#include "BuildJournalComponent.generated.h"
+
+class APlayerChar;
+class ABuildingPart;
+
+// What a journal record did when it was applied
+enum class EBuildJournalOp : uint8
+{
+	Place,   // Spawned a part and spent a building kit
+	Remove   // Removed a part and refunded its kit
+};
+
+namespace BuildJournalFlags
+{
+	// First record of an undo step. Batches are one step.
+	constexpr uint8 StepStart = 1 << 0;
+
+	// Loaded from a save while applied. Its part is found by location, since handles do not persist.
+	constexpr uint8 FindByLocation = 1 << 1;
+}
+
+// One journaled change to one part. Fixed size, so the ring never allocates per command.
+struct FBuildJournalRecord
+{
+	EBuildJournalOp Op = EBuildJournalOp::Place;
+	uint8 Flags = 0;
+
+	// Index into the journal's class table
+	uint8 ClassIndex = 0;
+
+	// BuildingArray slot the kit came from, or INDEX_NONE
+	int8 BuildingId = INDEX_NONE;
+
+	// Part while it exists in the world. Stale after it is removed or the journal is loaded.
+	FBuildingPartHandle Handle;
+
+	FVector3f Location = FVector3f::ZeroVector;
+	float Yaw = 0.f;
+
+	// Health when the part was last removed, restored when it comes back. Negative for full health.
+	float Health = -1.f;
+
+	// Change to the BuildingArray slot when the record is applied; undo reverses it
+	int32 BuildingDelta = 0;
+
+	friend FArchive& operator<<(FArchive& Ar, FBuildJournalRecord& Record);
+};
+static_assert(sizeof(FBuildJournalRecord) == 32, "Journal records are meant to stay at 32 bytes");
+
+/**
+ * Undo/redo history of one player's building. Records live in a fixed ring allocated once at
+ * BeginPlay; when it fills, the oldest steps are forgotten. Undo and redo touch only the parts
+ * in the step, so a batch placement reverses in one call. Runs where parts are placed, so
+ * remote clients forward their requests to the server; the kits it spends and refunds reach
+ * the owning client through the player's replicated BuildingArray.
+ */
+UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
+class GAM312_PAFFENROTH_API UBuildJournalComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UBuildJournalComponent();
+
+	// Notes a part the player just placed with a kit from a BuildingArray slot
+	void RecordPlace(const ABuildingPart* Part, int32 BuildingId);
+
+	// Notes a part about to be removed, with the slot its kit was refunded to
+	void RecordRemove(const ABuildingPart* Part, int32 BuildingId);
+
+	// Everything recorded until EndBatch undoes and redoes as one step
+	void BeginBatch();
+	void EndBatch();
+
+	// Reverses the newest step. Returns false if there is nothing to undo or it could not be fully reversed.
+	UFUNCTION(BlueprintCallable, Category = "Building")
+		bool Undo();
+
+	// Reapplies the newest undone step. Returns false if nothing was undone or a part no longer fits.
+	UFUNCTION(BlueprintCallable, Category = "Building")
+		bool Redo();
+
+	UFUNCTION(Server, Reliable)
+		void ServerUndo();
+
+	UFUNCTION(Server, Reliable)
+		void ServerRedo();
+
+	bool CanUndo() const { return Applied > 0; }
+	bool CanRedo() const { return Applied < Total; }
+
+	// Parts changed by the newest step, or the next redo
+	int32 GetUndoStepSize() const;
+
+	// Saves or loads the history. Handles are dropped on load and parts are found by location instead.
+	void SerializeJournal(FArchive& Ar);
+
+	// Drops all history
+	void Reset();
+
+	// Records kept before the oldest steps are forgotten
+	UPROPERTY(EditAnywhere, Category = "Build Journal")
+		int32 MaxRecords = 4096;
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	FBuildJournalRecord& At(int32 Offset) { return Records[(Begin + Offset) % Records.Num()]; }
+	const FBuildJournalRecord& At(int32 Offset) const { return Records[(Begin + Offset) % Records.Num()]; }
+
+	void Push(FBuildJournalRecord Record);
+
+	// Forgets the oldest step to make room
+	void DropOldestStep();
+
+	// Applies or reverses one record. Returns false if the world no longer allows it.
+	bool Apply(FBuildJournalRecord& Record, bool bReverse);
+
+	// Spawns the record's part, spending a kit if BuildingDelta is negative
+	bool SpawnPart(FBuildJournalRecord& Record, int32 BuildingDelta);
+
+	// Removes the record's part, refunding a kit if BuildingDelta is positive
+	bool RemovePart(FBuildJournalRecord& Record, int32 BuildingDelta);
+
+	ABuildingPart* ResolvePart(const FBuildJournalRecord& Record) const;
+
+	// Index records use for a part class, or INDEX_NONE once a byte cannot hold another
+	int32 ClassIndexFor(UClass* Class);
+
+	UPROPERTY(Transient)
+		TObjectPtr<APlayerChar> Player;
+
+	// Part classes the records refer to by index
+	UPROPERTY(Transient)
+		TArray<TObjectPtr<UClass>> Classes;
+
+	// Ring storage, sized once
+	TArray<FBuildJournalRecord> Records;
+
+	// Ring index of the oldest record
+	int32 Begin = 0;
+
+	// Records currently applied, counted from Begin. Records past this are redoable.
+	int32 Applied = 0;
+
+	// Records held, applied or redoable
+	int32 Total = 0;
+
+	bool bInBatch = false;
+	bool bBatchStarted = false;
+};
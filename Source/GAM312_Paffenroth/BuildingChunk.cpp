@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingChunk.h"
+#include "Engine/CollisionProfile.h"
+#include "PhysicsEngine/BodySetup.h"
+
+// Slack when testing whether a hit point belongs to an element box
+static constexpr float ElementContainsTolerance = 2.f;
+
+UBuildingChunkCollisionComponent::UBuildingChunkCollisionComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+	SetGenerateOverlapEvents(false);
+	bHiddenInGame = true;
+	Mobility = EComponentMobility::Static;
+}
+
+UBodySetup* UBuildingChunkCollisionComponent::GetBodySetup()
+{
+	return ChunkBodySetup;
+}
+
+FBoxSphereBounds UBuildingChunkCollisionComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	if (Elements.Num() == 0)
+	{
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.f);
+	}
+
+	FBox Box(ForceInit);
+	for (const FBuildingChunkElement& Element : Elements)
+	{
+		Box += FBox(-Element.HalfExtent, Element.HalfExtent).TransformBy(Element.LocalTransform);
+	}
+	return FBoxSphereBounds(Box.TransformBy(LocalToWorld));
+}
+
+void UBuildingChunkCollisionComponent::AddElement(FBuildingPartHandle Part, const FVector& Center, const FQuat& Rotation, const FVector& HalfExtent)
+{
+	FBuildingChunkElement& Element = Elements.AddDefaulted_GetRef();
+	Element.HalfExtent = HalfExtent;
+	Element.LocalTransform = FTransform(Rotation, Center).GetRelativeTransform(GetComponentTransform());
+	Element.Part = Part;
+}
+
+void UBuildingChunkCollisionComponent::RemoveElement(FBuildingPartHandle Part)
+{
+	Elements.RemoveAllSwap([Part](const FBuildingChunkElement& Element)
+	{
+		return Element.Part == Part;
+	});
+}
+
+void UBuildingChunkCollisionComponent::RebuildBody()
+{
+	if (!ChunkBodySetup)
+	{
+		ChunkBodySetup = NewObject<UBodySetup>(this, NAME_None, RF_Transient);
+		ChunkBodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+		ChunkBodySetup->bGenerateMirroredCollision = false;
+	}
+
+	ChunkBodySetup->AggGeom.BoxElems.Reset(Elements.Num());
+	for (const FBuildingChunkElement& Element : Elements)
+	{
+		FKBoxElem Box(Element.HalfExtent.X * 2.f, Element.HalfExtent.Y * 2.f, Element.HalfExtent.Z * 2.f);
+		Box.Center = Element.LocalTransform.GetLocation();
+		Box.Rotation = Element.LocalTransform.Rotator();
+		ChunkBodySetup->AggGeom.BoxElems.Add(Box);
+	}
+
+	ChunkBodySetup->InvalidatePhysicsData();
+	ChunkBodySetup->CreatePhysicsMeshes();
+
+	RecreatePhysicsState();
+	UpdateBounds();
+}
+
+FBuildingPartHandle UBuildingChunkCollisionComponent::ResolvePart(const FVector& WorldPoint, int32 ElementHint) const
+{
+	const FVector LocalPoint = GetComponentTransform().InverseTransformPosition(WorldPoint);
+
+	auto Contains = [&LocalPoint](const FBuildingChunkElement& Element)
+	{
+		const FVector P = Element.LocalTransform.InverseTransformPositionNoScale(LocalPoint).GetAbs();
+		const FVector Max = Element.HalfExtent + FVector(ElementContainsTolerance);
+		return P.X <= Max.X && P.Y <= Max.Y && P.Z <= Max.Z;
+	};
+
+	// Box element order matches Elements, so the hit element index is usually exact
+	if (Elements.IsValidIndex(ElementHint) && Contains(Elements[ElementHint]))
+	{
+		return Elements[ElementHint].Part;
+	}
+
+	for (const FBuildingChunkElement& Element : Elements)
+	{
+		if (Contains(Element))
+		{
+			return Element.Part;
+		}
+	}
+	return FBuildingPartHandle();
+}
+
+ABuildingChunkActor::ABuildingChunkActor()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	Collision = CreateDefaultSubobject<UBuildingChunkCollisionComponent>(TEXT("Collision"));
+	RootComponent = Collision;
+}
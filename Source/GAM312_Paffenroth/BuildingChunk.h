@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Components/PrimitiveComponent.h"
+#include "BuildingPartHandle.h"
+#include "BuildingChunk.generated.h"
+
+class UBodySetup;
+
+// One placed part's box inside a chunk body
+struct FBuildingChunkElement
+{
+	// Box centre and rotation relative to the chunk
+	FTransform LocalTransform;
+
+	FVector HalfExtent = FVector::ZeroVector;
+
+	FBuildingPartHandle Part;
+};
+
+/**
+ * Single compound collision body built from the boxes of every placed part in a chunk.
+ */
+UCLASS(ClassGroup = (Custom))
+class GAM312_PAFFENROTH_API UBuildingChunkCollisionComponent : public UPrimitiveComponent
+{
+	GENERATED_BODY()
+
+public:
+	UBuildingChunkCollisionComponent();
+
+	virtual UBodySetup* GetBodySetup() override;
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+	// Adds a part's world-space box. The body is rebuilt by RebuildBody.
+	void AddElement(FBuildingPartHandle Part, const FVector& Center, const FQuat& Rotation, const FVector& HalfExtent);
+
+	// Removes a part's box. The body is rebuilt by RebuildBody.
+	void RemoveElement(FBuildingPartHandle Part);
+
+	// Recreates the physics body from the current elements
+	void RebuildBody();
+
+	// Finds the part whose box contains a world-space point, using the hit element index as a hint
+	FBuildingPartHandle ResolvePart(const FVector& WorldPoint, int32 ElementHint = INDEX_NONE) const;
+
+	int32 GetNumElements() const { return Elements.Num(); }
+
+private:
+	TArray<FBuildingChunkElement> Elements;
+
+	UPROPERTY(Transient)
+		TObjectPtr<UBodySetup> ChunkBodySetup;
+};
+
+/**
+ * Owns the merged collision body for the placed parts in one spatial chunk.
+ */
+UCLASS(NotPlaceable)
+class GAM312_PAFFENROTH_API ABuildingChunkActor : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ABuildingChunkActor();
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Building")
+		UBuildingChunkCollisionComponent* Collision;
+};
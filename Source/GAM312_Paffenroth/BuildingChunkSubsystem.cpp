@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingChunkSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "BuildingChunk.h"
+#include "BuildingRegistrySubsystem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Building Chunk Rebuild"), STAT_BuildingChunkRebuild, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Chunk Bodies"), STAT_BuildingChunkBodies, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Chunk Elements"), STAT_BuildingChunkElements, STATGROUP_GAM312);
+
+void UBuildingChunkSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Registry = Collection.InitializeDependency<UBuildingRegistrySubsystem>();
+
+	// However a part leaves the registry, its box leaves its chunk while the handle still resolves
+	RemovedHandle = Registry->OnPartRemoved.AddUObject(this, &UBuildingChunkSubsystem::RemovePart);
+}
+
+void UBuildingChunkSubsystem::Deinitialize()
+{
+	if (Registry)
+	{
+		Registry->OnPartRemoved.Remove(RemovedHandle);
+	}
+
+	Chunks.Empty();
+	DirtyChunks.Empty();
+	PartChunks.Empty();
+	Registry = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UBuildingChunkSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UBuildingChunkSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBuildingChunkSubsystem, STATGROUP_Tickables);
+}
+
+FIntVector UBuildingChunkSubsystem::ChunkKeyFor(const FVector& Location) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Location.X / ChunkSize),
+		FMath::FloorToInt(Location.Y / ChunkSize),
+		FMath::FloorToInt(Location.Z / ChunkSize));
+}
+
+ABuildingChunkActor* UBuildingChunkSubsystem::FindOrCreateChunk(const FIntVector& Key)
+{
+	if (TObjectPtr<ABuildingChunkActor>* Existing = Chunks.Find(Key))
+	{
+		if (*Existing)
+		{
+			return *Existing;
+		}
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	const FVector Origin = FVector(Key) * ChunkSize;
+	ABuildingChunkActor* Chunk = GetWorld()->SpawnActor<ABuildingChunkActor>(ABuildingChunkActor::StaticClass(), Origin, FRotator::ZeroRotator, SpawnParams);
+	Chunks.Add(Key, Chunk);
+	return Chunk;
+}
+
+void UBuildingChunkSubsystem::AddPart(FBuildingPartHandle Part)
+{
+	const int32 Index = Registry ? Registry->ToDense(Part) : INDEX_NONE;
+	if (Index == INDEX_NONE || PartChunks.Contains(Part)) return;
+
+	const FBuildingPartStore& Store = Registry->GetStore();
+	const FIntVector Key = ChunkKeyFor(Store.Location[Index]);
+	ABuildingChunkActor* Chunk = FindOrCreateChunk(Key);
+	if (!Chunk) return;
+
+	Chunk->Collision->AddElement(Part, Store.BoxCenter[Index], Store.Transform[Index].GetRotation(), Store.BoxExtent[Index]);
+	PartChunks.Add(Part, Key);
+
+	// The chunk body now blocks for this part
+	if (ABuildingPart* Actor = Store.Actor[Index].Get())
+	{
+		Actor->Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	}
+
+	DirtyChunks.Add(Key);
+}
+
+void UBuildingChunkSubsystem::RemovePart(FBuildingPartHandle Part)
+{
+	FIntVector Key;
+	if (!PartChunks.RemoveAndCopyValue(Part, Key)) return;
+
+	if (TObjectPtr<ABuildingChunkActor>* Chunk = Chunks.Find(Key))
+	{
+		if (*Chunk)
+		{
+			(*Chunk)->Collision->RemoveElement(Part);
+			DirtyChunks.Add(Key);
+		}
+	}
+
+	// A part that outlives its chunk box blocks on its own again, as its class sets up
+	ABuildingPart* Actor = Registry ? Registry->GetActor(Part) : nullptr;
+	if (Actor && !Actor->IsActorBeingDestroyed())
+	{
+		const ABuildingPart* Defaults = Actor->GetClass()->GetDefaultObject<ABuildingPart>();
+		Actor->Mesh->SetCollisionEnabled(Defaults->Mesh ? Defaults->Mesh->GetCollisionEnabled() : ECollisionEnabled::QueryAndPhysics);
+	}
+}
+
+FBuildingPartHandle UBuildingChunkSubsystem::ResolveHitHandle(const FHitResult& Hit)
+{
+	if (const UBuildingChunkCollisionComponent* ChunkCollision = Cast<UBuildingChunkCollisionComponent>(Hit.GetComponent()))
+	{
+		return ChunkCollision->ResolvePart(Hit.ImpactPoint - Hit.ImpactNormal, Hit.ElementIndex);
+	}
+
+	const ABuildingPart* Part = Cast<ABuildingPart>(Hit.GetActor());
+	return Part ? Part->Handle : FBuildingPartHandle();
+}
+
+ABuildingPart* UBuildingChunkSubsystem::ResolveHitPart(const FHitResult& Hit)
+{
+	if (ABuildingPart* Part = Cast<ABuildingPart>(Hit.GetActor()))
+	{
+		return Part;
+	}
+
+	const UWorld* World = Hit.GetComponent() ? Hit.GetComponent()->GetWorld() : nullptr;
+	const UBuildingRegistrySubsystem* Registry = World ? World->GetSubsystem<UBuildingRegistrySubsystem>() : nullptr;
+	return Registry ? Registry->GetActor(ResolveHitHandle(Hit)) : nullptr;
+}
+
+void UBuildingChunkSubsystem::Tick(float DeltaTime)
+{
+	if (DirtyChunks.Num() > 0)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_BuildingChunkRebuild);
+
+		for (const FIntVector& Key : DirtyChunks)
+		{
+			TObjectPtr<ABuildingChunkActor>* Chunk = Chunks.Find(Key);
+			if (!Chunk || !*Chunk) continue;
+
+			if ((*Chunk)->Collision->GetNumElements() == 0)
+			{
+				(*Chunk)->Destroy();
+				Chunks.Remove(Key);
+			}
+			else
+			{
+				(*Chunk)->Collision->RebuildBody();
+			}
+		}
+		DirtyChunks.Reset();
+	}
+
+#if STATS
+	int32 NumElements = 0;
+	for (const TPair<FIntVector, TObjectPtr<ABuildingChunkActor>>& Pair : Chunks)
+	{
+		NumElements += Pair.Value ? Pair.Value->Collision->GetNumElements() : 0;
+	}
+	SET_DWORD_STAT(STAT_BuildingChunkBodies, Chunks.Num());
+	SET_DWORD_STAT(STAT_BuildingChunkElements, NumElements);
+#endif
+}
@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "BuildingPartHandle.h"
+#include "BuildingChunkSubsystem.generated.h"
+
+class ABuildingPart;
+class ABuildingChunkActor;
+class UBuildingRegistrySubsystem;
+
+/**
+ * Merges the collision of placed building parts into one compound body per spatial
+ * chunk, so a large base adds a handful of bodies to the broadphase instead of one
+ * per part. Chunks touched during a frame are rebuilt once at the end of it.
+ * Chunk actors are local: the server and every client build their own from the parts
+ * they have, so movement and traces collide the same way everywhere.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UBuildingChunkSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Moves a registered part's collision into its chunk body
+	void AddPart(FBuildingPartHandle Part);
+
+	// Takes a part's box out of its chunk body and gives the part its own collision back.
+	// Called for every part the registry removes.
+	void RemovePart(FBuildingPartHandle Part);
+
+	// Maps a query hit back to the building part it touched, whether it hit a chunk body or the part itself
+	static FBuildingPartHandle ResolveHitHandle(const FHitResult& Hit);
+
+	// As ResolveHitHandle, returning the part's actor if it has one
+	static ABuildingPart* ResolveHitPart(const FHitResult& Hit);
+
+	// Chunk key for a world location
+	FIntVector ChunkKeyFor(const FVector& Location) const;
+
+	// Side length of a chunk
+	UPROPERTY(Config)
+		float ChunkSize = 2000.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	ABuildingChunkActor* FindOrCreateChunk(const FIntVector& Key);
+
+	UPROPERTY(Transient)
+		TMap<FIntVector, TObjectPtr<ABuildingChunkActor>> Chunks;
+
+	// Chunks whose body must be rebuilt this frame
+	TSet<FIntVector> DirtyChunks;
+
+	// Chunk each part's box lives in
+	TMap<FBuildingPartHandle, FIntVector> PartChunks;
+
+	UPROPERTY(Transient)
+		TObjectPtr<UBuildingRegistrySubsystem> Registry;
+
+	FDelegateHandle RemovedHandle;
+};
@@ -0,0 +1,196 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingDecaySubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "BuildingRegistrySubsystem.h"
+#include "FrameBudgetSubsystem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Building Decay Tick"), STAT_BuildingDecayTick, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Decay Parts"), STAT_BuildingDecayParts, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Decay Slice"), STAT_BuildingDecaySlice, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Collapses Pending"), STAT_BuildingCollapsesPending, STATGROUP_GAM312);
+
+void UBuildingDecaySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Registry = Collection.InitializeDependency<UBuildingRegistrySubsystem>();
+}
+
+void UBuildingDecaySubsystem::Deinitialize()
+{
+	Registry = nullptr;
+	PendingCollapse.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UBuildingDecaySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UBuildingDecaySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBuildingDecaySubsystem, STATGROUP_Tickables);
+}
+
+int32 UBuildingDecaySubsystem::GetNumParts() const
+{
+	return Registry ? Registry->Num() : 0;
+}
+
+void UBuildingDecaySubsystem::AddSyntheticParts(int32 Count, float MaxHealth, float DecayRate)
+{
+	if (!Registry) return;
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	FBuildingPartStore& Store = Registry->GetStore();
+
+	FRandomStream Random(Count);
+	for (int32 i = 0; i < Count; ++i)
+	{
+		const FTransform Transform(FVector(Random.FRandRange(-50000.f, 50000.f), Random.FRandRange(-50000.f, 50000.f), 0.f));
+		const FBuildingPartHandle Handle = Registry->AddPartData(EBuildingPartType::Floor, Transform, FVector(200.f, 200.f, 10.f), MaxHealth, DecayRate);
+
+		// Start them past the grace period so they decay straight away
+		Store.LastTouched[Registry->ToDense(Handle)] = Now - DecayGracePeriod;
+	}
+}
+
+void UBuildingDecaySubsystem::KillPart(int32 Index)
+{
+	FBuildingPartStore& Store = Registry->GetStore();
+
+	if (ABuildingPart* Part = Store.Actor[Index].Get())
+	{
+		PendingCollapse.Add(Part);
+	}
+	Registry->RemovePart(Store.Handle[Index]);
+}
+
+void UBuildingDecaySubsystem::ApplyDamage(FBuildingPartHandle Handle, float Amount)
+{
+	const int32 Index = Registry ? Registry->ToDense(Handle) : INDEX_NONE;
+	if (Index == INDEX_NONE) return;
+
+	FBuildingPartStore& Store = Registry->GetStore();
+	Store.Health[Index] -= Amount;
+	Store.LastTouched[Index] = GetWorld()->GetTimeSeconds();
+
+	if (Store.Health[Index] <= 0.f)
+	{
+		KillPart(Index);
+	}
+	else if (ABuildingPart* Part = Store.Actor[Index].Get())
+	{
+		Part->SetDamageAmount(1.f - Store.Health[Index] / Store.MaxHealth[Index]);
+	}
+}
+
+void UBuildingDecaySubsystem::RepairPart(FBuildingPartHandle Handle)
+{
+	const int32 Index = Registry ? Registry->ToDense(Handle) : INDEX_NONE;
+	if (Index == INDEX_NONE) return;
+
+	FBuildingPartStore& Store = Registry->GetStore();
+	Store.Health[Index] = Store.MaxHealth[Index];
+	Store.LastTouched[Index] = GetWorld()->GetTimeSeconds();
+
+	if (ABuildingPart* Part = Store.Actor[Index].Get())
+	{
+		Part->SetDamageAmount(0.f);
+	}
+}
+
+void UBuildingDecaySubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_BuildingDecayTick);
+
+	// Only the server decays parts. Clients see each part's damage through ABuildingPart::ReplicatedDamage.
+	if (!Registry || GetWorld()->GetNetMode() == NM_Client) return;
+
+	const FBuildingPartStore& Store = Registry->GetStore();
+
+	// Enough parts per frame to cover the whole store once per AmortisePeriod, capped. The frame
+	// budget lowers the cap under load; parts decay for all the time since they were last processed.
+	const int32 Wanted = FMath::CeilToInt(Store.Num() * DeltaTime / FMath::Max(AmortisePeriod, KINDA_SMALL_NUMBER));
+	const float BudgetScale = UFrameBudgetSubsystem::GetScale(GetWorld(), EFrameBudgetKnob::DecaySlice);
+	const int32 SliceSize = FMath::Min(Wanted, FMath::Max(FMath::RoundToInt(MaxSlicePerFrame * BudgetScale), 1));
+
+	ProcessSlice(SliceSize, GetWorld()->GetTimeSeconds());
+	FlushCollapses();
+
+	SET_DWORD_STAT(STAT_BuildingDecayParts, Store.Num());
+	SET_DWORD_STAT(STAT_BuildingDecaySlice, SliceSize);
+	SET_DWORD_STAT(STAT_BuildingCollapsesPending, PendingCollapse.Num());
+}
+
+void UBuildingDecaySubsystem::ProcessSlice(int32 Count, double Now)
+{
+	FBuildingPartStore& Store = Registry->GetStore();
+
+	for (int32 Processed = 0; Processed < Count && Store.Num() > 0; ++Processed)
+	{
+		if (Cursor >= Store.Num())
+		{
+			Cursor = 0;
+		}
+
+		const int32 Index = Cursor;
+		const double Elapsed = Now - Store.LastProcessed[Index];
+		Store.LastProcessed[Index] = Now;
+
+		// Only the part of the elapsed time past the grace period counts as decay
+		const double DecayStart = Store.LastTouched[Index] + DecayGracePeriod;
+		if (Now > DecayStart)
+		{
+			const double DecayTime = FMath::Min(Elapsed, Now - DecayStart);
+			Store.Health[Index] -= Store.DecayRate[Index] * DecayTime;
+		}
+
+		if (Store.Health[Index] <= 0.f)
+		{
+			// The last slot moves into this one, so process the same index again
+			KillPart(Index);
+			continue;
+		}
+
+		if (ABuildingPart* Part = Store.Actor[Index].Get())
+		{
+			Part->SetDamageAmount(1.f - Store.Health[Index] / Store.MaxHealth[Index]);
+		}
+		++Cursor;
+	}
+}
+
+void UBuildingDecaySubsystem::FlushCollapses()
+{
+	const int32 NumToCollapse = FMath::Min(PendingCollapse.Num(), MaxCollapsePerFrame);
+
+	for (int32 i = 0; i < NumToCollapse; ++i)
+	{
+		if (ABuildingPart* Part = PendingCollapse[i].Get())
+		{
+			Part->Collapse();
+		}
+	}
+
+	PendingCollapse.RemoveAt(0, NumToCollapse, EAllowShrinking::No);
+}
+
+// Benchmark helper: "Building.DecayStress <Count>" adds actor-less parts to the registry.
+// With "stat GAM312" the decay slice stays at MaxSlicePerFrame however large the store gets.
+GAM312_BENCH_COMMAND(GBuildingDecayStressCmd, "Building.DecayStress",
+	"Adds synthetic parts to the building decay store. Usage: Building.DecayStress <Count>")
+{
+	UBuildingDecaySubsystem* Decay = World ? World->GetSubsystem<UBuildingDecaySubsystem>() : nullptr;
+	if (!Decay) return;
+
+	const int32 Count = GAM312Bench::Count(Args, 0, 50000);
+	Decay->AddSyntheticParts(Count, 500.f, 0.1f);
+
+	UE_LOG(LogGAM312, Log, TEXT("Building.DecayStress: registry now holds %d parts"), Decay->GetNumParts());
+}
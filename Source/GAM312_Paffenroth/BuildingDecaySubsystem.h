@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "BuildingPartHandle.h"
+#include "BuildingDecaySubsystem.generated.h"
+
+class ABuildingPart;
+class UBuildingRegistrySubsystem;
+
+/**
+ * Applies upkeep decay and damage to placed building parts without ticking them.
+ * Health lives in the building registry. Each frame processes a bounded slice of parts
+ * round-robin, so the whole set is covered once per AmortisePeriod and the per-frame
+ * cost never exceeds MaxSlicePerFrame. Only runs where the world has authority.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UBuildingDecaySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Removes health from a part and restarts its decay grace period
+	void ApplyDamage(FBuildingPartHandle Handle, float Amount);
+
+	// Restores a part to full health
+	void RepairPart(FBuildingPartHandle Handle);
+
+	int32 GetNumParts() const;
+
+	// Adds parts with no actor to the registry, used to stress the scheduler
+	void AddSyntheticParts(int32 Count, float MaxHealth, float DecayRate);
+
+// --- Settings ---
+
+	// Seconds it takes to process every part once
+	UPROPERTY(Config)
+		float AmortisePeriod = 10.0f;
+
+	// Upper bound on parts processed per frame
+	UPROPERTY(Config)
+		int32 MaxSlicePerFrame = 512;
+
+	// Upper bound on parts collapsed per frame
+	UPROPERTY(Config)
+		int32 MaxCollapsePerFrame = 16;
+
+	// Seconds after the last touch before decay starts
+	UPROPERTY(Config)
+		float DecayGracePeriod = 3600.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void ProcessSlice(int32 Count, double Now);
+
+	// Removes a dead part from the registry and queues its actor to collapse
+	void KillPart(int32 Index);
+
+	void FlushCollapses();
+
+	UPROPERTY(Transient)
+		TObjectPtr<UBuildingRegistrySubsystem> Registry;
+
+	// Next slot to process
+	int32 Cursor = 0;
+
+	// Parts whose health reached zero, waiting to be collapsed
+	TArray<TWeakObjectPtr<ABuildingPart>> PendingCollapse;
+};
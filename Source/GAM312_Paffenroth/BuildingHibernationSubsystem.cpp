@@ -0,0 +1,660 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingHibernationSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "BuildingChunk.h"
+#include "BuildingChunkSubsystem.h"
+#include "BuildingRegistrySubsystem.h"
+#include "Async/Async.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DECLARE_CYCLE_STAT(TEXT("Building Hibernation Tick"), STAT_BuildingHibernationTick, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Hibernated Chunks"), STAT_BuildingHibernatedChunks, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Hibernated Parts"), STAT_BuildingHibernatedParts, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Chunks Restoring"), STAT_BuildingChunksRestoring, STATGROUP_GAM312);
+
+namespace BuildingHibernation
+{
+	static constexpr uint32 FileMagic = 0x4E524248; // "HBRN"
+	static constexpr int32 FileVersion = 2;
+
+	// Compresses a serialised cluster and writes it with a small uncompressed header
+	static void WriteFile(const FString& Path, const TArray<uint8>& Raw)
+	{
+		int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Oodle, Raw.Num());
+		TArray<uint8> Compressed;
+		Compressed.SetNumUninitialized(CompressedSize);
+
+		if (!FCompression::CompressMemory(NAME_Oodle, Compressed.GetData(), CompressedSize, Raw.GetData(), Raw.Num()))
+		{
+			UE_LOG(LogGAM312, Error, TEXT("Could not compress hibernated chunk %s"), *Path);
+			return;
+		}
+
+		TArray<uint8> Bytes;
+		FMemoryWriter Writer(Bytes);
+		uint32 Magic = FileMagic;
+		int32 Version = FileVersion;
+		int32 RawSize = Raw.Num();
+		Writer << Magic << Version << RawSize;
+		Writer.Serialize(Compressed.GetData(), CompressedSize);
+
+		if (!FFileHelper::SaveArrayToFile(Bytes, *Path))
+		{
+			UE_LOG(LogGAM312, Error, TEXT("Could not write hibernated chunk %s"), *Path);
+		}
+	}
+
+	// Id a part's owner is saved under: the player's net id, or their name where there is none
+	static FString OwnerIdFor(const AActor* Owner)
+	{
+		const APawn* Pawn = Cast<APawn>(Owner);
+		const APlayerState* PlayerState = Pawn ? Pawn->GetPlayerState() : nullptr;
+		if (!PlayerState) return FString();
+
+		const FUniqueNetIdRepl& NetId = PlayerState->GetUniqueId();
+		return NetId.IsValid() ? NetId.ToString() : PlayerState->GetPlayerName();
+	}
+
+	// Pawn of the player a saved owner id belongs to, if they are playing
+	static APawn* FindOwner(UWorld* World, const FString& Id)
+	{
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			const APlayerController* Controller = It->Get();
+			APawn* Pawn = Controller ? Controller->GetPawn() : nullptr;
+			if (Pawn && OwnerIdFor(Pawn) == Id)
+			{
+				return Pawn;
+			}
+		}
+		return nullptr;
+	}
+
+	// Reads and decompresses a cluster. Returns null if the file is missing or damaged.
+	static TSharedPtr<FHibernatedCluster> ReadFile(const FString& Path)
+	{
+		TArray<uint8> Bytes;
+		if (!FFileHelper::LoadFileToArray(Bytes, *Path))
+		{
+			return nullptr;
+		}
+
+		FMemoryReader Reader(Bytes);
+		uint32 Magic = 0;
+		int32 Version = 0;
+		int32 RawSize = 0;
+		Reader << Magic << Version << RawSize;
+		if (Magic != FileMagic || Version != FileVersion || RawSize <= 0)
+		{
+			return nullptr;
+		}
+
+		const int64 HeaderSize = Reader.Tell();
+		TArray<uint8> Raw;
+		Raw.SetNumUninitialized(RawSize);
+		if (!FCompression::UncompressMemory(NAME_Oodle, Raw.GetData(), RawSize, Bytes.GetData() + HeaderSize, Bytes.Num() - HeaderSize))
+		{
+			return nullptr;
+		}
+
+		TSharedPtr<FHibernatedCluster> Cluster = MakeShared<FHibernatedCluster>();
+		FMemoryReader RawReader(Raw);
+		RawReader << *Cluster;
+		return RawReader.IsError() ? nullptr : Cluster;
+	}
+}
+
+FArchive& operator<<(FArchive& Ar, FHibernatedPart& Part)
+{
+	uint8 Type = (uint8)Part.Type;
+
+	Ar << Part.ClassIndex;
+	Ar << Part.OwnerIndex;
+	Ar << Type;
+	Ar << Part.Transform;
+	Ar << Part.LocalExtent;
+	Ar << Part.BoxCenter;
+	Ar << Part.BoxExtent;
+	Ar << Part.Health;
+	Ar << Part.MaxHealth;
+	Ar << Part.DecayRate;
+	Ar << Part.LastTouched;
+	for (int32& Support : Part.Supports)
+	{
+		Ar << Support;
+	}
+
+	Part.Type = (EBuildingPartType)Type;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FHibernatedCluster& Cluster)
+{
+	Ar << Cluster.Key;
+	Ar << Cluster.HibernatedAt;
+	Ar << Cluster.Classes;
+	Ar << Cluster.Owners;
+	Ar << Cluster.Parts;
+	return Ar;
+}
+
+void UBuildingHibernationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Registry = Collection.InitializeDependency<UBuildingRegistrySubsystem>();
+	Chunks = Collection.InitializeDependency<UBuildingChunkSubsystem>();
+
+	Directory = FPaths::ProjectSavedDir() / TEXT("Hibernation") / GetWorld()->GetMapName();
+}
+
+void UBuildingHibernationSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// Placed parts do not outlive the world, so neither do files left by an earlier run. Only
+	// the server hibernates, and a client sharing its Saved directory must not wipe its files.
+	// The net mode is only known once play begins.
+	if (InWorld.GetNetMode() != NM_Client)
+	{
+		IFileManager::Get().DeleteDirectory(*Directory, false, true);
+		IFileManager::Get().MakeDirectory(*Directory, true);
+	}
+}
+
+void UBuildingHibernationSubsystem::Deinitialize()
+{
+	FlushWrites();
+
+	for (FRestoreJob& Job : Restoring)
+	{
+		if (Job.Load.IsValid())
+		{
+			Job.Load.Wait();
+		}
+	}
+
+	Restoring.Empty();
+	Hibernated.Empty();
+	LastVisited.Empty();
+	Occupied.Empty();
+	Registry = nullptr;
+	Chunks = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UBuildingHibernationSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UBuildingHibernationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBuildingHibernationSubsystem, STATGROUP_Tickables);
+}
+
+FString UBuildingHibernationSubsystem::GetChunkPath(const FIntVector& Key) const
+{
+	return Directory / FString::Printf(TEXT("%d_%d_%d.bin"), Key.X, Key.Y, Key.Z);
+}
+
+int32 UBuildingHibernationSubsystem::GetNumHibernatedParts() const
+{
+	int32 Total = 0;
+	for (const TPair<FIntVector, FHibernationRecord>& Pair : Hibernated)
+	{
+		Total += Pair.Value.NumParts;
+	}
+	return Total;
+}
+
+void UBuildingHibernationSubsystem::FlushWrites()
+{
+	for (TPair<FIntVector, FHibernationRecord>& Pair : Hibernated)
+	{
+		if (Pair.Value.Write.IsValid())
+		{
+			Pair.Value.Write.Wait();
+		}
+	}
+}
+
+void UBuildingHibernationSubsystem::GatherPlayerLocations(TArray<FVector, TInlineAllocator<16>>& OutLocations) const
+{
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APawn* PlayerPawn = It->Get() ? It->Get()->GetPawn() : nullptr)
+		{
+			OutLocations.Add(PlayerPawn->GetActorLocation());
+		}
+	}
+}
+
+void UBuildingHibernationSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_BuildingHibernationTick);
+
+	// Clients only see what the server keeps resident
+	if (!Registry || !Chunks || GetWorld()->GetNetMode() == NM_Client) return;
+
+	CheckTimer -= DeltaTime;
+	if (CheckTimer <= 0.f)
+	{
+		CheckTimer = CheckInterval;
+
+		TArray<FVector, TInlineAllocator<16>> Players;
+		GatherPlayerLocations(Players);
+
+		const double Now = GetWorld()->GetTimeSeconds();
+		const float RadiusSq = FMath::Square(WakeRadius);
+		const float HalfChunk = Chunks->ChunkSize * 0.5f;
+
+		// Rebuild the resident chunk set, keeping visit times for chunks that still have parts
+		TMap<FIntVector, double> Resident;
+		for (const FVector& Location : Registry->GetStore().Location)
+		{
+			const FIntVector Key = Chunks->ChunkKeyFor(Location);
+			if (!Resident.Contains(Key))
+			{
+				const double* Visited = LastVisited.Find(Key);
+				Resident.Add(Key, Visited ? *Visited : Now);
+			}
+		}
+
+		Occupied.Reset();
+		for (TPair<FIntVector, double>& Pair : Resident)
+		{
+			const FVector Center = (FVector(Pair.Key) + FVector(0.5f)) * Chunks->ChunkSize;
+			for (const FVector& Player : Players)
+			{
+				if (FVector::DistSquared(Player, Center) <= FMath::Square(WakeRadius + HalfChunk))
+				{
+					Pair.Value = Now;
+					Occupied.Add(Pair.Key);
+					break;
+				}
+			}
+		}
+		LastVisited = MoveTemp(Resident);
+
+		HibernateIdleChunks(HibernateAfter, MaxHibernationsPerCheck);
+
+		// Wake sleeping chunks a player is heading into
+		TArray<FIntVector, TInlineAllocator<8>> ToWake;
+		for (const TPair<FIntVector, FHibernationRecord>& Pair : Hibernated)
+		{
+			for (const FVector& Player : Players)
+			{
+				if (Pair.Value.Bounds.ComputeSquaredDistanceToPoint(Player) <= RadiusSq)
+				{
+					ToWake.Add(Pair.Key);
+					break;
+				}
+			}
+		}
+
+		for (const FIntVector& Key : ToWake)
+		{
+			StartRestore(Key);
+		}
+	}
+
+	int32 Budget = RestorePartsPerFrame;
+	for (int32 i = 0; i < Restoring.Num() && Budget > 0;)
+	{
+		if (AdvanceRestore(Restoring[i], Budget))
+		{
+			FinishRestore(Restoring[i]);
+			Restoring.RemoveAtSwap(i, 1, EAllowShrinking::No);
+			continue;
+		}
+		++i;
+	}
+
+	SET_DWORD_STAT(STAT_BuildingHibernatedChunks, Hibernated.Num());
+	SET_DWORD_STAT(STAT_BuildingHibernatedParts, GetNumHibernatedParts());
+	SET_DWORD_STAT(STAT_BuildingChunksRestoring, Restoring.Num());
+}
+
+int32 UBuildingHibernationSubsystem::HibernateIdleChunks(double IdleSeconds, int32 MaxChunks)
+{
+	if (!Registry || !Chunks) return 0;
+
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	TArray<FIntVector, TInlineAllocator<8>> Idle;
+	for (const TPair<FIntVector, double>& Pair : LastVisited)
+	{
+		if (Idle.Num() >= MaxChunks) break;
+		if (Now - Pair.Value < IdleSeconds || Occupied.Contains(Pair.Key)) continue;
+
+		// A chunk still coming back from disk is not idle
+		const bool bRestoring = Restoring.ContainsByPredicate([&Pair](const FRestoreJob& Job) { return Job.Key == Pair.Key; });
+		if (!bRestoring && !Hibernated.Contains(Pair.Key))
+		{
+			Idle.Add(Pair.Key);
+		}
+	}
+
+	if (Idle.Num() == 0) return 0;
+
+	// One pass over the store sorts parts into the chunks going to sleep
+	TMap<FIntVector, TArray<int32>> Members;
+	for (const FIntVector& Key : Idle)
+	{
+		Members.Add(Key);
+	}
+
+	const TArray<FVector>& Locations = Registry->GetStore().Location;
+	for (int32 i = 0; i < Locations.Num(); ++i)
+	{
+		if (TArray<int32>* Indices = Members.Find(Chunks->ChunkKeyFor(Locations[i])))
+		{
+			Indices->Add(i);
+		}
+	}
+
+	for (const TPair<FIntVector, TArray<int32>>& Pair : Members)
+	{
+		if (Pair.Value.Num() > 0)
+		{
+			HibernateChunk(Pair.Key, Pair.Value);
+		}
+		LastVisited.Remove(Pair.Key);
+	}
+
+	return Idle.Num();
+}
+
+void UBuildingHibernationSubsystem::HibernateChunk(const FIntVector& Key, TConstArrayView<int32> DenseIndices)
+{
+	const FBuildingPartStore& Store = Registry->GetStore();
+
+	FHibernatedCluster Cluster;
+	Cluster.Key = Key;
+	Cluster.HibernatedAt = GetWorld()->GetTimeSeconds();
+	Cluster.Parts.Reserve(DenseIndices.Num());
+
+	// Support links are stored as indices into this cluster; links to other chunks are dropped
+	TMap<FBuildingPartHandle, int32> LocalIndex;
+	LocalIndex.Reserve(DenseIndices.Num());
+	for (int32 i = 0; i < DenseIndices.Num(); ++i)
+	{
+		LocalIndex.Add(Store.Handle[DenseIndices[i]], i);
+	}
+
+	FHibernationRecord Record;
+	Record.Path = GetChunkPath(Key);
+	Record.NumParts = DenseIndices.Num();
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	ABuildingChunkActor* Proxy = GetWorld()->SpawnActor<ABuildingChunkActor>(ABuildingChunkActor::StaticClass(), FVector(Key) * Chunks->ChunkSize, FRotator::ZeroRotator, SpawnParams);
+
+	TArray<FBuildingPartHandle> Handles;
+	Handles.Reserve(DenseIndices.Num());
+
+	for (const int32 Dense : DenseIndices)
+	{
+		FHibernatedPart& Part = Cluster.Parts.AddDefaulted_GetRef();
+		Part.Type = Store.Type[Dense];
+		Part.Transform = Store.Transform[Dense];
+		Part.LocalExtent = Store.LocalExtent[Dense];
+		Part.BoxCenter = Store.BoxCenter[Dense];
+		Part.BoxExtent = Store.BoxExtent[Dense];
+		Part.Health = Store.Health[Dense];
+		Part.MaxHealth = Store.MaxHealth[Dense];
+		Part.DecayRate = Store.DecayRate[Dense];
+		Part.LastTouched = Store.LastTouched[Dense];
+
+		for (int32 s = 0; s < FBuildingSupportLinks::Max; ++s)
+		{
+			const int32* Support = LocalIndex.Find(Store.Supports[Dense].Links[s]);
+			Part.Supports[s] = Support ? *Support : INDEX_NONE;
+		}
+
+		if (const ABuildingPart* Actor = Store.Actor[Dense].Get())
+		{
+			Part.ClassIndex = Cluster.Classes.AddUnique(Actor->GetClass()->GetPathName());
+		}
+
+		const FString OwnerId = BuildingHibernation::OwnerIdFor(Store.Owner[Dense].Get());
+		if (!OwnerId.IsEmpty())
+		{
+			Part.OwnerIndex = Cluster.Owners.AddUnique(OwnerId);
+		}
+
+		const FQuat Rotation = Part.Transform.GetRotation();
+		Record.Bounds += FBox(-Part.BoxExtent, Part.BoxExtent).TransformBy(FTransform(Rotation, Part.BoxCenter));
+		if (Proxy)
+		{
+			Proxy->Collision->AddElement(FBuildingPartHandle(), Part.BoxCenter, Rotation, Part.BoxExtent);
+		}
+
+		Handles.Add(Store.Handle[Dense]);
+	}
+
+	if (Proxy)
+	{
+		Proxy->Collision->RebuildBody();
+		Record.Proxy = Proxy;
+	}
+
+	// Dense indices shift as parts leave, so remove by handle
+	for (const FBuildingPartHandle Handle : Handles)
+	{
+		if (ABuildingPart* Actor = Registry->GetActor(Handle))
+		{
+			// EndPlay takes the part out of the registry, chunks and rooms
+			Actor->Destroy();
+		}
+		else
+		{
+			Registry->RemovePart(Handle);
+		}
+	}
+
+	TArray<uint8> Raw;
+	FMemoryWriter Writer(Raw);
+	Writer << Cluster;
+
+	Record.Write = Async(EAsyncExecution::ThreadPool, [Path = Record.Path, Raw = MoveTemp(Raw)]()
+	{
+		BuildingHibernation::WriteFile(Path, Raw);
+	});
+
+	UE_LOG(LogGAM312, Verbose, TEXT("Hibernated chunk %s with %d parts"), *Key.ToString(), Record.NumParts);
+	Hibernated.Add(Key, MoveTemp(Record));
+}
+
+void UBuildingHibernationSubsystem::StartRestore(const FIntVector& Key)
+{
+	FHibernationRecord* Record = Hibernated.Find(Key);
+	if (!Record) return;
+	if (Restoring.ContainsByPredicate([&Key](const FRestoreJob& Job) { return Job.Key == Key; })) return;
+
+	// Wait for the file to land before reading it back
+	if (Record->Write.IsValid() && !Record->Write.IsReady()) return;
+
+	FRestoreJob& Job = Restoring.AddDefaulted_GetRef();
+	Job.Key = Key;
+	Job.Load = Async(EAsyncExecution::ThreadPool, [Path = Record->Path]()
+	{
+		return BuildingHibernation::ReadFile(Path);
+	});
+}
+
+bool UBuildingHibernationSubsystem::AdvanceRestore(FRestoreJob& Job, int32& Budget)
+{
+	if (!Job.Cluster)
+	{
+		if (!Job.Load.IsReady()) return false;
+
+		Job.Cluster = Job.Load.Get();
+		if (!Job.Cluster)
+		{
+			UE_LOG(LogGAM312, Error, TEXT("Could not read hibernated chunk %s, its parts are lost"), *Job.Key.ToString());
+			return true;
+		}
+
+		// Building classes are normally resident already through the asset preloader
+		for (const FString& ClassPath : Job.Cluster->Classes)
+		{
+			Job.Classes.Add(FSoftClassPath(ClassPath).TryLoadClass<ABuildingPart>());
+		}
+
+		// Parts go back to their owners' current pawns; owners who are not playing lose them
+		for (const FString& OwnerId : Job.Cluster->Owners)
+		{
+			Job.Owners.Add(BuildingHibernation::FindOwner(GetWorld(), OwnerId));
+		}
+		Job.Restored.Reserve(Job.Cluster->Parts.Num());
+	}
+
+	FBuildingPartStore& Store = Registry->GetStore();
+	const TArray<FHibernatedPart>& Parts = Job.Cluster->Parts;
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	while (Budget > 0 && Job.Restored.Num() < Parts.Num())
+	{
+		const FHibernatedPart& Saved = Parts[Job.Restored.Num()];
+		FBuildingPartHandle Handle;
+
+		APawn* Owner = Job.Owners.IsValidIndex(Saved.OwnerIndex) ? Job.Owners[Saved.OwnerIndex].Get() : nullptr;
+		SpawnParams.Owner = Owner;
+		SpawnParams.Instigator = Owner;
+
+		UClass* Class = Job.Classes.IsValidIndex(Saved.ClassIndex) ? Job.Classes[Saved.ClassIndex].Get() : nullptr;
+		if (Class)
+		{
+			if (ABuildingPart* Actor = GetWorld()->SpawnActor<ABuildingPart>(Class, Saved.Transform, SpawnParams))
+			{
+				Actor->OnPlaced();
+				Handle = Actor->Handle;
+			}
+		}
+		else if (Saved.ClassIndex == INDEX_NONE)
+		{
+			Handle = Registry->AddPartData(Saved.Type, Saved.Transform, Saved.LocalExtent, Saved.MaxHealth, Saved.DecayRate);
+		}
+
+		// Decay covers the time asleep on the part's next slice
+		const int32 Dense = Registry->ToDense(Handle);
+		if (Dense != INDEX_NONE)
+		{
+			Store.Health[Dense] = Saved.Health;
+			Store.MaxHealth[Dense] = Saved.MaxHealth;
+			Store.DecayRate[Dense] = Saved.DecayRate;
+			Store.LastTouched[Dense] = Saved.LastTouched;
+			Store.LastProcessed[Dense] = Job.Cluster->HibernatedAt;
+			Store.Owner[Dense] = Owner;
+		}
+
+		Job.Restored.Add(Handle);
+		--Budget;
+	}
+
+	return Job.Restored.Num() == Parts.Num();
+}
+
+void UBuildingHibernationSubsystem::FinishRestore(FRestoreJob& Job)
+{
+	if (Job.Cluster)
+	{
+		FBuildingPartStore& Store = Registry->GetStore();
+		const TArray<FHibernatedPart>& Parts = Job.Cluster->Parts;
+
+		// Every part has a handle now, so support links can be resolved
+		for (int32 i = 0; i < Parts.Num(); ++i)
+		{
+			const int32 Dense = Registry->ToDense(Job.Restored[i]);
+			if (Dense == INDEX_NONE) continue;
+
+			for (int32 s = 0; s < FBuildingSupportLinks::Max; ++s)
+			{
+				const int32 Support = Parts[i].Supports[s];
+				Store.Supports[Dense].Links[s] = Job.Restored.IsValidIndex(Support) ? Job.Restored[Support] : FBuildingPartHandle();
+			}
+		}
+	}
+
+	FHibernationRecord Record;
+	if (Hibernated.RemoveAndCopyValue(Job.Key, Record))
+	{
+		if (ABuildingChunkActor* Proxy = Record.Proxy.Get())
+		{
+			Proxy->Destroy();
+		}
+		IFileManager::Get().Delete(*Record.Path, false, false, true);
+	}
+
+	LastVisited.Add(Job.Key, GetWorld()->GetTimeSeconds());
+	UE_LOG(LogGAM312, Verbose, TEXT("Restored chunk %s with %d parts"), *Job.Key.ToString(), Job.Restored.Num());
+}
+
+// Benchmark helper: "Building.HibernationSoak <Days> <PartsPerDay>" simulates a long-running
+// server where every day new actor-less parts are built away from players and then left alone.
+// Each simulated day hibernates every idle chunk and logs resident parts and process memory,
+// which should stay flat while the hibernated totals grow.
+GAM312_BENCH_COMMAND(GBuildingHibernationSoakCmd, "Building.HibernationSoak",
+	"Simulates days of building and hibernation. Usage: Building.HibernationSoak <Days> <PartsPerDay>")
+{
+	UBuildingHibernationSubsystem* Hibernation = World ? World->GetSubsystem<UBuildingHibernationSubsystem>() : nullptr;
+	UBuildingRegistrySubsystem* Registry = World ? World->GetSubsystem<UBuildingRegistrySubsystem>() : nullptr;
+	UBuildingChunkSubsystem* Chunks = World ? World->GetSubsystem<UBuildingChunkSubsystem>() : nullptr;
+	if (!Hibernation || !Registry || !Chunks) return;
+
+	const int32 Days = GAM312Bench::Count(Args, 0, 30);
+	const int32 PartsPerDay = GAM312Bench::Count(Args, 1, 2000);
+
+	const int32 StartResident = Registry->Num();
+	int32 PeakResident = StartResident;
+	double FirstDayMB = 0.0;
+	double LastDayMB = 0.0;
+
+	FRandomStream Random(Days * PartsPerDay);
+	for (int32 Day = 0; Day < Days; ++Day)
+	{
+		// Each day's base goes up in its own block of chunks, far from the map origin
+		const FVector Origin(200000.f + Day * Chunks->ChunkSize * 8.f, 200000.f, 0.f);
+		for (int32 i = 0; i < PartsPerDay; ++i)
+		{
+			const FVector Offset(Random.FRandRange(0.f, Chunks->ChunkSize * 4.f), Random.FRandRange(0.f, Chunks->ChunkSize * 4.f), 0.f);
+			Registry->AddPartData(EBuildingPartType::Floor, FTransform(Origin + Offset), FVector(200.f, 200.f, 10.f), 500.f, 0.1f);
+		}
+
+		// Run an activity check, then put every chunk without a player near it to sleep at once
+		Hibernation->Tick(Hibernation->CheckInterval);
+		Hibernation->HibernateIdleChunks(0.0, MAX_int32);
+		Hibernation->FlushWrites();
+
+		const double UsedMB = FPlatformMemory::GetStats().UsedPhysical / (1024.0 * 1024.0);
+		FirstDayMB = Day == 0 ? UsedMB : FirstDayMB;
+		LastDayMB = UsedMB;
+		PeakResident = FMath::Max(PeakResident, Registry->Num());
+
+		UE_LOG(LogGAM312, Log, TEXT("Building.HibernationSoak: day %d, %d resident parts, %d hibernated chunks holding %d parts, %.1f MB used"),
+			Day + 1, Registry->Num(), Hibernation->GetNumHibernatedChunks(), Hibernation->GetNumHibernatedParts(), UsedMB);
+	}
+
+	// Every day's parts go to sleep the same day, so residency is bounded when nothing piles up
+	// beyond what was there at the start
+	const bool bBounded = Registry->Num() <= StartResident;
+	UE_LOG(LogGAM312, Log, TEXT("Building.HibernationSoak: %d days, resident parts %d at start, %d at peak, %d at end (%s). Memory %+.1f MB from day 1 to day %d (%+.2f MB per day)."),
+		Days, StartResident, PeakResident, Registry->Num(), bBounded ? TEXT("bounded") : TEXT("growing"),
+		LastDayMB - FirstDayMB, Days, Days > 1 ? (LastDayMB - FirstDayMB) / (Days - 1) : 0.0);
+}
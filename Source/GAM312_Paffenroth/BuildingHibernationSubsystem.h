@@ -0,0 +1,180 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Async/Future.h"
+#include "BuildingPart.h"
+#include "BuildingPartHandle.h"
+#include "BuildingHibernationSubsystem.generated.h"
+
+class ABuildingChunkActor;
+class APawn;
+class UBuildingRegistrySubsystem;
+class UBuildingChunkSubsystem;
+
+// One part of a hibernated cluster
+struct FHibernatedPart
+{
+	// Index into the cluster's class table, or INDEX_NONE for parts without an actor
+	int32 ClassIndex = INDEX_NONE;
+
+	// Index into the cluster's owner table, or INDEX_NONE for unowned parts
+	int32 OwnerIndex = INDEX_NONE;
+
+	EBuildingPartType Type = EBuildingPartType::Floor;
+	FTransform Transform;
+	FVector LocalExtent = FVector::ZeroVector;
+
+	// World-space collision box, kept so the proxy can be rebuilt on load
+	FVector BoxCenter = FVector::ZeroVector;
+	FVector BoxExtent = FVector::ZeroVector;
+
+	float Health = 0.f;
+	float MaxHealth = 0.f;
+	float DecayRate = 0.f;
+	double LastTouched = 0.0;
+
+	// Indices of supporting parts within the same cluster
+	int32 Supports[4] = { INDEX_NONE, INDEX_NONE, INDEX_NONE, INDEX_NONE };
+
+	friend FArchive& operator<<(FArchive& Ar, FHibernatedPart& Part);
+};
+
+// Everything needed to bring a chunk's parts back
+struct FHibernatedCluster
+{
+	FIntVector Key = FIntVector::ZeroValue;
+
+	// World time the cluster went to sleep, so decay catches up on restore
+	double HibernatedAt = 0.0;
+
+	TArray<FString> Classes;
+
+	// Owning players by id, since their pawns may be gone by the time the cluster wakes
+	TArray<FString> Owners;
+
+	TArray<FHibernatedPart> Parts;
+
+	friend FArchive& operator<<(FArchive& Ar, FHibernatedCluster& Cluster);
+};
+
+/**
+ * Moves building chunks that no player has been near for a while out of the world and
+ * into compressed files on disk, leaving one collision proxy per chunk. A chunk comes
+ * back when a player gets within WakeRadius: its file is read and decompressed on a
+ * worker thread, then parts are respawned a few per frame. Only runs on the server.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UBuildingHibernationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Hibernates resident chunks no player has been near for IdleSeconds, never one a player
+	// is near right now. Returns how many went to sleep.
+	int32 HibernateIdleChunks(double IdleSeconds, int32 MaxChunks);
+
+	// Blocks until queued file writes have finished
+	void FlushWrites();
+
+	int32 GetNumHibernatedChunks() const { return Hibernated.Num(); }
+
+	int32 GetNumHibernatedParts() const;
+
+// --- Settings ---
+
+	// Seconds without a nearby player before a chunk hibernates
+	UPROPERTY(Config)
+		float HibernateAfter = 1800.0f;
+
+	// A player this close to a chunk keeps it awake and wakes it if it sleeps
+	UPROPERTY(Config)
+		float WakeRadius = 20000.0f;
+
+	// Seconds between activity checks
+	UPROPERTY(Config)
+		float CheckInterval = 5.0f;
+
+	// Upper bound on chunks put to sleep per check
+	UPROPERTY(Config)
+		int32 MaxHibernationsPerCheck = 4;
+
+	// Upper bound on parts respawned per frame while restoring
+	UPROPERTY(Config)
+		int32 RestorePartsPerFrame = 32;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	// A chunk that is on disk
+	struct FHibernationRecord
+	{
+		FString Path;
+		FBox Bounds = FBox(ForceInit);
+		int32 NumParts = 0;
+
+		TWeakObjectPtr<ABuildingChunkActor> Proxy;
+
+		// Compression and file write running on a worker
+		TFuture<void> Write;
+	};
+
+	// A chunk coming back from disk
+	struct FRestoreJob
+	{
+		FIntVector Key = FIntVector::ZeroValue;
+
+		// File read and decompression running on a worker
+		TFuture<TSharedPtr<FHibernatedCluster>> Load;
+
+		TSharedPtr<FHibernatedCluster> Cluster;
+		TArray<TWeakObjectPtr<UClass>> Classes;
+
+		// Owners that are playing when the cluster wakes, by owner table index
+		TArray<TWeakObjectPtr<APawn>> Owners;
+
+		TArray<FBuildingPartHandle> Restored;
+	};
+
+	void HibernateChunk(const FIntVector& Key, TConstArrayView<int32> DenseIndices);
+
+	void StartRestore(const FIntVector& Key);
+
+	// Respawns up to Budget parts. Returns whether the job has finished.
+	bool AdvanceRestore(FRestoreJob& Job, int32& Budget);
+
+	void FinishRestore(FRestoreJob& Job);
+
+	void GatherPlayerLocations(TArray<FVector, TInlineAllocator<16>>& OutLocations) const;
+
+	FString GetChunkPath(const FIntVector& Key) const;
+
+	UPROPERTY(Transient)
+		TObjectPtr<UBuildingRegistrySubsystem> Registry;
+
+	UPROPERTY(Transient)
+		TObjectPtr<UBuildingChunkSubsystem> Chunks;
+
+	// World time a player was last near each resident chunk
+	TMap<FIntVector, double> LastVisited;
+
+	// Resident chunks with a player near them at the last check
+	TSet<FIntVector> Occupied;
+
+	TMap<FIntVector, FHibernationRecord> Hibernated;
+
+	TArray<FRestoreJob> Restoring;
+
+	FString Directory;
+
+	float CheckTimer = 0.f;
+};
@@ -0,0 +1,201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingInstanceSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "BuildingPart.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Instance Batches"), STAT_BuildingInstanceBatches, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Instances"), STAT_BuildingInstances, STATGROUP_GAM312);
+
+bool UBuildingInstanceSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+#if UE_SERVER
+	return false;
+#else
+	return Super::ShouldCreateSubsystem(Outer);
+#endif
+}
+
+bool UBuildingInstanceSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UBuildingInstanceSubsystem::Deinitialize()
+{
+	Batches.Empty();
+	BatchIndex.Empty();
+	Holder = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UBuildingInstanceSubsystem::AddPart(ABuildingPart* Part)
+{
+	if (!Part || Part->bInstanceTracked || GetWorld()->GetNetMode() == NM_DedicatedServer) return;
+
+	Part->bInstanceTracked = true;
+	Refresh(Part);
+}
+
+void UBuildingInstanceSubsystem::RemovePart(ABuildingPart* Part)
+{
+	if (!Part || !Part->bInstanceTracked) return;
+
+	RemoveInstance(Part);
+	Part->bInstanceTracked = false;
+	Part->InstanceExclusions = EBuildingInstanceExclusion::None;
+	Part->HiddenViews = 0;
+}
+
+void UBuildingInstanceSubsystem::SetExcluded(ABuildingPart* Part, EBuildingInstanceExclusion Reason, bool bExcluded)
+{
+	if (!Part) return;
+
+	if (bExcluded)
+	{
+		EnumAddFlags(Part->InstanceExclusions, Reason);
+	}
+	else
+	{
+		EnumRemoveFlags(Part->InstanceExclusions, Reason);
+	}
+
+	Refresh(Part);
+}
+
+void UBuildingInstanceSubsystem::UpdateDamage(ABuildingPart* Part)
+{
+	if (!Part || Part->InstanceBatch == INDEX_NONE) return;
+
+	if (UHierarchicalInstancedStaticMeshComponent* Component = Batches[Part->InstanceBatch].Component.Get())
+	{
+		Component->SetCustomDataValue(Part->InstanceIndex, BuildingPartData::Damage, Part->DamageAmount, true);
+	}
+}
+
+void UBuildingInstanceSubsystem::SetHiddenForView(ABuildingPart* Part, bool bHidden)
+{
+	if (!Part) return;
+
+	Part->HiddenViews = bHidden ? Part->HiddenViews + 1 : FMath::Max(Part->HiddenViews - 1, 0);
+	SetExcluded(Part, EBuildingInstanceExclusion::RoomHidden, Part->HiddenViews > 0);
+}
+
+int32 UBuildingInstanceSubsystem::GetNumInstances() const
+{
+	int32 Num = 0;
+	for (const FInstanceBatch& Batch : Batches)
+	{
+		Num += Batch.Parts.Num();
+	}
+	return Num;
+}
+
+void UBuildingInstanceSubsystem::Refresh(ABuildingPart* Part)
+{
+	const bool bWantInstance = Part->bInstanceTracked && Part->InstanceExclusions == EBuildingInstanceExclusion::None;
+	const bool bHasInstance = Part->InstanceBatch != INDEX_NONE;
+
+	if (bWantInstance && !bHasInstance)
+	{
+		AddInstance(Part);
+	}
+	else if (!bWantInstance && bHasInstance)
+	{
+		RemoveInstance(Part);
+	}
+}
+
+int32 UBuildingInstanceSubsystem::FindOrCreateBatch(UStaticMesh* Mesh, UMaterialInterface* Material)
+{
+	const FBatchKey Key(Mesh, Material);
+	if (const int32* Existing = BatchIndex.Find(Key))
+	{
+		return *Existing;
+	}
+
+	if (!Holder)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		Holder = GetWorld()->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+		if (!Holder) return INDEX_NONE;
+	}
+
+	UHierarchicalInstancedStaticMeshComponent* Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(Holder);
+	Component->SetMobility(EComponentMobility::Static);
+	Component->SetStaticMesh(Mesh);
+	Component->SetMaterial(0, Material);
+	Component->SetNumCustomDataFloats(BuildingPartData::NumFloats);
+
+	// The parts' chunk bodies block; the instances only draw
+	Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Component->SetCanEverAffectNavigation(false);
+	Component->RegisterComponent();
+	Holder->AddInstanceComponent(Component);
+
+	FInstanceBatch& Batch = Batches.AddDefaulted_GetRef();
+	Batch.Component = Component;
+
+	const int32 Index = Batches.Num() - 1;
+	BatchIndex.Add(Key, Index);
+	SET_DWORD_STAT(STAT_BuildingInstanceBatches, Batches.Num());
+	return Index;
+}
+
+void UBuildingInstanceSubsystem::AddInstance(ABuildingPart* Part)
+{
+	UStaticMesh* Mesh = Part->Mesh ? Part->Mesh->GetStaticMesh() : nullptr;
+	if (!Mesh) return;
+
+	const int32 BatchId = FindOrCreateBatch(Mesh, Part->Mesh->GetMaterial(0));
+	if (BatchId == INDEX_NONE) return;
+
+	FInstanceBatch& Batch = Batches[BatchId];
+	UHierarchicalInstancedStaticMeshComponent* Component = Batch.Component.Get();
+	if (!Component) return;
+
+	Part->InstanceBatch = BatchId;
+	Part->InstanceIndex = Component->AddInstance(Part->Mesh->GetComponentTransform(), true);
+	check(Part->InstanceIndex == Batch.Parts.Num());
+	Batch.Parts.Add(Part);
+	Component->SetCustomDataValue(Part->InstanceIndex, BuildingPartData::Damage, Part->DamageAmount, true);
+
+	Part->Mesh->SetVisibility(false);
+	INC_DWORD_STAT(STAT_BuildingInstances);
+}
+
+void UBuildingInstanceSubsystem::RemoveInstance(ABuildingPart* Part)
+{
+	if (Part->InstanceBatch == INDEX_NONE) return;
+
+	FInstanceBatch& Batch = Batches[Part->InstanceBatch];
+	const int32 Index = Part->InstanceIndex;
+
+	if (UHierarchicalInstancedStaticMeshComponent* Component = Batch.Component.Get())
+	{
+		Component->RemoveInstance(Index);
+	}
+
+	// The hierarchical component fills the gap with its last instance
+	Batch.Parts.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	if (Batch.Parts.IsValidIndex(Index))
+	{
+		if (ABuildingPart* Moved = Batch.Parts[Index].Get())
+		{
+			Moved->InstanceIndex = Index;
+		}
+	}
+
+	Part->InstanceBatch = INDEX_NONE;
+	Part->InstanceIndex = INDEX_NONE;
+
+	if (Part->Mesh)
+	{
+		Part->Mesh->SetVisibility(true);
+	}
+	DEC_DWORD_STAT(STAT_BuildingInstances);
+}
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "BuildingInstanceSubsystem.generated.h"
+
+class ABuildingPart;
+class UStaticMesh;
+class UMaterialInterface;
+class UHierarchicalInstancedStaticMeshComponent;
+
+// Why a placed part draws its own mesh instead of an instance
+enum class EBuildingInstanceExclusion : uint8
+{
+	None       = 0,
+
+	// Damaged while its material has not been converted to custom data
+	Damaged    = 1 << 0,
+	OwnerColor = 1 << 1,
+
+	// Interior of a room some local player cannot see into
+	RoomHidden = 1 << 2
+};
+ENUM_CLASS_FLAGS(EBuildingInstanceExclusion);
+
+/**
+ * Draws placed building parts as instances of one hierarchical instanced mesh per mesh and
+ * material, so a base renders in a handful of draws. Damage is copied into each instance's
+ * custom data at BuildingPartData::Damage, so decaying parts stay batched. An owner-tinted or
+ * room-hidden part shows its own mesh again, since that state lives on the part's primitive
+ * and cannot be hidden per player on an instance.
+ * Cosmetic only, so it does nothing on a dedicated server.
+ */
+UCLASS()
+class GAM312_PAFFENROTH_API UBuildingInstanceSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Starts drawing a placed part through its batch
+	void AddPart(ABuildingPart* Part);
+
+	// Takes a part out of the instancing entirely
+	void RemovePart(ABuildingPart* Part);
+
+	// Keeps a part out of its batch while any exclusion is set
+	void SetExcluded(ABuildingPart* Part, EBuildingInstanceExclusion Reason, bool bExcluded);
+
+	// Copies a part's damage to its instance, if it has one
+	void UpdateDamage(ABuildingPart* Part);
+
+	// Counts the local players a part is hidden for. Excluded while any are.
+	void SetHiddenForView(ABuildingPart* Part, bool bHidden);
+
+	int32 GetNumInstances() const;
+
+	int32 GetNumBatches() const { return Batches.Num(); }
+
+protected:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FInstanceBatch
+	{
+		TWeakObjectPtr<UHierarchicalInstancedStaticMeshComponent> Component;
+
+		// Part drawn by each instance, in instance order
+		TArray<TWeakObjectPtr<ABuildingPart>> Parts;
+	};
+
+	using FBatchKey = TPair<TObjectKey<UStaticMesh>, TObjectKey<UMaterialInterface>>;
+
+	// Adds or removes the part's instance to match its exclusions
+	void Refresh(ABuildingPart* Part);
+
+	void AddInstance(ABuildingPart* Part);
+	void RemoveInstance(ABuildingPart* Part);
+
+	int32 FindOrCreateBatch(UStaticMesh* Mesh, UMaterialInterface* Material);
+
+	TArray<FInstanceBatch> Batches;
+	TMap<FBatchKey, int32> BatchIndex;
+
+	// Owns every batch component
+	UPROPERTY(Transient)
+		TObjectPtr<AActor> Holder;
+};
@@ -1,14 +1,31 @@
 #include "BuildingPart.h"
+#include "BuildingRegistrySubsystem.h"
+#include "BuildingChunkSubsystem.h"
+#include "BuildingRoomSubsystem.h"
+#include "BuildingInstanceSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Net/UnrealNetwork.h"
+
+#if WITH_EDITOR
+#include "Materials/Material.h"
+#include "Materials/MaterialExpressionPerInstanceCustomData.h"
+#include "Materials/MaterialExpressionScalarParameter.h"
+#include "Materials/MaterialExpressionVectorParameter.h"
+#endif
 
 ABuildingPart::ABuildingPart()
 {
 	PrimaryActorTick.bCanEverTick = false;
+	bReplicates = true;
 
 	PivotArrow = CreateDefaultSubobject<UArrowComponent>(TEXT("Pivot Arrow"));
 	RootComponent = PivotArrow;
 
 	Mesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Mesh"));
 	Mesh->SetupAttachment(PivotArrow);
+	Mesh->SetDefaultCustomPrimitiveDataVector4(BuildingPartData::TintColor, FVector4(1.f, 1.f, 1.f, 1.f));
+	Mesh->SetDefaultCustomPrimitiveDataVector3(BuildingPartData::OwnerColor, FVector(1.f, 1.f, 1.f));
 
 	SP_North = CreateDefaultSubobject<UArrowComponent>(TEXT("SP_North"));
 	SP_South = CreateDefaultSubobject<UArrowComponent>(TEXT("SP_South"));
@@ -44,6 +61,115 @@ void ABuildingPart::OnConstruction(const FTransform& Transform)
 void ABuildingPart::BeginPlay()
 {
 	Super::BeginPlay();
+
+	// A part that arrives already placed registers now, one placed later when the flag replicates
+	if (!HasAuthority() && bPlaced)
+	{
+		RegisterReplicated();
+	}
+}
+
+void ABuildingPart::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ABuildingPart, bPlaced);
+	DOREPLIFETIME(ABuildingPart, ReplicatedDamage);
+}
+
+void ABuildingPart::OnRep_Damage()
+{
+	SetDamageAmount(ReplicatedDamage / 255.f);
+}
+
+void ABuildingPart::OnRep_Placed()
+{
+	if (bPlaced && HasActorBegunPlay())
+	{
+		RegisterReplicated();
+	}
+}
+
+void ABuildingPart::RegisterReplicated()
+{
+	if (Handle.IsValid()) return;
+
+	ClearPreview();
+
+	// The registry feeds the local placement preview, chunks give the client the same
+	// collision, and rooms drive local visibility
+	if (UBuildingRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UBuildingRegistrySubsystem>())
+	{
+		Registry->AddPart(this);
+	}
+
+	if (UBuildingChunkSubsystem* Chunks = GetWorld()->GetSubsystem<UBuildingChunkSubsystem>())
+	{
+		Chunks->AddPart(Handle);
+	}
+
+	if (UBuildingRoomSubsystem* RoomSubsystem = GetWorld()->GetSubsystem<UBuildingRoomSubsystem>())
+	{
+		RoomSubsystem->AddPart(this);
+	}
+
+	if (UBuildingInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UBuildingInstanceSubsystem>())
+	{
+		Instances->AddPart(this);
+	}
+}
+
+void ABuildingPart::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// The chunk subsystem drops the part's box as the registry removes it
+	if (UBuildingRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UBuildingRegistrySubsystem>())
+	{
+		Registry->RemovePart(Handle);
+	}
+
+	if (UBuildingRoomSubsystem* RoomSubsystem = GetWorld()->GetSubsystem<UBuildingRoomSubsystem>())
+	{
+		RoomSubsystem->RemovePart(this);
+	}
+
+	if (UBuildingInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UBuildingInstanceSubsystem>())
+	{
+		Instances->RemovePart(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ABuildingPart::OnPlaced(TConstArrayView<FBuildingPartHandle> Supports)
+{
+	ClearPreview();
+	bPlaced = true;
+
+	// The registry holds health for upkeep decay, so this also starts decay
+	if (UBuildingRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UBuildingRegistrySubsystem>())
+	{
+		Registry->AddPart(this, Supports);
+	}
+
+	if (UBuildingChunkSubsystem* Chunks = GetWorld()->GetSubsystem<UBuildingChunkSubsystem>())
+	{
+		Chunks->AddPart(Handle);
+	}
+
+	if (UBuildingRoomSubsystem* RoomSubsystem = GetWorld()->GetSubsystem<UBuildingRoomSubsystem>())
+	{
+		RoomSubsystem->AddPart(this);
+	}
+
+	if (UBuildingInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UBuildingInstanceSubsystem>())
+	{
+		Instances->AddPart(this);
+	}
+}
+
+void ABuildingPart::Collapse()
+{
+	Destroy();
 }
 
 static FVector GetMeshExtentsLocal(const UStaticMeshComponent* MeshComp)
@@ -57,38 +183,52 @@ static FVector GetMeshExtentsLocal(const UStaticMeshComponent* MeshComp)
 	return LocalBounds.BoxExtent; 
 }
 
-void ABuildingPart::UpdateSnapPoints()
+FVector ABuildingPart::GetLocalExtents() const
 {
-	const FVector Extents = GetMeshExtentsLocal(Mesh);
+	return GetMeshExtentsLocal(Mesh);
+}
 
+FTransform ABuildingPart::GetSocketRelativeTransform(EBuildingPartType Type, const FVector& Extents, ESnapPoint Point)
+{
 	const float HalfX = Extents.X;
 	const float HalfY = Extents.Y;
 	const float HalfZ = Extents.Z;
 
-	// Locations (relative to pivot)
-	float EdgeZ = 0.f;
+	// Floor edges sit on the top surface so walls stand on them
+	const float EdgeZ = (Type == EBuildingPartType::Floor) ? +HalfZ : 0.f;
 
-	if (PartType == EBuildingPartType::Floor)
+	switch (Point)
 	{
-		EdgeZ = +HalfZ;
+	case ESnapPoint::North:  return FTransform(FRotator(0.f, 90.f, 0.f),  FVector(0.f, +HalfY, EdgeZ));  // +Y
+	case ESnapPoint::South:  return FTransform(FRotator(0.f, -90.f, 0.f), FVector(0.f, -HalfY, EdgeZ));  // -Y
+	case ESnapPoint::East:   return FTransform(FRotator(0.f, 0.f, 0.f),   FVector(+HalfX, 0.f, EdgeZ));  // +X
+	case ESnapPoint::West:   return FTransform(FRotator(0.f, 180.f, 0.f), FVector(-HalfX, 0.f, EdgeZ));  // -X
+	case ESnapPoint::Top:    return FTransform(FRotator(-90.f, 0.f, 0.f), FVector(0.f, 0.f, +HalfZ));    // +Z
+	default:                 return FTransform(FRotator(90.f, 0.f, 0.f),  FVector(0.f, 0.f, -HalfZ));    // -Z
 	}
+}
 
-	if (SP_North)  SP_North->SetRelativeLocation(FVector(0.f, +HalfY, EdgeZ));
-	if (SP_South)  SP_South->SetRelativeLocation(FVector(0.f, -HalfY, EdgeZ));
-	if (SP_East)   SP_East->SetRelativeLocation(FVector(+HalfX, 0.f, EdgeZ));
-	if (SP_West)   SP_West->SetRelativeLocation(FVector(-HalfX, 0.f, EdgeZ));
-
-	if (SP_Top)    SP_Top->SetRelativeLocation(FVector(0.f, 0.f, +HalfZ));
-	if (SP_Bottom) SP_Bottom->SetRelativeLocation(FVector(0.f, 0.f, -HalfZ));
-
+void ABuildingPart::UpdateSnapPoints()
+{
+	const FVector Extents = GetMeshExtentsLocal(Mesh);
 
-	// Rotations
-	if (SP_North)  SP_North->SetRelativeRotation(FRotator(0.f, 90.f, 0.f));    // +Y
-	if (SP_South)  SP_South->SetRelativeRotation(FRotator(0.f, -90.f, 0.f));   // -Y
-	if (SP_East)   SP_East->SetRelativeRotation(FRotator(0.f, 0.f, 0.f));      // +X
-	if (SP_West)   SP_West->SetRelativeRotation(FRotator(0.f, 180.f, 0.f));    // -X
-	if (SP_Top)    SP_Top->SetRelativeRotation(FRotator(-90.f, 0.f, 0.f));     // +Z
-	if (SP_Bottom) SP_Bottom->SetRelativeRotation(FRotator(90.f, 0.f, 0.f));   // -Z
+	const TPair<UArrowComponent*, ESnapPoint> Sockets[] =
+	{
+		{ SP_North, ESnapPoint::North },
+		{ SP_South, ESnapPoint::South },
+		{ SP_East, ESnapPoint::East },
+		{ SP_West, ESnapPoint::West },
+		{ SP_Top, ESnapPoint::Top },
+		{ SP_Bottom, ESnapPoint::Bottom },
+	};
+
+	for (const TPair<UArrowComponent*, ESnapPoint>& Socket : Sockets)
+	{
+		if (Socket.Key)
+		{
+			Socket.Key->SetRelativeTransform(GetSocketRelativeTransform(PartType, Extents, Socket.Value));
+		}
+	}
 }
 
 static UArrowComponent* GetSnapComponent(const ABuildingPart* Part, ESnapPoint Point)
@@ -172,17 +312,210 @@ TArray<UArrowComponent*> ABuildingPart::GetAllSnapPoints() const
 	return Points;
 }
 
-void ABuildingPart::SetPreviewValid(bool bValid)
+// Per-part state goes through custom primitive data on the shared material rather than a
+// dynamic material instance, so parts keep cached draw commands and can still be instanced.
+void ABuildingPart::SetTint(const FLinearColor& Color)
 {
+#if !UE_SERVER
 	if (!Mesh) return;
 
+	if (bMaterialUsesPrimitiveData)
+	{
+		Mesh->SetCustomPrimitiveDataVector4(BuildingPartData::TintColor, FVector4(Color.R, Color.G, Color.B, Color.A));
+	}
+	else
+	{
+		UpdateStateMaterial();
+	}
+#endif
+}
+
+void ABuildingPart::UpdateStateMaterial()
+{
+#if !UE_SERVER
+	if (!Mesh || bMaterialUsesPrimitiveData) return;
+
+	// A preview keeps its instance until placed, so toggling validity does not recreate it
+	const bool bDefault = PreviewState == EPreviewState::None && DamageAmount <= 0.f && OwnerColor.Equals(FLinearColor::White);
+	if (bDefault)
+	{
+		if (PreviewMID)
+		{
+			Mesh->SetMaterial(0, PreviewMID->Parent);
+			PreviewMID = nullptr;
+		}
+		return;
+	}
+
 	if (!PreviewMID)
 	{
 		PreviewMID = Mesh->CreateAndSetMaterialInstanceDynamic(0);
+		if (!PreviewMID) return;
 	}
 
-	if (PreviewMID)
+	PreviewMID->SetVectorParameterValue(TEXT("TintColor"), PreviewState == EPreviewState::Invalid ? FLinearColor(1, 0, 0, 1) : FLinearColor::White);
+	PreviewMID->SetScalarParameterValue(TEXT("Damage"), DamageAmount);
+	PreviewMID->SetVectorParameterValue(TEXT("OwnerColor"), OwnerColor);
+#endif
+}
+
+void ABuildingPart::SetPreviewValid(bool bValid)
+{
+	const EPreviewState NewState = bValid ? EPreviewState::Valid : EPreviewState::Invalid;
+	if (NewState == PreviewState) return;
+
+	PreviewState = NewState;
+	SetTint(bValid ? FLinearColor(1, 1, 1, 1) : FLinearColor(1, 0, 0, 1));
+}
+
+void ABuildingPart::ClearPreview()
+{
+	if (PreviewState == EPreviewState::None) return;
+
+	PreviewState = EPreviewState::None;
+	SetTint(FLinearColor::White);
+}
+
+void ABuildingPart::SetDamageAmount(float Damage01)
+{
+	Damage01 = FMath::Clamp(Damage01, 0.f, 1.f);
+	if (!Mesh || FMath::IsNearlyEqual(Damage01, DamageAmount)) return;
+
+	DamageAmount = Damage01;
+	if (HasAuthority())
+	{
+		ReplicatedDamage = (uint8)FMath::RoundToInt(DamageAmount * 255.f);
+	}
+#if !UE_SERVER
+	UBuildingInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UBuildingInstanceSubsystem>();
+	if (bMaterialUsesPrimitiveData)
+	{
+		// An instanced part carries its damage on the instance, so decay does not break up the batch
+		Mesh->SetCustomPrimitiveDataFloat(BuildingPartData::Damage, DamageAmount);
+		if (Instances)
+		{
+			Instances->UpdateDamage(this);
+		}
+	}
+	else
+	{
+		// Damage only shows through the part's own material instance, which cannot be batched
+		UpdateStateMaterial();
+		if (Instances)
+		{
+			Instances->SetExcluded(this, EBuildingInstanceExclusion::Damaged, DamageAmount > 0.f);
+		}
+	}
+#endif
+}
+
+void ABuildingPart::SetOwnerColor(FLinearColor Color)
+{
+	if (!Mesh || Color.Equals(OwnerColor)) return;
+
+	OwnerColor = Color;
+#if !UE_SERVER
+	if (bMaterialUsesPrimitiveData)
+	{
+		Mesh->SetCustomPrimitiveDataVector3(BuildingPartData::OwnerColor, FVector(Color.R, Color.G, Color.B));
+	}
+	else
+	{
+		UpdateStateMaterial();
+	}
+
+	if (UBuildingInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UBuildingInstanceSubsystem>())
+	{
+		Instances->SetExcluded(this, EBuildingInstanceExclusion::OwnerColor, !OwnerColor.Equals(FLinearColor::White));
+	}
+#endif
+}
+
+#if WITH_EDITOR
+void ABuildingPart::ConvertMaterialToPrimitiveData()
+{
+	UMaterialInterface* Interface = Mesh ? Mesh->GetMaterial(0) : nullptr;
+	UMaterial* Material = Interface ? Interface->GetMaterial() : nullptr;
+	if (!Material)
+	{
+		UE_LOG(LogGAM312, Warning, TEXT("%s has no material to convert"), *GetName());
+		return;
+	}
+
+	int32 NumConverted = 0;
+	UMaterialExpressionScalarParameter* DamageParameter = nullptr;
+	auto Convert = [&NumConverted](auto* Parameter, int32 Index)
+	{
+		Parameter->Modify();
+		Parameter->bUseCustomPrimitiveData = true;
+		Parameter->PrimitiveDataIndex = (uint8)Index;
+		++NumConverted;
+	};
+
+	Material->Modify();
+	for (UMaterialExpression* Expression : Material->GetExpressions())
+	{
+		if (UMaterialExpressionVectorParameter* Vector = Cast<UMaterialExpressionVectorParameter>(Expression))
+		{
+			if (Vector->ParameterName == TEXT("TintColor"))
+			{
+				Convert(Vector, BuildingPartData::TintColor);
+			}
+			else if (Vector->ParameterName == TEXT("OwnerColor"))
+			{
+				Convert(Vector, BuildingPartData::OwnerColor);
+			}
+		}
+		else if (UMaterialExpressionScalarParameter* Scalar = Cast<UMaterialExpressionScalarParameter>(Expression))
+		{
+			if (Scalar->ParameterName == TEXT("Damage"))
+			{
+				Convert(Scalar, BuildingPartData::Damage);
+				DamageParameter = Scalar;
+			}
+		}
+	}
+	// Batched parts keep their damage in per-instance custom data at the same index. The damage
+	// parameter becomes the fallback of a per-instance read, which a part drawing its own mesh gets.
+	if (DamageParameter)
 	{
-		PreviewMID->SetVectorParameterValue(TEXT("TintColor"), bValid ? FLinearColor(1, 1, 1, 1) : FLinearColor(1, 0, 0, 1));
+		UMaterialExpressionPerInstanceCustomData* PerInstance = NewObject<UMaterialExpressionPerInstanceCustomData>(Material);
+		PerInstance->DataIndex = BuildingPartData::Damage;
+		PerInstance->MaterialExpressionEditorX = DamageParameter->MaterialExpressionEditorX + 200;
+		PerInstance->MaterialExpressionEditorY = DamageParameter->MaterialExpressionEditorY;
+
+		auto Redirect = [DamageParameter, PerInstance](FExpressionInput* Input)
+		{
+			if (Input && Input->Expression == DamageParameter)
+			{
+				Input->Expression = PerInstance;
+				Input->OutputIndex = 0;
+			}
+		};
+		for (UMaterialExpression* Expression : Material->GetExpressions())
+		{
+			for (FExpressionInput* Input : Expression->GetInputsView())
+			{
+				Redirect(Input);
+			}
+		}
+		for (int32 Property = 0; Property < MP_MAX; ++Property)
+		{
+			Redirect(Material->GetExpressionInputForProperty((EMaterialProperty)Property));
+		}
+
+		PerInstance->DefaultValue.Connect(0, DamageParameter);
+		Material->GetExpressionCollection().AddExpression(PerInstance);
 	}
-}
\ No newline at end of file
+
+	Material->PostEditChange();
+	Material->MarkPackageDirty();
+
+	ABuildingPart* Defaults = GetClass()->GetDefaultObject<ABuildingPart>();
+	Defaults->Modify();
+	Defaults->bMaterialUsesPrimitiveData = true;
+	Defaults->MarkPackageDirty();
+
+	UE_LOG(LogGAM312, Log, TEXT("Converted %d parameters of %s to custom primitive data"), NumConverted, *Material->GetName());
+}
+#endif
@@ -4,6 +4,8 @@
 #include "GameFramework/Actor.h"
 #include "Components/ArrowComponent.h"
 #include "Components/StaticMeshComponent.h"
+#include "BuildingPartHandle.h"
+#include "BuildingInstanceSubsystem.h"
 #include "BuildingPart.generated.h"
 
 UENUM(BlueprintType)
@@ -26,6 +28,30 @@ enum class ESnapPoint : uint8
 	Bottom
 };
 
+// Custom primitive data layout shared by every building part material. The material's
+// TintColor, Damage and OwnerColor parameters read these indices once converted with
+// ABuildingPart::ConvertMaterialToPrimitiveData.
+namespace BuildingPartData
+{
+	// RGBA preview tint
+	constexpr int32 TintColor = 0;
+
+	// 0 = intact, 1 = destroyed
+	constexpr int32 Damage = 4;
+
+	// RGB ownership colour
+	constexpr int32 OwnerColor = 5;
+
+	constexpr int32 NumFloats = 8;
+}
+
+enum class EPreviewState : uint8
+{
+	None,
+	Valid,
+	Invalid
+};
+
 UCLASS()
 class GAM312_PAFFENROTH_API ABuildingPart : public AActor
 {
@@ -64,12 +90,67 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building")
 	FVector PartSize = FVector(200.f, 200.f, 10.f);
 
+	// Walls with an opening, such as doorways. They bound a room but can be seen through.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building")
+	bool bIsOpening = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Health")
+	float MaxHealth = 500.f;
+
+	// Health lost per second once upkeep decay has started
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Health")
+	float DecayRate = 0.05f;
+
+	// Handle in the building registry, invalid while the part is not placed
+	FBuildingPartHandle Handle;
+
+	// Set on the server once the part is committed. Clients only register placed parts.
+	UPROPERTY(ReplicatedUsing = OnRep_Placed)
+	bool bPlaced = false;
+
+	// Damage set on the server in 1/255 steps, so clients show decay without a send per slice
+	UPROPERTY(ReplicatedUsing = OnRep_Damage)
+	uint8 ReplicatedDamage = 0;
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	// Called once the part is committed to the world, with the parts it rests on
+	void OnPlaced(TConstArrayView<FBuildingPartHandle> Supports = {});
+
+	// Removes a destroyed part from the world
+	void Collapse();
+
+	// Set once the part's material reads its state from custom primitive data at the
+	// BuildingPartData indices. Until then state changes go through PreviewMID.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Building")
+	bool bMaterialUsesPrimitiveData = false;
+
+	// Material instance for per-part state when the material does not read custom primitive
+	// data. Only exists while the part is tinted, damaged or owner coloured.
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
 	UMaterialInstanceDynamic* PreviewMID = nullptr;
 
+#if WITH_EDITOR
+	// Switches this part's material parameters to custom primitive data at the BuildingPartData
+	// indices and sets bMaterialUsesPrimitiveData on the class. Save the material and class after.
+	UFUNCTION(CallInEditor, Category = "Building")
+	void ConvertMaterialToPrimitiveData();
+#endif
+
+	// Tints the part as a valid or invalid placement preview. Only touches the render state when validity changes.
 	UFUNCTION()
 	void SetPreviewValid(bool bValid);
 
+	// Removes the preview tint once the part is placed
+	UFUNCTION(BlueprintCallable, Category = "Building")
+	void ClearPreview();
+
+	UFUNCTION(BlueprintCallable, Category = "Building")
+	void SetDamageAmount(float Damage01);
+
+	UFUNCTION(BlueprintCallable, Category = "Building")
+	void SetOwnerColor(FLinearColor Color);
+
 	UFUNCTION(BlueprintCallable, Category = "Snapping")
 	FTransform GetSnapTransform(ESnapPoint Point) const;
 
@@ -78,11 +159,47 @@ public:
 
 	FTransform GetSnapRelativeTransform(ESnapPoint Point) const;
 
+	// Unscaled half extents of the mesh, which the snap sockets are placed from
+	FVector GetLocalExtents() const;
+
+	// Socket transform relative to a part of the given type and extents
+	static FTransform GetSocketRelativeTransform(EBuildingPartType Type, const FVector& Extents, ESnapPoint Point);
+
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void Tick(float DeltaTime) override;
 	virtual void OnConstruction(const FTransform& Transform) override;
 
 private:
+	friend class UBuildingInstanceSubsystem;
+
+	UFUNCTION()
+	void OnRep_Placed();
+
+	UFUNCTION()
+	void OnRep_Damage();
+
+	// Adds a part placed on the server to this client's registry, chunks, rooms and instances
+	void RegisterReplicated();
+
 	void UpdateSnapPoints();
+
+	void SetTint(const FLinearColor& Color);
+
+	// Writes the current state to a dynamic material, or drops it once the state is default again
+	void UpdateStateMaterial();
+
+	EPreviewState PreviewState = EPreviewState::None;
+
+	float DamageAmount = 0.f;
+
+	FLinearColor OwnerColor = FLinearColor::White;
+
+	// Instanced drawing state, owned by UBuildingInstanceSubsystem
+	bool bInstanceTracked = false;
+	EBuildingInstanceExclusion InstanceExclusions = EBuildingInstanceExclusion::None;
+	int32 HiddenViews = 0;
+	int32 InstanceBatch = INDEX_NONE;
+	int32 InstanceIndex = INDEX_NONE;
 };
\ No newline at end of file
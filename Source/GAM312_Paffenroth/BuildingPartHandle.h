@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * 32-bit reference to a part in the building registry: a slot index in the low bits and
+ * the slot's generation in the high bits. A handle goes stale once its part is removed,
+ * even if the slot is reused. Zero is never a valid handle.
+ */
+struct FBuildingPartHandle
+{
+	static constexpr uint32 IndexBits = 20;
+	static constexpr uint32 IndexMask = (1u << IndexBits) - 1;
+	static constexpr uint32 MaxGeneration = (1u << (32 - IndexBits)) - 1;
+
+	uint32 Value = 0;
+
+	FBuildingPartHandle() = default;
+
+	FBuildingPartHandle(int32 Index, uint32 Generation)
+		: Value((Generation << IndexBits) | ((uint32)Index & IndexMask))
+	{
+	}
+
+	bool IsValid() const { return Value != 0; }
+
+	int32 GetIndex() const { return (int32)(Value & IndexMask); }
+
+	uint32 GetGeneration() const { return Value >> IndexBits; }
+
+	void Reset() { Value = 0; }
+
+	bool operator==(const FBuildingPartHandle& Other) const { return Value == Other.Value; }
+	bool operator!=(const FBuildingPartHandle& Other) const { return Value != Other.Value; }
+
+	friend uint32 GetTypeHash(const FBuildingPartHandle& Handle) { return Handle.Value; }
+
+	friend FArchive& operator<<(FArchive& Ar, FBuildingPartHandle& Handle)
+	{
+		return Ar << Handle.Value;
+	}
+};
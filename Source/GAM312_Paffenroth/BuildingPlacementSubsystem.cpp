@@ -0,0 +1,504 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingPlacementSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "BuildingPart.h"
+#include "BuildingSnapRules.h"
+#include "PlayerChar.h"
+#include "LandscapeHeightSubsystem.h"
+#include "Async/ParallelFor.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Building Placement Resolve"), STAT_BuildingPlacementResolve, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Placement Requests"), STAT_BuildingPlacementRequests, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Placement Rejected"), STAT_BuildingPlacementRejected, STATGROUP_GAM312);
+
+// How far a resting part may be from its support's top and still count as resting on it
+static constexpr float RestHeightTolerance = 2.f;
+
+// How far a snapped part may be from where its rule puts it, covering replicated transform rounding
+static constexpr float SocketTolerance = 2.f;
+static constexpr float SocketYawTolerance = 1.f;
+
+// Whether a part sits where a snap candidate puts it against a target: its socket on the
+// target's socket, at the rule's yaw. A resting part's height comes from its support instead.
+static bool MatchesSocket(const UBuildingRegistrySubsystem& Registry, const FCompiledSnapCandidate& Candidate, FBuildingPartHandle Target,
+	int32 Type, const FTransform& Transform, const FVector& LocalExtent)
+{
+	const FTransform SocketT = Registry.GetSnapTransform(Target, Candidate.TargetSocket);
+
+	// Same yaw choice as APlayerChar::SolvePlacement; Keep leaves the player's own yaw
+	float Yaw = Transform.Rotator().Yaw;
+	switch (Candidate.Rotation)
+	{
+	case ESnapRotation::Target:
+		Yaw = Registry.GetStore().Transform[Registry.ToDense(Target)].Rotator().Yaw + Candidate.YawOffset;
+		break;
+
+	case ESnapRotation::Socket:
+		Yaw = SocketT.Rotator().Yaw + Candidate.YawOffset;
+		break;
+
+	default:
+		break;
+	}
+
+	if (FMath::Abs(FRotator::NormalizeAxis(Transform.Rotator().Yaw - Yaw)) > SocketYawTolerance) return false;
+
+	const FQuat Q = FRotator(0.f, Yaw, 0.f).Quaternion();
+	const FVector PartSocket = ABuildingPart::GetSocketRelativeTransform((EBuildingPartType)Type, LocalExtent, Candidate.PartSocket).GetLocation()
+		* Transform.GetScale3D();
+	const FVector Delta = Transform.GetLocation() - (SocketT.GetLocation() + Q.RotateVector(Candidate.Offset - PartSocket));
+
+	return FVector2D(Delta).SizeSquared() <= FMath::Square(SocketTolerance)
+		&& (Candidate.RestOnType != INDEX_NONE || FMath::Abs(Delta.Z) <= SocketTolerance);
+}
+
+// Overlap of two boxes that are only rotated about Z, by separating axes in the ground plane
+static bool YawBoxesOverlap(const FTransform& A, const FVector& ExtentA, const FTransform& B, const FVector& ExtentB)
+{
+	const FVector Delta = B.GetLocation() - A.GetLocation();
+	if (FMath::Abs(Delta.Z) > ExtentA.Z + ExtentB.Z) return false;
+
+	const FVector2D AX = FVector2D(A.GetUnitAxis(EAxis::X)).GetSafeNormal();
+	const FVector2D AY = FVector2D(A.GetUnitAxis(EAxis::Y)).GetSafeNormal();
+	const FVector2D BX = FVector2D(B.GetUnitAxis(EAxis::X)).GetSafeNormal();
+	const FVector2D BY = FVector2D(B.GetUnitAxis(EAxis::Y)).GetSafeNormal();
+	const FVector2D D(Delta);
+
+	for (const FVector2D& Axis : { AX, AY, BX, BY })
+	{
+		const float RadiusA = ExtentA.X * FMath::Abs(AX | Axis) + ExtentA.Y * FMath::Abs(AY | Axis);
+		const float RadiusB = ExtentB.X * FMath::Abs(BX | Axis) + ExtentB.Y * FMath::Abs(BY | Axis);
+		if (FMath::Abs(D | Axis) > RadiusA + RadiusB)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void UBuildingPlacementSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Registry = Collection.InitializeDependency<UBuildingRegistrySubsystem>();
+}
+
+void UBuildingPlacementSubsystem::Deinitialize()
+{
+	Registry = nullptr;
+	Pending.Empty();
+	Recent.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UBuildingPlacementSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UBuildingPlacementSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBuildingPlacementSubsystem, STATGROUP_Tickables);
+}
+
+void UBuildingPlacementSubsystem::Tick(float DeltaTime)
+{
+	// Requests only arrive through server RPCs
+	if (Pending.Num() > 0 && GetWorld()->GetNetMode() != NM_Client)
+	{
+		ResolveBatch();
+	}
+}
+
+void UBuildingPlacementSubsystem::QueuePlacement(APlayerChar* Player, TSubclassOf<ABuildingPart> PartClass, const FTransform& Transform, int32 BuildingId)
+{
+	FPlacementRequest& Request = Pending.AddDefaulted_GetRef();
+	Request.Player = Player;
+	Request.PartClass = PartClass;
+	Request.Transform = Transform;
+	Request.BuildingId = BuildingId;
+}
+
+bool UBuildingPlacementSubsystem::FindSupports(const UBuildingRegistrySubsystem& Registry, const FCompiledSnapTable& Table, int32 Type,
+	const FTransform& Transform, const FVector& LocalExtent, float SearchRadius, FPlacementSupports& OutSupports)
+{
+	OutSupports.Reset();
+
+	// Ground types stand anywhere, others need a target and their supports
+	if (Table.IsGroundType(Type)) return true;
+
+	const FVector Location = Transform.GetLocation();
+
+	for (const FCompiledSnapCandidate& Candidate : Table.GetCandidates(Type))
+	{
+		// The part must line up with a socket of some target in range, not just be near one
+		FBuildingPartHandle Target;
+		Registry.ForEachInRadius(Location, (EBuildingPartType)Candidate.TargetType, SearchRadius, [&](FBuildingPartHandle Handle)
+		{
+			if (!MatchesSocket(Registry, Candidate, Handle, Type, Transform, LocalExtent)) return true;
+
+			Target = Handle;
+			return false;
+		});
+		if (!Target.IsValid()) continue;
+
+		// A part resting on a support must sit at the height the preview solve put it
+		if (Candidate.RestOnType != INDEX_NONE)
+		{
+			const FBuildingPartHandle Rest = Registry.FindNearest(Location, (EBuildingPartType)Candidate.RestOnType, SearchRadius);
+			if (!Rest.IsValid()) continue;
+
+			const float PartSocketZ = ABuildingPart::GetSocketRelativeTransform((EBuildingPartType)Type, LocalExtent, Candidate.PartSocket).GetLocation().Z
+				* Transform.GetScale3D().Z;
+			const float RestZ = Registry.GetSnapTransform(Rest, ESnapPoint::Top).GetLocation().Z - PartSocketZ + Candidate.Offset.Z;
+			if (FMath::Abs(Location.Z - RestZ) > RestHeightTolerance) continue;
+		}
+
+		OutSupports.Reset();
+		OutSupports.Add(Target);
+
+		bool bSupported = true;
+		for (int32 SupportType = 0; SupportType < Table.NumTypes() && bSupported; ++SupportType)
+		{
+			if (Candidate.SupportMask & (1u << SupportType))
+			{
+				const FBuildingPartHandle Support = Registry.FindNearest(Location, (EBuildingPartType)SupportType, SearchRadius);
+				bSupported = Support.IsValid();
+				if (bSupported && OutSupports.Num() < FBuildingSupportLinks::Max)
+				{
+					OutSupports.AddUnique(Support);
+				}
+			}
+		}
+
+		if (bSupported) return true;
+	}
+
+	OutSupports.Reset();
+	return false;
+}
+
+int32 UBuildingPlacementSubsystem::ResolveBatch(TArray<ABuildingPart*>* OutPlaced)
+{
+	SCOPE_CYCLE_COUNTER(STAT_BuildingPlacementResolve);
+
+	FMemory::Memzero(LastRejected);
+	if (!Registry || Pending.Num() == 0) return 0;
+
+	// Take the oldest requests; anything past the cap waits, still in arrival order
+	const int32 NumRequests = FMath::Min(Pending.Num(), FMath::Max(MaxRequestsPerBatch, 1));
+	Batch.Reset();
+	Batch.Append(Pending.GetData(), NumRequests);
+	Pending.RemoveAt(0, NumRequests, EAllowShrinking::No);
+
+	SET_DWORD_STAT(STAT_BuildingPlacementRequests, NumRequests);
+
+	Recent.RemoveAll([](const FRecentPlacement& Placed) { return Placed.Frame + 2 <= GFrameCounter; });
+
+	// Gather what validation needs on the game thread: class defaults, snap tables and boxes
+	Resolved.Reset();
+	Resolved.SetNum(NumRequests);
+
+	const APlayerChar* DefaultPlayer = GetDefault<APlayerChar>();
+	for (int32 i = 0; i < NumRequests; ++i)
+	{
+		FPlacementRequest& Request = Batch[i];
+		FResolvedPlacement& Placement = Resolved[i];
+
+		const ABuildingPart* PartDefaults = Request.PartClass ? Request.PartClass->GetDefaultObject<ABuildingPart>() : nullptr;
+		APlayerChar* Player = Request.Player.Get();
+		if (!PartDefaults || (!Request.Player.IsExplicitlyNull() && !Player))
+		{
+			Placement.Reason = EPlacementRejectReason::InvalidRequest;
+			continue;
+		}
+
+		// Players build only what their kit makes, within reach, and pay before validation so
+		// two requests in one batch cannot spend the same kit
+		if (Player)
+		{
+			if (!Player->BuildingArray.IsValidIndex(Request.BuildingId)
+				|| Player->GetBuildPartClass(Request.BuildingId).ToSoftObjectPath() != FSoftObjectPath(Request.PartClass.Get()))
+			{
+				Placement.Reason = EPlacementRejectReason::InvalidRequest;
+				continue;
+			}
+
+			if (FVector::DistSquared(Player->GetActorLocation(), Request.Transform.GetLocation()) > FMath::Square(Player->MaxBuildReach))
+			{
+				Placement.Reason = EPlacementRejectReason::OutOfReach;
+				continue;
+			}
+
+			if (!Request.bKitSpent)
+			{
+				if (Player->BuildingArray[Request.BuildingId] < 1)
+				{
+					Placement.Reason = EPlacementRejectReason::NoKit;
+					continue;
+				}
+				Player->BuildingArray[Request.BuildingId] -= 1;
+				Request.bKitSpent = true;
+			}
+		}
+
+		const APlayerChar* Rules = Player ? Player : DefaultPlayer;
+		Placement.Table = &Rules->GetSnapTable();
+		Placement.Type = (int32)PartDefaults->PartType;
+		if (Placement.Type >= Placement.Table->NumTypes())
+		{
+			Placement.Reason = EPlacementRejectReason::InvalidRequest;
+			continue;
+		}
+
+		Placement.LocalExtent = PartDefaults->GetLocalExtents();
+		const FVector Extent = Placement.LocalExtent * Request.Transform.GetScale3D().GetAbs();
+		Placement.BoxExtent = Extent * 0.98f;
+		Placement.BoundsRadius = Placement.BoxExtent.Size();
+
+		// Same allowance as ValidatePlacement: the centre can be up to the part's size past the socket
+		Placement.SearchRadius = Rules->SnapRadius + FBox(-Extent, Extent).TransformBy(Request.Transform).GetExtent().GetMax();
+	}
+
+	// Validate every request against the same registry state. Nothing writes to the registry
+	// until the batch is decided, so the searches can run on any thread.
+	const UBuildingRegistrySubsystem& RegistryRef = *Registry;
+	ParallelFor(NumRequests, [this, &RegistryRef](int32 i)
+	{
+		FResolvedPlacement& Placement = Resolved[i];
+		if (Placement.Reason != EPlacementRejectReason::None) return;
+
+		const FTransform& Transform = Batch[i].Transform;
+		if (!FindSupports(RegistryRef, *Placement.Table, Placement.Type, Transform, Placement.LocalExtent, Placement.SearchRadius, Placement.Supports))
+		{
+			Placement.Reason = EPlacementRejectReason::NoSupport;
+			return;
+		}
+
+		// Only earlier requests matter, since they are decided first
+		for (int32 j = 0; j < i; ++j)
+		{
+			const FResolvedPlacement& Other = Resolved[j];
+			if (Other.Table == nullptr) continue;
+
+			const FTransform& OtherTransform = Batch[j].Transform;
+			if (FVector::DistSquared(Transform.GetLocation(), OtherTransform.GetLocation()) > FMath::Square(Placement.BoundsRadius + Other.BoundsRadius))
+			{
+				continue;
+			}
+
+			if (YawBoxesOverlap(Transform, Placement.BoxExtent, OtherTransform, Other.BoxExtent))
+			{
+				Placement.Overlaps.Add(j);
+			}
+		}
+
+		for (const FRecentPlacement& Placed : Recent)
+		{
+			if (FVector::DistSquared(Transform.GetLocation(), Placed.Transform.GetLocation()) <= FMath::Square(Placement.BoundsRadius + Placed.BoundsRadius)
+				&& YawBoxesOverlap(Transform, Placement.BoxExtent, Placed.Transform, Placed.BoxExtent))
+			{
+				Placement.Reason = EPlacementRejectReason::Blocked;
+				return;
+			}
+		}
+	}, NumRequests < MinParallelBatch ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+	// Decide in arrival order, so the outcome only depends on the order requests came in.
+	// Ground and world collision are checked here, for survivors only.
+	const ULandscapeHeightSubsystem* Heights = GetWorld()->GetSubsystem<ULandscapeHeightSubsystem>();
+	for (int32 i = 0; i < NumRequests; ++i)
+	{
+		FResolvedPlacement& Placement = Resolved[i];
+		if (Placement.Reason != EPlacementRejectReason::None) continue;
+
+		for (int32 Earlier : Placement.Overlaps)
+		{
+			if (Resolved[Earlier].bAccepted)
+			{
+				Placement.Reason = EPlacementRejectReason::Conflict;
+				break;
+			}
+		}
+		if (Placement.Reason != EPlacementRejectReason::None) continue;
+
+		const FTransform& Transform = Batch[i].Transform;
+
+		FCollisionQueryParams Params;
+		Params.AddIgnoredActor(Batch[i].Player.Get());
+
+		// Foundations have to stand on the ground, snapped or not. Traces need the game thread.
+		if (Placement.Table->IsGroundType(Placement.Type))
+		{
+			const APlayerChar* Rules = Batch[i].Player.IsValid() ? Batch[i].Player.Get() : DefaultPlayer;
+			const FVector Extent = Placement.LocalExtent * Transform.GetScale3D().GetAbs();
+
+			FFootprintHeights Ground;
+			if (!Heights || !Heights->SampleGround(Transform.GetLocation(), FVector2D(Extent), Transform.Rotator().Yaw, Params, Ground)
+				|| !Rules->FoundationFits(Ground, Transform.GetLocation().Z - Extent.Z))
+			{
+				Placement.Reason = EPlacementRejectReason::NoGround;
+				continue;
+			}
+		}
+
+		if (GetWorld()->OverlapAnyTestByChannel(Transform.GetLocation(), Transform.GetRotation(), ECC_WorldStatic,
+			FCollisionShape::MakeBox(Placement.BoxExtent), Params))
+		{
+			Placement.Reason = EPlacementRejectReason::Blocked;
+			continue;
+		}
+
+		Placement.bAccepted = true;
+	}
+
+	// Apply every winner together, after all decisions are made
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	bool bAnyAccepted = false;
+	for (const FResolvedPlacement& Placement : Resolved)
+	{
+		bAnyAccepted |= Placement.bAccepted;
+	}
+
+	int32 NumPlaced = 0;
+	int32 NumRejected = 0;
+	Deferred.Reset();
+	for (int32 i = 0; i < NumRequests; ++i)
+	{
+		FPlacementRequest& Request = Batch[i];
+		const FResolvedPlacement& Placement = Resolved[i];
+
+		if (!Placement.bAccepted)
+		{
+			// A support may have been among this batch's winners, so try once more next batch
+			if (Placement.Reason == EPlacementRejectReason::NoSupport && !Request.bDeferred && bAnyAccepted)
+			{
+				Request.bDeferred = true;
+				Deferred.Add(Request);
+				continue;
+			}
+
+			Reject(Request, Placement.Reason);
+			++NumRejected;
+			continue;
+		}
+
+		APlayerChar* Player = Request.Player.Get();
+		SpawnParams.Owner = Player;
+		SpawnParams.Instigator = Player;
+
+		ABuildingPart* Part = GetWorld()->SpawnActor<ABuildingPart>(Request.PartClass, Request.Transform, SpawnParams);
+		if (!Part)
+		{
+			Reject(Request, EPlacementRejectReason::InvalidRequest);
+			++NumRejected;
+			continue;
+		}
+
+		Part->OnPlaced(Placement.Supports);
+		++NumPlaced;
+
+		FRecentPlacement& Placed = Recent.AddDefaulted_GetRef();
+		Placed.Transform = Request.Transform;
+		Placed.BoxExtent = Placement.BoxExtent;
+		Placed.BoundsRadius = Placement.BoundsRadius;
+		Placed.Frame = GFrameCounter;
+
+		if (Player)
+		{
+			Player->BuildJournal->RecordPlace(Part, Request.BuildingId);
+			Player->NotePartBuilt(Part);
+		}
+		if (OutPlaced)
+		{
+			OutPlaced->Add(Part);
+		}
+	}
+
+	// Held back requests are older than anything still waiting, so they go first next batch
+	Pending.Insert(Deferred, 0);
+
+	SET_DWORD_STAT(STAT_BuildingPlacementRejected, NumRejected);
+	return NumPlaced;
+}
+
+void UBuildingPlacementSubsystem::Reject(const FPlacementRequest& Request, EPlacementRejectReason Reason)
+{
+	++LastRejected[(uint8)Reason];
+
+	if (APlayerChar* Player = Request.Player.Get())
+	{
+		if (Request.bKitSpent && Player->BuildingArray.IsValidIndex(Request.BuildingId))
+		{
+			Player->BuildingArray[Request.BuildingId] += 1;
+		}
+		Player->ClientPlacementRejected(Reason, Request.BuildingId);
+	}
+}
+
+// Benchmark helper: "Building.PlacementBench <Players> <PartsPerPlayer>" queues a floor from
+// every player per round onto a shared grid near the first player, so some requests collide,
+// then times resolving them as server batches. The parts placed are destroyed afterwards.
+GAM312_BENCH_COMMAND(GBuildingPlacementBenchCmd, "Building.PlacementBench",
+	"Times batched placement resolution. Usage: Building.PlacementBench <Players> <PartsPerPlayer>")
+{
+	UBuildingPlacementSubsystem* Placement = World ? World->GetSubsystem<UBuildingPlacementSubsystem>() : nullptr;
+	APlayerChar* Player = Cast<APlayerChar>(UGameplayStatics::GetPlayerCharacter(World, 0));
+	if (!Placement || !Player || World->GetNetMode() == NM_Client) return;
+
+	UClass* PartClass = Player->GetBuildPartClass(1).LoadSynchronous();
+	if (!PartClass) return;
+
+	const int32 Players = GAM312Bench::Count(Args, 0, 64);
+	const int32 PartsPerPlayer = GAM312Bench::Count(Args, 1, 8);
+	const int32 Total = Players * PartsPerPlayer;
+
+	// About one request in four lands on a cell someone else picked
+	const FVector Extent = PartClass->GetDefaultObject<ABuildingPart>()->GetLocalExtents();
+	const int32 Side = FMath::Max(FMath::CeilToInt(FMath::Sqrt(Total * 0.75f)), 1);
+	const FVector Origin = Player->GetActorLocation() + Player->GetActorForwardVector() * 1000.f
+		+ FVector(0.f, 0.f, Extent.Z - Player->GetSimpleCollisionHalfHeight() + 5.f);
+
+	FRandomStream Random(Total);
+	for (int32 Round = 0; Round < PartsPerPlayer; ++Round)
+	{
+		for (int32 p = 0; p < Players; ++p)
+		{
+			const int32 Cell = Random.RandHelper(Side * Side);
+			const FVector Location = Origin + FVector((Cell % Side) * Extent.X * 2.f, (Cell / Side) * Extent.Y * 2.f, 0.f);
+			Placement->QueuePlacement(nullptr, PartClass, FTransform(Location), INDEX_NONE);
+		}
+	}
+
+	TArray<ABuildingPart*> Placed;
+	int32 Rejected[(uint8)EPlacementRejectReason::Count] = {};
+	int32 Batches = 0;
+
+	const double Start = FPlatformTime::Seconds();
+	while (Placement->GetNumPending() > 0)
+	{
+		Placement->ResolveBatch(&Placed);
+		++Batches;
+		for (int32 Reason = 0; Reason < (int32)EPlacementRejectReason::Count; ++Reason)
+		{
+			Rejected[Reason] += Placement->GetLastRejected((EPlacementRejectReason)Reason);
+		}
+	}
+	const double Ms = (FPlatformTime::Seconds() - Start) * 1000.0;
+
+	UE_LOG(LogGAM312, Log, TEXT("Building.PlacementBench: %d requests from %d players in %d batches, %.2f ms (%.0f requests/s). Placed %d, conflict %d, blocked %d, no support %d."),
+		Total, Players, Batches, Ms, Total / FMath::Max(Ms / 1000.0, 1e-6), Placed.Num(),
+		Rejected[(uint8)EPlacementRejectReason::Conflict], Rejected[(uint8)EPlacementRejectReason::Blocked], Rejected[(uint8)EPlacementRejectReason::NoSupport]);
+
+	for (ABuildingPart* Part : Placed)
+	{
+		Part->Destroy();
+	}
+}
@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "BuildingRegistrySubsystem.h"
+#include "BuildingPlacementSubsystem.generated.h"
+
+class APlayerChar;
+class ABuildingPart;
+struct FCompiledSnapTable;
+
+// Why the server turned down a placement
+UENUM()
+enum class EPlacementRejectReason : uint8
+{
+	None,
+	InvalidRequest,  // Unknown class, a class the kit does not build, or the player left
+	NoSupport,       // Nothing to snap to or rest on
+	Blocked,         // Overlaps the world or an existing part
+	Conflict,        // Overlaps a request placed earlier in the same batch
+	OutOfReach,      // Further from the player than they can build
+	NoKit,           // The player has no kit left for the part
+	NoGround,        // A foundation sunk too deep into the ground or left hanging over it
+	Count UMETA(Hidden)
+};
+
+// Parts a placement rests on
+using FPlacementSupports = TArray<FBuildingPartHandle, TInlineAllocator<FBuildingSupportLinks::Max>>;
+
+// A placement a client has committed, waiting for the next batch
+struct FPlacementRequest
+{
+	TWeakObjectPtr<APlayerChar> Player;
+	TSubclassOf<ABuildingPart> PartClass;
+	FTransform Transform;
+	int32 BuildingId = INDEX_NONE;
+
+	// Already held back once for a support that might have been placed in the same batch
+	bool bDeferred = false;
+
+	// The player's kit has been taken, and is returned if the request is rejected
+	bool bKitSpent = false;
+};
+
+/**
+ * Places committed parts on the server in one batch per tick. Every request in a batch is
+ * validated in parallel against the same registry state, then requests are accepted in
+ * arrival order: one that overlaps an earlier accepted request is rejected, so two players
+ * can never both take the same spot. Accepted parts are spawned together after every
+ * decision is made, and rejected players are told why.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UBuildingPlacementSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Queues a part for the next batch. A null player places an unowned part.
+	void QueuePlacement(APlayerChar* Player, TSubclassOf<ABuildingPart> PartClass, const FTransform& Transform, int32 BuildingId);
+
+	// Resolves up to MaxRequestsPerBatch queued requests now. Returns how many were placed.
+	int32 ResolveBatch(TArray<ABuildingPart*>* OutPlaced = nullptr);
+
+	int32 GetNumPending() const { return Pending.Num(); }
+
+	// Rejections of one reason in the last batch
+	int32 GetLastRejected(EPlacementRejectReason Reason) const { return LastRejected[(uint8)Reason]; }
+
+	// Finds what a part of a type at a transform would rest on, by the snap rules: its socket must
+	// meet a target's socket at the rule's yaw, a resting part must sit on its support, and every
+	// required support must be in range. Ground types need nothing. Only reads
+	// the registry, so it is safe off the game thread while nothing writes.
+	static bool FindSupports(const UBuildingRegistrySubsystem& Registry, const FCompiledSnapTable& Table, int32 Type,
+		const FTransform& Transform, const FVector& LocalExtent, float SearchRadius, FPlacementSupports& OutSupports);
+
+// --- Settings ---
+
+	// Most requests resolved in one tick; the rest wait for the next
+	UPROPERTY(Config)
+		int32 MaxRequestsPerBatch = 256;
+
+	// Smaller batches are validated on the game thread
+	UPROPERTY(Config)
+		int32 MinParallelBatch = 8;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	// A request with everything validation needs, gathered on the game thread
+	struct FResolvedPlacement
+	{
+		const FCompiledSnapTable* Table = nullptr;
+		int32 Type = 0;
+		float SearchRadius = 0.f;
+
+		// Unscaled half size of the part's mesh, for socket heights
+		FVector LocalExtent = FVector::ZeroVector;
+
+		// Collision box, slightly shrunk so touching parts do not count as overlapping
+		FVector BoxExtent = FVector::ZeroVector;
+		float BoundsRadius = 0.f;
+
+		FPlacementSupports Supports;
+
+		// Earlier requests in the batch this one overlaps
+		TArray<int32, TInlineAllocator<4>> Overlaps;
+
+		EPlacementRejectReason Reason = EPlacementRejectReason::None;
+		bool bAccepted = false;
+	};
+
+	// A part placed by a recent batch, which may not be in its chunk's collision yet
+	struct FRecentPlacement
+	{
+		FTransform Transform;
+		FVector BoxExtent = FVector::ZeroVector;
+		float BoundsRadius = 0.f;
+		uint64 Frame = 0;
+	};
+
+	void Reject(const FPlacementRequest& Request, EPlacementRejectReason Reason);
+
+	UPROPERTY(Transient)
+		TObjectPtr<UBuildingRegistrySubsystem> Registry;
+
+	TArray<FPlacementRequest> Pending;
+
+	// Scratch reused every batch
+	TArray<FPlacementRequest> Batch;
+	TArray<FResolvedPlacement> Resolved;
+	TArray<FPlacementRequest> Deferred;
+
+	// Chunk bodies are rebuilt at the end of a frame, so world collision misses parts placed
+	// since then. Batches test against these instead until the rebuild has happened.
+	TArray<FRecentPlacement> Recent;
+
+	int32 LastRejected[(uint8)EPlacementRejectReason::Count] = {};
+};
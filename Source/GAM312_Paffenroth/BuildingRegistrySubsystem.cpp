@@ -0,0 +1,281 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingRegistrySubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "EngineUtils.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Building Registry Parts"), STAT_BuildingRegistryParts, STATGROUP_GAM312);
+
+// FBuildingPartStore
+
+int32 FBuildingPartStore::AddDefaulted()
+{
+	Type.AddDefaulted();
+	Location.AddDefaulted();
+	Transform.AddDefaulted();
+	LocalExtent.AddDefaulted();
+	BoxCenter.AddDefaulted();
+	BoxExtent.AddDefaulted();
+	Health.AddDefaulted();
+	MaxHealth.AddDefaulted();
+	DecayRate.AddDefaulted();
+	LastTouched.AddDefaulted();
+	LastProcessed.AddDefaulted();
+	Supports.AddDefaulted();
+	Owner.AddDefaulted();
+	Actor.AddDefaulted();
+	return Handle.AddDefaulted();
+}
+
+void FBuildingPartStore::RemoveAtSwap(int32 Index)
+{
+	Handle.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Type.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Location.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Transform.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	LocalExtent.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	BoxCenter.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	BoxExtent.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Health.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	MaxHealth.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	DecayRate.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	LastTouched.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	LastProcessed.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Supports.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Owner.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	Actor.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+}
+
+// UBuildingRegistrySubsystem
+
+void UBuildingRegistrySubsystem::Deinitialize()
+{
+	Store = FBuildingPartStore();
+	Slots.Empty();
+	FreeSlots.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UBuildingRegistrySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+FBuildingPartHandle UBuildingRegistrySubsystem::AllocateSlot(int32 Dense)
+{
+	int32 SlotIndex;
+	if (FreeSlots.Num() > 0)
+	{
+		SlotIndex = FreeSlots.Pop(EAllowShrinking::No);
+	}
+	else
+	{
+		// Handles only have room for IndexBits of slot index
+		check(Slots.Num() <= (int32)FBuildingPartHandle::IndexMask);
+		SlotIndex = Slots.AddDefaulted();
+	}
+
+	Slots[SlotIndex].Dense = Dense;
+	return FBuildingPartHandle(SlotIndex, Slots[SlotIndex].Generation);
+}
+
+FBuildingPartHandle UBuildingRegistrySubsystem::AddPartData(EBuildingPartType Type, const FTransform& Transform, const FVector& LocalExtent, float MaxHealth, float DecayRate)
+{
+	const int32 Dense = Store.AddDefaulted();
+	const FBuildingPartHandle Handle = AllocateSlot(Dense);
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	Store.Handle[Dense] = Handle;
+	Store.Type[Dense] = Type;
+	Store.Location[Dense] = Transform.GetLocation();
+	Store.Transform[Dense] = Transform;
+	Store.LocalExtent[Dense] = LocalExtent;
+	Store.BoxCenter[Dense] = Transform.GetLocation();
+	Store.BoxExtent[Dense] = LocalExtent * Transform.GetScale3D().GetAbs();
+	Store.Health[Dense] = MaxHealth;
+	Store.MaxHealth[Dense] = MaxHealth;
+	Store.DecayRate[Dense] = DecayRate;
+	Store.LastTouched[Dense] = Now;
+	Store.LastProcessed[Dense] = Now;
+
+	SET_DWORD_STAT(STAT_BuildingRegistryParts, Store.Num());
+	return Handle;
+}
+
+FBuildingPartHandle UBuildingRegistrySubsystem::AddPart(ABuildingPart* Part, TConstArrayView<FBuildingPartHandle> Supports)
+{
+	if (!Part) return FBuildingPartHandle();
+	if (IsValid(Part->Handle)) return Part->Handle;
+
+	const FBuildingPartHandle Handle = AddPartData(Part->PartType, Part->GetActorTransform(), Part->GetLocalExtents(), Part->MaxHealth, Part->DecayRate);
+	const int32 Dense = ToDense(Handle);
+
+	// The collision box follows the mesh, which may be offset from the pivot
+	if (Part->Mesh)
+	{
+		const FBoxSphereBounds LocalBounds = Part->Mesh->CalcBounds(FTransform::Identity);
+		const FTransform MeshToWorld = Part->Mesh->GetComponentTransform();
+		Store.BoxCenter[Dense] = MeshToWorld.TransformPosition(LocalBounds.Origin);
+		Store.BoxExtent[Dense] = LocalBounds.BoxExtent * MeshToWorld.GetScale3D().GetAbs();
+	}
+
+	for (int32 i = 0; i < FMath::Min(Supports.Num(), FBuildingSupportLinks::Max); ++i)
+	{
+		Store.Supports[Dense].Links[i] = Supports[i];
+	}
+
+	Store.Owner[Dense] = Part->GetOwner();
+	Store.Actor[Dense] = Part;
+	Part->Handle = Handle;
+	return Handle;
+}
+
+void UBuildingRegistrySubsystem::RemovePart(FBuildingPartHandle Handle)
+{
+	const int32 Dense = ToDense(Handle);
+	if (Dense == INDEX_NONE) return;
+
+	OnPartRemoved.Broadcast(Handle);
+
+	if (ABuildingPart* Part = Store.Actor[Dense].Get())
+	{
+		Part->Handle.Reset();
+	}
+
+	// The last part moves into the freed dense slot
+	const int32 Last = Store.Num() - 1;
+	if (Dense != Last)
+	{
+		Slots[Store.Handle[Last].GetIndex()].Dense = Dense;
+	}
+	Store.RemoveAtSwap(Dense);
+
+	// Bumping the generation makes every outstanding handle to this slot stale
+	FSlot& Slot = Slots[Handle.GetIndex()];
+	Slot.Dense = INDEX_NONE;
+	Slot.Generation = Slot.Generation >= FBuildingPartHandle::MaxGeneration ? 1 : Slot.Generation + 1;
+	FreeSlots.Add(Handle.GetIndex());
+
+	SET_DWORD_STAT(STAT_BuildingRegistryParts, Store.Num());
+}
+
+int32 UBuildingRegistrySubsystem::ToDense(FBuildingPartHandle Handle) const
+{
+	if (!Handle.IsValid() || !Slots.IsValidIndex(Handle.GetIndex())) return INDEX_NONE;
+
+	const FSlot& Slot = Slots[Handle.GetIndex()];
+	return Slot.Generation == Handle.GetGeneration() ? Slot.Dense : INDEX_NONE;
+}
+
+ABuildingPart* UBuildingRegistrySubsystem::GetActor(FBuildingPartHandle Handle) const
+{
+	const int32 Dense = ToDense(Handle);
+	return Dense != INDEX_NONE ? Store.Actor[Dense].Get() : nullptr;
+}
+
+FTransform UBuildingRegistrySubsystem::GetSnapTransform(FBuildingPartHandle Handle, ESnapPoint Point) const
+{
+	const int32 Dense = ToDense(Handle);
+	if (Dense == INDEX_NONE) return FTransform::Identity;
+
+	return ABuildingPart::GetSocketRelativeTransform(Store.Type[Dense], Store.LocalExtent[Dense], Point) * Store.Transform[Dense];
+}
+
+FBuildingPartHandle UBuildingRegistrySubsystem::FindNearest(const FVector& Point, EBuildingPartType Type, float Radius, FBuildingPartHandle Ignore) const
+{
+	int32 Best = INDEX_NONE;
+	double BestDistSq = FMath::Square((double)Radius);
+
+	const int32 Count = Store.Num();
+	const EBuildingPartType* Types = Store.Type.GetData();
+	const FVector* Locations = Store.Location.GetData();
+
+	for (int32 i = 0; i < Count; ++i)
+	{
+		if (Types[i] != Type) continue;
+
+		const double DistSq = FVector::DistSquared(Locations[i], Point);
+		if (DistSq < BestDistSq && Store.Handle[i] != Ignore)
+		{
+			BestDistSq = DistSq;
+			Best = i;
+		}
+	}
+
+	return Best != INDEX_NONE ? Store.Handle[Best] : FBuildingPartHandle();
+}
+
+void UBuildingRegistrySubsystem::ForEachInRadius(const FVector& Point, EBuildingPartType Type, float Radius, TFunctionRef<bool(FBuildingPartHandle Handle)> Fn) const
+{
+	const double RadiusSq = FMath::Square((double)Radius);
+
+	const int32 Count = Store.Num();
+	const EBuildingPartType* Types = Store.Type.GetData();
+	const FVector* Locations = Store.Location.GetData();
+
+	for (int32 i = 0; i < Count; ++i)
+	{
+		if (Types[i] == Type && FVector::DistSquared(Locations[i], Point) <= RadiusSq && !Fn(Store.Handle[i]))
+		{
+			return;
+		}
+	}
+}
+
+// Benchmark helper: "Building.RegistryBench <Queries>" times nearest-part searches through
+// the registry against the old TActorIterator path. Use Building.DecayStress to add parts.
+GAM312_BENCH_COMMAND(GBuildingRegistryBenchCmd, "Building.RegistryBench",
+	"Times nearest-part queries against the registry and the actor iterator. Usage: Building.RegistryBench <Queries>")
+{
+	UBuildingRegistrySubsystem* Registry = World ? World->GetSubsystem<UBuildingRegistrySubsystem>() : nullptr;
+	if (!Registry) return;
+
+	const int32 Queries = GAM312Bench::Count(Args, 0, 1000);
+
+	FRandomStream Random(Queries);
+	TArray<FVector> Points;
+	Points.Reserve(Queries);
+	for (int32 i = 0; i < Queries; ++i)
+	{
+		Points.Add(Random.VRand() * Random.FRandRange(0.f, 20000.f));
+	}
+
+	int32 RegistryHits = 0;
+	const double RegistryStart = FPlatformTime::Seconds();
+	for (const FVector& Point : Points)
+	{
+		RegistryHits += Registry->FindNearest(Point, EBuildingPartType::Floor, 2000.f).IsValid() ? 1 : 0;
+	}
+	const double RegistryMs = GAM312Bench::MsSince(RegistryStart);
+
+	int32 ActorHits = 0;
+	int32 NumActors = 0;
+	const double ActorStart = FPlatformTime::Seconds();
+	for (const FVector& Point : Points)
+	{
+		const ABuildingPart* Best = nullptr;
+		double BestDistSq = FMath::Square(2000.0);
+		NumActors = 0;
+
+		for (TActorIterator<ABuildingPart> It(World); It; ++It)
+		{
+			++NumActors;
+			if (It->PartType != EBuildingPartType::Floor) continue;
+
+			const double DistSq = FVector::DistSquared(It->GetActorLocation(), Point);
+			if (DistSq < BestDistSq)
+			{
+				BestDistSq = DistSq;
+				Best = *It;
+			}
+		}
+		ActorHits += Best ? 1 : 0;
+	}
+	const double ActorMs = GAM312Bench::MsSince(ActorStart);
+
+	UE_LOG(LogGAM312, Log, TEXT("Building.RegistryBench: %d queries over %d parts in %.3f ms (%d hits). Actor iterator: %d queries over %d actors in %.3f ms (%d hits)."),
+		Queries, Registry->Num(), RegistryMs, RegistryHits, Queries, NumActors, ActorMs, ActorHits);
+}
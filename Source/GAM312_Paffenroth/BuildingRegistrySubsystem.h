@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "BuildingPart.h"
+#include "BuildingPartHandle.h"
+#include "BuildingRegistrySubsystem.generated.h"
+
+// Parts a placed part rests on
+struct FBuildingSupportLinks
+{
+	static constexpr int32 Max = 4;
+
+	FBuildingPartHandle Links[Max];
+};
+
+/**
+ * Gameplay data for every registered part, one dense slot per part in parallel arrays.
+ * Slots are removed by swapping with the last one, so dense indices are not stable;
+ * hold FBuildingPartHandle instead.
+ */
+struct FBuildingPartStore
+{
+	TArray<FBuildingPartHandle> Handle;
+	TArray<EBuildingPartType> Type;
+
+	// Actor location, kept apart from Transform for tight search loops
+	TArray<FVector> Location;
+	TArray<FTransform> Transform;
+
+	// Unscaled mesh half extents, which the snap sockets are placed from
+	TArray<FVector> LocalExtent;
+
+	// World-space collision box, rotated with Transform
+	TArray<FVector> BoxCenter;
+	TArray<FVector> BoxExtent;
+
+	TArray<float> Health;
+	TArray<float> MaxHealth;
+
+	// Health lost per second once decay has started
+	TArray<float> DecayRate;
+
+	// World time the part was last placed, repaired or damaged
+	TArray<double> LastTouched;
+
+	// World time the part was last processed by the decay scheduler
+	TArray<double> LastProcessed;
+
+	TArray<FBuildingSupportLinks> Supports;
+	TArray<TWeakObjectPtr<AActor>> Owner;
+
+	// Visual representation, if the part currently has one
+	TArray<TWeakObjectPtr<ABuildingPart>> Actor;
+
+	int32 Num() const { return Handle.Num(); }
+
+	int32 AddDefaulted();
+
+	void RemoveAtSwap(int32 Index);
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnBuildingPartRemoved, FBuildingPartHandle /*Handle*/);
+
+/**
+ * Registry of placed building parts addressed by generational handles. Adding, removing
+ * and resolving a handle are O(1), and scans walk dense arrays instead of actors.
+ * Parts may exist without an actor.
+ */
+UCLASS()
+class GAM312_PAFFENROTH_API UBuildingRegistrySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Registers a placed part actor and stores its handle on it
+	FBuildingPartHandle AddPart(ABuildingPart* Part, TConstArrayView<FBuildingPartHandle> Supports = {});
+
+	// Registers a part that has no actor
+	FBuildingPartHandle AddPartData(EBuildingPartType Type, const FTransform& Transform, const FVector& LocalExtent, float MaxHealth, float DecayRate);
+
+	// Removes a part. Stale handles are ignored.
+	void RemovePart(FBuildingPartHandle Handle);
+
+	// Dense index of a live handle, or INDEX_NONE if it is stale
+	int32 ToDense(FBuildingPartHandle Handle) const;
+
+	bool IsValid(FBuildingPartHandle Handle) const { return ToDense(Handle) != INDEX_NONE; }
+
+	// Actor for a handle, or null if the handle is stale or the part has no actor
+	ABuildingPart* GetActor(FBuildingPartHandle Handle) const;
+
+	// World transform of a snap socket, computed from the stored transform and extents
+	FTransform GetSnapTransform(FBuildingPartHandle Handle, ESnapPoint Point) const;
+
+	// Closest part of a type within a radius, by linear scan
+	FBuildingPartHandle FindNearest(const FVector& Point, EBuildingPartType Type, float Radius, FBuildingPartHandle Ignore = FBuildingPartHandle()) const;
+
+	// Calls Fn for every part of a type within a radius, by linear scan, until Fn returns false
+	void ForEachInRadius(const FVector& Point, EBuildingPartType Type, float Radius, TFunctionRef<bool(FBuildingPartHandle Handle)> Fn) const;
+
+	// Dense arrays for systems that scan every part. Fields may be written; add and remove through the registry.
+	FBuildingPartStore& GetStore() { return Store; }
+	const FBuildingPartStore& GetStore() const { return Store; }
+
+	int32 Num() const { return Store.Num(); }
+
+	// Broadcast just before a part leaves the registry
+	FOnBuildingPartRemoved OnPartRemoved;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FSlot
+	{
+		int32 Dense = INDEX_NONE;
+		uint32 Generation = 1;
+	};
+
+	FBuildingPartHandle AllocateSlot(int32 Dense);
+
+	FBuildingPartStore Store;
+
+	TArray<FSlot> Slots;
+	TArray<int32> FreeSlots;
+};
@@ -0,0 +1,635 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingRoomSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "BuildingPart.h"
+#include "BuildingInstanceSubsystem.h"
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Room Rebuild"), STAT_RoomRebuild, STATGROUP_GAM312);
+DECLARE_CYCLE_STAT(TEXT("Room Visibility"), STAT_RoomVisibility, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Rooms"), STAT_Rooms, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Room Hidden Primitives"), STAT_RoomHiddenPrimitives, STATGROUP_GAM312);
+
+static TAutoConsoleVariable<int32> CVarRoomCulling(
+	TEXT("Building.RoomCulling"),
+	1,
+	TEXT("Hide the interior of rooms the camera cannot see into. 0 = off, 1 = on."));
+
+// Last component of a grid key
+namespace RoomGridKind
+{
+	// Wall on the boundary X = key.X, between cells X - 1 and X
+	constexpr int32 EdgeX = 0;
+
+	// Wall on the boundary Y = key.Y, between cells Y - 1 and Y
+	constexpr int32 EdgeY = 1;
+
+	// Floor, ceiling or roof covering cell (X, Y) at the bottom of Level
+	constexpr int32 Slab = 2;
+}
+
+// How far a part may sit from its grid position, in cells, and still be filed
+static constexpr float RoomGridTolerance = 0.15f;
+
+// How far a part's yaw may be from the grid axes, in degrees, and still be filed
+static constexpr float RoomGridYawTolerance = 5.f;
+
+enum class ERoomEdge : uint8
+{
+	Open,
+	Solid,
+	Opening
+};
+
+void UBuildingRoomSubsystem::Deinitialize()
+{
+	for (FRoomViewState& State : ViewStates)
+	{
+		ApplyHidden(State.Controller.Get(), State, false);
+	}
+
+	ViewStates.Empty();
+	Grids.Empty();
+	PartKeys.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UBuildingRoomSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UBuildingRoomSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UBuildingRoomSubsystem, STATGROUP_Tickables);
+}
+
+int32 UBuildingRoomSubsystem::GetNumRooms() const
+{
+	int32 Num = 0;
+	for (const FRoomGrid& Grid : Grids)
+	{
+		Num += Grid.Rooms.Num();
+	}
+	return Num;
+}
+
+FIntVector UBuildingRoomSubsystem::CellAt(const FRoomGrid& Grid, const FVector& Location) const
+{
+	const FVector P = Grid.Transform.InverseTransformPosition(Location);
+	return FIntVector(FMath::FloorToInt(P.X / Grid.CellSize), FMath::FloorToInt(P.Y / Grid.CellSize), FMath::FloorToInt(P.Z / LevelHeight));
+}
+
+FVector UBuildingRoomSubsystem::EdgeCenter(const FRoomGrid& Grid, const FIntVector4& Edge) const
+{
+	const float Z = (Edge.Z + 0.5f) * LevelHeight;
+	const FVector Local = Edge.W == RoomGridKind::EdgeX
+		? FVector(Edge.X * Grid.CellSize, (Edge.Y + 0.5f) * Grid.CellSize, Z)
+		: FVector((Edge.X + 0.5f) * Grid.CellSize, Edge.Y * Grid.CellSize, Z);
+	return Grid.Transform.TransformPosition(Local);
+}
+
+FIntVector4 UBuildingRoomSubsystem::KeyForPart(const FRoomGrid& Grid, const ABuildingPart* Part) const
+{
+	const FIntVector4 Invalid(0, 0, 0, INDEX_NONE);
+
+	// Parts turned off the grid axes would be filed in the wrong cells
+	const float Yaw = FMath::Abs(FRotator::NormalizeAxis(Part->GetActorRotation().Yaw - Grid.Transform.Rotator().Yaw));
+	const float YawOffAxis = FMath::Fmod(Yaw, 90.f);
+	if (YawOffAxis > RoomGridYawTolerance && YawOffAxis < 90.f - RoomGridYawTolerance) return Invalid;
+
+	const FVector P = Grid.Transform.InverseTransformPosition(Part->GetActorLocation());
+	const float FX = P.X / Grid.CellSize;
+	const float FY = P.Y / Grid.CellSize;
+
+	if (Part->PartType == EBuildingPartType::Wall)
+	{
+		const int32 Level = FMath::FloorToInt(P.Z / LevelHeight);
+		const float DX = FMath::Abs(FX - FMath::RoundToFloat(FX));
+		const float DY = FMath::Abs(FY - FMath::RoundToFloat(FY));
+
+		if (FMath::Min(DX, DY) > RoomGridTolerance) return Invalid;
+
+		return DX < DY
+			? FIntVector4(FMath::RoundToInt(FX), FMath::FloorToInt(FY), Level, RoomGridKind::EdgeX)
+			: FIntVector4(FMath::FloorToInt(FX), FMath::RoundToInt(FY), Level, RoomGridKind::EdgeY);
+	}
+
+	// Slabs sit on cell centres
+	if (FMath::Abs(FMath::Frac(FX) - 0.5f) > RoomGridTolerance || FMath::Abs(FMath::Frac(FY) - 0.5f) > RoomGridTolerance) return Invalid;
+
+	return FIntVector4(FMath::FloorToInt(FX), FMath::FloorToInt(FY), FMath::RoundToInt(P.Z / LevelHeight), RoomGridKind::Slab);
+}
+
+bool UBuildingRoomSubsystem::HasNeighbours(const FRoomGrid& Grid, const FIntVector4& Key)
+{
+	for (int32 Z = Key.Z - 1; Z <= Key.Z + 1; ++Z)
+	{
+		for (int32 Y = Key.Y - 1; Y <= Key.Y + 1; ++Y)
+		{
+			for (int32 X = Key.X - 1; X <= Key.X + 1; ++X)
+			{
+				for (int32 Kind = RoomGridKind::EdgeX; Kind <= RoomGridKind::Slab; ++Kind)
+				{
+					if (HasElement(Grid, FIntVector4(X, Y, Z, Kind))) return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+int32 UBuildingRoomSubsystem::FindGridForPart(const ABuildingPart* Part, FIntVector4& OutKey) const
+{
+	// A part can line up with more than one grid by chance, so the base it was built onto wins
+	int32 Fallback = INDEX_NONE;
+	FIntVector4 FallbackKey;
+
+	for (TSparseArray<FRoomGrid>::TConstIterator It(Grids); It; ++It)
+	{
+		const FIntVector4 Key = KeyForPart(*It, Part);
+		if (Key.W == INDEX_NONE) continue;
+
+		if (HasNeighbours(*It, Key))
+		{
+			OutKey = Key;
+			return It.GetIndex();
+		}
+
+		if (Fallback == INDEX_NONE)
+		{
+			Fallback = It.GetIndex();
+			FallbackKey = Key;
+		}
+	}
+
+	OutKey = FallbackKey;
+	return Fallback;
+}
+
+void UBuildingRoomSubsystem::AddPart(ABuildingPart* Part)
+{
+	if (!Part || PartKeys.Contains(Part)) return;
+
+	FIntVector4 Key;
+	int32 GridIndex = FindGridForPart(Part, Key);
+
+	// A floor that lines up with no base starts a new one
+	if (GridIndex == INDEX_NONE)
+	{
+		if (Part->PartType != EBuildingPartType::Floor || !Part->Mesh) return;
+
+		FRoomGrid Grid;
+		Grid.CellSize = CellSize;
+		if (Grid.CellSize <= 0.f)
+		{
+			const FVector Extent = Part->Mesh->Bounds.BoxExtent;
+			Grid.CellSize = FMath::Max(Extent.X, Extent.Y) * 2.f;
+		}
+		if (Grid.CellSize <= 0.f) return;
+
+		const FQuat Rotation = FRotator(0.f, Part->GetActorRotation().Yaw, 0.f).Quaternion();
+		Grid.Transform = FTransform(Rotation, Part->GetActorLocation() - Rotation.RotateVector(FVector(Grid.CellSize * 0.5f, Grid.CellSize * 0.5f, 0.f)));
+
+		GridIndex = Grids.Add(MoveTemp(Grid));
+		Key = KeyForPart(Grids[GridIndex], Part);
+		check(Key.W != INDEX_NONE);
+	}
+
+	FRoomGrid& Grid = Grids[GridIndex];
+	Grid.Elements.FindOrAdd(Key).Add(Part);
+	++Grid.NumParts;
+	PartKeys.Add(Part, TPair<int32, FIntVector4>(GridIndex, Key));
+
+	MarkDirty(Grid, Key);
+}
+
+void UBuildingRoomSubsystem::RemovePart(ABuildingPart* Part)
+{
+	TPair<int32, FIntVector4> Filed;
+	if (!PartKeys.RemoveAndCopyValue(Part, Filed)) return;
+
+	FRoomGrid& Grid = Grids[Filed.Key];
+	const FIntVector4& Key = Filed.Value;
+
+	if (TArray<TWeakObjectPtr<ABuildingPart>>* Parts = Grid.Elements.Find(Key))
+	{
+		Parts->RemoveAllSwap([Part](const TWeakObjectPtr<ABuildingPart>& P) { return P.Get() == Part || !P.IsValid(); });
+		if (Parts->Num() == 0)
+		{
+			Grid.Elements.Remove(Key);
+		}
+	}
+
+	// The last part of a base takes its grid with it
+	if (--Grid.NumParts <= 0)
+	{
+		Grids.RemoveAt(Filed.Key);
+		for (FRoomViewState& State : ViewStates)
+		{
+			State.VisibleHash = 0;
+		}
+		return;
+	}
+
+	MarkDirty(Grid, Key);
+}
+
+void UBuildingRoomSubsystem::MarkDirty(FRoomGrid& Grid, const FIntVector4& Key)
+{
+	// A slab bounds the cell above and below it, a wall the cells on either side
+	Grid.DirtyCells.Add(FIntVector(Key.X, Key.Y, Key.Z));
+	switch (Key.W)
+	{
+	case RoomGridKind::Slab:  Grid.DirtyCells.Add(FIntVector(Key.X, Key.Y, Key.Z - 1)); break;
+	case RoomGridKind::EdgeX: Grid.DirtyCells.Add(FIntVector(Key.X - 1, Key.Y, Key.Z)); break;
+	case RoomGridKind::EdgeY: Grid.DirtyCells.Add(FIntVector(Key.X, Key.Y - 1, Key.Z)); break;
+	}
+}
+
+bool UBuildingRoomSubsystem::HasElement(const FRoomGrid& Grid, const FIntVector4& Key)
+{
+	const TArray<TWeakObjectPtr<ABuildingPart>>* Parts = Grid.Elements.Find(Key);
+	return Parts && Parts->Num() > 0;
+}
+
+bool UBuildingRoomSubsystem::IsRoomCell(const FRoomGrid& Grid, const FIntVector& Cell)
+{
+	return HasElement(Grid, FIntVector4(Cell.X, Cell.Y, Cell.Z, RoomGridKind::Slab))
+		&& HasElement(Grid, FIntVector4(Cell.X, Cell.Y, Cell.Z + 1, RoomGridKind::Slab));
+}
+
+FIntPoint UBuildingRoomSubsystem::FindRoomAt(const FVector& Location) const
+{
+	for (TSparseArray<FRoomGrid>::TConstIterator It(Grids); It; ++It)
+	{
+		if (const int32* RoomId = It->CellRooms.Find(CellAt(*It, Location)))
+		{
+			return FIntPoint(It.GetIndex(), *RoomId);
+		}
+	}
+	return FIntPoint(INDEX_NONE, INDEX_NONE);
+}
+
+void UBuildingRoomSubsystem::ReleaseRoom(FRoomGrid& Grid, int32 RoomId, TArray<FIntVector>& OutSeeds)
+{
+	for (const FIntVector& Cell : Grid.Rooms[RoomId].Cells)
+	{
+		Grid.CellRooms.Remove(Cell);
+	}
+	OutSeeds.Append(Grid.Rooms[RoomId].Cells);
+	Grid.Rooms.RemoveAt(RoomId);
+}
+
+void UBuildingRoomSubsystem::FloodRoom(FRoomGrid& Grid, const FIntVector& Seed, TArray<FIntVector>& Seeds)
+{
+	const int32 RoomId = Grid.Rooms.Add(FBuildingRoom());
+
+	TArray<FIntVector, TInlineAllocator<64>> Stack;
+	Stack.Add(Seed);
+	Grid.CellRooms.Add(Seed, RoomId);
+
+	auto EdgeState = [&Grid](const FIntVector4& Edge)
+	{
+		const TArray<TWeakObjectPtr<ABuildingPart>>* Parts = Grid.Elements.Find(Edge);
+		if (!Parts || Parts->Num() == 0) return ERoomEdge::Open;
+
+		for (const TWeakObjectPtr<ABuildingPart>& Part : *Parts)
+		{
+			if (Part.IsValid() && !Part->bIsOpening) return ERoomEdge::Solid;
+		}
+		return ERoomEdge::Opening;
+	};
+
+	while (Stack.Num() > 0)
+	{
+		const FIntVector Cell = Stack.Pop(EAllowShrinking::No);
+		Grid.Rooms[RoomId].Cells.Add(Cell);
+
+		const TPair<FIntVector4, FIntVector> Neighbours[4] =
+		{
+			{ FIntVector4(Cell.X,     Cell.Y,     Cell.Z, RoomGridKind::EdgeX), FIntVector(Cell.X - 1, Cell.Y, Cell.Z) },
+			{ FIntVector4(Cell.X + 1, Cell.Y,     Cell.Z, RoomGridKind::EdgeX), FIntVector(Cell.X + 1, Cell.Y, Cell.Z) },
+			{ FIntVector4(Cell.X,     Cell.Y,     Cell.Z, RoomGridKind::EdgeY), FIntVector(Cell.X, Cell.Y - 1, Cell.Z) },
+			{ FIntVector4(Cell.X,     Cell.Y + 1, Cell.Z, RoomGridKind::EdgeY), FIntVector(Cell.X, Cell.Y + 1, Cell.Z) },
+		};
+
+		for (const TPair<FIntVector4, FIntVector>& Neighbour : Neighbours)
+		{
+			const ERoomEdge State = EdgeState(Neighbour.Key);
+			if (State == ERoomEdge::Solid) continue;
+
+			if (State == ERoomEdge::Open && IsRoomCell(Grid, Neighbour.Value))
+			{
+				const int32* Other = Grid.CellRooms.Find(Neighbour.Value);
+				if (Other && *Other == RoomId) continue;
+
+				// An untouched room that now connects to this one is merged into it
+				if (Other)
+				{
+					ReleaseRoom(Grid, *Other, Seeds);
+				}
+
+				Grid.CellRooms.Add(Neighbour.Value, RoomId);
+				Stack.Add(Neighbour.Value);
+				continue;
+			}
+
+			// A gap to open space, or a doorway
+			FRoomPortal& Portal = Grid.Rooms[RoomId].Portals.AddDefaulted_GetRef();
+			Portal.FromCell = Cell;
+			Portal.ToCell = Neighbour.Value;
+			Portal.Center = EdgeCenter(Grid, Neighbour.Key);
+		}
+	}
+}
+
+void UBuildingRoomSubsystem::RebuildDirtyRooms(FRoomGrid& Grid)
+{
+	SCOPE_CYCLE_COUNTER(STAT_RoomRebuild);
+
+	TArray<FIntVector> Seeds = Grid.DirtyCells.Array();
+	Grid.DirtyCells.Reset();
+
+	// Rooms touching an edit are dropped and their cells flooded again
+	for (int32 i = 0; i < Seeds.Num(); ++i)
+	{
+		if (const int32* RoomId = Grid.CellRooms.Find(Seeds[i]))
+		{
+			ReleaseRoom(Grid, *RoomId, Seeds);
+		}
+	}
+
+	for (int32 i = 0; i < Seeds.Num(); ++i)
+	{
+		if (!Grid.CellRooms.Contains(Seeds[i]) && IsRoomCell(Grid, Seeds[i]))
+		{
+			FloodRoom(Grid, Seeds[i], Seeds);
+		}
+	}
+
+	// Visibility computed against the old rooms is stale
+	for (FRoomViewState& State : ViewStates)
+	{
+		State.VisibleHash = 0;
+	}
+}
+
+void UBuildingRoomSubsystem::CollectHiddenParts(const TSet<FIntPoint>& VisibleRooms, TArray<TWeakObjectPtr<UPrimitiveComponent>>& OutHidden) const
+{
+	for (TSparseArray<FRoomGrid>::TConstIterator GridIt(Grids); GridIt; ++GridIt)
+	{
+		const FRoomGrid& Grid = *GridIt;
+		const int32 GridIndex = GridIt.GetIndex();
+
+		auto IsHiddenCell = [&Grid, GridIndex, &VisibleRooms](const FIntVector& Cell)
+		{
+			const int32* RoomId = Grid.CellRooms.Find(Cell);
+			return RoomId && !VisibleRooms.Contains(FIntPoint(GridIndex, *RoomId));
+		};
+
+		auto AddParts = [&Grid, &OutHidden](const FIntVector4& Key)
+		{
+			if (const TArray<TWeakObjectPtr<ABuildingPart>>* Parts = Grid.Elements.Find(Key))
+			{
+				for (const TWeakObjectPtr<ABuildingPart>& Part : *Parts)
+				{
+					if (Part.IsValid() && Part->Mesh)
+					{
+						OutHidden.Add(Part->Mesh);
+					}
+				}
+			}
+		};
+
+		for (TSparseArray<FBuildingRoom>::TConstIterator It(Grid.Rooms); It; ++It)
+		{
+			if (VisibleRooms.Contains(FIntPoint(GridIndex, It.GetIndex()))) continue;
+
+			for (const FIntVector& Cell : It->Cells)
+			{
+				// The floor, unless a room below can see its underside
+				const FIntVector Below(Cell.X, Cell.Y, Cell.Z - 1);
+				if (!Grid.CellRooms.Contains(Below) || IsHiddenCell(Below))
+				{
+					AddParts(FIntVector4(Cell.X, Cell.Y, Cell.Z, RoomGridKind::Slab));
+				}
+
+				// The cap only when it is also the floor of a hidden room, otherwise it is the roof
+				if (IsHiddenCell(FIntVector(Cell.X, Cell.Y, Cell.Z + 1)))
+				{
+					AddParts(FIntVector4(Cell.X, Cell.Y, Cell.Z + 1, RoomGridKind::Slab));
+				}
+
+				// Walls between two hidden cells. The outer shell stays visible.
+				if (IsHiddenCell(FIntVector(Cell.X + 1, Cell.Y, Cell.Z)))
+				{
+					AddParts(FIntVector4(Cell.X + 1, Cell.Y, Cell.Z, RoomGridKind::EdgeX));
+				}
+				if (IsHiddenCell(FIntVector(Cell.X, Cell.Y + 1, Cell.Z)))
+				{
+					AddParts(FIntVector4(Cell.X, Cell.Y + 1, Cell.Z, RoomGridKind::EdgeY));
+				}
+			}
+		}
+	}
+}
+
+void UBuildingRoomSubsystem::UpdateVisibility(APlayerController* Controller, FRoomViewState& State)
+{
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	Controller->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+	const FVector ViewDir = ViewRotation.Vector();
+	const float HalfFov = Controller->PlayerCameraManager ? Controller->PlayerCameraManager->GetFOVAngle() * 0.5f : 45.f;
+	const float CosHalfFov = FMath::Cos(FMath::DegreesToRadians(HalfFov + 10.f));
+	const float MaxDistSq = FMath::Square(MaxPortalDistance);
+
+	auto PortalInView = [&](const FRoomGrid& Grid, const FRoomPortal& Portal)
+	{
+		const FVector ToPortal = Portal.Center - ViewLocation;
+		const float DistSq = ToPortal.SizeSquared();
+		if (DistSq > MaxDistSq) return false;
+
+		// Standing in the opening sees both sides
+		if (DistSq < FMath::Square(Grid.CellSize)) return true;
+
+		return (ToPortal.GetUnsafeNormal() | ViewDir) >= CosHalfFov;
+	};
+
+	TSet<FIntPoint> Visible;
+	TArray<FIntPoint, TInlineAllocator<16>> Open;
+	bool bOutsideVisible = false;
+
+	// Every room with an opening to the outside in view can be seen into, on any base
+	auto VisitOutside = [&]()
+	{
+		bOutsideVisible = true;
+		for (TSparseArray<FRoomGrid>::TConstIterator GridIt(Grids); GridIt; ++GridIt)
+		{
+			for (TSparseArray<FBuildingRoom>::TConstIterator It(GridIt->Rooms); It; ++It)
+			{
+				const FIntPoint Room(GridIt.GetIndex(), It.GetIndex());
+				if (Visible.Contains(Room)) continue;
+
+				for (const FRoomPortal& Portal : It->Portals)
+				{
+					if (!GridIt->CellRooms.Contains(Portal.ToCell) && PortalInView(*GridIt, Portal))
+					{
+						Visible.Add(Room);
+						Open.Add(Room);
+						break;
+					}
+				}
+			}
+		}
+	};
+
+	const FIntPoint CameraRoom = FindRoomAt(ViewLocation);
+	if (CameraRoom.Y != INDEX_NONE)
+	{
+		Visible.Add(CameraRoom);
+		Open.Add(CameraRoom);
+	}
+	else
+	{
+		VisitOutside();
+	}
+
+	while (Open.Num() > 0)
+	{
+		const FIntPoint Room = Open.Pop(EAllowShrinking::No);
+		const FRoomGrid& Grid = Grids[Room.X];
+
+		for (const FRoomPortal& Portal : Grid.Rooms[Room.Y].Portals)
+		{
+			if (!PortalInView(Grid, Portal)) continue;
+
+			if (const int32* ToRoom = Grid.CellRooms.Find(Portal.ToCell))
+			{
+				const FIntPoint To(Room.X, *ToRoom);
+				if (!Visible.Contains(To))
+				{
+					Visible.Add(To);
+					Open.Add(To);
+				}
+			}
+			else if (!bOutsideVisible)
+			{
+				VisitOutside();
+			}
+		}
+	}
+
+	// Only touch the controller's hidden list when the visible set changed
+	TArray<FIntPoint> Sorted = Visible.Array();
+	Sorted.Sort([](const FIntPoint& A, const FIntPoint& B) { return A.X != B.X ? A.X < B.X : A.Y < B.Y; });
+	uint32 Hash = HashCombineFast(GetTypeHash(Grids.Num()), GetTypeHash(GetNumRooms())) + 1;
+	for (const FIntPoint& Room : Sorted)
+	{
+		Hash = HashCombineFast(Hash, GetTypeHash(Room));
+	}
+	if (Hash == State.VisibleHash) return;
+	State.VisibleHash = Hash;
+
+	ApplyHidden(Controller, State, false);
+
+	CollectHiddenParts(Visible, State.Hidden);
+	ApplyHidden(Controller, State, true);
+}
+
+void UBuildingRoomSubsystem::ApplyHidden(APlayerController* Controller, FRoomViewState& State, bool bHide)
+{
+	if (State.Hidden.Num() == 0) return;
+
+	if (Controller)
+	{
+		if (bHide)
+		{
+			Controller->HiddenPrimitiveComponents.Append(State.Hidden);
+		}
+		else
+		{
+			const TSet<TWeakObjectPtr<UPrimitiveComponent>> Ours(State.Hidden);
+			Controller->HiddenPrimitiveComponents.RemoveAll([&Ours](const TWeakObjectPtr<UPrimitiveComponent>& Comp) { return Ours.Contains(Comp); });
+		}
+	}
+
+	// An instance cannot be hidden for one player, so hidden parts draw their own mesh
+	if (UBuildingInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UBuildingInstanceSubsystem>())
+	{
+		for (const TWeakObjectPtr<UPrimitiveComponent>& Comp : State.Hidden)
+		{
+			if (ABuildingPart* Part = Comp.IsValid() ? Cast<ABuildingPart>(Comp->GetOwner()) : nullptr)
+			{
+				Instances->SetHiddenForView(Part, bHide);
+			}
+		}
+	}
+
+	if (!bHide)
+	{
+		State.Hidden.Reset();
+	}
+}
+
+void UBuildingRoomSubsystem::Tick(float DeltaTime)
+{
+	for (FRoomGrid& Grid : Grids)
+	{
+		if (Grid.DirtyCells.Num() > 0)
+		{
+			RebuildDirtyRooms(Grid);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_Rooms, GetNumRooms());
+
+#if !UE_SERVER
+	SCOPE_CYCLE_COUNTER(STAT_RoomVisibility);
+
+	const bool bCulling = CVarRoomCulling.GetValueOnGameThread() != 0;
+	int32 NumHidden = 0;
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* Controller = It->Get();
+		if (!Controller || !Controller->IsLocalController()) continue;
+
+		FRoomViewState* State = ViewStates.FindByPredicate([Controller](const FRoomViewState& S) { return S.Controller == Controller; });
+		if (!State)
+		{
+			State = &ViewStates.AddDefaulted_GetRef();
+			State->Controller = Controller;
+		}
+
+		if (bCulling)
+		{
+			UpdateVisibility(Controller, *State);
+		}
+		else if (State->Hidden.Num() > 0)
+		{
+			ApplyHidden(Controller, *State, false);
+			State->VisibleHash = 0;
+		}
+
+		NumHidden += State->Hidden.Num();
+	}
+
+	for (FRoomViewState& State : ViewStates)
+	{
+		if (!State.Controller.IsValid())
+		{
+			ApplyHidden(nullptr, State, false);
+		}
+	}
+	ViewStates.RemoveAllSwap([](const FRoomViewState& S) { return !S.Controller.IsValid(); });
+
+	SET_DWORD_STAT(STAT_RoomHiddenPrimitives, NumHidden);
+#endif
+}
@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "BuildingRoomSubsystem.generated.h"
+
+class ABuildingPart;
+class APlayerController;
+class UPrimitiveComponent;
+
+// Opening from a room cell to a neighbouring cell: a gap with no wall or a passable wall
+struct FRoomPortal
+{
+	FIntVector FromCell = FIntVector::ZeroValue;
+	FIntVector ToCell = FIntVector::ZeroValue;
+
+	// World-space centre of the opening
+	FVector Center = FVector::ZeroVector;
+};
+
+// Connected set of floored, capped cells bounded by walls
+struct FBuildingRoom
+{
+	TArray<FIntVector> Cells;
+	TArray<FRoomPortal> Portals;
+};
+
+// Room grid of one base, anchored at the first floor placed in it
+struct FRoomGrid
+{
+	// Grid space: cell (0, 0, 0) has its corner at the origin
+	FTransform Transform;
+	float CellSize = 0.f;
+
+	// Parts per slab or wall edge
+	TMap<FIntVector4, TArray<TWeakObjectPtr<ABuildingPart>>> Elements;
+
+	TSparseArray<FBuildingRoom> Rooms;
+	TMap<FIntVector, int32> CellRooms;
+
+	TSet<FIntVector> DirtyCells;
+
+	int32 NumParts = 0;
+};
+
+// Parts hidden for one local player, so they can be taken back out of its hidden list
+struct FRoomViewState
+{
+	TWeakObjectPtr<APlayerController> Controller;
+
+	// Hash of the visible room set the hidden list was built from
+	uint32 VisibleHash = 0;
+
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> Hidden;
+};
+
+/**
+ * Detects rooms in placed bases and hides the inside of rooms the camera cannot see.
+ *
+ * Each base has its own grid, anchored at the first floor placed in it, so bases built at
+ * different offsets or angles all get rooms. A part is filed on the grid it lines up with,
+ * preferring one that already has parts next to it; a floor that lines up with none starts
+ * a new grid. On a grid, floors, ceilings and roofs are slabs at (X, Y, Level) and walls
+ * are cell edges. A cell with a slab below and above is a room cell, and rooms are flood
+ * filled across edges without walls. Edits only re-flood the rooms they touch. Every frame
+ * each local player walks the portal graph from the camera's room (or from outside) through
+ * portals in view, and the interior parts of rooms it does not reach go into the
+ * controller's HiddenPrimitiveComponents.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UBuildingRoomSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Files a placed part on the room grid
+	void AddPart(ABuildingPart* Part);
+
+	// Takes a part off the room grid
+	void RemovePart(ABuildingPart* Part);
+
+	// Room containing a world location as (grid, room), or INDEX_NONE in both
+	FIntPoint FindRoomAt(const FVector& Location) const;
+
+	int32 GetNumRooms() const;
+
+	int32 GetNumGrids() const { return Grids.Num(); }
+
+	// Grid cell size. 0 uses the footprint of the floor each grid is anchored at.
+	UPROPERTY(Config)
+		float CellSize = 0.0f;
+
+	// Height of one storey, floor to floor
+	UPROPERTY(Config)
+		float LevelHeight = 300.0f;
+
+	// Portals further than this from the camera are not looked through
+	UPROPERTY(Config)
+		float MaxPortalDistance = 6000.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	// Key for a part on a grid: (X, Y, Level, Kind) where Kind is EdgeX, EdgeY or Slab.
+	// Kind is INDEX_NONE if the part does not line up with the grid.
+	FIntVector4 KeyForPart(const FRoomGrid& Grid, const ABuildingPart* Part) const;
+
+	// Picks the grid a part files on and its key there, or returns INDEX_NONE
+	int32 FindGridForPart(const ABuildingPart* Part, FIntVector4& OutKey) const;
+
+	FIntVector CellAt(const FRoomGrid& Grid, const FVector& Location) const;
+
+	FVector EdgeCenter(const FRoomGrid& Grid, const FIntVector4& Edge) const;
+
+	static bool HasElement(const FRoomGrid& Grid, const FIntVector4& Key);
+
+	// Whether any part is filed in the cells around a key
+	static bool HasNeighbours(const FRoomGrid& Grid, const FIntVector4& Key);
+
+	// Marks the cells a grid element bounds for re-flooding
+	static void MarkDirty(FRoomGrid& Grid, const FIntVector4& Key);
+
+	static bool IsRoomCell(const FRoomGrid& Grid, const FIntVector& Cell);
+
+	// Re-floods every room touching the dirty cells
+	void RebuildDirtyRooms(FRoomGrid& Grid);
+
+	static void ReleaseRoom(FRoomGrid& Grid, int32 RoomId, TArray<FIntVector>& OutSeeds);
+
+	void FloodRoom(FRoomGrid& Grid, const FIntVector& Seed, TArray<FIntVector>& Seeds);
+
+	void UpdateVisibility(APlayerController* Controller, FRoomViewState& State);
+
+	// Collects the parts inside the rooms not in VisibleRooms, which holds (grid, room) pairs
+	void CollectHiddenParts(const TSet<FIntPoint>& VisibleRooms, TArray<TWeakObjectPtr<UPrimitiveComponent>>& OutHidden) const;
+
+	// Adds or takes a player's hidden parts in its controller's hidden list, and keeps
+	// them out of instanced drawing while they are hidden
+	void ApplyHidden(APlayerController* Controller, FRoomViewState& State, bool bHide);
+
+	TSparseArray<FRoomGrid> Grids;
+
+	// Grid and key each part was filed under
+	TMap<TObjectKey<ABuildingPart>, TPair<int32, FIntVector4>> PartKeys;
+
+	TArray<FRoomViewState> ViewStates;
+};
@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BuildingSnapRules.h"
+#include "GAM312_Paffenroth.h"
+
+static ESnapPoint OppositeSocket(ESnapPoint Point)
+{
+	switch (Point)
+	{
+	case ESnapPoint::North:  return ESnapPoint::South;
+	case ESnapPoint::South:  return ESnapPoint::North;
+	case ESnapPoint::East:   return ESnapPoint::West;
+	case ESnapPoint::West:   return ESnapPoint::East;
+	case ESnapPoint::Top:    return ESnapPoint::Bottom;
+	default:                 return ESnapPoint::Top;
+	}
+}
+
+UBuildingSnapRules::UBuildingSnapRules()
+{
+	const TArray<ESnapPoint> Edges = { ESnapPoint::North, ESnapPoint::South, ESnapPoint::East, ESnapPoint::West };
+
+	GroundTypes = { EBuildingPartType::Floor };
+
+	// Floors extend other floors edge to edge
+	FBuildingSnapRule& FloorToFloor = Rules.AddDefaulted_GetRef();
+	FloorToFloor.PartType = EBuildingPartType::Floor;
+	FloorToFloor.TargetType = EBuildingPartType::Floor;
+	FloorToFloor.TargetSockets = Edges;
+	FloorToFloor.bUseOppositeSocket = true;
+
+	// Walls stand on floor edges, sunk slightly into the floor
+	FBuildingSnapRule& WallToFloor = Rules.AddDefaulted_GetRef();
+	WallToFloor.PartType = EBuildingPartType::Wall;
+	WallToFloor.TargetType = EBuildingPartType::Floor;
+	WallToFloor.TargetSockets = Edges;
+	WallToFloor.PartSocket = ESnapPoint::Bottom;
+	WallToFloor.Rotation = ESnapRotation::Socket;
+	WallToFloor.YawOffset = 90.f;
+	WallToFloor.Offset = FVector(0.f, 0.f, -15.f);
+
+	// Ceilings cover a floor at the height of its walls
+	FBuildingSnapRule& CeilingOverFloor = Rules.AddDefaulted_GetRef();
+	CeilingOverFloor.PartType = EBuildingPartType::Ceiling;
+	CeilingOverFloor.TargetType = EBuildingPartType::Floor;
+	CeilingOverFloor.TargetSockets = { ESnapPoint::Top };
+	CeilingOverFloor.PartSocket = ESnapPoint::Bottom;
+	CeilingOverFloor.RequiredSupports = { EBuildingPartType::Wall };
+	CeilingOverFloor.bRestOnSupport = true;
+
+	// Roofs sit on ceilings and extend other roofs
+	FBuildingSnapRule& RoofOnCeiling = Rules.AddDefaulted_GetRef();
+	RoofOnCeiling.PartType = EBuildingPartType::Roof;
+	RoofOnCeiling.TargetType = EBuildingPartType::Ceiling;
+	RoofOnCeiling.TargetSockets = { ESnapPoint::Top };
+	RoofOnCeiling.bUseOppositeSocket = true;
+
+	FBuildingSnapRule& RoofToRoof = Rules.AddDefaulted_GetRef();
+	RoofToRoof.PartType = EBuildingPartType::Roof;
+	RoofToRoof.TargetType = EBuildingPartType::Roof;
+	RoofToRoof.TargetSockets = Edges;
+	RoofToRoof.bUseOppositeSocket = true;
+}
+
+void UBuildingSnapRules::PostLoad()
+{
+	Super::PostLoad();
+
+	Compile();
+}
+
+#if WITH_EDITOR
+void UBuildingSnapRules::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	Compile();
+}
+#endif
+
+const FCompiledSnapTable& UBuildingSnapRules::GetTable() const
+{
+	if (!bCompiled)
+	{
+		Compile();
+	}
+	return Table;
+}
+
+void UBuildingSnapRules::Compile() const
+{
+	// Sized from the enum, so new part types need no code here
+	const int32 NumTypes = FMath::Min(StaticEnum<EBuildingPartType>()->NumEnums() - 1, 32);
+
+	Table = FCompiledSnapTable();
+	Table.TypeStart.SetNumZeroed(NumTypes + 1);
+
+	for (EBuildingPartType Type : GroundTypes)
+	{
+		Table.GroundMask |= 1u << (uint8)Type;
+	}
+
+	// Counting sort by placed type keeps each type's candidates contiguous
+	TArray<int32> Counts;
+	Counts.SetNumZeroed(NumTypes);
+	for (const FBuildingSnapRule& Rule : Rules)
+	{
+		if ((int32)Rule.PartType < NumTypes && (int32)Rule.TargetType < NumTypes)
+		{
+			Counts[(int32)Rule.PartType] += Rule.TargetSockets.Num();
+		}
+	}
+
+	for (int32 Type = 0; Type < NumTypes; ++Type)
+	{
+		Table.TypeStart[Type + 1] = Table.TypeStart[Type] + Counts[Type];
+	}
+
+	Table.Candidates.SetNum(Table.TypeStart[NumTypes]);
+	TArray<int32> Next(Table.TypeStart.GetData(), NumTypes);
+
+	for (const FBuildingSnapRule& Rule : Rules)
+	{
+		if ((int32)Rule.PartType >= NumTypes || (int32)Rule.TargetType >= NumTypes)
+		{
+			UE_LOG(LogGAM312, Warning, TEXT("%s: snap rule uses a part type outside the table"), *GetName());
+			continue;
+		}
+
+		uint32 SupportMask = 0;
+		for (EBuildingPartType Support : Rule.RequiredSupports)
+		{
+			SupportMask |= 1u << (uint8)Support;
+		}
+
+		for (ESnapPoint Socket : Rule.TargetSockets)
+		{
+			FCompiledSnapCandidate& Candidate = Table.Candidates[Next[(int32)Rule.PartType]++];
+			Candidate.TargetType = (uint8)Rule.TargetType;
+			Candidate.TargetSocket = Socket;
+			Candidate.PartSocket = Rule.bUseOppositeSocket ? OppositeSocket(Socket) : Rule.PartSocket;
+			Candidate.Rotation = Rule.Rotation;
+			Candidate.YawOffset = Rule.YawOffset;
+			Candidate.Offset = Rule.Offset;
+			Candidate.SupportMask = SupportMask;
+			Candidate.RestOnType = (Rule.bRestOnSupport && Rule.RequiredSupports.Num() > 0) ? (int8)Rule.RequiredSupports[0] : (int8)INDEX_NONE;
+		}
+	}
+
+	bCompiled = true;
+}
@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "BuildingPart.h"
+#include "BuildingSnapRules.generated.h"
+
+// Where a snapped part takes its yaw from
+UENUM(BlueprintType)
+enum class ESnapRotation : uint8
+{
+	// The part's own yaw, as rotated by the player
+	Keep,
+
+	// The target part's yaw plus YawOffset
+	Target,
+
+	// The target socket's yaw plus YawOffset
+	Socket
+};
+
+// One way a part type may attach to another
+USTRUCT(BlueprintType)
+struct FBuildingSnapRule
+{
+	GENERATED_BODY()
+
+	// Type being placed
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		EBuildingPartType PartType = EBuildingPartType::Floor;
+
+	// Type it attaches to
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		EBuildingPartType TargetType = EBuildingPartType::Floor;
+
+	// Sockets on the target it may attach at
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		TArray<ESnapPoint> TargetSockets;
+
+	// Socket on the placed part that meets the target socket
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping", meta = (EditCondition = "!bUseOppositeSocket"))
+		ESnapPoint PartSocket = ESnapPoint::Bottom;
+
+	// Meet each target socket with the opposite socket on the placed part (North to South, Top to Bottom)
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		bool bUseOppositeSocket = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		ESnapRotation Rotation = ESnapRotation::Target;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		float YawOffset = 0.0f;
+
+	// Extra offset in the placed part's space
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		FVector Offset = FVector::ZeroVector;
+
+	// Types that must be within snap range of the final position
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		TArray<EBuildingPartType> RequiredSupports;
+
+	// Rest the part's socket on the top socket of the nearest support of the first required type
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		bool bRestOnSupport = false;
+};
+
+// A rule expanded for one target socket
+struct FCompiledSnapCandidate
+{
+	uint8 TargetType = 0;
+	ESnapPoint TargetSocket = ESnapPoint::North;
+	ESnapPoint PartSocket = ESnapPoint::South;
+	ESnapRotation Rotation = ESnapRotation::Target;
+	float YawOffset = 0.f;
+	FVector Offset = FVector::ZeroVector;
+
+	// Bit per required support type
+	uint32 SupportMask = 0;
+
+	// Support type to rest on, or INDEX_NONE
+	int8 RestOnType = INDEX_NONE;
+};
+
+// Snap rules flattened into per-type ranges and bitmasks
+struct FCompiledSnapTable
+{
+	// Candidates grouped by placed type
+	TArray<FCompiledSnapCandidate> Candidates;
+
+	// First candidate of each type, plus one trailing entry
+	TArray<int32> TypeStart;
+
+	// Bit per type that may be placed without a target
+	uint32 GroundMask = 0;
+
+	int32 NumTypes() const { return TypeStart.Num() - 1; }
+
+	bool IsGroundType(int32 Type) const { return (GroundMask & (1u << Type)) != 0; }
+
+	TArrayView<const FCompiledSnapCandidate> GetCandidates(int32 Type) const
+	{
+		return TypeStart.IsValidIndex(Type + 1)
+			? TArrayView<const FCompiledSnapCandidate>(Candidates.GetData() + TypeStart[Type], TypeStart[Type + 1] - TypeStart[Type])
+			: TArrayView<const FCompiledSnapCandidate>();
+	}
+};
+
+/**
+ * Declares how building part types connect. Compiled once into flat per-type tables,
+ * so the placement solver handles new part types without code changes.
+ * A new asset starts with the rules for floors, walls, ceilings and roofs.
+ */
+UCLASS(BlueprintType)
+class GAM312_PAFFENROTH_API UBuildingSnapRules : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UBuildingSnapRules();
+
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	// Compiled tables, built on first use if the asset has not been loaded
+	const FCompiledSnapTable& GetTable() const;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		TArray<FBuildingSnapRule> Rules;
+
+	// Types that may be placed on the ground with nothing to snap to
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Snapping")
+		TArray<EBuildingPartType> GroundTypes;
+
+private:
+	void Compile() const;
+
+	mutable FCompiledSnapTable Table;
+	mutable bool bCompiled = false;
+};
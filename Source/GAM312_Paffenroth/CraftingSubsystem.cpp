@@ -0,0 +1,297 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CraftingSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "PlayerChar.h"
+#include "TelemetrySubsystem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Crafting Tick"), STAT_CraftingTick, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Crafting Queues"), STAT_CraftingQueues, STATGROUP_GAM312);
+
+FArchive& operator<<(FArchive& Ar, FCraftOrder& Order)
+{
+	Ar << Order.RecipeIndex;
+	Ar << Order.Remaining;
+	Ar << Order.WoodEach;
+	Ar << Order.StoneEach;
+	Ar << Order.Progress;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FCraftQueue& Queue)
+{
+	Ar << Queue.Orders;
+	return Ar;
+}
+
+void UCraftingSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	ValidateRecipes();
+}
+
+void UCraftingSubsystem::ValidateRecipes()
+{
+	const int32 NumRemoved = Recipes.RemoveAll([](const FCraftingRecipe& Recipe)
+	{
+		const bool bValid = Recipe.BuildingIndex >= 0 && Recipe.WoodCost >= 0 && Recipe.StoneCost >= 0 && Recipe.Duration >= 0.f;
+		if (!bValid)
+		{
+			UE_LOG(LogGAM312, Error, TEXT("Crafting recipe %s has a negative slot, cost or duration and was dropped"), *Recipe.Name.ToString());
+		}
+		return !bValid;
+	});
+
+	if (Recipes.Num() > MaxRecipes)
+	{
+		UE_LOG(LogGAM312, Error, TEXT("%d crafting recipes configured, only the first %d are used"), Recipes.Num(), MaxRecipes);
+		Recipes.SetNum(MaxRecipes);
+	}
+}
+
+void UCraftingSubsystem::Deinitialize()
+{
+	Queues.Empty();
+	QueueLookup.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UCraftingSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UCraftingSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCraftingSubsystem, STATGROUP_Tickables);
+}
+
+int32 UCraftingSubsystem::FindRecipe(FName Name) const
+{
+	return Recipes.IndexOfByPredicate([Name](const FCraftingRecipe& Recipe) { return Recipe.Name == Name; });
+}
+
+FCraftQueue& UCraftingSubsystem::FindOrAddQueue(APlayerChar* Player)
+{
+	if (const int32* Index = QueueLookup.Find(Player))
+	{
+		return Queues[*Index];
+	}
+
+	const int32 Index = Queues.AddDefaulted();
+	Queues[Index].Owner = Player;
+	QueueLookup.Add(Player, Index);
+	return Queues[Index];
+}
+
+void UCraftingSubsystem::NotifyQueueChanged(APlayerChar* Player)
+{
+	FCraftQueueSummary Summary;
+	if (const FCraftQueue* Queue = GetQueue(Player))
+	{
+		for (const FCraftOrder& Order : Queue->Orders)
+		{
+			FCraftOrderSummary& Entry = Summary.Orders.AddDefaulted_GetRef();
+			Entry.RecipeIndex = Order.RecipeIndex;
+			Entry.Remaining = Order.Remaining;
+		}
+
+		// Only the first order makes progress
+		if (Queue->Orders.Num() > 0)
+		{
+			Summary.CurrentStartedAt = GetWorld()->GetTimeSeconds() - Queue->Orders[0].Progress;
+		}
+	}
+
+	Player->SetCraftQueue(Summary);
+	OnQueueChanged.Broadcast(Player);
+}
+
+const FCraftQueue* UCraftingSubsystem::GetQueue(const APlayerChar* Player) const
+{
+	const int32* Index = QueueLookup.Find(Player);
+	return Index ? &Queues[*Index] : nullptr;
+}
+
+bool UCraftingSubsystem::QueueCraft(APlayerChar* Player, int32 RecipeIndex, int32 Count, int32 WoodEach, int32 StoneEach)
+{
+	if (!Player || !Recipes.IsValidIndex(RecipeIndex) || Count <= 0 || Player->ResourcesArray.Num() < 2) return false;
+
+	// A negative cost would pay the player for queueing
+	if (WoodEach < 0 || StoneEach < 0) return false;
+
+	Count = FMath::Min(Count, (int32)TNumericLimits<uint16>::Max());
+
+	const int64 WoodTotal = (int64)WoodEach * Count;
+	const int64 StoneTotal = (int64)StoneEach * Count;
+
+	// All or nothing: check every cost before taking anything
+	if (WoodTotal > Player->ResourcesArray[0] || StoneTotal > Player->ResourcesArray[1]) return false;
+
+	Player->ResourcesArray[0] -= (int32)WoodTotal;
+	Player->ResourcesArray[1] -= (int32)StoneTotal;
+
+	FCraftOrder& Order = FindOrAddQueue(Player).Orders.AddDefaulted_GetRef();
+	Order.RecipeIndex = (uint8)RecipeIndex;
+	Order.Remaining = (uint16)Count;
+	Order.WoodEach = WoodEach;
+	Order.StoneEach = StoneEach;
+
+	FGameplayTelemetry::Record(ETelemetryEvent::CraftQueued, FGameplayTelemetry::PlayerId(Player), Count, (uint8)RecipeIndex);
+
+	NotifyQueueChanged(Player);
+	return true;
+}
+
+bool UCraftingSubsystem::QueueRecipe(APlayerChar* Player, int32 RecipeIndex, int32 Count)
+{
+	if (!Recipes.IsValidIndex(RecipeIndex)) return false;
+
+	return QueueCraft(Player, RecipeIndex, Count, Recipes[RecipeIndex].WoodCost, Recipes[RecipeIndex].StoneCost);
+}
+
+void UCraftingSubsystem::CancelOrder(APlayerChar* Player, int32 OrderIndex)
+{
+	const int32* QueueIndex = QueueLookup.Find(Player);
+	if (!QueueIndex || !Player) return;
+
+	FCraftQueue& Queue = Queues[*QueueIndex];
+	if (!Queue.Orders.IsValidIndex(OrderIndex)) return;
+
+	const FCraftOrder& Order = Queue.Orders[OrderIndex];
+	Player->ResourcesArray[0] += Order.WoodEach * Order.Remaining;
+	Player->ResourcesArray[1] += Order.StoneEach * Order.Remaining;
+
+	Queue.Orders.RemoveAt(OrderIndex);
+	NotifyQueueChanged(Player);
+}
+
+void UCraftingSubsystem::SerializeQueue(APlayerChar* Player, FArchive& Ar)
+{
+	if (!Player) return;
+
+	FCraftQueue& Queue = FindOrAddQueue(Player);
+	Ar << Queue;
+
+	if (Ar.IsLoading())
+	{
+		// Drop orders for recipes that no longer exist
+		Queue.Orders.RemoveAll([this](const FCraftOrder& Order) { return !Recipes.IsValidIndex(Order.RecipeIndex); });
+		NotifyQueueChanged(Player);
+	}
+}
+
+void UCraftingSubsystem::AddSyntheticQueues(int32 Count, int32 ItemsPerQueue)
+{
+	for (int32 i = 0; i < Count && Recipes.Num() > 0; ++i)
+	{
+		FCraftOrder& Order = Queues.AddDefaulted_GetRef().Orders.AddDefaulted_GetRef();
+		Order.RecipeIndex = (uint8)(i % Recipes.Num());
+		Order.Remaining = (uint16)FMath::Clamp(ItemsPerQueue, 1, (int32)TNumericLimits<uint16>::Max());
+	}
+}
+
+void UCraftingSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_CraftingTick);
+	SET_DWORD_STAT(STAT_CraftingQueues, Queues.Num());
+
+	bool bHasStaleQueues = false;
+
+	// Completed items per building slot this tick, granted once at the end
+	TArray<int32, TInlineAllocator<8>> Completed;
+
+	for (FCraftQueue& Queue : Queues)
+	{
+		// Players that left are swept below, emptied queues included
+		APlayerChar* Player = Queue.Owner.Get();
+		if (!Player && !Queue.Owner.IsExplicitlyNull())
+		{
+			bHasStaleQueues = true;
+			continue;
+		}
+
+		if (Queue.Orders.Num() == 0) continue;
+
+		Completed.Reset();
+		Completed.SetNumZeroed(Player ? Player->BuildingArray.Num() : 0);
+
+		bool bChanged = false;
+		float Budget = DeltaTime;
+
+		while (Budget > 0.f && Queue.Orders.Num() > 0)
+		{
+			FCraftOrder& Order = Queue.Orders[0];
+			const FCraftingRecipe& Recipe = Recipes[Order.RecipeIndex];
+			const float Needed = FMath::Max(Recipe.Duration - Order.Progress, 0.f);
+
+			if (Budget < Needed)
+			{
+				Order.Progress += Budget;
+				break;
+			}
+
+			Budget -= Needed;
+			Order.Progress = 0.f;
+			--Order.Remaining;
+			bChanged = true;
+
+			if (Completed.IsValidIndex(Recipe.BuildingIndex))
+			{
+				++Completed[Recipe.BuildingIndex];
+			}
+
+			if (Order.Remaining == 0)
+			{
+				Queue.Orders.RemoveAt(0, 1, EAllowShrinking::No);
+			}
+		}
+
+		// Synthetic queues have no one to grant to
+		if (!bChanged || !Player) continue;
+
+		for (int32 Slot = 0; Slot < Completed.Num(); ++Slot)
+		{
+			if (Completed[Slot] > 0)
+			{
+				Player->BuildingArray[Slot] += Completed[Slot];
+				FGameplayTelemetry::Record(ETelemetryEvent::CraftCompleted, FGameplayTelemetry::PlayerId(Player), Completed[Slot], (uint8)Slot);
+			}
+		}
+		NotifyQueueChanged(Player);
+	}
+
+	// Players that left take their queues with them
+	if (bHasStaleQueues)
+	{
+		Queues.RemoveAll([](const FCraftQueue& Queue) { return !Queue.Owner.IsExplicitlyNull() && !Queue.Owner.IsValid(); });
+
+		QueueLookup.Reset();
+		for (int32 Index = 0; Index < Queues.Num(); ++Index)
+		{
+			if (APlayerChar* Player = Queues[Index].Owner.Get())
+			{
+				QueueLookup.Add(Player, Index);
+			}
+		}
+	}
+}
+
+// Benchmark helper: "Crafting.Bench <Queues> <Items>" adds owner-less queues so the
+// batched tick can be checked with "stat GAM312".
+GAM312_BENCH_COMMAND(GCraftingBenchCmd, "Crafting.Bench",
+	"Adds synthetic crafting queues. Usage: Crafting.Bench <Queues> <ItemsPerQueue>")
+{
+	UCraftingSubsystem* Crafting = World ? World->GetSubsystem<UCraftingSubsystem>() : nullptr;
+	if (!Crafting) return;
+
+	const int32 Count = GAM312Bench::Count(Args, 0, 1000);
+	const int32 Items = GAM312Bench::Count(Args, 1, 50);
+	Crafting->AddSyntheticQueues(Count, Items);
+
+	UE_LOG(LogGAM312, Log, TEXT("Crafting.Bench: %d queues"), Crafting->GetNumQueues());
+}
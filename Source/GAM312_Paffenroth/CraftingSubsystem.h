@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "CraftingSubsystem.generated.h"
+
+class APlayerChar;
+
+// A craftable building part
+USTRUCT(BlueprintType)
+struct FCraftingRecipe
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crafting")
+		FName Name;
+
+	// Slot in APlayerChar::BuildingArray the crafted part goes to
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crafting")
+		int32 BuildingIndex = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crafting")
+		int32 WoodCost = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crafting")
+		int32 StoneCost = 0;
+
+	// Seconds to craft one item
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Crafting")
+		float Duration = 2.0f;
+};
+
+// A bulk order for one recipe. Resources for every item were taken when it was queued.
+struct FCraftOrder
+{
+	uint8 RecipeIndex = 0;
+	uint16 Remaining = 0;
+
+	// Per-item cost that was paid, refunded if the order is cancelled
+	int32 WoodEach = 0;
+	int32 StoneEach = 0;
+
+	// Seconds spent on the current item
+	float Progress = 0.f;
+
+	friend FArchive& operator<<(FArchive& Ar, FCraftOrder& Order);
+};
+
+// What the owning client sees of one order
+USTRUCT()
+struct FCraftOrderSummary
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		uint8 RecipeIndex = 0;
+
+	UPROPERTY()
+		uint16 Remaining = 0;
+};
+
+// A player's queue as replicated to its owner. Progress is sent as the server time the current
+// item started, so it only changes when an item completes or the queue is edited.
+USTRUCT()
+struct FCraftQueueSummary
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		TArray<FCraftOrderSummary> Orders;
+
+	UPROPERTY()
+		float CurrentStartedAt = 0.f;
+};
+
+struct FCraftQueue
+{
+	TWeakObjectPtr<APlayerChar> Owner;
+
+	TArray<FCraftOrder, TInlineAllocator<4>> Orders;
+
+	friend FArchive& operator<<(FArchive& Ar, FCraftQueue& Queue);
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnCraftQueueChanged, APlayerChar* /*Player*/);
+
+/**
+ * Timed crafting for every player. All queues advance together in one pass per tick,
+ * with no timer per item, and finished items are handed out once per queue per tick.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UCraftingSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Orders store their recipe index in a byte
+	static constexpr int32 MaxRecipes = MAX_uint8 + 1;
+
+	// Returns the recipe index for a name, or INDEX_NONE
+	int32 FindRecipe(FName Name) const;
+
+	// Pays for Count items up front and queues them. Fails without side effects if the player cannot
+	// afford all of them, or a cost is negative.
+	bool QueueCraft(APlayerChar* Player, int32 RecipeIndex, int32 Count, int32 WoodEach, int32 StoneEach);
+
+	// Queues Count items at the recipe's own cost
+	bool QueueRecipe(APlayerChar* Player, int32 RecipeIndex, int32 Count);
+
+	// Cancels an order and refunds the items not yet crafted
+	void CancelOrder(APlayerChar* Player, int32 OrderIndex);
+
+	// Read-only view of a player's queue, or null if they have none
+	const FCraftQueue* GetQueue(const APlayerChar* Player) const;
+
+	// Writes or reads a player's queue
+	void SerializeQueue(APlayerChar* Player, FArchive& Ar);
+
+	// Adds queues with no owner, used to stress the tick
+	void AddSyntheticQueues(int32 Count, int32 ItemsPerQueue);
+
+	int32 GetNumQueues() const { return Queues.Num(); }
+
+	const TArray<FCraftingRecipe>& GetRecipes() const { return Recipes; }
+
+	// Fired on the server after a player's queue changed. Clients watch APlayerChar::OnCraftQueueUpdated.
+	FOnCraftQueueChanged OnQueueChanged;
+
+	UPROPERTY(Config)
+		TArray<FCraftingRecipe> Recipes;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	FCraftQueue& FindOrAddQueue(APlayerChar* Player);
+
+	// Copies a player's queue to their replicated summary and broadcasts the change
+	void NotifyQueueChanged(APlayerChar* Player);
+
+	// Drops recipes with negative costs or slots, and any past MaxRecipes
+	void ValidateRecipes();
+
+	TArray<FCraftQueue> Queues;
+
+	// Queue index per player
+	TMap<TObjectKey<APlayerChar>, int32> QueueLookup;
+};
@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CraftingWidget.h"
+#include "CraftingSubsystem.h"
+#include "PlayerChar.h"
+#include "GAM312_Paffenroth.h"
+#include "GameFramework/GameStateBase.h"
+
+#if WITH_EDITOR
+#include "Kismet2/BlueprintEditorUtils.h"
+#include "Kismet2/KismetEditorUtilities.h"
+#endif
+
+void UCraftingWidget::NativeConstruct()
+{
+	Super::NativeConstruct();
+
+	if (APlayerChar* Player = GetPlayer())
+	{
+		BoundPlayer = Player;
+		QueueChangedHandle = Player->OnCraftQueueUpdated.AddUObject(this, &UCraftingWidget::OnQueueUpdated);
+	}
+}
+
+void UCraftingWidget::NativeDestruct()
+{
+	if (APlayerChar* Player = BoundPlayer.Get())
+	{
+		Player->OnCraftQueueUpdated.Remove(QueueChangedHandle);
+	}
+	BoundPlayer = nullptr;
+
+	Super::NativeDestruct();
+}
+
+APlayerChar* UCraftingWidget::GetPlayer() const
+{
+	return Cast<APlayerChar>(GetOwningPlayerPawn());
+}
+
+UCraftingSubsystem* UCraftingWidget::GetCrafting() const
+{
+	UWorld* World = GetWorld();
+	return World ? World->GetSubsystem<UCraftingSubsystem>() : nullptr;
+}
+
+bool UCraftingWidget::QueueCraft(FName Recipe, int32 Count)
+{
+	APlayerChar* Player = GetPlayer();
+	UCraftingSubsystem* Crafting = GetCrafting();
+	if (!Player || !Crafting || Count <= 0) return false;
+
+	// The server owns the inventory, so a client only asks
+	if (!Player->HasAuthority())
+	{
+		Player->ServerQueueRecipe(Recipe, Count);
+		return Crafting->FindRecipe(Recipe) != INDEX_NONE;
+	}
+
+	return Crafting->QueueRecipe(Player, Crafting->FindRecipe(Recipe), Count);
+}
+
+void UCraftingWidget::CancelOrder(int32 Index)
+{
+	APlayerChar* Player = GetPlayer();
+	if (Player && !Player->HasAuthority())
+	{
+		Player->ServerCancelCraftOrder(Index);
+	}
+	else if (UCraftingSubsystem* Crafting = GetCrafting())
+	{
+		Crafting->CancelOrder(Player, Index);
+	}
+}
+
+int32 UCraftingWidget::GetQueuedCount(FName Recipe) const
+{
+	const UCraftingSubsystem* Crafting = GetCrafting();
+	const APlayerChar* Player = GetPlayer();
+	if (!Crafting || !Player) return 0;
+
+	const int32 RecipeIndex = Crafting->FindRecipe(Recipe);
+
+	int32 Count = 0;
+	for (const FCraftOrderSummary& Order : Player->CraftQueue.Orders)
+	{
+		if (Order.RecipeIndex == RecipeIndex)
+		{
+			Count += Order.Remaining;
+		}
+	}
+	return Count;
+}
+
+float UCraftingWidget::GetCurrentProgress() const
+{
+	const UCraftingSubsystem* Crafting = GetCrafting();
+	const APlayerChar* Player = GetPlayer();
+	if (!Crafting || !Player || Player->CraftQueue.Orders.Num() == 0) return 0.f;
+
+	const FCraftOrderSummary& Order = Player->CraftQueue.Orders[0];
+	if (!Crafting->GetRecipes().IsValidIndex(Order.RecipeIndex)) return 0.f;
+
+	// Recipes are config, so clients have the same durations as the server
+	const float Duration = Crafting->GetRecipes()[Order.RecipeIndex].Duration;
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	const double Now = GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+	return Duration > 0.f ? FMath::Clamp((float)(Now - Player->CraftQueue.CurrentStartedAt) / Duration, 0.f, 1.f) : 1.f;
+}
+
+#if WITH_EDITOR
+// Editor helper: "Crafting.ReparentWidget [BlueprintPath]" reparents the crafting widget Blueprint
+// (Crafting_W by default) to UCraftingWidget and recompiles it. Save the asset afterwards.
+static FAutoConsoleCommand GCraftingReparentWidgetCmd(
+	TEXT("Crafting.ReparentWidget"),
+	TEXT("Reparents a widget Blueprint to UCraftingWidget. Usage: Crafting.ReparentWidget [BlueprintPath]"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		const FString Path = Args.Num() > 0 ? Args[0] : TEXT("/Game/Widgets/Crafting_W.Crafting_W");
+		UBlueprint* Blueprint = LoadObject<UBlueprint>(nullptr, *Path);
+		if (!Blueprint)
+		{
+			UE_LOG(LogGAM312, Warning, TEXT("No widget Blueprint at %s"), *Path);
+			return;
+		}
+
+		if (Blueprint->ParentClass && Blueprint->ParentClass->IsChildOf(UCraftingWidget::StaticClass()))
+		{
+			UE_LOG(LogGAM312, Log, TEXT("%s already derives from UCraftingWidget"), *Blueprint->GetName());
+			return;
+		}
+
+		Blueprint->Modify();
+		Blueprint->ParentClass = UCraftingWidget::StaticClass();
+		FBlueprintEditorUtils::RefreshAllNodes(Blueprint);
+		FBlueprintEditorUtils::MarkBlueprintAsStructurallyModified(Blueprint);
+		FKismetEditorUtilities::CompileBlueprint(Blueprint);
+
+		UE_LOG(LogGAM312, Log, TEXT("Reparented %s to UCraftingWidget, save it to keep the change"), *Blueprint->GetName());
+	}));
+#endif
@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Blueprint/UserWidget.h"
+#include "CraftingWidget.generated.h"
+
+class APlayerChar;
+class UCraftingSubsystem;
+
+/**
+ * Native base for Crafting_W. Queues bulk orders and reports queue progress from the owning
+ * player's replicated queue summary, so it works the same on a client as on the server.
+ */
+UCLASS()
+class GAM312_PAFFENROTH_API UCraftingWidget : public UUserWidget
+{
+	GENERATED_BODY()
+
+public:
+
+	// Pays for and queues Count of a recipe. Returns false if the player cannot afford all of them.
+	UFUNCTION(BlueprintCallable, Category = "Crafting")
+		bool QueueCraft(FName Recipe, int32 Count = 1);
+
+	// Cancels the order at Index and refunds what has not been crafted
+	UFUNCTION(BlueprintCallable, Category = "Crafting")
+		void CancelOrder(int32 Index);
+
+	// Items of a recipe still waiting in the queue
+	UFUNCTION(BlueprintPure, Category = "Crafting")
+		int32 GetQueuedCount(FName Recipe) const;
+
+	// 0-1 progress of the item currently being crafted
+	UFUNCTION(BlueprintPure, Category = "Crafting")
+		float GetCurrentProgress() const;
+
+	// Called whenever the owning player's queue changes
+	UFUNCTION(BlueprintImplementableEvent)
+		void OnQueueUpdated();
+
+protected:
+	virtual void NativeConstruct() override;
+	virtual void NativeDestruct() override;
+
+private:
+	APlayerChar* GetPlayer() const;
+
+	UCraftingSubsystem* GetCrafting() const;
+
+	// Player the queue handle is bound on
+	TWeakObjectPtr<APlayerChar> BoundPlayer;
+
+	FDelegateHandle QueueChangedHandle;
+};
@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FrameBudgetSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "CoreGlobals.h"
+#include "Misc/App.h"
+
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Frame Budget Game Thread ms"), STAT_FrameBudgetGameThreadMs, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Frame Budget Level"), STAT_FrameBudgetLevel, STATGROUP_GAM312);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Frame Budget Preview Solve Scale"), STAT_FrameBudgetPreviewSolve, STATGROUP_GAM312);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Frame Budget Snap Radius Scale"), STAT_FrameBudgetSnapRadius, STATGROUP_GAM312);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Frame Budget Decay Slice Scale"), STAT_FrameBudgetDecaySlice, STATGROUP_GAM312);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Frame Budget Label Scale"), STAT_FrameBudgetLabels, STATGROUP_GAM312);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Frame Budget Wildlife Scale"), STAT_FrameBudgetWildlife, STATGROUP_GAM312);
+
+bool UFrameBudgetSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UFrameBudgetSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFrameBudgetSubsystem, STATGROUP_Tickables);
+}
+
+float UFrameBudgetSubsystem::GetScale(EFrameBudgetKnob Knob) const
+{
+	return Scales[(uint8)Knob];
+}
+
+float UFrameBudgetSubsystem::GetScale(const UWorld* World, EFrameBudgetKnob Knob)
+{
+	const UFrameBudgetSubsystem* Governor = World ? World->GetSubsystem<UFrameBudgetSubsystem>() : nullptr;
+	return Governor ? Governor->GetScale(Knob) : 1.f;
+}
+
+void UFrameBudgetSubsystem::Tick(float DeltaTime)
+{
+	// The game thread's own work last frame. Waiting on the render thread or a frame rate
+	// cap is not counted, since cutting gameplay work would not shorten either.
+	AddFrame((float)FPlatformTime::ToMilliseconds(GGameThreadTime), (float)FApp::GetDeltaTime());
+
+	SET_FLOAT_STAT(STAT_FrameBudgetGameThreadMs, SmoothedMs);
+	SET_DWORD_STAT(STAT_FrameBudgetLevel, Level);
+	SET_FLOAT_STAT(STAT_FrameBudgetPreviewSolve, Scales[(uint8)EFrameBudgetKnob::PreviewSolve]);
+	SET_FLOAT_STAT(STAT_FrameBudgetSnapRadius, Scales[(uint8)EFrameBudgetKnob::SnapRadius]);
+	SET_FLOAT_STAT(STAT_FrameBudgetDecaySlice, Scales[(uint8)EFrameBudgetKnob::DecaySlice]);
+	SET_FLOAT_STAT(STAT_FrameBudgetLabels, Scales[(uint8)EFrameBudgetKnob::Labels]);
+	SET_FLOAT_STAT(STAT_FrameBudgetWildlife, Scales[(uint8)EFrameBudgetKnob::Wildlife]);
+}
+
+void UFrameBudgetSubsystem::AddFrame(float FrameMs, float RealDelta)
+{
+	const float Alpha = 1.f - FMath::Exp(-RealDelta / FMath::Max(SmoothingTime, KINDA_SMALL_NUMBER));
+	SmoothedMs = SmoothedMs > 0.f ? FMath::Lerp(SmoothedMs, FrameMs, Alpha) : FrameMs;
+
+	if (bEnabled)
+	{
+		UpdateLevel(SmoothedMs, RealDelta);
+	}
+	else if (Level != 0)
+	{
+		SetLevel(0);
+	}
+
+	if (BenchPhase != 0)
+	{
+		TickBenchmark(FrameMs, RealDelta);
+	}
+}
+
+void UFrameBudgetSubsystem::UpdateLevel(float FrameMs, float DeltaTime)
+{
+	const bool bOver = FrameMs > TargetMs * (1.f + OverMargin);
+	const bool bUnder = FrameMs < TargetMs * (1.f - UnderMargin);
+
+	// Between the two thresholds nothing changes, and both timers start again
+	OverTime = bOver ? OverTime + DeltaTime : 0.f;
+	UnderTime = bUnder ? UnderTime + DeltaTime : 0.f;
+
+	if (OverTime >= DegradeDelay && Level < NumLevels)
+	{
+		SetLevel(Level + 1);
+		OverTime = 0.f;
+	}
+	else if (UnderTime >= RecoverDelay && Level > 0)
+	{
+		SetLevel(Level - 1);
+		UnderTime = 0.f;
+	}
+}
+
+void UFrameBudgetSubsystem::SetLevel(int32 NewLevel)
+{
+	Level = FMath::Clamp(NewLevel, 0, FMath::Max(NumLevels, 0));
+
+	const float Alpha = NumLevels > 0 ? (float)Level / NumLevels : 0.f;
+	Scales[(uint8)EFrameBudgetKnob::PreviewSolve] = FMath::Lerp(1.f, MinPreviewSolveScale, Alpha);
+	Scales[(uint8)EFrameBudgetKnob::SnapRadius] = FMath::Lerp(1.f, MinSnapRadiusScale, Alpha);
+	Scales[(uint8)EFrameBudgetKnob::DecaySlice] = FMath::Lerp(1.f, MinDecaySliceScale, Alpha);
+	Scales[(uint8)EFrameBudgetKnob::Labels] = FMath::Lerp(1.f, MinLabelScale, Alpha);
+	Scales[(uint8)EFrameBudgetKnob::Wildlife] = FMath::Lerp(1.f, MinWildlifeScale, Alpha);
+
+	UE_LOG(LogGAM312, Log, TEXT("Frame budget level %d at %.2f ms game thread (target %.2f ms)"), Level, SmoothedMs, TargetMs);
+}
+
+void UFrameBudgetSubsystem::StartBenchmark(float Seconds)
+{
+	if (BenchPhase == 0)
+	{
+		bEnabledBeforeBench = bEnabled;
+	}
+
+	BenchSeconds = FMath::Max(Seconds, 1.f);
+	BenchElapsed = 0.f;
+	BenchPhase = 1;
+	BenchSamples[0].Reset();
+	BenchSamples[1].Reset();
+	bEnabled = false;
+}
+
+void UFrameBudgetSubsystem::TickBenchmark(float FrameMs, float RealDelta)
+{
+	BenchSamples[BenchPhase - 1].Add(FrameMs);
+	BenchElapsed += RealDelta;
+	if (BenchElapsed < BenchSeconds) return;
+
+	BenchElapsed = 0.f;
+	if (BenchPhase == 1)
+	{
+		BenchPhase = 2;
+		bEnabled = true;
+		return;
+	}
+
+	BenchPhase = 0;
+	bEnabled = bEnabledBeforeBench;
+
+	for (int32 Phase = 0; Phase < 2; ++Phase)
+	{
+		TArray<float>& Samples = BenchSamples[Phase];
+		if (Samples.Num() == 0) continue;
+
+		float Mean = 0.f;
+		for (float Sample : Samples)
+		{
+			Mean += Sample;
+		}
+		Mean /= Samples.Num();
+
+		float Variance = 0.f;
+		for (float Sample : Samples)
+		{
+			Variance += FMath::Square(Sample - Mean);
+		}
+		Variance /= Samples.Num();
+
+		Samples.Sort();
+		const float P99 = Samples[FMath::Min(FMath::FloorToInt(Samples.Num() * 0.99f), Samples.Num() - 1)];
+
+		UE_LOG(LogGAM312, Log, TEXT("Gameplay.BudgetBench: governor %s, %d frames, mean %.2f ms, std dev %.2f ms, p99 %.2f ms"),
+			Phase == 0 ? TEXT("off") : TEXT("on"), Samples.Num(), Mean, FMath::Sqrt(Variance), P99);
+	}
+}
+
+// Benchmark helper: "Gameplay.BudgetBench <Seconds>" records game thread frame times with the
+// governor off and then on, for Seconds each, and logs the mean, spread and p99 of both.
+// Run it under load, such as Building.DecayStress with several players building.
+GAM312_BENCH_COMMAND(GFrameBudgetBenchCmd, "Gameplay.BudgetBench",
+	"Compares frame time spread with and without the frame budget governor. Usage: Gameplay.BudgetBench <Seconds>")
+{
+	UFrameBudgetSubsystem* Governor = World ? World->GetSubsystem<UFrameBudgetSubsystem>() : nullptr;
+	if (!Governor) return;
+
+	const float Seconds = GAM312Bench::Number(Args, 0, 30.f);
+	Governor->StartBenchmark(Seconds);
+
+	UE_LOG(LogGAM312, Log, TEXT("Gameplay.BudgetBench: running for %.0f s"), Seconds * 2.f);
+}
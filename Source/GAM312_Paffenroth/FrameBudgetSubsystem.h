@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "FrameBudgetSubsystem.generated.h"
+
+// Work the governor can scale back when the game thread is over budget
+enum class EFrameBudgetKnob : uint8
+{
+	PreviewSolve,  // Share of frames the build preview is re-solved on
+	SnapRadius,    // Radius the preview searches for snap targets
+	DecaySlice,    // Parts decayed per frame
+	Labels,        // Resource labels drawn by the HUD
+	Wildlife,      // Time wildlife agents may use per frame
+	Count
+};
+
+/**
+ * Watches game thread time against a budget and steps gameplay work down when it runs
+ * over, then back up once there is headroom again. Each knob only changes how often or how
+ * much work is done, never its outcome: commits are still validated in full and decay still
+ * catches up on skipped time. Levels change with hysteresis, so a frame time sitting near the
+ * budget does not flip back and forth. "stat GAM312" shows the current level and scales.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UFrameBudgetSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// 1 at full fidelity, down to the knob's minimum at the lowest level
+	float GetScale(EFrameBudgetKnob Knob) const;
+
+	// Scale for a knob in a world, or 1 if the world has no governor
+	static float GetScale(const UWorld* World, EFrameBudgetKnob Knob);
+
+	int32 GetLevel() const { return Level; }
+
+	// Smoothed game thread milliseconds per frame
+	float GetGameThreadMs() const { return SmoothedMs; }
+
+	// Feeds one frame to the governor: game thread milliseconds and real seconds elapsed.
+	// Tick passes the engine's measurements; tests pass their own.
+	void AddFrame(float FrameMs, float RealDelta);
+
+	// Runs the governor off and then on for Seconds each, and logs frame time spread for both
+	void StartBenchmark(float Seconds);
+
+// --- Settings ---
+
+	UPROPERTY(Config)
+		bool bEnabled = true;
+
+	// Game thread milliseconds per frame the governor aims for
+	UPROPERTY(Config)
+		float TargetMs = 16.0f;
+
+	// Fraction over the target that counts as over budget
+	UPROPERTY(Config)
+		float OverMargin = 0.1f;
+
+	// Fraction under the target needed before fidelity comes back
+	UPROPERTY(Config)
+		float UnderMargin = 0.25f;
+
+	// Seconds over budget before stepping down a level
+	UPROPERTY(Config)
+		float DegradeDelay = 0.5f;
+
+	// Seconds under budget before stepping back up, longer than DegradeDelay so it settles
+	UPROPERTY(Config)
+		float RecoverDelay = 3.0f;
+
+	// Time constant of the frame time average
+	UPROPERTY(Config)
+		float SmoothingTime = 0.5f;
+
+	// Steps between full fidelity and every knob at its minimum
+	UPROPERTY(Config)
+		int32 NumLevels = 4;
+
+	// Scale of each knob at the lowest level
+	UPROPERTY(Config)
+		float MinPreviewSolveScale = 0.25f;
+
+	UPROPERTY(Config)
+		float MinSnapRadiusScale = 0.5f;
+
+	UPROPERTY(Config)
+		float MinDecaySliceScale = 0.25f;
+
+	UPROPERTY(Config)
+		float MinLabelScale = 0.25f;
+
+	UPROPERTY(Config)
+		float MinWildlifeScale = 0.25f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void UpdateLevel(float FrameMs, float DeltaTime);
+
+	void SetLevel(int32 NewLevel);
+
+	void TickBenchmark(float FrameMs, float RealDelta);
+
+	int32 Level = 0;
+
+	float SmoothedMs = 0.f;
+
+	// Time spent continuously over or under budget
+	float OverTime = 0.f;
+	float UnderTime = 0.f;
+
+	float Scales[(uint8)EFrameBudgetKnob::Count] = { 1.f, 1.f, 1.f, 1.f, 1.f };
+
+	// Benchmark state. Phase 0 is idle, 1 runs without the governor, 2 with it.
+	int32 BenchPhase = 0;
+	float BenchSeconds = 0.f;
+	float BenchElapsed = 0.f;
+	bool bEnabledBeforeBench = true;
+	TArray<float> BenchSamples[2];
+};
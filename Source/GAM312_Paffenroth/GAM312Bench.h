@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+
+class UWorld;
+
+/**
+ * Shared plumbing for the console benchmarks. A benchmark is declared with GAM312_BENCH_COMMAND
+ * and its body runs with the typed arguments in Args and the world it was typed in as World,
+ * which may be null. Results are logged to LogGAM312 on a line starting with the command name,
+ * so a run can be grepped out of the log.
+ */
+namespace GAM312Bench
+{
+	// Argument Index as a count of at least one, or Default when it was not given
+	inline int32 Count(const TArray<FString>& Args, int32 Index, int32 Default)
+	{
+		return Args.Num() > Index ? FMath::Max(FCString::Atoi(*Args[Index]), 1) : Default;
+	}
+
+	// Argument Index as a number of at least one, or Default when it was not given
+	inline float Number(const TArray<FString>& Args, int32 Index, float Default)
+	{
+		return Args.Num() > Index ? FMath::Max(FCString::Atof(*Args[Index]), 1.f) : Default;
+	}
+
+	// Milliseconds since a FPlatformTime::Seconds() reading
+	inline double MsSince(double StartSeconds)
+	{
+		return (FPlatformTime::Seconds() - StartSeconds) * 1000.0;
+	}
+}
+
+// Declares a console benchmark. Follow it with the body, e.g.
+//   GAM312_BENCH_COMMAND(GFooBenchCmd, "Foo.Bench", "Times foo. Usage: Foo.Bench <Count>")
+//   { const int32 Count = GAM312Bench::Count(Args, 0, 100); ... }
+#define GAM312_BENCH_COMMAND(Var, Name, Help) \
+	static void Var##Run(const TArray<FString>& Args, UWorld* World); \
+	static FAutoConsoleCommandWithWorldAndArgs Var(TEXT(Name), TEXT(Help), \
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&Var##Run)); \
+	static void Var##Run(const TArray<FString>& Args, UWorld* World)
@@ -2,4 +2,11 @@
 
 
 #include "GAM312GameModeBase.h"
+#include "GAM312HUD.h"
+#include "GAM312GameState.h"
 
+AGAM312GameModeBase::AGAM312GameModeBase()
+{
+	HUDClass = AGAM312HUD::StaticClass();
+	GameStateClass = AGAM312GameState::StaticClass();
+}
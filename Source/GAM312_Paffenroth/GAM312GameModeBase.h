@@ -13,5 +13,8 @@ UCLASS()
 class GAM312_PAFFENROTH_API AGAM312GameModeBase : public AGameModeBase
 {
 	GENERATED_BODY()
+
+public:
+	AGAM312GameModeBase();
 	
 };
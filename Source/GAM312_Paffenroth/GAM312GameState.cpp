@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GAM312GameState.h"
+#include "HarvestSubsystem.h"
+#include "Net/UnrealNetwork.h"
+
+void FDepletedResourceNodes::PostReplicatedAdd(const TArrayView<int32>& AddedIndices, int32 FinalSize)
+{
+	const AGAM312GameState* GameState = Owner.Get();
+	if (!GameState) return;
+
+	for (const int32 Index : AddedIndices)
+	{
+		GameState->RemoveLocalNode(Items[Index]);
+	}
+}
+
+AGAM312GameState::AGAM312GameState()
+{
+	DepletedNodes.Owner = this;
+}
+
+void AGAM312GameState::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AGAM312GameState, DepletedNodes);
+}
+
+void AGAM312GameState::BeginPlay()
+{
+	Super::BeginPlay();
+
+	NodeSubsystem = GetWorld()->GetSubsystem<UResourceNodeSubsystem>();
+	if (NodeSubsystem && HasAuthority())
+	{
+		NodeDepletedHandle = NodeSubsystem->OnNodeDepleted.AddUObject(this, &AGAM312GameState::OnNodeDepleted);
+	}
+}
+
+void AGAM312GameState::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (NodeSubsystem)
+	{
+		NodeSubsystem->OnNodeDepleted.Remove(NodeDepletedHandle);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AGAM312GameState::OnNodeDepleted(int32 NodeId)
+{
+	// Broadcast before the node is removed, so its record is still there
+	const FResourceNodeRecord* Node = NodeSubsystem->GetNode(NodeId);
+	if (!Node) return;
+
+	FDepletedResourceNode& Entry = DepletedNodes.Items.AddDefaulted_GetRef();
+	Entry.Location = Node->Location;
+	Entry.Type = Node->Type;
+	DepletedNodes.MarkItemDirty(Entry);
+}
+
+void AGAM312GameState::ApplyDepletedNodes()
+{
+	if (HasAuthority()) return;
+
+	for (const FDepletedResourceNode& Entry : DepletedNodes.Items)
+	{
+		RemoveLocalNode(Entry);
+	}
+}
+
+void AGAM312GameState::RemoveLocalNode(const FDepletedResourceNode& Entry) const
+{
+	UResourceNodeSubsystem* Nodes = GetWorld() ? GetWorld()->GetSubsystem<UResourceNodeSubsystem>() : nullptr;
+	if (!Nodes) return;
+
+	// Matched the same way the server matches a client's swing to its own copy of a node
+	const UHarvestSubsystem* Harvest = GetWorld()->GetSubsystem<UHarvestSubsystem>();
+	Nodes->RemoveNodeAt(Entry.Location, Harvest ? Harvest->NodeMatchRadius : 50.f, Entry.Type);
+}
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/GameStateBase.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "ResourceNodeSubsystem.h"
+#include "GAM312GameState.generated.h"
+
+class AGAM312GameState;
+
+// A resource node the server depleted, named by what every machine agrees on. Node ids are
+// handed out locally, so they differ between the server and clients.
+USTRUCT()
+struct FDepletedResourceNode : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		FVector_NetQuantize Location = FVector::ZeroVector;
+
+	UPROPERTY()
+		EResourceType Type = EResourceType::Wood;
+};
+
+// Every node depleted so far. Only additions replicate, and a joining client gets them all.
+USTRUCT()
+struct FDepletedResourceNodes : public FFastArraySerializer
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		TArray<FDepletedResourceNode> Items;
+
+	// Set on the owning game state, which removes the local nodes as entries arrive
+	TWeakObjectPtr<AGAM312GameState> Owner;
+
+	void PostReplicatedAdd(const TArrayView<int32>& AddedIndices, int32 FinalSize);
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FDepletedResourceNode, FDepletedResourceNodes>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FDepletedResourceNodes> : public TStructOpsTypeTraitsBase2<FDepletedResourceNodes>
+{
+	enum { WithNetDeltaSerializer = true };
+};
+
+/**
+ * Shares world state that has no actor of its own to replicate through. Resource nodes are
+ * scattered locally on every machine, so the server lists each node it depletes here and
+ * clients remove their matching local node.
+ */
+UCLASS()
+class GAM312_PAFFENROTH_API AGAM312GameState : public AGameStateBase
+{
+	GENERATED_BODY()
+
+public:
+	AGAM312GameState();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	// Removes the local node of every depleted entry, for nodes registered after the entries
+	// arrived. Does nothing on the server, which removed them itself.
+	void ApplyDepletedNodes();
+
+	int32 GetNumDepletedNodes() const { return DepletedNodes.Items.Num(); }
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	friend struct FDepletedResourceNodes;
+
+	void OnNodeDepleted(int32 NodeId);
+
+	void RemoveLocalNode(const FDepletedResourceNode& Entry) const;
+
+	UPROPERTY(Replicated)
+		FDepletedResourceNodes DepletedNodes;
+
+	FDelegateHandle NodeDepletedHandle;
+
+	UPROPERTY(Transient)
+		TObjectPtr<UResourceNodeSubsystem> NodeSubsystem;
+};
@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GAM312HUD.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "BuildingChunkSubsystem.h"
+#include "FrameBudgetSubsystem.h"
+#include "PlayerChar.h"
+#include "Resource_M.h"
+#include "Engine/Canvas.h"
+#include "Engine/Engine.h"
+#include "Engine/Font.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Resource Labels"), STAT_ResourceLabels, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Resource Labels Drawn"), STAT_ResourceLabelsDrawn, STATGROUP_GAM312);
+
+// Height above the node origin the label is drawn at
+static constexpr float LabelHeightOffset = 80.f;
+
+void AGAM312HUD::BeginPlay()
+{
+	Super::BeginPlay();
+
+	NodeSubsystem = GetWorld()->GetSubsystem<UResourceNodeSubsystem>();
+
+	for (uint8 Type = 0; Type < (uint8)EResourceType::Count; ++Type)
+	{
+		TypeLabels[Type] = UEnum::GetDisplayValueAsText((EResourceType)Type);
+	}
+
+	if (!LabelFont && GEngine)
+	{
+		LabelFont = GEngine->GetMediumFont();
+	}
+}
+
+void AGAM312HUD::DrawHUD()
+{
+	Super::DrawHUD();
+
+	DrawResourceLabels();
+	DrawTargetHighlight();
+}
+
+void AGAM312HUD::DrawResourceLabels()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ResourceLabels);
+
+	FocusedNode = INDEX_NONE;
+	bHasTarget = false;
+	if (!NodeSubsystem || !Canvas || !PlayerOwner || !PlayerOwner->PlayerCameraManager) return;
+
+	// The node under the crosshair wins over the angle test, using the trace the player already made
+	int32 HitNode = INDEX_NONE;
+	if (APlayerChar* Player = Cast<APlayerChar>(PlayerOwner->GetPawn()))
+	{
+		const FViewQueryResult& View = Player->ViewQuery->GetViewHit();
+		if (View.bHit)
+		{
+			if (const AResource_M* Resource = Cast<AResource_M>(View.Hit.GetActor()))
+			{
+				HitNode = Resource->NodeId;
+				bHasTarget = true;
+			}
+			else
+			{
+				bHasTarget = UBuildingChunkSubsystem::ResolveHitPart(View.Hit) != nullptr;
+			}
+		}
+	}
+
+	const FVector ViewLocation = PlayerOwner->PlayerCameraManager->GetCameraLocation();
+	const FVector ViewDir = PlayerOwner->PlayerCameraManager->GetCameraRotation().Vector();
+
+	// Cone slightly wider than the horizontal FOV; the projection below does the exact screen test
+	const float CosHalfFov = FMath::Cos(FMath::DegreesToRadians(PlayerOwner->PlayerCameraManager->GetFOVAngle() * 0.5f + 5.f));
+	const float CosFocus = FMath::Cos(FMath::DegreesToRadians(FocusAngle));
+
+	NodeIds.Reset();
+	NodeSubsystem->QueryRadius(ViewLocation, LabelDistance, NodeIds);
+
+	Candidates.Reset();
+	float BestFocus = CosFocus;
+
+	for (int32 NodeId : NodeIds)
+	{
+		const FResourceNodeRecord* Node = NodeSubsystem->GetNode(NodeId);
+		const FVector ToNode = Node->Location - ViewLocation;
+		const float DistSq = ToNode.SizeSquared();
+		const float Dot = ViewDir | ToNode.GetSafeNormal();
+
+		if (Dot < CosHalfFov) continue;
+
+		if (Dot > BestFocus)
+		{
+			BestFocus = Dot;
+			FocusedNode = NodeId;
+		}
+
+		Candidates.Emplace(DistSq, NodeId);
+	}
+
+	if (HitNode != INDEX_NONE && NodeSubsystem->GetNode(HitNode))
+	{
+		FocusedNode = HitNode;
+	}
+
+	int32 NumDrawn = 0;
+
+	if (FocusedNode != INDEX_NONE)
+	{
+		DrawLabel(*NodeSubsystem->GetNode(FocusedNode), FocusedColor);
+		++NumDrawn;
+	}
+
+	// Nearest first, and only as many as the budget allows
+	const int32 LabelBudget = FMath::RoundToInt(MaxLabels * UFrameBudgetSubsystem::GetScale(GetWorld(), EFrameBudgetKnob::Labels));
+	Candidates.Sort([](const TPair<float, int32>& A, const TPair<float, int32>& B) { return A.Key < B.Key; });
+
+	for (const TPair<float, int32>& Candidate : Candidates)
+	{
+		if (NumDrawn >= LabelBudget) break;
+		if (Candidate.Value == FocusedNode) continue;
+
+		DrawLabel(*NodeSubsystem->GetNode(Candidate.Value), LabelColor);
+		++NumDrawn;
+	}
+
+	SET_DWORD_STAT(STAT_ResourceLabelsDrawn, NumDrawn);
+}
+
+void AGAM312HUD::DrawLabel(const FResourceNodeRecord& Node, const FLinearColor& Color)
+{
+	const FVector Screen = Canvas->Project(Node.Location + FVector(0.f, 0.f, LabelHeightOffset));
+	if (Screen.Z <= 0.f || Screen.X < 0.f || Screen.Y < 0.f || Screen.X > Canvas->ClipX || Screen.Y > Canvas->ClipY) return;
+
+	FCanvasTextItem Text(FVector2D(Screen.X, Screen.Y), TypeLabels[(uint8)Node.Type], LabelFont, Color);
+	Text.bCentreX = true;
+	Text.bCentreY = true;
+	Text.EnableShadow(FLinearColor::Black);
+	Canvas->DrawItem(Text);
+}
+
+void AGAM312HUD::DrawTargetHighlight()
+{
+	if (!Canvas) return;
+
+	const FLinearColor Color = bHasTarget ? FocusedColor : LabelColor;
+	const float CX = Canvas->ClipX * 0.5f;
+	const float CY = Canvas->ClipY * 0.5f;
+
+	DrawLine(CX - CrosshairSize, CY, CX + CrosshairSize, CY, Color);
+	DrawLine(CX, CY - CrosshairSize, CX, CY + CrosshairSize, Color);
+}
+
+// Benchmark helper: "HUD.LabelBench <Count> <Radius>" registers actorless nodes around the
+// local player so label cost can be compared with "stat GAM312", "stat RHI" and "memreport".
+GAM312_BENCH_COMMAND(GLabelBenchCmd, "HUD.LabelBench",
+	"Registers resource nodes around the player to stress labels. Usage: HUD.LabelBench <Count> <Radius>")
+{
+	UResourceNodeSubsystem* NodeSubsystem = World ? World->GetSubsystem<UResourceNodeSubsystem>() : nullptr;
+	APawn* Pawn = UGameplayStatics::GetPlayerPawn(World, 0);
+	if (!NodeSubsystem || !Pawn) return;
+
+	const int32 Count = GAM312Bench::Count(Args, 0, 5000);
+	const float Radius = GAM312Bench::Number(Args, 1, 20000.f);
+
+	FRandomStream Random(Count);
+	for (int32 i = 0; i < Count; ++i)
+	{
+		const float Angle = Random.FRandRange(0.f, UE_TWO_PI);
+		const FVector2D Offset = FVector2D(FMath::Cos(Angle), FMath::Sin(Angle)) * Radius * FMath::Sqrt(Random.FRand());
+		const EResourceType Type = (EResourceType)Random.RandRange(0, (int32)EResourceType::Count - 1);
+		NodeSubsystem->RegisterNode(Pawn->GetActorLocation() + FVector(Offset, 0.f), Type, 100, 5);
+	}
+
+	UE_LOG(LogGAM312, Log, TEXT("HUD.LabelBench: resource node index now holds %d nodes"), NodeSubsystem->GetNumNodes());
+}
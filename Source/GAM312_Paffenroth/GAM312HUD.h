@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/HUD.h"
+#include "ResourceNodeSubsystem.h"
+#include "GAM312HUD.generated.h"
+
+class UFont;
+
+/**
+ * Draws resource node labels for the nodes the player is looking at, all in the
+ * HUD's canvas pass. Nodes come from the resource node index, so labels work for
+ * nodes with or without an actor and cost nothing per node when out of range.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API AGAM312HUD : public AHUD
+{
+	GENERATED_BODY()
+
+public:
+	virtual void DrawHUD() override;
+
+	// Labels further than this from the camera are never drawn
+	UPROPERTY(Config, EditAnywhere, Category = "Labels")
+		float LabelDistance = 2500.0f;
+
+	// Most labels drawn per frame, nearest first. The focused node is always included.
+	UPROPERTY(Config, EditAnywhere, Category = "Labels", meta = (ClampMin = "0"))
+		int32 MaxLabels = 12;
+
+	// A node within this angle of the crosshair counts as focused
+	UPROPERTY(Config, EditAnywhere, Category = "Labels")
+		float FocusAngle = 5.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Labels")
+		TObjectPtr<UFont> LabelFont;
+
+	UPROPERTY(EditAnywhere, Category = "Labels")
+		FLinearColor LabelColor = FLinearColor::White;
+
+	UPROPERTY(EditAnywhere, Category = "Labels")
+		FLinearColor FocusedColor = FLinearColor::Yellow;
+
+	// Half size of the crosshair in pixels
+	UPROPERTY(EditAnywhere, Category = "Crosshair")
+		float CrosshairSize = 6.0f;
+
+	// Node the player is looking at, or INDEX_NONE
+	int32 GetFocusedNode() const { return FocusedNode; }
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	void DrawResourceLabels();
+
+	// Crosshair tinted when the view ray rests on something the player can use
+	void DrawTargetHighlight();
+
+	void DrawLabel(const FResourceNodeRecord& Node, const FLinearColor& Color);
+
+	// Display name per resource type, built once
+	FText TypeLabels[(uint8)EResourceType::Count];
+
+	// Scratch buffers reused every frame
+	TArray<int32> NodeIds;
+	TArray<TPair<float, int32>> Candidates;
+
+	int32 FocusedNode = INDEX_NONE;
+
+	// Whether the view ray currently hits a resource or building part
+	bool bHasTarget = false;
+
+	UPROPERTY(Transient)
+		TObjectPtr<UResourceNodeSubsystem> NodeSubsystem;
+};
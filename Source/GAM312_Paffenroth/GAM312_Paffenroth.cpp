@@ -3,4 +3,6 @@
 #include "GAM312_Paffenroth.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogGAM312);
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, GAM312_Paffenroth, "GAM312_Paffenroth" );
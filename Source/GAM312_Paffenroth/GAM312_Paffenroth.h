@@ -3,4 +3,9 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
 
+DECLARE_LOG_CATEGORY_EXTERN(LogGAM312, Log, All);
+
+// Stat group for gameplay systems ("stat GAM312")
+DECLARE_STATS_GROUP(TEXT("GAM312"), STATGROUP_GAM312, STATCAT_Advanced);
@@ -0,0 +1,229 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HarvestSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "PlayerChar.h"
+#include "Resource_M.h"
+#include "TelemetrySubsystem.h"
+#include "Algo/StableSort.h"
+
+DECLARE_CYCLE_STAT(TEXT("Harvest Resolve"), STAT_HarvestResolve, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Harvest Swings"), STAT_HarvestSwings, STATGROUP_GAM312);
+
+void UHarvestSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	NodeSubsystem = Collection.InitializeDependency<UResourceNodeSubsystem>();
+}
+
+void UHarvestSubsystem::Deinitialize()
+{
+	NodeSubsystem = nullptr;
+	Pending.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UHarvestSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UHarvestSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHarvestSubsystem, STATGROUP_Tickables);
+}
+
+void UHarvestSubsystem::Tick(float DeltaTime)
+{
+	// Swings only arrive through server RPCs
+	if (Pending.Num() > 0 && GetWorld()->GetNetMode() != NM_Client)
+	{
+		ResolveHarvests();
+	}
+}
+
+void UHarvestSubsystem::QueueHarvest(APlayerChar* Player, int32 NodeId, const FVector& HitLocation)
+{
+	FHarvestIntent& Intent = Pending.AddDefaulted_GetRef();
+	Intent.Player = Player;
+	Intent.NodeId = NodeId;
+	Intent.Location = HitLocation;
+}
+
+int32 UHarvestSubsystem::ResolveHarvests()
+{
+	SCOPE_CYCLE_COUNTER(STAT_HarvestResolve);
+
+	if (!NodeSubsystem) return 0;
+
+	Batch.Reset();
+	Swap(Batch, Pending);
+	SET_DWORD_STAT(STAT_HarvestSwings, Batch.Num());
+
+	// Group swings by node, keeping arrival order within each node
+	Algo::StableSortBy(Batch, &FHarvestIntent::NodeId);
+
+	Gains.Reset();
+	TMap<const APlayerChar*, int32, TInlineSetAllocator<16>> GainIndex;
+
+	int32 TotalGranted = 0;
+	for (int32 Start = 0; Start < Batch.Num(); )
+	{
+		const int32 NodeId = Batch[Start].NodeId;
+		int32 End = Start + 1;
+		while (End < Batch.Num() && Batch[End].NodeId == NodeId)
+		{
+			++End;
+		}
+
+		const int32 NumSwings = End - Start;
+		const FResourceNodeRecord* Node = NodeSubsystem->GetNode(NodeId);
+		if (!Node)
+		{
+			Start = End;
+			continue;
+		}
+
+		// The node may be removed by the consume, so read it first
+		const EResourceType Type = Node->Type;
+		const int32 Wanted = Node->Yield * NumSwings;
+		const int32 Granted = NodeSubsystem->ConsumeFromNode(NodeId, Wanted);
+		TotalGranted += Granted;
+
+		// Everyone gets the full yield, or an even share of what was left
+		const int32 Base = Granted / NumSwings;
+		const int32 Extra = Granted % NumSwings;
+		const int32 FirstExtra = (int32)(PassCounter % (uint32)NumSwings);
+
+		for (int32 i = 0; i < NumSwings; ++i)
+		{
+			const FHarvestIntent& Intent = Batch[Start + i];
+			const int32 Share = Base + (((i - FirstExtra + NumSwings) % NumSwings) < Extra ? 1 : 0);
+			if (Share <= 0) continue;
+
+			const APlayerChar* Player = Intent.Player.Get();
+			int32* Index = GainIndex.Find(Player);
+			if (!Index)
+			{
+				Index = &GainIndex.Add(Player, Gains.Num());
+				Gains.AddDefaulted_GetRef().Player = Intent.Player;
+			}
+
+			FHarvestGain& Gain = Gains[*Index];
+			Gain.Amounts[(uint8)Type] += Share;
+			Gain.Swings += 1;
+			Gain.LastLocation = Intent.Location;
+		}
+
+		Start = End;
+	}
+	++PassCounter;
+
+	for (const FHarvestGain& Gain : Gains)
+	{
+		ApplyGain(Gain);
+	}
+
+	return TotalGranted;
+}
+
+void UHarvestSubsystem::ApplyGain(const FHarvestGain& Gain)
+{
+	APlayerChar* Player = Gain.Player.Get();
+	if (!Player) return;
+
+	Player->AddResources(Gain.Amounts);
+	Player->SetStamina(-StaminaPerSwing * Gain.Swings);
+
+	int32 Total = 0;
+	for (uint8 Type = 0; Type < (uint8)EResourceType::Count; ++Type)
+	{
+		Total += Gain.Amounts[Type];
+		if (Gain.Amounts[Type] > 0)
+		{
+			FGameplayTelemetry::Record(ETelemetryEvent::Harvest, FGameplayTelemetry::PlayerId(Player), Gain.Amounts[Type],
+				Type, FVector3f(Gain.LastLocation));
+		}
+	}
+	Player->AddMaterialsCollected(Total);
+}
+
+// Benchmark helper: "Harvest.Bench <Players> <Nodes> <Passes>" adds a field of actor-less nodes
+// and has every player swing at a random one each pass, so nodes are shared and run dry. Times
+// the batched pass against consuming each swing on its own.
+GAM312_BENCH_COMMAND(GHarvestBenchCmd, "Harvest.Bench",
+	"Times batched harvesting of a shared node field. Usage: Harvest.Bench <Players> <Nodes> <Passes>")
+{
+	UHarvestSubsystem* Harvest = World ? World->GetSubsystem<UHarvestSubsystem>() : nullptr;
+	UResourceNodeSubsystem* Nodes = World ? World->GetSubsystem<UResourceNodeSubsystem>() : nullptr;
+	if (!Harvest || !Nodes) return;
+
+	const int32 Players = GAM312Bench::Count(Args, 0, 100);
+	const int32 NumNodes = GAM312Bench::Count(Args, 1, 50);
+	const int32 Passes = GAM312Bench::Count(Args, 2, 200);
+
+	const AResource_M* Defaults = GetDefault<AResource_M>();
+	auto AddField = [&](TArray<int32>& OutIds)
+	{
+		OutIds.Reset();
+		for (int32 i = 0; i < NumNodes; ++i)
+		{
+			OutIds.Add(Nodes->RegisterNode(FVector(i * 300.f, -100000.f, 0.f), EResourceType::Wood, Defaults->totalResource, Defaults->resourceAmount));
+		}
+	};
+
+	// Both runs start from a fresh field, and nothing is left behind. Ids carry their slot's
+	// generation, so the second field's ids never match a node from the first.
+	auto RemoveField = [&](const TArray<int32>& Ids)
+	{
+		for (int32 NodeId : Ids)
+		{
+			if (Nodes->GetNode(NodeId)) Nodes->UnregisterNode(NodeId);
+		}
+	};
+
+	// Batched: every swing of a pass resolved together
+	TArray<int32> Field;
+	AddField(Field);
+	FRandomStream Random(Players);
+
+	int32 BatchedGranted = 0;
+	double BatchedSeconds = 0.0;
+	for (int32 Pass = 0; Pass < Passes; ++Pass)
+	{
+		for (int32 p = 0; p < Players; ++p)
+		{
+			Harvest->QueueHarvest(nullptr, Field[Random.RandHelper(Field.Num())], FVector::ZeroVector);
+		}
+
+		const double Start = FPlatformTime::Seconds();
+		BatchedGranted += Harvest->ResolveHarvests();
+		BatchedSeconds += FPlatformTime::Seconds() - Start;
+	}
+
+	RemoveField(Field);
+
+	// Per swing: the same swings consumed one at a time
+	AddField(Field);
+	Random.Reset();
+
+	int32 SingleGranted = 0;
+	const double SingleStart = FPlatformTime::Seconds();
+	for (int32 Pass = 0; Pass < Passes; ++Pass)
+	{
+		for (int32 p = 0; p < Players; ++p)
+		{
+			SingleGranted += Nodes->ConsumeFromNode(Field[Random.RandHelper(Field.Num())], Defaults->resourceAmount);
+		}
+	}
+	const double SingleSeconds = FPlatformTime::Seconds() - SingleStart;
+
+	RemoveField(Field);
+
+	UE_LOG(LogGAM312, Log, TEXT("Harvest.Bench: %d players, %d nodes, %d passes. Batched %.3f ms per pass (%d granted), per swing %.3f ms per pass (%d granted)."),
+		Players, NumNodes, Passes, BatchedSeconds * 1000.0 / Passes, BatchedGranted, SingleSeconds * 1000.0 / Passes, SingleGranted);
+}
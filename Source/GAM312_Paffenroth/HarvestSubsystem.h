@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ResourceNodeSubsystem.h"
+#include "HarvestSubsystem.generated.h"
+
+class APlayerChar;
+
+// One swing at a resource node, waiting for the next harvest pass
+struct FHarvestIntent
+{
+	TWeakObjectPtr<APlayerChar> Player;
+	int32 NodeId = INDEX_NONE;
+	FVector Location = FVector::ZeroVector;
+};
+
+/**
+ * Collects harvest swings from every player and resolves them once per tick on the server.
+ * Clients send their swings with APlayerChar::ServerHarvestSwing. Each node is
+ * consumed once for all the swings at it; when it cannot cover them all, what is left is
+ * split evenly and the remainder rotates between players from pass to pass. Each player's
+ * gains are then added to their inventory in one go.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UHarvestSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Queues a swing at a node for this tick's pass. A null player harvests into nothing.
+	void QueueHarvest(APlayerChar* Player, int32 NodeId, const FVector& HitLocation);
+
+	// Resolves every queued swing now. Returns the total amount granted.
+	int32 ResolveHarvests();
+
+	int32 GetNumPending() const { return Pending.Num(); }
+
+// --- Settings ---
+
+	// Swings per second while interact is held on a node
+	UPROPERTY(Config)
+		float HarvestRate = 2.0f;
+
+	// Stamina a swing needs and uses when it yields something
+	UPROPERTY(Config)
+		float StaminaPerSwing = 5.0f;
+
+	// Furthest a player may stand from a node the server lets them swing at
+	UPROPERTY(Config)
+		float MaxHarvestReach = 1000.0f;
+
+	// How far the server's copy of a node may be from where the client saw it
+	UPROPERTY(Config)
+		float NodeMatchRadius = 50.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	// Everything one player gained in a pass
+	struct FHarvestGain
+	{
+		TWeakObjectPtr<APlayerChar> Player;
+		int32 Amounts[(uint8)EResourceType::Count] = {};
+		int32 Swings = 0;
+		FVector LastLocation = FVector::ZeroVector;
+	};
+
+	void ApplyGain(const FHarvestGain& Gain);
+
+	UPROPERTY(Transient)
+		TObjectPtr<UResourceNodeSubsystem> NodeSubsystem;
+
+	TArray<FHarvestIntent> Pending;
+
+	// Scratch reused every pass
+	TArray<FHarvestIntent> Batch;
+	TArray<FHarvestGain> Gains;
+
+	// Which swing at a short node gets the first of the remainder, advanced every pass
+	uint32 PassCounter = 0;
+};
@@ -0,0 +1,528 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "InputReplayComponent.h"
+#include "GAM312_Paffenroth.h"
+#include "PlayerChar.h"
+#include "BuildingDecaySubsystem.h"
+#include "BuildingRegistrySubsystem.h"
+#include "ResourceNodeSubsystem.h"
+#include "Resource_M.h"
+#include "Algo/StableSort.h"
+#include "Components/InputComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+FArchive& operator<<(FArchive& Ar, FRecordedInputFrame& Frame)
+{
+	uint16 Actions = (uint16)Frame.Actions;
+
+	Ar << Frame.DeltaTime;
+	Ar << Frame.MoveForward;
+	Ar << Frame.MoveRight;
+	Ar << Frame.ControlRotation;
+	Ar << Actions;
+	Ar << Frame.SpawnBuildingId;
+
+	Frame.Actions = (EReplayAction)Actions;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FRecordedPart& Part)
+{
+	Ar << Part.ClassPath;
+	Ar << Part.Transform;
+	Ar << Part.Health;
+	Ar << Part.bOwnedByPlayer;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FRecordedNode& Node)
+{
+	Ar << Node.Location;
+	Ar << Node.Type;
+	Ar << Node.Remaining;
+	Ar << Node.Yield;
+	return Ar;
+}
+
+FArchive& operator<<(FArchive& Ar, FRecordedSessionHeader& Header)
+{
+	Ar << Header.Version;
+
+	// Older recordings stop here and are rejected by the version check
+	if (Header.Version != FRecordedSessionHeader::CurrentVersion) return Ar;
+
+	Ar << Header.MapName;
+	Ar << Header.PlayerTransform;
+	Ar << Header.ControlRotation;
+	Ar << Header.Health;
+	Ar << Header.Hunger;
+	Ar << Header.Stamina;
+	Ar << Header.Resources;
+	Ar << Header.Buildings;
+	Ar << Header.Parts;
+	Ar << Header.Nodes;
+	return Ar;
+}
+
+UInputReplayComponent::UInputReplayComponent()
+{
+	// Ticking is turned on only for a local player with a session to run
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickGroup = TG_PrePhysics;
+}
+
+void UInputReplayComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Player = Cast<APlayerChar>(GetOwner());
+
+	// Command line sessions start once the player is controlled locally
+	if (FParse::Value(FCommandLine::Get(), TEXT("-replay="), CommandLinePath))
+	{
+		bCommandLineReplay = true;
+	}
+	else
+	{
+		FParse::Value(FCommandLine::Get(), TEXT("-recordinput="), CommandLinePath);
+	}
+}
+
+void UInputReplayComponent::OnLocallyControlled()
+{
+	if (!CommandLinePath.IsEmpty())
+	{
+		SetComponentTickEnabled(true);
+	}
+}
+
+void UInputReplayComponent::StartCommandLineSession()
+{
+	if (bCommandLineReplay)
+	{
+		FString CommandTrace = FPaths::ChangeExtension(CommandLinePath, TEXT("csv"));
+		FParse::Value(FCommandLine::Get(), TEXT("-replaytrace="), CommandTrace);
+		bQuitWhenDone = StartReplay(CommandLinePath, CommandTrace);
+	}
+	else
+	{
+		StartRecording(CommandLinePath);
+	}
+
+	CommandLinePath.Empty();
+}
+
+void UInputReplayComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopRecording();
+
+	if (bReplaying)
+	{
+		bReplaying = false;
+		RestoreTimeStep();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UInputReplayComponent::StartRecording(const FString& InPath)
+{
+	if (!Player || bReplaying) return;
+
+	Path = InPath;
+	Frames.Reset();
+	PendingActions = EReplayAction(0);
+	PendingBuildingId = INDEX_NONE;
+
+	Header = FRecordedSessionHeader();
+	Header.MapName = UWorld::RemovePIEPrefix(GetWorld()->GetMapName());
+	Header.PlayerTransform = Player->GetActorTransform();
+	Header.ControlRotation = Player->GetControlRotation();
+	Header.Health = Player->Health;
+	Header.Hunger = Player->Hunger;
+	Header.Stamina = Player->Stamina;
+	Header.Resources = Player->ResourcesArray;
+	Header.Buildings = Player->BuildingArray;
+	CaptureWorld();
+
+	bRecording = true;
+	SetComponentTickEnabled(true);
+	UE_LOG(LogGAM312, Log, TEXT("Recording input to %s"), *Path);
+}
+
+void UInputReplayComponent::StopRecording()
+{
+	if (!bRecording) return;
+
+	bRecording = false;
+
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	Writer << Header;
+	Writer << Frames;
+
+	FFileHelper::SaveArrayToFile(Bytes, *Path);
+	UE_LOG(LogGAM312, Log, TEXT("Recorded %d input frames to %s"), Frames.Num(), *Path);
+}
+
+bool UInputReplayComponent::StartReplay(const FString& InPath, const FString& InTracePath)
+{
+	if (!Player || bRecording) return false;
+
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *InPath))
+	{
+		UE_LOG(LogGAM312, Warning, TEXT("Could not load input recording %s"), *InPath);
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	Reader << Header;
+	if (Header.Version != FRecordedSessionHeader::CurrentVersion)
+	{
+		UE_LOG(LogGAM312, Warning, TEXT("Input recording %s is version %d, expected %d"), *InPath, Header.Version, FRecordedSessionHeader::CurrentVersion);
+		return false;
+	}
+	Reader << Frames;
+
+	const FString MapName = UWorld::RemovePIEPrefix(GetWorld()->GetMapName());
+	if (Header.MapName != MapName)
+	{
+		UE_LOG(LogGAM312, Warning, TEXT("Input recording %s was made on %s, not %s"), *InPath, *Header.MapName, *MapName);
+		return false;
+	}
+
+	// Restore the recorded starting state
+	Player->SetActorTransform(Header.PlayerTransform, false, nullptr, ETeleportType::ResetPhysics);
+	Player->Health = Header.Health;
+	Player->Hunger = Header.Hunger;
+	Player->Stamina = Header.Stamina;
+	Player->ResourcesArray = Header.Resources;
+	Player->BuildingArray = Header.Buildings;
+
+	if (APlayerController* PC = Cast<APlayerController>(Player->GetController()))
+	{
+		PC->SetControlRotation(Header.ControlRotation);
+		Player->DisableInput(PC);
+	}
+
+	RestoreWorld();
+
+	// Step the game at the recorded deltas regardless of how long frames really take
+	bSavedUseFixedTimeStep = FApp::UseFixedTimeStep();
+	SavedFixedDeltaTime = FApp::GetFixedDeltaTime();
+	FApp::SetUseFixedTimeStep(true);
+	if (Frames.Num() > 0)
+	{
+		FApp::SetFixedDeltaTime(Frames[0].DeltaTime);
+	}
+
+	Path = InPath;
+	TracePath = InTracePath;
+	TraceLines.Reset(Frames.Num() + 1);
+	TraceLines.Add(TEXT("Frame,DeltaMs,GameThreadMs,RenderThreadMs,UsedPhysicalMB,BuildingParts"));
+
+	FrameIndex = 0;
+	bReplaying = true;
+	SetComponentTickEnabled(true);
+	UE_LOG(LogGAM312, Log, TEXT("Replaying %d input frames from %s"), Frames.Num(), *Path);
+	return true;
+}
+
+void UInputReplayComponent::NoteAction(EReplayAction Action, int32 BuildingId)
+{
+	if (!bRecording) return;
+
+	PendingActions |= Action;
+	if (BuildingId != INDEX_NONE)
+	{
+		PendingBuildingId = (int8)BuildingId;
+	}
+}
+
+void UInputReplayComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!CommandLinePath.IsEmpty() && Player && Player->GetController())
+	{
+		StartCommandLineSession();
+	}
+
+	if (bRecording)
+	{
+		RecordFrame();
+	}
+	else if (bReplaying)
+	{
+		ReplayFrame();
+	}
+
+	if (!bRecording && !bReplaying && CommandLinePath.IsEmpty())
+	{
+		SetComponentTickEnabled(false);
+	}
+}
+
+void UInputReplayComponent::RecordFrame()
+{
+	// The undilated engine step, which is what the fixed timestep replaces on replay
+	FRecordedInputFrame& Frame = Frames.AddDefaulted_GetRef();
+	Frame.DeltaTime = FMath::Max((float)FApp::GetDeltaTime(), UE_KINDA_SMALL_NUMBER);
+	Frame.ControlRotation = Player->GetControlRotation();
+	Frame.Actions = PendingActions;
+	Frame.SpawnBuildingId = PendingBuildingId;
+
+	if (UInputComponent* Input = Player->InputComponent)
+	{
+		Frame.MoveForward = Input->GetAxisValue(TEXT("MoveForward"));
+		Frame.MoveRight = Input->GetAxisValue(TEXT("MoveRight"));
+	}
+
+	PendingActions = EReplayAction(0);
+	PendingBuildingId = INDEX_NONE;
+}
+
+void UInputReplayComponent::ReplayFrame()
+{
+	// Trace the frame that just finished before driving the next one
+	if (FrameIndex > 0)
+	{
+		const FPlatformMemoryStats Memory = FPlatformMemory::GetStats();
+		const UBuildingDecaySubsystem* Decay = GetWorld()->GetSubsystem<UBuildingDecaySubsystem>();
+
+		TraceLines.Add(FString::Printf(TEXT("%d,%.3f,%.3f,%.3f,%.1f,%d"),
+			FrameIndex - 1,
+			FApp::GetDeltaTime() * 1000.0,
+			FPlatformTime::ToMilliseconds(GGameThreadTime),
+			FPlatformTime::ToMilliseconds(GRenderThreadTime),
+			Memory.UsedPhysical / (1024.0 * 1024.0),
+			Decay ? Decay->GetNumParts() : 0));
+	}
+
+	if (!Frames.IsValidIndex(FrameIndex))
+	{
+		FinishReplay();
+		return;
+	}
+
+	const FRecordedInputFrame& Frame = Frames[FrameIndex++];
+
+	// The next engine step is the one the next frame was recorded over
+	if (Frames.IsValidIndex(FrameIndex))
+	{
+		FApp::SetFixedDeltaTime(Frames[FrameIndex].DeltaTime);
+	}
+
+	if (AController* Controller = Player->GetController())
+	{
+		Controller->SetControlRotation(Frame.ControlRotation);
+	}
+
+	Player->MoveForward(Frame.MoveForward);
+	Player->MoveRight(Frame.MoveRight);
+
+	if (EnumHasAnyFlags(Frame.Actions, EReplayAction::JumpPressed))  Player->StartJump();
+	if (EnumHasAnyFlags(Frame.Actions, EReplayAction::JumpReleased)) Player->StopJump();
+	if (EnumHasAnyFlags(Frame.Actions, EReplayAction::RotatePart))   Player->RotateBuilding();
+	if (EnumHasAnyFlags(Frame.Actions, EReplayAction::Interact))     Player->FindObject();
+	if (EnumHasAnyFlags(Frame.Actions, EReplayAction::InteractReleased)) Player->StopInteract();
+	if (EnumHasAnyFlags(Frame.Actions, EReplayAction::Demolish))     Player->DemolishBuilding();
+	if (EnumHasAnyFlags(Frame.Actions, EReplayAction::Undo))         Player->UndoBuilding();
+	if (EnumHasAnyFlags(Frame.Actions, EReplayAction::Redo))         Player->RedoBuilding();
+
+	if (EnumHasAnyFlags(Frame.Actions, EReplayAction::SpawnBuilding))
+	{
+		bool bSpawned = false;
+		Player->SpawnBuilding(Frame.SpawnBuildingId, bSpawned);
+	}
+}
+
+void UInputReplayComponent::FinishReplay()
+{
+	bReplaying = false;
+	RestoreTimeStep();
+
+	FFileHelper::SaveStringArrayToFile(TraceLines, *TracePath);
+	UE_LOG(LogGAM312, Log, TEXT("Replay finished, wrote %d frames of timing to %s"), TraceLines.Num() - 1, *TracePath);
+
+	// Headless replays end the process once the session is done
+	if (bQuitWhenDone)
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void UInputReplayComponent::RestoreTimeStep()
+{
+	FApp::SetUseFixedTimeStep(bSavedUseFixedTimeStep);
+	FApp::SetFixedDeltaTime(SavedFixedDeltaTime);
+}
+
+void UInputReplayComponent::CaptureWorld()
+{
+	UWorld* World = GetWorld();
+
+	// Parts without an actor are hibernated and come back from their own saved chunks
+	if (const UBuildingRegistrySubsystem* Registry = World->GetSubsystem<UBuildingRegistrySubsystem>())
+	{
+		const FBuildingPartStore& Store = Registry->GetStore();
+		for (int32 i = 0; i < Store.Num(); ++i)
+		{
+			const ABuildingPart* Part = Store.Actor[i].Get();
+			if (!Part) continue;
+
+			FRecordedPart& Recorded = Header.Parts.AddDefaulted_GetRef();
+			Recorded.ClassPath = Part->GetClass()->GetPathName();
+			Recorded.Transform = Store.Transform[i];
+			Recorded.Health = Store.Health[i];
+			Recorded.bOwnedByPlayer = Store.Owner[i].Get() == Player;
+		}
+	}
+
+	if (const UResourceNodeSubsystem* NodeSubsystem = World->GetSubsystem<UResourceNodeSubsystem>())
+	{
+		NodeSubsystem->ForEachNode([this](int32 NodeId, const FResourceNodeRecord& Node)
+		{
+			FRecordedNode& Recorded = Header.Nodes.AddDefaulted_GetRef();
+			Recorded.Location = Node.Location;
+			Recorded.Type = (uint8)Node.Type;
+			Recorded.Remaining = Node.Actor.IsValid() ? Node.Actor->totalResource : Node.Remaining;
+			Recorded.Yield = Node.Yield;
+		});
+	}
+}
+
+void UInputReplayComponent::RestoreWorld()
+{
+	UWorld* World = GetWorld();
+	if (!Player->HasAuthority())
+	{
+		UE_LOG(LogGAM312, Warning, TEXT("Replaying on a client, so the recorded parts and nodes are not restored"));
+		return;
+	}
+
+	if (UBuildingRegistrySubsystem* Registry = World->GetSubsystem<UBuildingRegistrySubsystem>())
+	{
+		// Collected first, since each part leaves the store as it is destroyed
+		TArray<ABuildingPart*> Existing;
+		const FBuildingPartStore& Store = Registry->GetStore();
+		for (int32 i = 0; i < Store.Num(); ++i)
+		{
+			if (ABuildingPart* Part = Store.Actor[i].Get())
+			{
+				Existing.Add(Part);
+			}
+		}
+
+		for (ABuildingPart* Part : Existing)
+		{
+			Part->Destroy();
+		}
+
+		if (Player->BuildJournal)
+		{
+			Player->BuildJournal->Reset();
+		}
+
+		// Lowest first, so every part finds what it rests on
+		TArray<const FRecordedPart*> Parts;
+		for (const FRecordedPart& Recorded : Header.Parts)
+		{
+			Parts.Add(&Recorded);
+		}
+		Algo::StableSortBy(Parts, [](const FRecordedPart* Recorded) { return Recorded->Transform.GetLocation().Z; });
+
+		for (const FRecordedPart* Recorded : Parts)
+		{
+			UClass* Class = FSoftClassPath(Recorded->ClassPath).TryLoadClass<ABuildingPart>();
+			if (!Class) continue;
+
+			FActorSpawnParameters SpawnParams;
+			SpawnParams.Owner = Recorded->bOwnedByPlayer ? Player.Get() : nullptr;
+			SpawnParams.Instigator = Recorded->bOwnedByPlayer ? Player.Get() : nullptr;
+			SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+			ABuildingPart* Part = World->SpawnActor<ABuildingPart>(Class, Recorded->Transform, SpawnParams);
+			if (!Part) continue;
+
+			// The recorded layout was valid, so a failed check only costs the part its supports
+			TArray<FBuildingPartHandle> Supports;
+			if (!Player->ValidatePlacement(Part, Recorded->Transform, &Supports))
+			{
+				Supports.Reset();
+			}
+			Part->OnPlaced(Supports);
+
+			const int32 Index = Registry->ToDense(Part->Handle);
+			if (Index != INDEX_NONE)
+			{
+				FBuildingPartStore& Placed = Registry->GetStore();
+				Placed.Health[Index] = FMath::Min(Recorded->Health, Placed.MaxHealth[Index]);
+				Part->SetDamageAmount(1.f - Placed.Health[Index] / Placed.MaxHealth[Index]);
+			}
+		}
+	}
+
+	if (UResourceNodeSubsystem* NodeSubsystem = World->GetSubsystem<UResourceNodeSubsystem>())
+	{
+		auto KeyFor = [](const FVector& Location)
+		{
+			return FIntVector(FMath::RoundToInt(Location.X), FMath::RoundToInt(Location.Y), FMath::RoundToInt(Location.Z));
+		};
+
+		TMap<FIntVector, const FRecordedNode*> Recorded;
+		for (const FRecordedNode& Node : Header.Nodes)
+		{
+			Recorded.Add(KeyFor(Node.Location), &Node);
+		}
+
+		// Collected first, since depleting a node removes it
+		TArray<TPair<int32, FIntVector>> Live;
+		NodeSubsystem->ForEachNode([&Live, &KeyFor](int32 NodeId, const FResourceNodeRecord& Node)
+		{
+			Live.Emplace(NodeId, KeyFor(Node.Location));
+		});
+
+		// Nodes the recording did not have had already run dry when it started
+		for (const TPair<int32, FIntVector>& Node : Live)
+		{
+			const FRecordedNode* Match = nullptr;
+			Recorded.RemoveAndCopyValue(Node.Value, Match);
+			NodeSubsystem->SetRemaining(Node.Key, Match ? Match->Remaining : 0);
+		}
+
+		for (const TPair<FIntVector, const FRecordedNode*>& Missing : Recorded)
+		{
+			const FRecordedNode& Node = *Missing.Value;
+			NodeSubsystem->RegisterNode(Node.Location, (EResourceType)Node.Type, Node.Remaining, Node.Yield);
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GInputRecordCmd(
+	TEXT("Input.Record"),
+	TEXT("Starts or stops recording the local player's input. Usage: Input.Record <file> | Input.Record stop"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		APlayerController* PC = World ? World->GetFirstPlayerController() : nullptr;
+		APlayerChar* PlayerChar = PC ? Cast<APlayerChar>(PC->GetPawn()) : nullptr;
+		if (!PlayerChar || !PlayerChar->InputReplay) return;
+
+		if (Args.Num() == 0 || Args[0] == TEXT("stop"))
+		{
+			PlayerChar->InputReplay->StopRecording();
+		}
+		else
+		{
+			PlayerChar->InputReplay->StartRecording(FPaths::ProjectSavedDir() / Args[0]);
+		}
+	}));
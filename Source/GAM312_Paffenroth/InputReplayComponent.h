@@ -0,0 +1,170 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "InputReplayComponent.generated.h"
+
+class APlayerChar;
+
+// Discrete inputs captured alongside the axis values
+enum class EReplayAction : uint16
+{
+	JumpPressed  = 1 << 0,
+	JumpReleased = 1 << 1,
+	Interact     = 1 << 2,
+	RotatePart   = 1 << 3,
+	SpawnBuilding = 1 << 4,
+	Demolish     = 1 << 5,
+	Undo         = 1 << 6,
+	Redo         = 1 << 7,
+	InteractReleased = 1 << 8
+};
+ENUM_CLASS_FLAGS(EReplayAction);
+
+// Input for one frame
+struct FRecordedInputFrame
+{
+	float DeltaTime = 0.f;
+	float MoveForward = 0.f;
+	float MoveRight = 0.f;
+	FRotator ControlRotation = FRotator::ZeroRotator;
+	EReplayAction Actions = EReplayAction(0);
+	int8 SpawnBuildingId = INDEX_NONE;
+
+	friend FArchive& operator<<(FArchive& Ar, FRecordedInputFrame& Frame);
+};
+
+// A placed part at the start of a recording
+struct FRecordedPart
+{
+	FString ClassPath;
+	FTransform Transform;
+	float Health = 0.f;
+	bool bOwnedByPlayer = false;
+
+	friend FArchive& operator<<(FArchive& Ar, FRecordedPart& Part);
+};
+
+// A resource node at the start of a recording
+struct FRecordedNode
+{
+	FVector Location = FVector::ZeroVector;
+	uint8 Type = 0;
+	int32 Remaining = 0;
+	int32 Yield = 0;
+
+	friend FArchive& operator<<(FArchive& Ar, FRecordedNode& Node);
+};
+
+// Player and world state at the start of a recording
+struct FRecordedSessionHeader
+{
+	// Version 2 widened the per-frame action flags. Version 3 added the world state and
+	// dropped the fixed rate, since frames step by their own recorded delta.
+	static constexpr int32 CurrentVersion = 3;
+
+	int32 Version = CurrentVersion;
+	FString MapName;
+	FTransform PlayerTransform;
+	FRotator ControlRotation = FRotator::ZeroRotator;
+	float Health = 100.f;
+	float Hunger = 100.f;
+	float Stamina = 100.f;
+	TArray<int32> Resources;
+	TArray<int32> Buildings;
+	TArray<FRecordedPart> Parts;
+	TArray<FRecordedNode> Nodes;
+
+	friend FArchive& operator<<(FArchive& Ar, FRecordedSessionHeader& Header);
+};
+
+/**
+ * Records the player's input stream and replays it at a fixed timestep so two builds
+ * can be profiled on the same session. Each replayed frame steps by the delta it was
+ * recorded with, from the placed parts and resource nodes the recording started with.
+ * Replays write a per-frame CSV trace.
+ *
+ * Only ticks for a locally controlled player, and only while it has a session to run.
+ *
+ * Command line: -recordinput=<file> records, -replay=<file> [-replaytrace=<csv>] replays and quits.
+ */
+UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
+class GAM312_PAFFENROTH_API UInputReplayComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UInputReplayComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	// Starts capturing input to a file
+	void StartRecording(const FString& InPath);
+
+	// Stops capturing and writes the recording
+	void StopRecording();
+
+	// Loads a recording and starts driving the player with it
+	bool StartReplay(const FString& InPath, const FString& InTracePath);
+
+	// Notes a discrete input during recording
+	void NoteAction(EReplayAction Action, int32 BuildingId = INDEX_NONE);
+
+	// Called once the owner is controlled on this machine, to start a command line session
+	void OnLocallyControlled();
+
+	bool IsRecording() const { return bRecording; }
+	bool IsReplaying() const { return bReplaying; }
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void StartCommandLineSession();
+
+	void RecordFrame();
+
+	void ReplayFrame();
+
+	void FinishReplay();
+
+	// Stops stepping at the recorded deltas and puts the engine's own timestep back
+	void RestoreTimeStep();
+
+	void CaptureWorld();
+
+	// Replaces the placed parts and node amounts with the recorded ones
+	void RestoreWorld();
+
+	UPROPERTY(Transient)
+		TObjectPtr<APlayerChar> Player;
+
+	FRecordedSessionHeader Header;
+	TArray<FRecordedInputFrame> Frames;
+
+	bool bRecording = false;
+	bool bReplaying = false;
+
+	// Actions noted since the last recorded frame
+	EReplayAction PendingActions = EReplayAction(0);
+	int8 PendingBuildingId = INDEX_NONE;
+
+	FString Path;
+
+	// Session requested on the command line, started once the player is possessed
+	FString CommandLinePath;
+	bool bCommandLineReplay = false;
+
+	// Replay state
+	int32 FrameIndex = 0;
+	FString TracePath;
+	bool bQuitWhenDone = false;
+	TArray<FString> TraceLines;
+
+	// Engine timestep settings from before the replay
+	bool bSavedUseFixedTimeStep = false;
+	double SavedFixedDeltaTime = 0.0;
+};
@@ -0,0 +1,462 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LandscapeHeightSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "EngineUtils.h"
+#include "LandscapeProxy.h"
+#include "LandscapeHeightfieldCollisionComponent.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include <limits>
+
+DECLARE_CYCLE_STAT(TEXT("Landscape Height Tile Build"), STAT_LandscapeHeightTileBuild, STATGROUP_GAM312);
+DECLARE_CYCLE_STAT(TEXT("Landscape Height Prefetch"), STAT_LandscapeHeightPrefetch, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Landscape Height Tiles Queued"), STAT_LandscapeHeightTilesQueued, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Landscape Height Tiles"), STAT_LandscapeHeightTiles, STATGROUP_GAM312);
+
+void ULandscapeHeightSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Streamed-in landscape invalidates tiles built before it arrived
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &ULandscapeHeightSubsystem::OnLevelAdded);
+}
+
+void ULandscapeHeightSubsystem::Deinitialize()
+{
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+
+	{
+		FWriteScopeLock Lock(TilesLock);
+		Tiles.Empty();
+	}
+	Landscapes.Empty();
+	bGatheredLandscapes = false;
+	PrefetchQueue.Empty();
+	Prefetching = FTileBuild();
+
+	Super::Deinitialize();
+}
+
+bool ULandscapeHeightSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void ULandscapeHeightSubsystem::OnLevelAdded(ULevel* Level, UWorld* InWorld)
+{
+	if (InWorld != GetWorld()) return;
+
+	FWriteScopeLock Lock(TilesLock);
+	Tiles.Reset();
+	Landscapes.Reset();
+	bGatheredLandscapes = false;
+	PrefetchQueue.Reset();
+	Prefetching = FTileBuild();
+}
+
+TStatId ULandscapeHeightSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(ULandscapeHeightSubsystem, STATGROUP_Tickables);
+}
+
+void ULandscapeHeightSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_LandscapeHeightPrefetch);
+
+	QueuePrefetch();
+
+	// Build rows of queued tiles until this frame's share of time is used up
+	const double Deadline = FPlatformTime::Seconds() + PrefetchMs / 1000.0;
+	while (FPlatformTime::Seconds() < Deadline)
+	{
+		if (!Prefetching.Tile)
+		{
+			if (PrefetchQueue.Num() == 0) break;
+
+			const FIntPoint Key = PrefetchQueue[0];
+			PrefetchQueue.RemoveAt(0, 1, EAllowShrinking::No);
+			BeginBuild(Key, Prefetching);
+		}
+
+		if (ContinueBuild(Prefetching, Deadline))
+		{
+			AddTile(Prefetching.Key, Prefetching.Tile);
+			Prefetching = FTileBuild();
+		}
+	}
+
+	SET_DWORD_STAT(STAT_LandscapeHeightTilesQueued, PrefetchQueue.Num() + (Prefetching.Tile ? 1 : 0));
+}
+
+void ULandscapeHeightSubsystem::QueuePrefetch()
+{
+	PrefetchQueue.Reset();
+
+	const int32 Reach = FMath::CeilToInt(PrefetchRadius / TileSize);
+	TArray<TPair<int32, FIntPoint>, TInlineAllocator<64>> Wanted;
+
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APawn* Pawn = It->Get() ? It->Get()->GetPawn() : nullptr;
+		if (!Pawn) continue;
+
+		const FIntPoint Center = TileKeyFor(FVector2D(Pawn->GetActorLocation()));
+		for (int32 Y = -Reach; Y <= Reach; ++Y)
+		{
+			for (int32 X = -Reach; X <= Reach; ++X)
+			{
+				Wanted.Emplace(FMath::Max(FMath::Abs(X), FMath::Abs(Y)), Center + FIntPoint(X, Y));
+			}
+		}
+	}
+
+	Wanted.Sort([](const TPair<int32, FIntPoint>& A, const TPair<int32, FIntPoint>& B) { return A.Key < B.Key; });
+
+	FReadScopeLock Lock(TilesLock);
+	for (const TPair<int32, FIntPoint>& Pair : Wanted)
+	{
+		// Tiles near a player count as used, so eviction takes the ones nobody is near
+		if (const TSharedPtr<const FLandscapeHeightTile>* Found = Tiles.Find(Pair.Value))
+		{
+			(*Found)->LastUsedFrame.store(GFrameCounter, std::memory_order_relaxed);
+		}
+		else if (!(Prefetching.Tile && Prefetching.Key == Pair.Value))
+		{
+			PrefetchQueue.AddUnique(Pair.Value);
+		}
+	}
+}
+
+FIntPoint ULandscapeHeightSubsystem::TileKeyFor(const FVector2D& Point) const
+{
+	return FIntPoint(FMath::FloorToInt(Point.X / TileSize), FMath::FloorToInt(Point.Y / TileSize));
+}
+
+int32 ULandscapeHeightSubsystem::GetNumTiles() const
+{
+	FReadScopeLock Lock(TilesLock);
+	return Tiles.Num();
+}
+
+void ULandscapeHeightSubsystem::GatherLandscapes() const
+{
+	check(IsInGameThread());
+
+	Landscapes.Reset();
+	for (TActorIterator<ALandscapeProxy> It(GetWorld()); It; ++It)
+	{
+		Landscapes.Emplace(*It, It->GetComponentsBoundingBox(true));
+	}
+	bGatheredLandscapes = true;
+}
+
+void ULandscapeHeightSubsystem::BeginBuild(const FIntPoint& Key, FTileBuild& OutBuild) const
+{
+	if (!bGatheredLandscapes)
+	{
+		GatherLandscapes();
+	}
+
+	OutBuild.Key = Key;
+	OutBuild.NextRow = 0;
+	OutBuild.Overlapping.Reset();
+	OutBuild.Tile = MakeShared<FLandscapeHeightTile>();
+
+	FLandscapeHeightTile& Tile = *OutBuild.Tile;
+	Tile.Origin = FVector2D(Key) * TileSize;
+
+	const FBox TileBox(FVector(Tile.Origin, -UE_BIG_NUMBER), FVector(Tile.Origin + FVector2D(TileSize), UE_BIG_NUMBER));
+	for (const TPair<TWeakObjectPtr<ALandscapeProxy>, FBox>& Landscape : Landscapes)
+	{
+		if (Landscape.Key.IsValid() && Landscape.Value.Intersect(TileBox))
+		{
+			OutBuild.Overlapping.Add(Landscape.Key);
+		}
+	}
+
+	// A tile with no landscape under it stays empty, so later samples miss without rebuilding
+	if (OutBuild.Overlapping.Num() == 0)
+	{
+		return;
+	}
+
+	Tile.Resolution = FMath::CeilToInt(TileSize / SampleSpacing) + 1;
+	Tile.Spacing = TileSize / (Tile.Resolution - 1);
+	Tile.Height.Init(std::numeric_limits<float>::quiet_NaN(), Tile.Resolution * Tile.Resolution);
+}
+
+bool ULandscapeHeightSubsystem::ContinueBuild(FTileBuild& Build, double Deadline) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_LandscapeHeightTileBuild);
+
+	FLandscapeHeightTile& Tile = *Build.Tile;
+	while (Build.NextRow < Tile.Resolution)
+	{
+		const int32 Y = Build.NextRow++;
+		for (int32 X = 0; X < Tile.Resolution; ++X)
+		{
+			const FVector Location(Tile.Origin.X + X * Tile.Spacing, Tile.Origin.Y + Y * Tile.Spacing, 0.f);
+
+			// Reads the collision heightfield directly; no scene query involved
+			for (const TWeakObjectPtr<ALandscapeProxy>& Landscape : Build.Overlapping)
+			{
+				const TOptional<float> Height = Landscape.IsValid() ? Landscape->GetHeightAtLocation(Location) : TOptional<float>();
+				if (Height.IsSet())
+				{
+					Tile.Height[Y * Tile.Resolution + X] = Height.GetValue();
+					break;
+				}
+			}
+		}
+
+		if (Build.NextRow < Tile.Resolution && FPlatformTime::Seconds() >= Deadline)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+TSharedPtr<const FLandscapeHeightTile> ULandscapeHeightSubsystem::BuildTile(const FIntPoint& Key) const
+{
+	FTileBuild Build;
+	BeginBuild(Key, Build);
+	ContinueBuild(Build, TNumericLimits<double>::Max());
+	return Build.Tile;
+}
+
+void ULandscapeHeightSubsystem::AddTile(const FIntPoint& Key, const TSharedPtr<const FLandscapeHeightTile>& Tile) const
+{
+	Tile->LastUsedFrame.store(GFrameCounter, std::memory_order_relaxed);
+	{
+		FWriteScopeLock Lock(TilesLock);
+		Tiles.Add(Key, Tile);
+	}
+
+	EvictTiles();
+}
+
+TSharedPtr<const FLandscapeHeightTile> ULandscapeHeightSubsystem::GetTile(const FIntPoint& Key) const
+{
+	{
+		FReadScopeLock Lock(TilesLock);
+		if (const TSharedPtr<const FLandscapeHeightTile>* Found = Tiles.Find(Key))
+		{
+			(*Found)->LastUsedFrame.store(GFrameCounter, std::memory_order_relaxed);
+			return *Found;
+		}
+	}
+
+	// Landscape data may only be read on the game thread
+	if (!IsInGameThread()) return nullptr;
+
+	// A tile half way through its prefetch is finished now rather than started again
+	TSharedPtr<const FLandscapeHeightTile> Tile;
+	if (Prefetching.Tile && Prefetching.Key == Key)
+	{
+		ContinueBuild(Prefetching, TNumericLimits<double>::Max());
+		Tile = MoveTemp(Prefetching.Tile);
+		Prefetching = FTileBuild();
+	}
+	else
+	{
+		Tile = BuildTile(Key);
+	}
+
+	AddTile(Key, Tile);
+	return Tile;
+}
+
+void ULandscapeHeightSubsystem::EvictTiles() const
+{
+	FWriteScopeLock Lock(TilesLock);
+
+	const int32 Excess = Tiles.Num() - FMath::Max(MaxTiles, 1);
+	if (Excess > 0)
+	{
+		TArray<TPair<uint64, FIntPoint>> ByAge;
+		ByAge.Reserve(Tiles.Num());
+		for (const TPair<FIntPoint, TSharedPtr<const FLandscapeHeightTile>>& Pair : Tiles)
+		{
+			ByAge.Emplace(Pair.Value->LastUsedFrame.load(std::memory_order_relaxed), Pair.Key);
+		}
+		ByAge.Sort([](const TPair<uint64, FIntPoint>& A, const TPair<uint64, FIntPoint>& B) { return A.Key < B.Key; });
+
+		// Readers holding a tile keep it alive through their shared pointer
+		for (int32 i = 0; i < Excess; ++i)
+		{
+			Tiles.Remove(ByAge[i].Value);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_LandscapeHeightTiles, Tiles.Num());
+}
+
+void ULandscapeHeightSubsystem::PrefetchTiles(const FBox2D& Bounds)
+{
+	const FIntPoint Min = TileKeyFor(Bounds.Min);
+	const FIntPoint Max = TileKeyFor(Bounds.Max);
+
+	for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+	{
+		for (int32 X = Min.X; X <= Max.X; ++X)
+		{
+			GetTile(FIntPoint(X, Y));
+		}
+	}
+}
+
+bool ULandscapeHeightSubsystem::SampleHeight(const FVector2D& Point, float& OutHeight) const
+{
+	const TSharedPtr<const FLandscapeHeightTile> Tile = GetTile(TileKeyFor(Point));
+	if (!Tile || Tile->Resolution < 2) return false;
+
+	const FVector2D Local = (Point - Tile->Origin) / Tile->Spacing;
+	const int32 X = FMath::Clamp(FMath::FloorToInt(Local.X), 0, Tile->Resolution - 2);
+	const int32 Y = FMath::Clamp(FMath::FloorToInt(Local.Y), 0, Tile->Resolution - 2);
+	const float FracX = FMath::Clamp(Local.X - X, 0.f, 1.f);
+	const float FracY = FMath::Clamp(Local.Y - Y, 0.f, 1.f);
+
+	const float* Row0 = Tile->Height.GetData() + Y * Tile->Resolution + X;
+	const float* Row1 = Row0 + Tile->Resolution;
+
+	// NaN marks a hole, which poisons the whole cell
+	const float Height = FMath::BiLerp(Row0[0], Row0[1], Row1[0], Row1[1], FracX, FracY);
+	if (FMath::IsNaN(Height)) return false;
+
+	OutHeight = Height;
+	return true;
+}
+
+bool ULandscapeHeightSubsystem::SampleFootprint(const FVector2D& Center, const FVector2D& HalfExtent, float Yaw, FFootprintHeights& OutHeights) const
+{
+	float S, C;
+	FMath::SinCos(&S, &C, FMath::DegreesToRadians(Yaw));
+	const FVector2D AxisX = FVector2D(C, S) * HalfExtent.X;
+	const FVector2D AxisY = FVector2D(-S, C) * HalfExtent.Y;
+
+	float Min = TNumericLimits<float>::Max();
+	float Max = TNumericLimits<float>::Lowest();
+	float Sum = 0.f;
+
+	// Corners, edge midpoints and centre
+	for (int32 Y = -1; Y <= 1; ++Y)
+	{
+		for (int32 X = -1; X <= 1; ++X)
+		{
+			float Height;
+			if (!SampleHeight(Center + AxisX * X + AxisY * Y, Height)) return false;
+
+			Min = FMath::Min(Min, Height);
+			Max = FMath::Max(Max, Height);
+			Sum += Height;
+		}
+	}
+
+	OutHeights.Min = Min;
+	OutHeights.Max = Max;
+	OutHeights.Average = Sum / 9.f;
+	return true;
+}
+
+bool ULandscapeHeightSubsystem::SampleGround(const FVector& Center, const FVector2D& HalfExtent, float Yaw, const FCollisionQueryParams& Params, FFootprintHeights& OutGround) const
+{
+	check(IsInGameThread());
+
+	// Rocks, buildings and foundations sit on the landscape, so the trace decides what is underneath
+	FHitResult Hit;
+	if (!GetWorld()->LineTraceSingleByChannel(Hit, Center + FVector(0.f, 0.f, GroundSearchUp), Center - FVector(0.f, 0.f, GroundSearchDown), ECC_Visibility, Params))
+	{
+		return false;
+	}
+
+	FFootprintHeights Landscape;
+	const bool bHasLandscape = SampleFootprint(FVector2D(Center), HalfExtent, Yaw, Landscape);
+
+	// On open ground the cache covers the corners the trace did not
+	if (bHasLandscape && Cast<ALandscapeProxy>(Hit.GetActor()))
+	{
+		OutGround = Landscape;
+		return true;
+	}
+
+	// Standing on something else, the slope can still rise into the footprint beside it
+	OutGround.Min = OutGround.Max = OutGround.Average = Hit.Location.Z;
+	if (bHasLandscape)
+	{
+		OutGround.Max = FMath::Max(OutGround.Max, Landscape.Max);
+	}
+	return true;
+}
+
+// Benchmark helper: "Building.HeightBench <Footprints>" measures floor ground checks around the
+// local player with the height cache and with line traces. The first pass times tile builds,
+// the second times cached footprint sampling, and the trace figures show the old per-frame cost.
+GAM312_BENCH_COMMAND(GLandscapeHeightBenchCmd, "Building.HeightBench",
+	"Compares landscape height cache footprints with ground traces. Usage: Building.HeightBench <Footprints>")
+{
+	ULandscapeHeightSubsystem* Heights = World ? World->GetSubsystem<ULandscapeHeightSubsystem>() : nullptr;
+	APlayerController* PC = World ? World->GetFirstPlayerController() : nullptr;
+	APawn* Pawn = PC ? PC->GetPawn() : nullptr;
+	if (!Heights || !Pawn) return;
+
+	const int32 Count = GAM312Bench::Count(Args, 0, 10000);
+	const FVector Origin = Pawn->GetActorLocation();
+	const FVector2D HalfExtent(200.f, 200.f);
+
+	FRandomStream Random(Count);
+	TArray<FVector2D> Centers;
+	TArray<float> Yaws;
+	for (int32 i = 0; i < Count; ++i)
+	{
+		Centers.Add(FVector2D(Origin) + FVector2D(Random.FRandRange(-3000.f, 3000.f), Random.FRandRange(-3000.f, 3000.f)));
+		Yaws.Add(Random.FRandRange(0.f, 360.f));
+	}
+
+	const double BuildStart = FPlatformTime::Seconds();
+	Heights->PrefetchTiles(FBox2D(FVector2D(Origin) - FVector2D(3500.f), FVector2D(Origin) + FVector2D(3500.f)));
+	const double BuildMs = GAM312Bench::MsSince(BuildStart);
+
+	TArray<float> CacheCenters;
+	CacheCenters.Init(std::numeric_limits<float>::quiet_NaN(), Count);
+	int32 CacheHits = 0;
+	const double CacheStart = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Count; ++i)
+	{
+		FFootprintHeights Footprint;
+		if (Heights->SampleFootprint(Centers[i], HalfExtent, Yaws[i], Footprint))
+		{
+			Heights->SampleHeight(Centers[i], CacheCenters[i]);
+			++CacheHits;
+		}
+	}
+	const double CacheMs = GAM312Bench::MsSince(CacheStart);
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(HeightBench), false, Pawn);
+	int32 TraceHits = 0;
+	double ErrorSum = 0.0;
+	int32 Compared = 0;
+	const double TraceStart = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Count; ++i)
+	{
+		FHitResult Hit;
+		if (World->LineTraceSingleByChannel(Hit, FVector(Centers[i], Origin.Z + 500.f), FVector(Centers[i], Origin.Z - 2000.f), ECC_Visibility, Params))
+		{
+			++TraceHits;
+			if (!FMath::IsNaN(CacheCenters[i]))
+			{
+				ErrorSum += FMath::Abs(Hit.Location.Z - CacheCenters[i]);
+				++Compared;
+			}
+		}
+	}
+	const double TraceMs = GAM312Bench::MsSince(TraceStart);
+
+	UE_LOG(LogGAM312, Log, TEXT("Building.HeightBench: %d tiles built in %.2f ms, %d footprints (9 samples each) in %.3f ms, %d on landscape."),
+		Heights->GetNumTiles(), BuildMs, Count, CacheMs, CacheHits);
+	UE_LOG(LogGAM312, Log, TEXT("Building.HeightBench: %d single traces in %.3f ms, %d hits. Mean centre height difference %.2f cm over %d points."),
+		Count, TraceMs, TraceHits, Compared > 0 ? ErrorSum / Compared : 0.0, Compared);
+}
@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Misc/ScopeRWLock.h"
+#include <atomic>
+#include "LandscapeHeightSubsystem.generated.h"
+
+class ALandscapeProxy;
+struct FCollisionQueryParams;
+
+// Landscape heights on a regular grid over one square tile. Never changes once built.
+struct FLandscapeHeightTile
+{
+	// World position of sample (0, 0)
+	FVector2D Origin = FVector2D::ZeroVector;
+
+	// Samples per side, with the last row and column shared with the next tile. Zero if no landscape.
+	int32 Resolution = 0;
+
+	float Spacing = 0.f;
+
+	// World Z per sample, or NaN where there is no landscape
+	TArray<float> Height;
+
+	// Frame the tile was last sampled, for eviction
+	mutable std::atomic<uint64> LastUsedFrame { 0 };
+};
+
+// Ground heights under a footprint
+struct FFootprintHeights
+{
+	float Min = 0.f;
+	float Max = 0.f;
+	float Average = 0.f;
+};
+
+/**
+ * Read-only cache of landscape heights, built from the landscape collision heightfields in
+ * tiles. Tiles around every player are built ahead of need a few rows per frame; a sample
+ * anywhere else builds its tile on the spot. Lookups are a bilinear read with no physics
+ * query. Sampling is safe on any thread; tiles are only built on the game thread, so other
+ * threads see a miss until the game thread has built that tile.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API ULandscapeHeightSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Ground height at a point. Returns false off the landscape or in an unbuilt tile off the game thread.
+	bool SampleHeight(const FVector2D& Point, float& OutHeight) const;
+
+	// Min, max and average height under a rotated rectangle, from a 3x3 grid of samples.
+	// Returns false if any sample is off the landscape.
+	bool SampleFootprint(const FVector2D& Center, const FVector2D& HalfExtent, float Yaw, FFootprintHeights& OutHeights) const;
+
+	// Ground under a footprint near a height. A trace under the centre finds what the footprint
+	// stands on; on landscape the cached footprint gives the spread under the corners, and on
+	// anything else the landscape only counts where it rises above the hit. Returns false if
+	// there is no ground within reach. Game thread only.
+	bool SampleGround(const FVector& Center, const FVector2D& HalfExtent, float Yaw, const FCollisionQueryParams& Params, FFootprintHeights& OutGround) const;
+
+	// Builds every tile overlapping a box now, instead of on first sample
+	void PrefetchTiles(const FBox2D& Bounds);
+
+	int32 GetNumTiles() const;
+
+// --- Settings ---
+
+	// Side length of a tile
+	UPROPERTY(Config)
+		float TileSize = 6400.0f;
+
+	// Distance between height samples
+	UPROPERTY(Config)
+		float SampleSpacing = 100.0f;
+
+	// Tiles kept resident before the least recently used ones are dropped. Should cover
+	// PrefetchRadius around every player, or prefetched tiles push each other out.
+	UPROPERTY(Config)
+		int32 MaxTiles = 64;
+
+	// Tiles within this distance of a player are built before anything samples them
+	UPROPERTY(Config)
+		float PrefetchRadius = 6400.0f;
+
+	// Milliseconds per frame spent building prefetched tiles
+	UPROPERTY(Config)
+		float PrefetchMs = 0.5f;
+
+	// How far above and below a query height SampleGround looks for ground
+	UPROPERTY(Config)
+		float GroundSearchUp = 500.0f;
+
+	UPROPERTY(Config)
+		float GroundSearchDown = 2000.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	// A tile being sampled, a few rows at a time when prefetched
+	struct FTileBuild
+	{
+		FIntPoint Key = FIntPoint::ZeroValue;
+		TSharedPtr<FLandscapeHeightTile> Tile;
+		TArray<TWeakObjectPtr<ALandscapeProxy>, TInlineAllocator<4>> Overlapping;
+		int32 NextRow = 0;
+	};
+
+	void OnLevelAdded(ULevel* Level, UWorld* InWorld);
+
+	FIntPoint TileKeyFor(const FVector2D& Point) const;
+
+	// Finds a tile, building it if called on the game thread
+	TSharedPtr<const FLandscapeHeightTile> GetTile(const FIntPoint& Key) const;
+
+	TSharedPtr<const FLandscapeHeightTile> BuildTile(const FIntPoint& Key) const;
+
+	void BeginBuild(const FIntPoint& Key, FTileBuild& OutBuild) const;
+
+	// Samples rows until the tile is complete or Deadline passes. Returns whether it is complete.
+	bool ContinueBuild(FTileBuild& Build, double Deadline) const;
+
+	void AddTile(const FIntPoint& Key, const TSharedPtr<const FLandscapeHeightTile>& Tile) const;
+
+	// Queues unbuilt tiles around every player, nearest first, and keeps built ones fresh
+	void QueuePrefetch();
+
+	void EvictTiles() const;
+
+	// Landscape actors and their bounds, gathered on first use
+	void GatherLandscapes() const;
+
+	mutable TMap<FIntPoint, TSharedPtr<const FLandscapeHeightTile>> Tiles;
+
+	mutable FRWLock TilesLock;
+
+	mutable TArray<TPair<TWeakObjectPtr<ALandscapeProxy>, FBox>> Landscapes;
+
+	mutable bool bGatheredLandscapes = false;
+
+	// Tiles waiting to be prefetched, and the one being built
+	mutable TArray<FIntPoint> PrefetchQueue;
+	mutable FTileBuild Prefetching;
+
+	FDelegateHandle LevelAddedHandle;
+};
@@ -2,7 +2,17 @@
 #include "Kismet/GameplayStatics.h"
 #include "Camera/CameraComponent.h"
 #include "BuildingPart.h"
-#include "EngineUtils.h"
+#include "GAM312_Paffenroth.h"
+#include "CraftingSubsystem.h"
+#include "BuildingSnapRules.h"
+#include "BuildingRegistrySubsystem.h"
+#include "LandscapeHeightSubsystem.h"
+#include "BuildingChunkSubsystem.h"
+#include "FrameBudgetSubsystem.h"
+#include "BuildingPlacementSubsystem.h"
+#include "HarvestSubsystem.h"
+#include "TelemetrySubsystem.h"
+#include "Net/UnrealNetwork.h"
 
 // Helpers
 
@@ -31,278 +41,315 @@ static bool OverlapsBlocking(UWorld* World, const AActor* IgnoredA, const AActor
 	);
 }
 
-static ABuildingPart* FindNearestPartOfType(UWorld* World, const FVector& Point, EBuildingPartType Type, float Radius, const AActor* IgnoreA, const AActor* IgnoreB)
+// APlayerChar
+
+APlayerChar::APlayerChar()
 {
-	if (!World) return nullptr;
+	PrimaryActorTick.bCanEverTick = true;
 
-	ABuildingPart* Best = nullptr;
-	float BestDistSq = FMath::Square(Radius);
+	PlayerCamComp = CreateDefaultSubobject<UCameraComponent>(TEXT("First Person Cam"));
+	PlayerCamComp->SetupAttachment(GetMesh(), FName("head"));
+	PlayerCamComp->bUsePawnControlRotation = true;
 
-	for (TActorIterator<ABuildingPart> It(World); It; ++It)
-	{
-		ABuildingPart* P = *It;
-		if (!P || P == IgnoreA || P == IgnoreB) continue;
-		if (P->PartType != Type) continue;
+	ViewQuery = CreateDefaultSubobject<UViewQueryComponent>(TEXT("View Query"));
 
-		const float D = FVector::DistSquared(P->GetActorLocation(), Point);
-		if (D < BestDistSq)
-		{
-			BestDistSq = D;
-			Best = P;
-		}
-	}
-	return Best;
+	InputReplay = CreateDefaultSubobject<UInputReplayComponent>(TEXT("Input Replay"));
+
+	BuildJournal = CreateDefaultSubobject<UBuildJournalComponent>(TEXT("Build Journal"));
+
+	BuildingArray.SetNum(3);
+	ResourcesArray.SetNum(3);
+	ResourcesNameArray.Add(TEXT("Wood"));
+	ResourcesNameArray.Add(TEXT("Stone"));
+	ResourcesNameArray.Add(TEXT("Berry"));
 }
 
-// Floors snap to other floors
-static FVector SnapFloorToFloor(const ABuildingPart* TargetFloor, const FVector& PointWS, const FVector& MyExtentsWS)
+void APlayerChar::BeginPlay()
 {
-	const FTransform TF = TargetFloor->GetActorTransform();
-	const FVector Local = TF.InverseTransformPosition(PointWS);
-	const FVector TargetExt = GetMeshExtentsWS(TargetFloor);
-
-	const float DistToXEdge = TargetExt.X - FMath::Abs(Local.X);
-	const float DistToYEdge = TargetExt.Y - FMath::Abs(Local.Y);
+	Super::BeginPlay();
 
-	FVector SnappedLocal = FVector::ZeroVector;
+	FTimerHandle StatsTimerHandle;
+	GetWorld()->GetTimerManager().SetTimer(StatsTimerHandle, this, &APlayerChar::DecreaseStats, 1.0f, true);
 
-	if (DistToXEdge < DistToYEdge)
+	if (objWidget)
 	{
-		const float Sign = (Local.X >= 0.f) ? 1.f : -1.f;
-		SnappedLocal.X = Sign * (TargetExt.X + MyExtentsWS.X);
-		SnappedLocal.Y = 0.f;
+		objWidget->UpdatebuildObj(0.0f);
+		objWidget->UpdatematOBJ(0.0f);
 	}
-	else
+}
+
+void APlayerChar::PostLoad()
+{
+	Super::PostLoad();
+
+	// Blueprints saved before the soft reference still hold the class in the old property
+	if (DefaultBuildPartClass.IsNull() && BuildPartClass)
 	{
-		const float Sign = (Local.Y >= 0.f) ? 1.f : -1.f;
-		SnappedLocal.Y = Sign * (TargetExt.Y + MyExtentsWS.Y);
-		SnappedLocal.X = 0.f;
+		DefaultBuildPartClass = BuildPartClass.Get();
 	}
-
-	SnappedLocal.Z = 0.f;
-	return TF.TransformPosition(SnappedLocal);
 }
 
-// Walls snap to nearest floor edge
-static FTransform SnapWallToFloor(const ABuildingPart* Floor, const FVector& PointWS, const FVector& WallExtWS)
+void APlayerChar::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
-	const FTransform TF = Floor->GetActorTransform();
-	const FVector Local = TF.InverseTransformPosition(PointWS);
-	const FVector FloorExt = GetMeshExtentsWS(Floor);
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	const float DistToXEdge = FloorExt.X - FMath::Abs(Local.X);
-	const float DistToYEdge = FloorExt.Y - FMath::Abs(Local.Y);
+	DOREPLIFETIME_CONDITION(APlayerChar, ResourcesArray, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(APlayerChar, BuildingArray, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(APlayerChar, objectsBuilt, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(APlayerChar, matsCollected, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(APlayerChar, CraftQueue, COND_OwnerOnly);
+}
 
-	FVector WallLocal(0.f, 0.f, 0.f);
-	FRotator WallRot = TF.Rotator();
-	WallRot.Pitch = 0.f;
-	WallRot.Roll = 0.f;
+void APlayerChar::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
 
-	if (DistToXEdge < DistToYEdge)
+#if !UE_SERVER
+	if (playerUI)
 	{
-		// East/West edge
-		const float Sign = (Local.X >= 0.f) ? 1.f : -1.f;
-		WallLocal.X = Sign * FloorExt.X; 
-		WallLocal.Y = 0.f;
-		WallRot.Yaw += 90.f;
+		playerUI->UpdateBars(Health, Hunger, Stamina);
 	}
-	else
+#endif
+
+	if (bHarvestHeld && !isBuilding)
 	{
-		// North/South edge
-		const float Sign = (Local.Y >= 0.f) ? 1.f : -1.f;
-		WallLocal.Y = Sign * FloorExt.Y; 
-		WallLocal.X = 0.f;
+		HarvestCooldown -= DeltaTime;
+		if (HarvestCooldown <= 0.f)
+		{
+			// A frame longer than the interval still swings only once
+			const UHarvestSubsystem* Harvest = GetWorld()->GetSubsystem<UHarvestSubsystem>();
+			HarvestCooldown = FMath::Max(HarvestCooldown + 1.f / FMath::Max(Harvest ? Harvest->HarvestRate : 1.f, 0.1f), 0.f);
+			HarvestSwing();
+		}
 	}
 
-	const float FloorTopWS = Floor->GetActorLocation().Z + FloorExt.Z;
+	// Only the owning client solves the preview. The server just validates commits.
+	// Under load the preview is solved on fewer frames; the commit is validated anyway.
+	const float SolveScale = UFrameBudgetSubsystem::GetScale(GetWorld(), EFrameBudgetKnob::PreviewSolve);
+	const int32 SolveInterval = FMath::RoundToInt(1.f / FMath::Max(SolveScale, 0.01f));
+
+	if (isBuilding && spawnedPart && IsLocallyControlled() && ++PreviewSolveCounter >= SolveInterval)
+	{
+		PreviewSolveCounter = 0;
 
-	constexpr float WallZBias = 15.0f;
+		const FViewQueryResult& View = ViewQuery->GetViewHit();
 
-	const float WallCenterZ = FloorTopWS + WallExtWS.Z - WallZBias;
+		// A result shared from before the preview spawned can still hit the preview itself
+		const bool bHit = View.bHit && View.Hit.GetActor() != spawnedPart;
+		const FVector AimPoint = bHit ? View.Hit.Location : View.Start + View.Direction * 400.f;
 
-	const FVector WallCenterWS = TF.TransformPosition(WallLocal);
+		FTransform DesiredT;
+		const bool bValid = SolvePlacement(spawnedPart, AimPoint, DesiredT);
 
-	FTransform Out;
-	Out.SetLocation(FVector(WallCenterWS.X, WallCenterWS.Y, WallCenterZ));
-	Out.SetRotation(WallRot.Quaternion());
-	Out.SetScale3D(FVector(1.f));
-	return Out;
+		spawnedPart->SetActorTransform(DesiredT);
+		spawnedPart->SetPreviewValid(bValid);
+	}
 }
 
-// APlayerChar
+const FCompiledSnapTable& APlayerChar::GetSnapTable() const
+{
+	return SnapRules ? SnapRules->GetTable() : GetDefault<UBuildingSnapRules>()->GetTable();
+}
 
-APlayerChar::APlayerChar()
+bool APlayerChar::SolvePlacement(ABuildingPart* Part, const FVector& AimPoint, FTransform& DesiredT) const
 {
-	PrimaryActorTick.bCanEverTick = true;
+	const FCompiledSnapTable& Table = GetSnapTable();
+	const int32 MyType = (int32)Part->PartType;
+	const FVector MyExt = GetMeshExtentsWS(Part);
+	const FVector MyScale = Part->GetActorScale3D();
 
-	PlayerCamComp = CreateDefaultSubobject<UCameraComponent>(TEXT("First Person Cam"));
-	PlayerCamComp->SetupAttachment(GetMesh(), FName("head"));
-	PlayerCamComp->bUsePawnControlRotation = true;
+	FRotator KeepRot = Part->GetActorRotation();
+	KeepRot.Pitch = 0.f;
+	KeepRot.Roll = 0.f;
 
-	BuildingArray.SetNum(3);
-	ResourcesArray.SetNum(3);
-	ResourcesNameArray.Add(TEXT("Wood"));
-	ResourcesNameArray.Add(TEXT("Stone"));
-	ResourcesNameArray.Add(TEXT("Berry"));
-}
+	DesiredT = FTransform(KeepRot, AimPoint, MyScale);
 
-void APlayerChar::BeginPlay()
-{
-	Super::BeginPlay();
+	if (MyType >= Table.NumTypes())
+	{
+		return false;
+	}
 
-	FTimerHandle StatsTimerHandle;
-	GetWorld()->GetTimerManager().SetTimer(StatsTimerHandle, this, &APlayerChar::DecreaseStats, 1.0f, true);
+	// Ground placement gives the point snapping searches from
+	const bool bGroundType = Table.IsGroundType(MyType);
+	FVector SearchPoint = AimPoint;
+	bool bGroundFits = true;
 
-	if (objWidget)
+	const ULandscapeHeightSubsystem* Heights = GetWorld()->GetSubsystem<ULandscapeHeightSubsystem>();
+	const FVector2D HalfFootprint(Part->GetLocalExtents() * MyScale.GetAbs());
+
+	FCollisionQueryParams GroundParams;
+	GroundParams.AddIgnoredActor(this);
+	GroundParams.AddIgnoredActor(Part);
+
+	if (bGroundType)
 	{
-		objWidget->UpdatebuildObj(0.0f);
-		objWidget->UpdatematOBJ(0.0f);
+		FFootprintHeights Ground;
+		if (Heights && Heights->SampleGround(AimPoint, HalfFootprint, KeepRot.Yaw, GroundParams, Ground))
+		{
+			// Sink into high spots a little, and refuse slopes that leave a gap under the low side
+			const float GroundZ = FMath::Max(Ground.Average, Ground.Max - MaxFoundationPenetration);
+			bGroundFits = FoundationFits(Ground, GroundZ);
+			SearchPoint.Z = GroundZ + MyExt.Z;
+		}
+		else
+		{
+			bGroundFits = false;
+		}
+
+		DesiredT.SetLocation(SearchPoint);
 	}
-}
 
-void APlayerChar::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
+	const UBuildingRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UBuildingRegistrySubsystem>();
+	if (!Registry) return false;
 
-	if (playerUI)
+	// Snap targets are searched in a smaller radius under load. Support checks below keep the full radius.
+	const float SnapSearchRadius = SnapRadius * UFrameBudgetSubsystem::GetScale(GetWorld(), EFrameBudgetKnob::SnapRadius);
+
+	// Nearest part of each target type, searched at most once per solve
+	TArray<FBuildingPartHandle, TInlineAllocator<8>> NearestByType;
+	NearestByType.SetNum(Table.NumTypes());
+	uint32 SearchedMask = 0;
+
+	const FCompiledSnapCandidate* Best = nullptr;
+	FBuildingPartHandle BestTarget;
+	FTransform BestSocket;
+	float BestDistSq = TNumericLimits<float>::Max();
+
+	for (const FCompiledSnapCandidate& Candidate : Table.GetCandidates(MyType))
 	{
-		playerUI->UpdateBars(Health, Hunger, Stamina);
+		if (!(SearchedMask & (1u << Candidate.TargetType)))
+		{
+			SearchedMask |= 1u << Candidate.TargetType;
+			NearestByType[Candidate.TargetType] = Registry->FindNearest(SearchPoint, (EBuildingPartType)Candidate.TargetType, SnapSearchRadius);
+		}
+
+		const FBuildingPartHandle Target = NearestByType[Candidate.TargetType];
+		if (!Target.IsValid()) continue;
+
+		const FTransform SocketT = Registry->GetSnapTransform(Target, Candidate.TargetSocket);
+		const float DistSq = FVector::DistSquared(SocketT.GetLocation(), SearchPoint);
+		if (DistSq < BestDistSq)
+		{
+			BestDistSq = DistSq;
+			Best = &Candidate;
+			BestTarget = Target;
+			BestSocket = SocketT;
+		}
 	}
 
-	if (isBuilding && spawnedPart)
+	// Nothing to snap to
+	if (!Best)
 	{
-		const float TraceDist = 2000.f;
-		const float SnapRadius = 300.f;
+		if (!bGroundType || !bGroundFits) return false;
 
-		const FVector CamStart = PlayerCamComp->GetComponentLocation();
-		const FVector CamEnd = CamStart + PlayerCamComp->GetForwardVector() * 800.f;
+		return !OverlapsBlocking(GetWorld(), this, Part, DesiredT, MyExt * 0.98f);
+	}
 
-		FHitResult Hit;
-		FCollisionQueryParams Params;
-		Params.AddIgnoredActor(this);
-		Params.AddIgnoredActor(spawnedPart);
-		Params.bTraceComplex = false;
+	FRotator Rotation = KeepRot;
+	switch (Best->Rotation)
+	{
+	case ESnapRotation::Target:
+		Rotation = FRotator(0.f, Registry->GetStore().Transform[Registry->ToDense(BestTarget)].Rotator().Yaw + Best->YawOffset, 0.f);
+		break;
 
-		const bool bHit = GetWorld()->LineTraceSingleByChannel(Hit, CamStart, CamEnd, ECC_Visibility, Params);
-		const FVector AimPoint = bHit ? Hit.Location : (CamStart + PlayerCamComp->GetForwardVector() * 400.f);
+	case ESnapRotation::Socket:
+		Rotation = FRotator(0.f, BestSocket.Rotator().Yaw + Best->YawOffset, 0.f);
+		break;
 
-		const EBuildingPartType MyType = spawnedPart->PartType;
-		const FVector MyExt = GetMeshExtentsWS(spawnedPart);
+	default:
+		break;
+	}
 
-		FTransform DesiredT = spawnedPart->GetActorTransform();
-		DesiredT.SetScale3D(spawnedPart->GetActorScale3D());
+	// Put the part's socket on the target socket
+	const FQuat Q = Rotation.Quaternion();
+	const FVector PartSocket = Part->GetSnapRelativeTransform(Best->PartSocket).GetLocation() * MyScale;
+	FVector Location = BestSocket.GetLocation() + Q.RotateVector(Best->Offset - PartSocket);
 
-		bool bValid = true;
+	DesiredT.SetRotation(Q);
+	DesiredT.SetLocation(Location);
 
-		// ---------- FLOORS ----------
-		if (MyType == EBuildingPartType::Floor)
-		{
-			FHitResult GroundHit;
-			const FVector GroundStart(AimPoint.X, AimPoint.Y, AimPoint.Z + 500.f);
-			const FVector GroundEnd(AimPoint.X, AimPoint.Y, AimPoint.Z - TraceDist);
-
-			const bool bGround = GetWorld()->LineTraceSingleByChannel(GroundHit, GroundStart, GroundEnd, ECC_Visibility, Params);
-
-			FVector FloorCenter = bGround ? GroundHit.Location : AimPoint;
-			FloorCenter.Z += MyExt.Z;
-
-			// Snap floor to floor
-			if (ABuildingPart* NearFloor = FindNearestPartOfType(GetWorld(), FloorCenter, EBuildingPartType::Floor, SnapRadius, this, spawnedPart))
-			{
-				const FVector Snapped = SnapFloorToFloor(NearFloor, FloorCenter, MyExt);
-				FloorCenter.X = Snapped.X;
-				FloorCenter.Y = Snapped.Y;
-				FloorCenter.Z = NearFloor->GetActorLocation().Z; 
-			}
-
-			FRotator R = spawnedPart->GetActorRotation();
-			R.Pitch = 0.f;
-			R.Roll = 0.f;
-			DesiredT.SetRotation(R.Quaternion());
-			DesiredT.SetLocation(FloorCenter);
-
-			if (bGround)
-			{
-				const float BottomZ = FloorCenter.Z - MyExt.Z;
-				const float Penetration = GroundHit.Location.Z - BottomZ;
-				const float MaxAllowedPenetration = 10.f;
-				if (Penetration > MaxAllowedPenetration)
-				{
-					bValid = false;
-				}
-			}
-
-			// Overlap check
-			if (OverlapsBlocking(GetWorld(), this, spawnedPart, DesiredT, MyExt * 0.98f))
-			{
-				bValid = false;
-			}
-		}
+	if (Best->RestOnType != INDEX_NONE)
+	{
+		const FBuildingPartHandle Support = Registry->FindNearest(Location, (EBuildingPartType)Best->RestOnType, SnapRadius);
+		if (!Support.IsValid()) return false;
+
+		Location.Z = Registry->GetSnapTransform(Support, ESnapPoint::Top).GetLocation().Z - PartSocket.Z + Best->Offset.Z;
+		DesiredT.SetLocation(Location);
+	}
 
-		// WALLS 
-		else if (MyType == EBuildingPartType::Wall)
+	for (int32 Type = 0; Type < Table.NumTypes(); ++Type)
+	{
+		if ((Best->SupportMask & (1u << Type)) && !Registry->FindNearest(Location, (EBuildingPartType)Type, SnapRadius).IsValid())
 		{
-			ABuildingPart* NearFloor = FindNearestPartOfType(GetWorld(), AimPoint, EBuildingPartType::Floor, SnapRadius, this, spawnedPart);
-			if (!NearFloor)
-			{
-				bValid = false;
-				DesiredT.SetLocation(AimPoint);
-			}
-			else
-			{
-				DesiredT = SnapWallToFloor(NearFloor, AimPoint, MyExt);
-				DesiredT.SetScale3D(spawnedPart->GetActorScale3D());
-
-				if (OverlapsBlocking(GetWorld(), this, spawnedPart, DesiredT, MyExt * 0.98f))
-				{
-					bValid = false;
-				}
-			}
+			return false;
 		}
+	}
 
-		// CEILINGS
-		else if (MyType == EBuildingPartType::Ceiling)
+	// A foundation snapped to another still has to stand on the ground where it ends up
+	if (bGroundType)
+	{
+		FFootprintHeights Ground;
+		if (!Heights || !Heights->SampleGround(Location, HalfFootprint, Rotation.Yaw, GroundParams, Ground)
+			|| !FoundationFits(Ground, Location.Z - MyExt.Z))
 		{
-			ABuildingPart* NearWall = FindNearestPartOfType(GetWorld(), AimPoint, EBuildingPartType::Wall, SnapRadius, this, spawnedPart);
-			ABuildingPart* NearFloor = FindNearestPartOfType(GetWorld(), AimPoint, EBuildingPartType::Floor, SnapRadius, this, spawnedPart);
-
-			if (!NearWall || !NearFloor)
-			{
-				bValid = false;
-				DesiredT.SetLocation(AimPoint);
-			}
-			else
-			{
-				const FVector WallExt = GetMeshExtentsWS(NearWall);
-				const float WallTopWS = NearWall->GetActorLocation().Z + WallExt.Z;
-
-				FVector CeilingCenter = NearFloor->GetActorLocation();
-				CeilingCenter.Z = WallTopWS + MyExt.Z;
-
-				FRotator R = NearWall->GetActorRotation();
-				R.Pitch = 0.f;
-				R.Roll = 0.f;
-
-				DesiredT.SetLocation(CeilingCenter);
-				DesiredT.SetRotation(R.Quaternion());
-				DesiredT.SetScale3D(spawnedPart->GetActorScale3D());
-
-				if (OverlapsBlocking(GetWorld(), this, spawnedPart, DesiredT, MyExt * 0.98f))
-				{
-					bValid = false;
-				}
-			}
+			return false;
 		}
+	}
 
-		else
+	return !OverlapsBlocking(GetWorld(), this, Part, DesiredT, MyExt * 0.98f);
+}
+
+bool APlayerChar::FoundationFits(const FFootprintHeights& Ground, float BottomZ) const
+{
+	// A centimetre of slack covers rounding between the client's solve and the server's check
+	return Ground.Max - BottomZ <= MaxFoundationPenetration + 1.f && BottomZ - Ground.Min <= MaxFoundationGap + 1.f;
+}
+
+bool APlayerChar::ValidatePlacement(ABuildingPart* Part, const FTransform& T, TArray<FBuildingPartHandle>* OutSupports) const
+{
+	if (!Part) return false;
+
+	const UBuildingRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UBuildingRegistrySubsystem>();
+	if (!Registry) return false;
+
+	const FCompiledSnapTable& Table = GetSnapTable();
+	const int32 MyType = (int32)Part->PartType;
+	if (MyType >= Table.NumTypes()) return false;
+
+	const FVector MyExt = GetMeshExtentsWS(Part);
+
+	// Same rules as the preview solve. The part's centre can be up to its own size further
+	// from a target than the socket was.
+	FPlacementSupports Supports;
+	const bool bSupported = UBuildingPlacementSubsystem::FindSupports(*Registry, Table, MyType, T, Part->GetLocalExtents(), SnapRadius + MyExt.GetMax(), Supports);
+
+	if (!bSupported || OverlapsBlocking(GetWorld(), this, Part, T, MyExt * 0.98f))
+	{
+		return false;
+	}
+
+	if (Table.IsGroundType(MyType))
+	{
+		const ULandscapeHeightSubsystem* Heights = GetWorld()->GetSubsystem<ULandscapeHeightSubsystem>();
+		const FVector2D HalfFootprint(Part->GetLocalExtents() * T.GetScale3D().GetAbs());
+
+		FCollisionQueryParams GroundParams;
+		GroundParams.AddIgnoredActor(this);
+		GroundParams.AddIgnoredActor(Part);
+
+		FFootprintHeights Ground;
+		if (!Heights || !Heights->SampleGround(T.GetLocation(), HalfFootprint, T.Rotator().Yaw, GroundParams, Ground)
+			|| !FoundationFits(Ground, T.GetLocation().Z - MyExt.Z))
 		{
-			bValid = false;
-			DesiredT.SetLocation(AimPoint);
+			return false;
 		}
+	}
 
-		spawnedPart->SetActorTransform(DesiredT);
-		spawnedPart->SetPreviewValid(bValid);
+	if (OutSupports)
+	{
+		*OutSupports = Supports;
 	}
+	return true;
 }
 
 void APlayerChar::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
@@ -317,7 +364,14 @@ void APlayerChar::SetupPlayerInputComponent(UInputComponent* PlayerInputComponen
 	PlayerInputComponent->BindAction("JumpEvent", IE_Pressed, this, &APlayerChar::StartJump);
 	PlayerInputComponent->BindAction("JumpEvent", IE_Released, this, &APlayerChar::StopJump);
 	PlayerInputComponent->BindAction("Interact", IE_Pressed, this, &APlayerChar::FindObject);
+	PlayerInputComponent->BindAction("Interact", IE_Released, this, &APlayerChar::StopInteract);
 	PlayerInputComponent->BindAction("RotPart", IE_Pressed, this, &APlayerChar::RotateBuilding);
+	PlayerInputComponent->BindAction("Demolish", IE_Pressed, this, &APlayerChar::DemolishBuilding);
+	PlayerInputComponent->BindAction("Undo", IE_Pressed, this, &APlayerChar::UndoBuilding);
+	PlayerInputComponent->BindAction("Redo", IE_Pressed, this, &APlayerChar::RedoBuilding);
+
+	// Input is only set up for the player controlling this pawn here
+	InputReplay->OnLocallyControlled();
 }
 
 void APlayerChar::MoveForward(float axisValue)
@@ -334,69 +388,62 @@ void APlayerChar::MoveRight(float axisValue)
 
 void APlayerChar::StartJump()
 {
+	InputReplay->NoteAction(EReplayAction::JumpPressed);
 	bPressedJump = true;
 }
 
 void APlayerChar::StopJump()
 {
+	InputReplay->NoteAction(EReplayAction::JumpReleased);
 	bPressedJump = false;
 }
 
-void APlayerChar::FindObject()
+void APlayerChar::HarvestSwing()
 {
-	FHitResult HitResult;
+	const UHarvestSubsystem* Harvest = GetWorld()->GetSubsystem<UHarvestSubsystem>();
+	const UResourceNodeSubsystem* Nodes = GetWorld()->GetSubsystem<UResourceNodeSubsystem>();
+	if (!Harvest || !Nodes || Stamina < Harvest->StaminaPerSwing) return;
+
+	const FViewQueryResult& View = ViewQuery->GetViewHit();
+	const AResource_M* HitResource = View.bHit ? Cast<AResource_M>(View.Hit.GetActor()) : nullptr;
+	const FResourceNodeRecord* Node = HitResource ? Nodes->GetNode(HitResource->NodeId) : nullptr;
+	if (!Node) return;
+
+#if !UE_SERVER
+	// The hit is marked straight away; the materials arrive once the server has resolved the swing
+	if (IsLocallyControlled())
+	{
+		UGameplayStatics::SpawnDecalAtLocation(GetWorld(), hitDecal, FVector(10.0f, 10.0f, 10.0f), View.Hit.Location, FRotator(-90, 0, 0), 2.0f);
+	}
+#endif
 
-	FVector StartLocation = PlayerCamComp->GetComponentLocation();
-	FVector Direction = PlayerCamComp->GetForwardVector() * 800.0f;
-	FVector EndLocation = StartLocation + Direction;
+	ServerHarvestSwing(Node->Type, Node->Location, View.Hit.Location);
+}
 
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(this);
-	QueryParams.bTraceComplex = true;
-	QueryParams.bReturnFaceIndex = true;
+void APlayerChar::FindObject()
+{
+	InputReplay->NoteAction(EReplayAction::Interact);
 
 	if (!isBuilding)
 	{
-		if (GetWorld()->LineTraceSingleByChannel(HitResult, StartLocation, EndLocation, ECC_Visibility, QueryParams))
-		{
-			AResource_M* HitResource = Cast<AResource_M>(HitResult.GetActor());
-
-			if (Stamina >= 5.0f)
-			{
-				if (HitResource)
-				{
-					const FString hitName = HitResource->resourceName;
-					const int resourceValue = HitResource->resourceAmount;
-
-					HitResource->totalResource = HitResource->totalResource - resourceValue;
-
-					if (HitResource->totalResource >= resourceValue)
-					{
-						GiveResource(resourceValue, hitName);
-
-						matsCollected = matsCollected + resourceValue;
-						if (objWidget) objWidget->UpdatematOBJ(matsCollected);
-
-						UGameplayStatics::SpawnDecalAtLocation(
-							GetWorld(), hitDecal, FVector(10.0f, 10.0f, 10.0f),
-							HitResult.Location, FRotator(-90, 0, 0), 2.0f
-						);
-
-						SetStamina(-5.0f);
-					}
-					else
-					{
-						HitResource->Destroy();
-					}
-				}
-			}
-		}
+		// Swings repeat from Tick while interact stays held
+		const UHarvestSubsystem* Harvest = GetWorld()->GetSubsystem<UHarvestSubsystem>();
+		bHarvestHeld = true;
+		HarvestCooldown = Harvest ? 1.f / FMath::Max(Harvest->HarvestRate, 0.1f) : 0.f;
+
+		HarvestSwing();
 	}
-	else
+	else if (spawnedPart)
 	{
+		// The server spawns the real part, which replicates back. A listen server host goes
+		// through the same batch as every client, so the host cannot win a contested spot
+		// just by skipping the queue.
+		ServerCommitPlacement(spawnedPart->GetClass(), spawnedPart->GetActorTransform(), SpawnedBuildingId);
+		spawnedPart->Destroy();
+		spawnedPart = nullptr;
+
 		isBuilding = false;
-		objectsBuilt = objectsBuilt + 1.0f;
-		if (objWidget) objWidget->UpdatebuildObj(objectsBuilt);
+		ViewQuery->SetIgnoredActor(nullptr);
 	}
 }
 
@@ -428,6 +475,14 @@ void APlayerChar::DecreaseStats()
 	{
 		SetHealth(-3.0f);
 	}
+
+	FGameplayTelemetry::Record(ETelemetryEvent::Vitals, FGameplayTelemetry::PlayerId(this), 0, 0, FVector3f(Health, Hunger, Stamina));
+}
+
+void APlayerChar::StopInteract()
+{
+	InputReplay->NoteAction(EReplayAction::InteractReleased);
+	bHarvestHeld = false;
 }
 
 void APlayerChar::GiveResource(int32 amount, FString resourceType)
@@ -450,37 +505,117 @@ void APlayerChar::GiveResource(int32 amount, FString resourceType)
 	}
 }
 
+void APlayerChar::AddResources(TConstArrayView<int32> Amounts)
+{
+	const int32 Num = FMath::Min(Amounts.Num(), ResourcesArray.Num());
+	for (int32 i = 0; i < Num; ++i)
+	{
+		ResourcesArray[i] += Amounts[i];
+	}
+}
+
+void APlayerChar::AddMaterialsCollected(int32 Amount)
+{
+	matsCollected += Amount;
+	if (objWidget) objWidget->UpdatematOBJ(matsCollected);
+}
+
+void APlayerChar::NotePartBuilt(const ABuildingPart* Part)
+{
+	objectsBuilt += 1.0f;
+	if (objWidget) objWidget->UpdatebuildObj(objectsBuilt);
+
+	// Telemetry sees the same event, but never feeds back into the count
+	FGameplayTelemetry::Record(ETelemetryEvent::Build, FGameplayTelemetry::PlayerId(this), 1,
+		(uint8)Part->PartType, FVector3f(Part->GetActorLocation()));
+}
+
+void APlayerChar::OnRep_Objectives()
+{
+	if (objWidget)
+	{
+		objWidget->UpdatebuildObj(objectsBuilt);
+		objWidget->UpdatematOBJ(matsCollected);
+	}
+}
+
 void APlayerChar::UpdateResources(float woodAmount, float stoneAmount, FString buildingObject)
 {
-	if (woodAmount <= ResourcesArray[0])
+	// Crafting is timed now; this queues one part and pays for it up front
+	if (!HasAuthority())
 	{
-		if (stoneAmount <= ResourcesArray[1])
-		{
-			ResourcesArray[0] = ResourcesArray[0] - woodAmount;
-			ResourcesArray[1] = ResourcesArray[1] - stoneAmount;
-
-			if (buildingObject == "Wall")
-			{
-				BuildingArray[0] = BuildingArray[0] + 1;
-			}
-
-			if (buildingObject == "Floor")
-			{
-				BuildingArray[1] = BuildingArray[1] + 1;
-			}
-
-			if (buildingObject == "Ceiling")
-			{
-				BuildingArray[2] = BuildingArray[2] + 1;
-			}
-		}
+		ServerUpdateResources(buildingObject);
+		return;
+	}
+
+	UCraftingSubsystem* Crafting = GetWorld()->GetSubsystem<UCraftingSubsystem>();
+	if (!Crafting) return;
+
+	const int32 RecipeIndex = Crafting->FindRecipe(FName(*buildingObject));
+	if (RecipeIndex == INDEX_NONE)
+	{
+		UE_LOG(LogGAM312, Warning, TEXT("No crafting recipe named %s"), *buildingObject);
+		return;
+	}
+
+	// Costs come from the recipe, never from the caller
+	Crafting->QueueRecipe(this, RecipeIndex, 1);
+}
+
+bool APlayerChar::ServerUpdateResources_Validate(const FString& buildingObject)
+{
+	return true;
+}
+
+void APlayerChar::ServerUpdateResources_Implementation(const FString& buildingObject)
+{
+	UpdateResources(0.f, 0.f, buildingObject);
+}
+
+bool APlayerChar::ServerQueueRecipe_Validate(FName Recipe, int32 Count)
+{
+	return Count > 0;
+}
+
+void APlayerChar::ServerQueueRecipe_Implementation(FName Recipe, int32 Count)
+{
+	if (UCraftingSubsystem* Crafting = GetWorld()->GetSubsystem<UCraftingSubsystem>())
+	{
+		Crafting->QueueRecipe(this, Crafting->FindRecipe(Recipe), Count);
+	}
+}
+
+void APlayerChar::SetCraftQueue(const FCraftQueueSummary& Summary)
+{
+	CraftQueue = Summary;
+	OnCraftQueueUpdated.Broadcast();
+}
+
+void APlayerChar::OnRep_CraftQueue()
+{
+	OnCraftQueueUpdated.Broadcast();
+}
+
+bool APlayerChar::ServerCancelCraftOrder_Validate(int32 OrderIndex)
+{
+	return true;
+}
+
+void APlayerChar::ServerCancelCraftOrder_Implementation(int32 OrderIndex)
+{
+	if (UCraftingSubsystem* Crafting = GetWorld()->GetSubsystem<UCraftingSubsystem>())
+	{
+		Crafting->CancelOrder(this, OrderIndex);
 	}
 }
 
 void APlayerChar::SpawnBuilding(int buildingID, bool& isSuccess)
 {
+	InputReplay->NoteAction(EReplayAction::SpawnBuilding, buildingID);
 	isSuccess = false;
 
+	const double StartTime = FPlatformTime::Seconds();
+
 	if (isBuilding)
 	{
 		return;
@@ -496,37 +631,183 @@ void APlayerChar::SpawnBuilding(int buildingID, bool& isSuccess)
 		return;
 	}
 
-	if (!BuildPartClass)
+	const TSoftClassPtr<ABuildingPart> SoftClass = GetBuildPartClass(buildingID);
+
+	UClass* PartClass = SoftClass.Get();
+	if (!PartClass && !SoftClass.IsNull())
 	{
-		return;
+		// Preloading should have made this resident; loading here hitches
+		UE_LOG(LogGAM312, Warning, TEXT("Building class %s was not preloaded"), *SoftClass.ToString());
+		PartClass = SoftClass.LoadSynchronous();
 	}
 
-	FActorSpawnParameters SpawnParams;
-	SpawnParams.Owner = this;
-	SpawnParams.Instigator = GetInstigator();
-	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	if (!PartClass)
+	{
+		return;
+	}
 
 	const FVector StartLocation = PlayerCamComp->GetComponentLocation();
 	const FVector EndLocation = StartLocation + (PlayerCamComp->GetForwardVector() * 400.0f);
 	const FRotator SpawnRot(0.f, 0.f, 0.f);
 
-	ABuildingPart* NewPart = GetWorld()->SpawnActor<ABuildingPart>(BuildPartClass, EndLocation, SpawnRot, SpawnParams);
+	// The preview is local to whoever builds it. On a listen server it would otherwise
+	// replicate to every client at wherever it was spawned.
+	ABuildingPart* NewPart = GetWorld()->SpawnActorDeferred<ABuildingPart>(PartClass, FTransform(SpawnRot, EndLocation), this, GetInstigator(),
+		ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
 	if (!NewPart)
 	{
 		return;
 	}
+	NewPart->SetReplicates(false);
+	NewPart->FinishSpawning(FTransform(SpawnRot, EndLocation));
 
 	spawnedPart = NewPart;
+	SpawnedBuildingId = buildingID;
+	ViewQuery->SetIgnoredActor(NewPart);
 	isBuilding = true;
-	BuildingArray[buildingID] -= 1;
+
+	// The kit is only spent by the server once the part is placed
+
+	if (!bHasBuilt)
+	{
+		bHasBuilt = true;
+		UE_LOG(LogGAM312, Log, TEXT("First building spawn took %.2f ms"), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+	}
 
 	isSuccess = true;
 }
 
 void APlayerChar::RotateBuilding()
 {
+	InputReplay->NoteAction(EReplayAction::RotatePart);
+
 	if (isBuilding && spawnedPart)
 	{
 		spawnedPart->AddActorWorldRotation(FRotator(0, 90, 0));
 	}
 }
+
+void APlayerChar::DemolishBuilding()
+{
+	InputReplay->NoteAction(EReplayAction::Demolish);
+
+	if (isBuilding) return;
+
+	const FViewQueryResult& View = ViewQuery->GetViewHit();
+	ABuildingPart* Part = View.bHit ? UBuildingChunkSubsystem::ResolveHitPart(View.Hit) : nullptr;
+	if (!Part || Part->GetOwner() != this) return;
+
+	if (HasAuthority())
+	{
+		DemolishPart(Part);
+	}
+	else
+	{
+		ServerDemolishBuilding(Part);
+	}
+}
+
+void APlayerChar::DemolishPart(ABuildingPart* Part)
+{
+	const int32 BuildingId = FindBuildingId(Part->GetClass());
+
+	BuildJournal->RecordRemove(Part, BuildingId);
+	if (BuildingArray.IsValidIndex(BuildingId))
+	{
+		BuildingArray[BuildingId] += 1;
+	}
+	Part->Destroy();
+}
+
+void APlayerChar::UndoBuilding()
+{
+	InputReplay->NoteAction(EReplayAction::Undo);
+	BuildJournal->Undo();
+}
+
+void APlayerChar::RedoBuilding()
+{
+	InputReplay->NoteAction(EReplayAction::Redo);
+	BuildJournal->Redo();
+}
+
+int32 APlayerChar::FindBuildingId(const UClass* PartClass) const
+{
+	for (int32 i = 0; i < BuildingArray.Num(); ++i)
+	{
+		if (GetBuildPartClass(i).Get() == PartClass)
+		{
+			return i;
+		}
+	}
+	return INDEX_NONE;
+}
+
+TSoftClassPtr<ABuildingPart> APlayerChar::GetBuildPartClass(int32 BuildingId) const
+{
+	if (BuildPartClasses.IsValidIndex(BuildingId) && !BuildPartClasses[BuildingId].IsNull())
+	{
+		return BuildPartClasses[BuildingId];
+	}
+	return !DefaultBuildPartClass.IsNull() ? DefaultBuildPartClass : TSoftClassPtr<ABuildingPart>(BuildPartClass.Get());
+}
+
+bool APlayerChar::ServerDemolishBuilding_Validate(ABuildingPart* Part)
+{
+	return true;
+}
+
+void APlayerChar::ServerDemolishBuilding_Implementation(ABuildingPart* Part)
+{
+	if (Part && Part->GetOwner() == this && Part->Handle.IsValid())
+	{
+		DemolishPart(Part);
+	}
+}
+
+bool APlayerChar::ServerHarvestSwing_Validate(EResourceType Type, FVector_NetQuantize NodeLocation, FVector_NetQuantize HitLocation)
+{
+	return Type < EResourceType::Count;
+}
+
+void APlayerChar::ServerHarvestSwing_Implementation(EResourceType Type, FVector_NetQuantize NodeLocation, FVector_NetQuantize HitLocation)
+{
+	UHarvestSubsystem* Harvest = GetWorld()->GetSubsystem<UHarvestSubsystem>();
+	const UResourceNodeSubsystem* Nodes = GetWorld()->GetSubsystem<UResourceNodeSubsystem>();
+	if (!Harvest || !Nodes || Stamina < Harvest->StaminaPerSwing) return;
+
+	// No faster than the harvest rate over time; the small burst only absorbs packets arriving unevenly
+	const double Now = GetWorld()->GetTimeSeconds();
+	HarvestSwingCredit = FMath::Min(HarvestSwingCredit + (float)(Now - LastHarvestCreditTime) * FMath::Max(Harvest->HarvestRate, 0.1f), HarvestSwingBurst);
+	LastHarvestCreditTime = Now;
+	if (HarvestSwingCredit < 1.f) return;
+
+	if (FVector::DistSquared(GetActorLocation(), NodeLocation) > FMath::Square(Harvest->MaxHarvestReach)) return;
+
+	const int32 NodeId = Nodes->FindNearestNode(NodeLocation, Harvest->NodeMatchRadius, Type);
+	if (NodeId == INDEX_NONE) return;
+
+	HarvestSwingCredit -= 1.f;
+	Harvest->QueueHarvest(this, NodeId, HitLocation);
+}
+
+bool APlayerChar::ServerCommitPlacement_Validate(TSubclassOf<ABuildingPart> PartClass, const FTransform& Transform, int32 BuildingId)
+{
+	// Only a tampered client asks for a class its kit does not build
+	return PartClass != nullptr && BuildingArray.IsValidIndex(BuildingId)
+		&& GetBuildPartClass(BuildingId).ToSoftObjectPath() == FSoftObjectPath(PartClass.Get());
+}
+
+void APlayerChar::ServerCommitPlacement_Implementation(TSubclassOf<ABuildingPart> PartClass, const FTransform& Transform, int32 BuildingId)
+{
+	// Validated and placed with every other commit this tick
+	if (UBuildingPlacementSubsystem* Placement = GetWorld()->GetSubsystem<UBuildingPlacementSubsystem>())
+	{
+		Placement->QueuePlacement(this, PartClass, Transform, BuildingId);
+	}
+}
+
+void APlayerChar::ClientPlacementRejected_Implementation(EPlacementRejectReason Reason, int32 BuildingId)
+{
+	UE_LOG(LogGAM312, Log, TEXT("Placement rejected: %s"), *UEnum::GetValueAsString(Reason));
+}
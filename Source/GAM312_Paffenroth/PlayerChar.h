@@ -8,8 +8,20 @@
 #include "BuildingPart.h"
 #include "PlayerWidget.h"
 #include "ObjectiveWidget.h"
+#include "InputReplayComponent.h"
+#include "ViewQueryComponent.h"
+#include "BuildJournalComponent.h"
+#include "BuildingPlacementSubsystem.h"
+#include "ResourceNodeSubsystem.h"
+#include "CraftingSubsystem.h"
 #include "PlayerChar.generated.h"
 
+class UBuildingSnapRules;
+struct FCompiledSnapTable;
+struct FFootprintHeights;
+
+DECLARE_MULTICAST_DELEGATE(FOnCraftQueueUpdated);
+
 UCLASS()
 class GAM312_PAFFENROTH_API APlayerChar : public ACharacter
 {
@@ -23,7 +35,11 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void PostLoad() override;
+
 public:	
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
@@ -48,16 +64,32 @@ public:
 	UFUNCTION()
 		void StopJump();
 
-	// Function placeholder for object interaction
+	// Places the building preview, or starts harvesting the node in view
 	UFUNCTION()
 		void FindObject();
 
+	// Stops harvesting when interact is released
+	UFUNCTION()
+		void StopInteract();
+
 // --- Camera component --- 
 
 	// Camera component that provides the player's viewpoint
 	UPROPERTY(VisibleAnywhere)
 		UCameraComponent* PlayerCamComp;
 
+	// Shared per-frame view trace for building, interaction and the HUD
+	UPROPERTY(VisibleAnywhere)
+		UViewQueryComponent* ViewQuery;
+
+	// Records and replays this player's input for performance runs
+	UPROPERTY(VisibleAnywhere)
+		UInputReplayComponent* InputReplay;
+
+	// Undo and redo history of this player's building
+	UPROPERTY(VisibleAnywhere)
+		UBuildJournalComponent* BuildJournal;
+
 // --- Stats ---
 
 	// Property to allow the setting of player health
@@ -84,8 +116,8 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Resources")
 		int Berry = 0;
 
-	// Dynamic array tracking amounts of each resource
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Resources")
+	// Dynamic array tracking amounts of each resource. Kept by the server and replicated to the owner.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Replicated, Category = "Resources")
 		TArray<int> ResourcesArray;
 
 	// Names of each resource type
@@ -100,22 +132,69 @@ public:
 
 // --- Building System --- 
 
-	// Inventory of building system
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Building Supplies")
+	// Inventory of building system. Kept by the server and replicated to the owner.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Replicated, Category = "Building Supplies")
 		TArray<int> BuildingArray;
 	
 	// Whether the player is in building mode
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 		bool isBuilding;
 
-	// Building class to spawn
+	// Building class to spawn when no per-ID class is set. Loaded by the asset preloader.
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite)
+		TSoftClassPtr<ABuildingPart> DefaultBuildPartClass;
+
+	// Deprecated: moved to DefaultBuildPartClass on load, and still used when that is unset.
+	// Clear it once the Blueprint is resaved so the class is no longer loaded with the player.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, meta = (DeprecatedProperty, DeprecationMessage = "Use DefaultBuildPartClass"))
 		TSubclassOf<ABuildingPart> BuildPartClass;
 
+	// Building class per building ID (0 = Wall, 1 = Floor, 2 = Ceiling)
+	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite)
+		TArray<TSoftClassPtr<ABuildingPart>> BuildPartClasses;
+
 	// Currently spawned building piece
 	UPROPERTY()
 		ABuildingPart* spawnedPart;
 
+	// BuildingArray slot the current piece's kit came from
+	int32 SpawnedBuildingId = INDEX_NONE;
+
+	// Frames since the preview was last solved
+	int32 PreviewSolveCounter = 0;
+
+	// Interact is held outside build mode, so swings repeat at the harvest rate
+	bool bHarvestHeld = false;
+
+	// Seconds until the next swing while harvesting is held
+	float HarvestCooldown = 0.f;
+
+	// Swings the server will still accept from this player, refilled at the harvest rate and
+	// capped at HarvestSwingBurst, so uneven packets pass but the long-run rate cannot be beaten
+	float HarvestSwingCredit = HarvestSwingBurst;
+	double LastHarvestCreditTime = 0.0;
+	static constexpr float HarvestSwingBurst = 2.f;
+
+	// Which part types and sockets connect. Uses the built-in rules when unset.
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly)
+		UBuildingSnapRules* SnapRules;
+
+	// How far from the player the server accepts a committed part, covering the view ray and snapping
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float MaxBuildReach = 1200.0f;
+
+	// How far the preview looks for parts to snap to
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float SnapRadius = 300.0f;
+
+	// How far a foundation may sink into high ground under its footprint
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float MaxFoundationPenetration = 10.0f;
+
+	// Largest gap allowed under the low side of a foundation on a slope
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float MaxFoundationGap = 40.0f;
+
 // --- Widgets ---
 
 	// Reference to player's UI Widget
@@ -126,14 +205,16 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 		UObjectiveWidget* objWidget;
 	
-	// Tracks the total number of objects built
-	UPROPERTY()
+	// Tracks the total number of objects built. Counted by the server.
+	UPROPERTY(ReplicatedUsing = OnRep_Objectives)
 		float objectsBuilt;
 
-	// Tracks the total number of materials collected
-	UPROPERTY()
+	// Tracks the total number of materials collected. Counted by the server.
+	UPROPERTY(ReplicatedUsing = OnRep_Objectives)
 	float matsCollected;
 
+	bool bHasBuilt = false;
+
 // --- Stat functions ---
 	
 	// Adjusts the player health by a given amount
@@ -152,16 +233,57 @@ public:
 	UFUNCTION()
 		void DecreaseStats();
 
+// --- Objective functions ---
+
+	// Counts gathered materials toward the objective
+	void AddMaterialsCollected(int32 Amount);
+
+	// Counts a part the server accepted toward the objective and records it in telemetry
+	void NotePartBuilt(const ABuildingPart* Part);
+
+	// Shows replicated objective progress on the owning client
+	UFUNCTION()
+		void OnRep_Objectives();
+
 // --- Resource Functions ---
 
 	// Adds a specific resource type and amount to the player's inventory
 	UFUNCTION()
 		void GiveResource(int32 amount, FString resourceType);
 
-	// Deducts and adds building part
+	// Adds an amount of every resource type at once, indexed by EResourceType
+	void AddResources(TConstArrayView<int32> Amounts);
+
+	// Pays for and queues one building part in the crafting subsystem. The amounts are kept for
+	// existing Blueprints; the server always charges the recipe's own cost.
 	UFUNCTION(BlueprintCallable)
 		void UpdateResources(float woodAmount, float stoneAmount, FString buildingObject);
 
+	// Crafts on the server, which owns the inventory and the recipe costs
+	UFUNCTION(Server, Reliable, WithValidation)
+		void ServerUpdateResources(const FString& buildingObject);
+
+	// Queues Count of a recipe at its own cost on the server
+	UFUNCTION(Server, Reliable, WithValidation)
+		void ServerQueueRecipe(FName Recipe, int32 Count);
+
+	// Cancels one of this player's crafting orders on the server
+	UFUNCTION(Server, Reliable, WithValidation)
+		void ServerCancelCraftOrder(int32 OrderIndex);
+
+	// This player's crafting queue, kept by the crafting subsystem on the server
+	UPROPERTY(ReplicatedUsing = OnRep_CraftQueue)
+		FCraftQueueSummary CraftQueue;
+
+	// Fired on the server and the owning client whenever CraftQueue changes
+	FOnCraftQueueUpdated OnCraftQueueUpdated;
+
+	// Sets the queue summary on the server
+	void SetCraftQueue(const FCraftQueueSummary& Summary);
+
+	UFUNCTION()
+		void OnRep_CraftQueue();
+
 // Building Functions
 
 	// Spawns building part
@@ -171,4 +293,60 @@ public:
 	// Rotates building part
 	UFUNCTION()
 		void RotateBuilding();
+
+	// Removes the player's own part under the crosshair and refunds its kit
+	UFUNCTION()
+		void DemolishBuilding();
+
+	// Undoes the last placement, removal or batch
+	UFUNCTION()
+		void UndoBuilding();
+
+	// Redoes the last undone placement, removal or batch
+	UFUNCTION()
+		void RedoBuilding();
+
+	// BuildingArray slot whose kit builds a part class, or INDEX_NONE
+	int32 FindBuildingId(const UClass* PartClass) const;
+
+	// Class the kit in a BuildingArray slot builds
+	TSoftClassPtr<ABuildingPart> GetBuildPartClass(int32 BuildingId) const;
+
+	// Snap rule tables in use
+	const FCompiledSnapTable& GetSnapTable() const;
+
+	// Finds where a preview part would go for an aim point. Returns whether the spot is valid.
+	bool SolvePlacement(ABuildingPart* Part, const FVector& AimPoint, FTransform& DesiredT) const;
+
+	// Checks supports, resting height, ground and overlaps for a part at a final transform,
+	// without snapping. Optionally returns the parts it would rest on.
+	bool ValidatePlacement(ABuildingPart* Part, const FTransform& T, TArray<FBuildingPartHandle>* OutSupports = nullptr) const;
+
+	// Whether a foundation with its bottom at BottomZ neither sinks too far into the ground
+	// under it nor leaves too big a gap
+	bool FoundationFits(const FFootprintHeights& Ground, float BottomZ) const;
+
+	// Asks the server to place a part where the client's preview ended up
+	UFUNCTION(Server, Reliable, WithValidation)
+		void ServerCommitPlacement(TSubclassOf<ABuildingPart> PartClass, const FTransform& Transform, int32 BuildingId);
+
+	// Tells the player a committed placement was turned down. The server has already returned its kit.
+	UFUNCTION(Client, Reliable)
+		void ClientPlacementRejected(EPlacementRejectReason Reason, int32 BuildingId);
+
+	// Asks the server to demolish one of this player's parts
+	UFUNCTION(Server, Reliable, WithValidation)
+		void ServerDemolishBuilding(ABuildingPart* Part);
+
+	// Asks the server to swing at a resource node. Node ids differ between machines, so the
+	// node is named by its type and where it stands.
+	UFUNCTION(Server, Reliable, WithValidation)
+		void ServerHarvestSwing(EResourceType Type, FVector_NetQuantize NodeLocation, FVector_NetQuantize HitLocation);
+
+private:
+	// Demolishes a part on the authority
+	void DemolishPart(ABuildingPart* Part);
+
+	// Swings at the resource node in view, if there is stamina for it. The server grants what it yields.
+	void HarvestSwing();
 };
@@ -0,0 +1,261 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ResourceNodeSubsystem.h"
+#include "Resource_M.h"
+
+void UResourceNodeSubsystem::Deinitialize()
+{
+	Nodes.Empty();
+	Generations.Empty();
+	Grid.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UResourceNodeSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+EResourceType UResourceNodeSubsystem::ResourceTypeFromName(const FString& Name)
+{
+	if (Name == TEXT("Stone"))
+	{
+		return EResourceType::Stone;
+	}
+
+	if (Name == TEXT("Berry"))
+	{
+		return EResourceType::Berry;
+	}
+
+	return EResourceType::Wood;
+}
+
+FIntPoint UResourceNodeSubsystem::CellFor(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+int32 UResourceNodeSubsystem::ToIndex(int32 NodeId) const
+{
+	if (NodeId < 0) return INDEX_NONE;
+
+	const int32 Index = NodeId & NodeIndexMask;
+	const uint16 Generation = (uint16)(NodeId >> NodeIndexBits);
+	return Nodes.IsValidIndex(Index) && Generations[Index] == Generation ? Index : INDEX_NONE;
+}
+
+int32 UResourceNodeSubsystem::RegisterNode(const FVector& Location, EResourceType Type, int32 Total, int32 Yield, AResource_M* Actor)
+{
+	FResourceNodeRecord Record;
+	Record.Location = Location;
+	Record.Actor = Actor;
+	Record.Remaining = Total;
+	Record.Yield = Yield;
+	Record.Type = Type;
+	Record.Cell = CellFor(Location);
+
+	const int32 Index = Nodes.Add(Record);
+	check(Index <= NodeIndexMask);
+
+	// Generations start at 1 so a zeroed id never matches
+	while (Generations.Num() <= Index)
+	{
+		Generations.Add(1);
+	}
+
+	const int32 NodeId = ((int32)Generations[Index] << NodeIndexBits) | Index;
+	Grid.FindOrAdd(Record.Cell).Add(NodeId);
+	return NodeId;
+}
+
+void UResourceNodeSubsystem::UnregisterNode(int32 NodeId)
+{
+	const int32 Index = ToIndex(NodeId);
+	if (Index == INDEX_NONE) return;
+
+	OnNodeRemoved.Broadcast(NodeId);
+
+	const FIntPoint Cell = Nodes[Index].Cell;
+	if (TArray<int32>* Bucket = Grid.Find(Cell))
+	{
+		Bucket->RemoveSingleSwap(NodeId);
+		if (Bucket->Num() == 0)
+		{
+			Grid.Remove(Cell);
+		}
+	}
+
+	Nodes.RemoveAt(Index);
+	Generations[Index] = Generations[Index] < MaxNodeGeneration ? Generations[Index] + 1 : 1;
+}
+
+void UResourceNodeSubsystem::AttachActor(int32 NodeId, AResource_M* Actor)
+{
+	const int32 Index = ToIndex(NodeId);
+	if (Index == INDEX_NONE) return;
+
+	Nodes[Index].Actor = Actor;
+}
+
+void UResourceNodeSubsystem::DetachActor(int32 NodeId)
+{
+	const int32 Index = ToIndex(NodeId);
+	if (Index == INDEX_NONE) return;
+
+	FResourceNodeRecord& Node = Nodes[Index];
+	if (const AResource_M* Actor = Node.Actor.Get())
+	{
+		Node.Remaining = Actor->totalResource;
+	}
+	Node.Actor = nullptr;
+}
+
+const FResourceNodeRecord* UResourceNodeSubsystem::GetNode(int32 NodeId) const
+{
+	const int32 Index = ToIndex(NodeId);
+	return Index != INDEX_NONE ? &Nodes[Index] : nullptr;
+}
+
+int32 UResourceNodeSubsystem::FindNearestNode(const FVector& Point, float Radius, EResourceType Type) const
+{
+	const FIntPoint Min = CellFor(Point - FVector(Radius));
+	const FIntPoint Max = CellFor(Point + FVector(Radius));
+
+	int32 Best = INDEX_NONE;
+	float BestDistSq = FMath::Square(Radius);
+
+	for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+	{
+		for (int32 X = Min.X; X <= Max.X; ++X)
+		{
+			const TArray<int32>* Bucket = Grid.Find(FIntPoint(X, Y));
+			if (!Bucket) continue;
+
+			for (const int32 NodeId : *Bucket)
+			{
+				const FResourceNodeRecord& Node = Nodes[NodeId & NodeIndexMask];
+				if (Node.Type != Type || Node.Remaining <= 0) continue;
+
+				const float D = FVector::DistSquared2D(Node.Location, Point);
+				if (D < BestDistSq)
+				{
+					BestDistSq = D;
+					Best = NodeId;
+				}
+			}
+		}
+	}
+	return Best;
+}
+
+void UResourceNodeSubsystem::QueryRadius(const FVector& Point, float Radius, TArray<int32>& OutNodeIds) const
+{
+	const FIntPoint Min = CellFor(Point - FVector(Radius));
+	const FIntPoint Max = CellFor(Point + FVector(Radius));
+	const float RadiusSq = FMath::Square(Radius);
+
+	for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+	{
+		for (int32 X = Min.X; X <= Max.X; ++X)
+		{
+			const TArray<int32>* Bucket = Grid.Find(FIntPoint(X, Y));
+			if (!Bucket) continue;
+
+			for (const int32 NodeId : *Bucket)
+			{
+				if (FVector::DistSquared(Nodes[NodeId & NodeIndexMask].Location, Point) <= RadiusSq)
+				{
+					OutNodeIds.Add(NodeId);
+				}
+			}
+		}
+	}
+}
+
+int32 UResourceNodeSubsystem::ConsumeFromNode(int32 NodeId, int32 Amount)
+{
+	const int32 Index = ToIndex(NodeId);
+	if (Index == INDEX_NONE || Amount <= 0) return 0;
+
+	FResourceNodeRecord& Node = Nodes[Index];
+	AResource_M* Actor = Node.Actor.Get();
+
+	// A materialised node is authoritative for its own amount
+	if (Actor)
+	{
+		Node.Remaining = Actor->totalResource;
+	}
+
+	const int32 Granted = FMath::Min(Amount, Node.Remaining);
+	Node.Remaining -= Granted;
+
+	if (Actor)
+	{
+		Actor->totalResource = Node.Remaining;
+	}
+
+	if (Node.Remaining <= 0)
+	{
+		OnNodeDepleted.Broadcast(NodeId);
+
+		if (Actor)
+		{
+			// EndPlay unregisters the node
+			Actor->Destroy();
+		}
+		else
+		{
+			UnregisterNode(NodeId);
+		}
+	}
+
+	return Granted;
+}
+
+bool UResourceNodeSubsystem::RemoveNodeAt(const FVector& Point, float Radius, EResourceType Type)
+{
+	const int32 NodeId = FindNearestNode(Point, Radius, Type);
+	if (NodeId == INDEX_NONE) return false;
+
+	if (AResource_M* Actor = Nodes[NodeId & NodeIndexMask].Actor.Get())
+	{
+		// EndPlay unregisters the node
+		Actor->Destroy();
+	}
+	else
+	{
+		UnregisterNode(NodeId);
+	}
+	return true;
+}
+
+void UResourceNodeSubsystem::SetRemaining(int32 NodeId, int32 Remaining)
+{
+	const int32 Index = ToIndex(NodeId);
+	if (Index == INDEX_NONE) return;
+
+	if (Remaining <= 0)
+	{
+		ConsumeFromNode(NodeId, MAX_int32);
+		return;
+	}
+
+	FResourceNodeRecord& Node = Nodes[Index];
+	Node.Remaining = Remaining;
+	if (AResource_M* Actor = Node.Actor.Get())
+	{
+		Actor->totalResource = Remaining;
+	}
+}
+
+void UResourceNodeSubsystem::ForEachNode(TFunctionRef<void(int32 NodeId, const FResourceNodeRecord& Node)> Fn) const
+{
+	for (auto It = Nodes.CreateConstIterator(); It; ++It)
+	{
+		const int32 Index = It.GetIndex();
+		Fn(((int32)Generations[Index] << NodeIndexBits) | Index, *It);
+	}
+}
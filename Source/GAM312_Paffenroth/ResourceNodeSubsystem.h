@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ResourceNodeSubsystem.generated.h"
+
+class AResource_M;
+
+UENUM(BlueprintType)
+enum class EResourceType : uint8
+{
+	Wood   UMETA(DisplayName = "Wood"),
+	Stone  UMETA(DisplayName = "Stone"),
+	Berry  UMETA(DisplayName = "Berry"),
+	Count  UMETA(Hidden)
+};
+
+// Gameplay data for one resource node, with or without an actor in the world
+struct FResourceNodeRecord
+{
+	FVector Location = FVector::ZeroVector;
+
+	// Actor representing the node, if it is currently materialised
+	TWeakObjectPtr<AResource_M> Actor;
+
+	// Amount left before the node depletes
+	int32 Remaining = 0;
+
+	// Amount given per harvest
+	int32 Yield = 0;
+
+	EResourceType Type = EResourceType::Wood;
+
+	// Grid cell the node is filed under
+	FIntPoint Cell = FIntPoint::ZeroValue;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnResourceNodeDepleted, int32 /*NodeId*/);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnResourceNodeRemoved, int32 /*NodeId*/);
+
+/**
+ * Registry of all resource nodes in the world, bucketed in a uniform 2D grid
+ * so that agents and players can find nearby nodes without iterating actors.
+ * A node id holds a slot index in the low bits and the slot's generation above it,
+ * so an id kept after its node is removed never finds the node that reuses the slot.
+ */
+UCLASS()
+class GAM312_PAFFENROTH_API UResourceNodeSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// Converts a resource display name ("Wood", "Stone", "Berry") to its type
+	static EResourceType ResourceTypeFromName(const FString& Name);
+
+	static constexpr int32 NodeIndexBits = 20;
+	static constexpr int32 NodeIndexMask = (1 << NodeIndexBits) - 1;
+	static constexpr uint16 MaxNodeGeneration = (1 << (31 - NodeIndexBits)) - 1;
+
+	// Adds a node to the index and returns its id
+	int32 RegisterNode(const FVector& Location, EResourceType Type, int32 Total, int32 Yield, AResource_M* Actor = nullptr);
+
+	// Removes a node from the index
+	void UnregisterNode(int32 NodeId);
+
+	// Binds a spawned actor to an existing node
+	void AttachActor(int32 NodeId, AResource_M* Actor);
+
+	// Unbinds a node's actor, keeping the node and its remaining amount in the index
+	void DetachActor(int32 NodeId);
+
+	// Returns the node with the given id, or null if it no longer exists
+	const FResourceNodeRecord* GetNode(int32 NodeId) const;
+
+	// Finds the closest node of a type within a radius, or INDEX_NONE
+	int32 FindNearestNode(const FVector& Point, float Radius, EResourceType Type) const;
+
+	// Collects all nodes within a radius of a point
+	void QueryRadius(const FVector& Point, float Radius, TArray<int32>& OutNodeIds) const;
+
+	// Takes up to Amount from a node and returns what was granted. Depleted nodes are removed.
+	int32 ConsumeFromNode(int32 NodeId, int32 Amount);
+
+	// Removes the node of a type nearest a point, as another machine's depletion of it.
+	// Returns false if no such node is within the radius.
+	bool RemoveNodeAt(const FVector& Point, float Radius, EResourceType Type);
+
+	// Overwrites the amount left in a node. Zero or less depletes it.
+	void SetRemaining(int32 NodeId, int32 Remaining);
+
+	// Calls Fn for every node in the index. Nodes must not be added or removed from Fn.
+	void ForEachNode(TFunctionRef<void(int32 NodeId, const FResourceNodeRecord& Node)> Fn) const;
+
+	int32 GetNumNodes() const { return Nodes.Num(); }
+
+	// Broadcast just before a depleted node is removed
+	FOnResourceNodeDepleted OnNodeDepleted;
+
+	// Broadcast whenever a node leaves the index
+	FOnResourceNodeRemoved OnNodeRemoved;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	FIntPoint CellFor(const FVector& Location) const;
+
+	// Slot of a live node, or INDEX_NONE if the id is stale
+	int32 ToIndex(int32 NodeId) const;
+
+	TSparseArray<FResourceNodeRecord> Nodes;
+
+	// Generation of each slot, bumped when its node is removed
+	TArray<uint16> Generations;
+
+	// Node ids per grid cell
+	TMap<FIntPoint, TArray<int32>> Grid;
+
+	// Size of a grid cell in world units
+	float CellSize = 2000.f;
+};
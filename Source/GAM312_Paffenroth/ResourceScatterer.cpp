@@ -0,0 +1,473 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ResourceScatterer.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312GameState.h"
+#include "Resource_M.h"
+#include "LandscapeProxy.h"
+#include "LandscapeLayerInfoObject.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Resource Scatter Generate"), STAT_ResourceScatterGenerate, STATGROUP_GAM312);
+DECLARE_CYCLE_STAT(TEXT("Resource Scatter Streaming"), STAT_ResourceScatterStreaming, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Resource Tiles Materialised"), STAT_ResourceTilesMaterialised, STATGROUP_GAM312);
+
+namespace ResourceScatter
+{
+	// Ground height and layer weights on a regular grid. Filled on the game thread,
+	// then only read while the tiles are sampled in parallel.
+	struct FSampleGrid
+	{
+		FVector2D Origin = FVector2D::ZeroVector;
+		float CellSize = 500.f;
+		int32 SizeX = 0;
+		int32 SizeY = 0;
+
+		TArray<float> Height;
+		TArray<uint8> Grass;
+		TArray<uint8> Dirt;
+
+		int32 Index(int32 X, int32 Y) const { return Y * SizeX + X; }
+
+		// Nearest-cell lookup. Returns false where no ground was found.
+		bool Sample(const FVector2D& Point, float& OutHeight, float& OutGrass, float& OutDirt) const
+		{
+			const int32 X = FMath::Clamp(FMath::FloorToInt((Point.X - Origin.X) / CellSize), 0, SizeX - 1);
+			const int32 Y = FMath::Clamp(FMath::FloorToInt((Point.Y - Origin.Y) / CellSize), 0, SizeY - 1);
+			const int32 I = Index(X, Y);
+
+			OutHeight = Height[I];
+			OutGrass = Grass[I] / 255.f;
+			OutDirt = Dirt[I] / 255.f;
+			return OutHeight != TNumericLimits<float>::Lowest();
+		}
+	};
+
+	// Bridson's Poisson-disk sampling inside a rectangle
+	static void PoissonDisk(const FBox2D& Bounds, float MinDistance, FRandomStream& Stream, TArray<FVector2D>& OutPoints)
+	{
+		const FVector2D Size = Bounds.GetSize();
+		if (Size.X <= 0.f || Size.Y <= 0.f) return;
+
+		constexpr int32 MaxAttempts = 30;
+		const float CellSize = MinDistance / UE_SQRT_2;
+		const float MinDistSq = FMath::Square(MinDistance);
+		const int32 GridX = FMath::Max(1, FMath::CeilToInt(Size.X / CellSize));
+		const int32 GridY = FMath::Max(1, FMath::CeilToInt(Size.Y / CellSize));
+
+		TArray<int32> Cells;
+		Cells.Init(INDEX_NONE, GridX * GridY);
+
+		TArray<FVector2D> Points;
+		TArray<int32> Active;
+
+		auto CellOf = [&](const FVector2D& P)
+		{
+			return FIntPoint(
+				FMath::Clamp(FMath::FloorToInt((P.X - Bounds.Min.X) / CellSize), 0, GridX - 1),
+				FMath::Clamp(FMath::FloorToInt((P.Y - Bounds.Min.Y) / CellSize), 0, GridY - 1));
+		};
+
+		auto Fits = [&](const FVector2D& P)
+		{
+			const FIntPoint C = CellOf(P);
+			for (int32 Y = FMath::Max(0, C.Y - 2); Y <= FMath::Min(GridY - 1, C.Y + 2); ++Y)
+			{
+				for (int32 X = FMath::Max(0, C.X - 2); X <= FMath::Min(GridX - 1, C.X + 2); ++X)
+				{
+					const int32 Other = Cells[Y * GridX + X];
+					if (Other != INDEX_NONE && FVector2D::DistSquared(Points[Other], P) < MinDistSq)
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		};
+
+		auto Insert = [&](const FVector2D& P)
+		{
+			const int32 Index = Points.Add(P);
+			const FIntPoint C = CellOf(P);
+			Cells[C.Y * GridX + C.X] = Index;
+			Active.Add(Index);
+		};
+
+		Insert(Bounds.Min + FVector2D(Stream.FRand() * Size.X, Stream.FRand() * Size.Y));
+
+		while (Active.Num() > 0)
+		{
+			const int32 Slot = Stream.RandHelper(Active.Num());
+			const FVector2D Center = Points[Active[Slot]];
+
+			bool bPlaced = false;
+			for (int32 Attempt = 0; Attempt < MaxAttempts; ++Attempt)
+			{
+				const float Angle = Stream.FRand() * UE_TWO_PI;
+				const float Dist = MinDistance * (1.f + Stream.FRand());
+				const FVector2D Candidate = Center + FVector2D(FMath::Cos(Angle), FMath::Sin(Angle)) * Dist;
+
+				if (Bounds.IsInside(Candidate) && Fits(Candidate))
+				{
+					Insert(Candidate);
+					bPlaced = true;
+					break;
+				}
+			}
+
+			if (!bPlaced)
+			{
+				Active.RemoveAtSwap(Slot);
+			}
+		}
+
+		OutPoints.Append(Points);
+	}
+}
+
+AResourceScatterer::AResourceScatterer()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+}
+
+void AResourceScatterer::PostLoad()
+{
+	Super::PostLoad();
+
+	if (Rules.Num() > FResourceSpawnRecord::MaxRules)
+	{
+		UE_LOG(LogGAM312, Error, TEXT("%s has %d scatter rules; only the first %d are used"),
+			*GetName(), Rules.Num(), FResourceSpawnRecord::MaxRules);
+	}
+}
+
+void AResourceScatterer::Generate()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ResourceScatterGenerate);
+
+	UWorld* World = GetWorld();
+	if (!World || Rules.Num() == 0) return;
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	const FBox Bounds = Landscape
+		? Landscape->GetComponentsBoundingBox(true)
+		: FBox(GetActorLocation() - FVector(TileSize * 4.f), GetActorLocation() + FVector(TileSize * 4.f));
+
+	// Sample height and layer weights on the game thread. Traces and weightmap reads are not
+	// safe from worker threads, and the grid is far coarser than the final node spacing.
+	ResourceScatter::FSampleGrid Grid;
+	Grid.Origin = FVector2D(Bounds.Min);
+	Grid.CellSize = SampleCellSize;
+	Grid.SizeX = FMath::Max(1, FMath::CeilToInt((Bounds.Max.X - Bounds.Min.X) / SampleCellSize));
+	Grid.SizeY = FMath::Max(1, FMath::CeilToInt((Bounds.Max.Y - Bounds.Min.Y) / SampleCellSize));
+	Grid.Height.Init(TNumericLimits<float>::Lowest(), Grid.SizeX * Grid.SizeY);
+	Grid.Grass.Init(255, Grid.SizeX * Grid.SizeY);
+	Grid.Dirt.Init(0, Grid.SizeX * Grid.SizeY);
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(ResourceScatter), false, this);
+
+	for (int32 Y = 0; Y < Grid.SizeY; ++Y)
+	{
+		for (int32 X = 0; X < Grid.SizeX; ++X)
+		{
+			const int32 I = Grid.Index(X, Y);
+			const FVector2D Center = Grid.Origin + FVector2D(X + 0.5f, Y + 0.5f) * SampleCellSize;
+			const FVector Start(Center, Bounds.Max.Z + 1000.f);
+			const FVector End(Center, Bounds.Min.Z - 1000.f);
+
+			FHitResult Hit;
+			if (World->LineTraceSingleByChannel(Hit, Start, End, ECC_Visibility, Params))
+			{
+				Grid.Height[I] = Hit.Location.Z;
+			}
+
+#if WITH_EDITOR
+			// Layer weights come from the editing weightmaps, so they are baked here and
+			// runtime generation falls back to uniform grass.
+			if (Landscape)
+			{
+				const FVector Location(Center, Grid.Height[I]);
+				if (GrassLayer)
+				{
+					Grid.Grass[I] = (uint8)FMath::Clamp(FMath::RoundToInt(Landscape->GetLayerWeightAtLocation(Location, GrassLayer) * 255.f), 0, 255);
+				}
+				if (DirtLayer)
+				{
+					Grid.Dirt[I] = (uint8)FMath::Clamp(FMath::RoundToInt(Landscape->GetLayerWeightAtLocation(Location, DirtLayer) * 255.f), 0, 255);
+				}
+			}
+#endif
+		}
+	}
+
+	FResourceSpawnTable Table;
+	Table.Origin = FVector2D(Bounds.Min);
+	Table.TileSize = TileSize;
+	Table.TilesX = FMath::Max(1, FMath::CeilToInt((Bounds.Max.X - Bounds.Min.X) / TileSize));
+	Table.TilesY = FMath::Max(1, FMath::CeilToInt((Bounds.Max.Y - Bounds.Min.Y) / TileSize));
+
+	// Each tile samples independently with its own seed, so the result does not depend on
+	// thread scheduling. Samples are inset by half the spacing so neighbouring tiles keep
+	// at least MinDistance between them.
+	TArray<TArray<FResourceSpawnRecord>> PerTile;
+	PerTile.SetNum(Table.NumTiles());
+
+	const int32 NumRules = FMath::Min(Rules.Num(), FResourceSpawnRecord::MaxRules);
+
+	ParallelFor(Table.NumTiles(), [&](int32 TileIndex)
+	{
+		const int32 TileX = TileIndex % Table.TilesX;
+		const int32 TileY = TileIndex / Table.TilesX;
+		const FVector2D TileMin = Table.Origin + FVector2D(TileX, TileY) * TileSize;
+
+		FRandomStream Stream((int32)HashCombine(GetTypeHash(Seed), GetTypeHash(TileIndex)));
+		TArray<FResourceSpawnRecord>& Out = PerTile[TileIndex];
+		TArray<FVector2D> Samples;
+
+		for (int32 RuleIndex = 0; RuleIndex < NumRules; ++RuleIndex)
+		{
+			const FResourceScatterRule& Rule = Rules[RuleIndex];
+			const float Inset = Rule.MinDistance * 0.5f;
+			const FBox2D TileBounds(TileMin + FVector2D(Inset), TileMin + FVector2D(TileSize - Inset));
+
+			Samples.Reset();
+			ResourceScatter::PoissonDisk(TileBounds, Rule.MinDistance, Stream, Samples);
+
+			for (const FVector2D& Sample : Samples)
+			{
+				float Height, Grass, Dirt;
+				if (!Grid.Sample(Sample, Height, Grass, Dirt)) continue;
+
+				// Thin the samples by how strongly each layer is painted
+				const float Density = FMath::Clamp(Grass * Rule.GrassDensity + Dirt * Rule.DirtDensity, 0.f, 1.f);
+				if (Stream.FRand() >= Density) continue;
+
+				// Keep different resource types from overlapping
+				bool bBlocked = false;
+				for (const FResourceSpawnRecord& Other : Out)
+				{
+					if (Other.RuleIndex == RuleIndex) continue;
+
+					const float Spacing = FMath::Min(Rule.MinDistance, Rules[Other.RuleIndex].MinDistance) * 0.5f;
+					if (FVector2D::DistSquared(FVector2D(Other.Location.X, Other.Location.Y), Sample) < FMath::Square(Spacing))
+					{
+						bBlocked = true;
+						break;
+					}
+				}
+				if (bBlocked) continue;
+
+				FResourceSpawnRecord Record;
+				Record.Location = FVector3f(Sample.X, Sample.Y, Height);
+				Record.RuleIndex = (uint8)RuleIndex;
+				Out.Add(Record);
+			}
+		}
+	});
+
+	Table.TileStart.Reserve(Table.NumTiles() + 1);
+	for (const TArray<FResourceSpawnRecord>& TileRecords : PerTile)
+	{
+		Table.TileStart.Add(Table.Records.Num());
+		Table.Records.Append(TileRecords);
+	}
+	Table.TileStart.Add(Table.Records.Num());
+
+	Modify();
+	SpawnTable = MoveTemp(Table);
+
+	UE_LOG(LogGAM312, Log, TEXT("Scattered %d resource nodes over %d tiles in %.1f ms"),
+		SpawnTable.Records.Num(), SpawnTable.NumTiles(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+void AResourceScatterer::BeginPlay()
+{
+	Super::BeginPlay();
+
+	SetActorTickInterval(StreamingInterval);
+
+	NodeSubsystem = GetWorld()->GetSubsystem<UResourceNodeSubsystem>();
+	if (!NodeSubsystem) return;
+
+	if (SpawnTable.Records.Num() == 0 && bGenerateAtRuntime)
+	{
+		Generate();
+	}
+
+	NodeRemovedHandle = NodeSubsystem->OnNodeRemoved.AddUObject(this, &AResourceScatterer::OnNodeRemoved);
+	RegisterRecords();
+
+	// A client scatters every node, including ones the server depleted before this ran
+	if (AGAM312GameState* GameState = GetWorld()->GetGameState<AGAM312GameState>())
+	{
+		GameState->ApplyDepletedNodes();
+	}
+}
+
+void AResourceScatterer::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (NodeSubsystem)
+	{
+		NodeSubsystem->OnNodeRemoved.Remove(NodeRemovedHandle);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AResourceScatterer::RegisterRecords()
+{
+	RecordNodeIds.SetNumUninitialized(SpawnTable.Records.Num());
+	NodeToRecord.Reserve(SpawnTable.Records.Num());
+
+	for (int32 RecordIndex = 0; RecordIndex < SpawnTable.Records.Num(); ++RecordIndex)
+	{
+		const FResourceSpawnRecord& Record = SpawnTable.Records[RecordIndex];
+		RecordNodeIds[RecordIndex] = INDEX_NONE;
+
+		if (!Rules.IsValidIndex(Record.RuleIndex)) continue;
+
+		const FResourceScatterRule& Rule = Rules[Record.RuleIndex];
+		const UClass* NodeClass = GetNodeClass(Rule);
+		const AResource_M* Defaults = NodeClass ? NodeClass->GetDefaultObject<AResource_M>() : GetDefault<AResource_M>();
+
+		const int32 NodeId = NodeSubsystem->RegisterNode(FVector(Record.Location), Rule.Type, Defaults->totalResource, Defaults->resourceAmount);
+		RecordNodeIds[RecordIndex] = NodeId;
+		NodeToRecord.Add(NodeId, RecordIndex);
+	}
+}
+
+UClass* AResourceScatterer::GetNodeClass(const FResourceScatterRule& Rule) const
+{
+	UClass* NodeClass = Rule.NodeClass.Get();
+	if (!NodeClass && !Rule.NodeClass.IsNull())
+	{
+		NodeClass = Rule.NodeClass.LoadSynchronous();
+	}
+	return NodeClass;
+}
+
+void AResourceScatterer::OnNodeRemoved(int32 NodeId)
+{
+	int32 RecordIndex;
+	if (NodeToRecord.RemoveAndCopyValue(NodeId, RecordIndex))
+	{
+		RecordNodeIds[RecordIndex] = INDEX_NONE;
+	}
+}
+
+void AResourceScatterer::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	SCOPE_CYCLE_COUNTER(STAT_ResourceScatterStreaming);
+
+	if (!NodeSubsystem || SpawnTable.NumTiles() == 0) return;
+
+	TArray<FVector, TInlineAllocator<16>> PlayerLocations;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APawn* PlayerPawn = It->Get() ? It->Get()->GetPawn() : nullptr)
+		{
+			PlayerLocations.Add(PlayerPawn->GetActorLocation());
+		}
+	}
+
+	// Tiles near any player that need actors
+	TSet<int32> Wanted;
+	const int32 TileRadius = FMath::CeilToInt(MaterialiseRadius / SpawnTable.TileSize);
+	for (const FVector& Location : PlayerLocations)
+	{
+		const int32 CenterX = FMath::FloorToInt((Location.X - SpawnTable.Origin.X) / SpawnTable.TileSize);
+		const int32 CenterY = FMath::FloorToInt((Location.Y - SpawnTable.Origin.Y) / SpawnTable.TileSize);
+
+		for (int32 Y = FMath::Max(0, CenterY - TileRadius); Y <= FMath::Min(SpawnTable.TilesY - 1, CenterY + TileRadius); ++Y)
+		{
+			for (int32 X = FMath::Max(0, CenterX - TileRadius); X <= FMath::Min(SpawnTable.TilesX - 1, CenterX + TileRadius); ++X)
+			{
+				Wanted.Add(Y * SpawnTable.TilesX + X);
+			}
+		}
+	}
+
+	// Release tiles no player wants any more
+	TArray<int32> Released;
+	for (const TPair<int32, TArray<TWeakObjectPtr<AResource_M>>>& Pair : MaterialisedTiles)
+	{
+		if (!Wanted.Contains(Pair.Key))
+		{
+			Released.Add(Pair.Key);
+		}
+	}
+	for (const int32 TileIndex : Released)
+	{
+		DematerialiseTile(TileIndex);
+	}
+
+	for (const int32 TileIndex : Wanted)
+	{
+		if (!MaterialisedTiles.Contains(TileIndex))
+		{
+			MaterialiseTile(TileIndex);
+		}
+	}
+
+	SET_DWORD_STAT(STAT_ResourceTilesMaterialised, MaterialisedTiles.Num());
+}
+
+void AResourceScatterer::MaterialiseTile(int32 TileIndex)
+{
+	TArray<TWeakObjectPtr<AResource_M>>& Actors = MaterialisedTiles.Add(TileIndex);
+
+	for (int32 RecordIndex = SpawnTable.TileStart[TileIndex]; RecordIndex < SpawnTable.TileStart[TileIndex + 1]; ++RecordIndex)
+	{
+		const int32 NodeId = RecordNodeIds[RecordIndex];
+		const FResourceNodeRecord* Node = NodeSubsystem->GetNode(NodeId);
+		if (!Node || Node->Actor.IsValid()) continue;
+
+		const FResourceSpawnRecord& Record = SpawnTable.Records[RecordIndex];
+		const FResourceScatterRule& Rule = Rules[Record.RuleIndex];
+		UClass* NodeClass = GetNodeClass(Rule);
+		if (!NodeClass) continue;
+
+		// The table height comes from the coarse sample grid, so settle the node on the ground
+		FVector Location(Record.Location);
+		FHitResult Hit;
+		if (GetWorld()->LineTraceSingleByChannel(Hit, Location + FVector(0.f, 0.f, 1000.f), Location - FVector(0.f, 0.f, 1000.f), ECC_Visibility))
+		{
+			Location = Hit.Location;
+		}
+
+		const FTransform SpawnTransform(Location);
+		AResource_M* Actor = GetWorld()->SpawnActorDeferred<AResource_M>(NodeClass, SpawnTransform, this);
+		if (!Actor) continue;
+
+		Actor->NodeId = NodeId;
+		Actor->totalResource = Node->Remaining;
+		Actor->FinishSpawning(SpawnTransform);
+
+		Actors.Add(Actor);
+	}
+}
+
+void AResourceScatterer::DematerialiseTile(int32 TileIndex)
+{
+	TArray<TWeakObjectPtr<AResource_M>> Actors;
+	if (!MaterialisedTiles.RemoveAndCopyValue(TileIndex, Actors)) return;
+
+	for (const TWeakObjectPtr<AResource_M>& WeakActor : Actors)
+	{
+		// Depleted nodes destroy themselves and leave the index on their own
+		if (AResource_M* Actor = WeakActor.Get())
+		{
+			NodeSubsystem->DetachActor(Actor->NodeId);
+			Actor->NodeId = INDEX_NONE;
+			Actor->Destroy();
+		}
+	}
+}
@@ -0,0 +1,175 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "ResourceNodeSubsystem.h"
+#include "ResourceScatterer.generated.h"
+
+class AResource_M;
+class ALandscapeProxy;
+class ULandscapeLayerInfoObject;
+
+// How one resource type is scattered over the landscape
+USTRUCT(BlueprintType)
+struct FResourceScatterRule
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Scatter")
+		EResourceType Type = EResourceType::Wood;
+
+	// Node Blueprint spawned for this type
+	UPROPERTY(EditAnywhere, Category = "Scatter")
+		TSoftClassPtr<AResource_M> NodeClass;
+
+	// Minimum distance between two nodes of this type
+	UPROPERTY(EditAnywhere, Category = "Scatter", meta = (ClampMin = "100.0"))
+		float MinDistance = 1500.0f;
+
+	// Chance to keep a sample on fully painted grass
+	UPROPERTY(EditAnywhere, Category = "Scatter", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+		float GrassDensity = 1.0f;
+
+	// Chance to keep a sample on fully painted dirt
+	UPROPERTY(EditAnywhere, Category = "Scatter", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+		float DirtDensity = 0.2f;
+};
+
+// One scattered node. Kept small since a large world holds hundreds of thousands of these.
+USTRUCT()
+struct FResourceSpawnRecord
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		FVector3f Location = FVector3f::ZeroVector;
+
+	UPROPERTY()
+		uint8 RuleIndex = 0;
+
+	// RuleIndex is a byte, so a scatterer uses at most this many rules
+	static constexpr int32 MaxRules = MAX_uint8 + 1;
+};
+
+// Scattered nodes sorted by tile, so a tile's nodes are one contiguous range
+USTRUCT()
+struct FResourceSpawnTable
+{
+	GENERATED_BODY()
+
+	// World position of tile (0, 0)
+	UPROPERTY()
+		FVector2D Origin = FVector2D::ZeroVector;
+
+	UPROPERTY()
+		float TileSize = 5000.0f;
+
+	UPROPERTY()
+		int32 TilesX = 0;
+
+	UPROPERTY()
+		int32 TilesY = 0;
+
+	// Index of the first record of each tile, plus one trailing entry
+	UPROPERTY()
+		TArray<int32> TileStart;
+
+	UPROPERTY()
+		TArray<FResourceSpawnRecord> Records;
+
+	int32 NumTiles() const { return TilesX * TilesY; }
+};
+
+/**
+ * Scatters resource nodes over a landscape with tile-parallel Poisson-disk sampling.
+ * Nodes live in the resource node index and only get actors in tiles near players.
+ */
+UCLASS()
+class GAM312_PAFFENROTH_API AResourceScatterer : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AResourceScatterer();
+
+	virtual void PostLoad() override;
+	virtual void Tick(float DeltaTime) override;
+
+	// Rebuilds the spawn table from the landscape and rules
+	UFUNCTION(CallInEditor, BlueprintCallable, Category = "Scatter")
+		void Generate();
+
+// --- Settings ---
+
+	// Landscape to scatter on
+	UPROPERTY(EditAnywhere, Category = "Scatter")
+		TObjectPtr<ALandscapeProxy> Landscape;
+
+	UPROPERTY(EditAnywhere, Category = "Scatter")
+		TObjectPtr<ULandscapeLayerInfoObject> GrassLayer;
+
+	UPROPERTY(EditAnywhere, Category = "Scatter")
+		TObjectPtr<ULandscapeLayerInfoObject> DirtLayer;
+
+	// At most FResourceSpawnRecord::MaxRules; any past that are ignored
+	UPROPERTY(EditAnywhere, Category = "Scatter")
+		TArray<FResourceScatterRule> Rules;
+
+	// Side length of a sampling and streaming tile
+	UPROPERTY(EditAnywhere, Category = "Scatter", meta = (ClampMin = "1000.0"))
+		float TileSize = 5000.0f;
+
+	// Resolution of the height and layer weight grid sampled before scattering
+	UPROPERTY(EditAnywhere, Category = "Scatter", meta = (ClampMin = "50.0"))
+		float SampleCellSize = 500.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Scatter")
+		int32 Seed = 1337;
+
+	// Generate at BeginPlay if the table is empty
+	UPROPERTY(EditAnywhere, Category = "Scatter")
+		bool bGenerateAtRuntime = false;
+
+	// Tiles within this distance of a player have actors
+	UPROPERTY(EditAnywhere, Category = "Streaming")
+		float MaterialiseRadius = 10000.0f;
+
+	// Seconds between streaming updates
+	UPROPERTY(EditAnywhere, Category = "Streaming")
+		float StreamingInterval = 0.5f;
+
+	UPROPERTY(VisibleAnywhere, Category = "Scatter")
+		FResourceSpawnTable SpawnTable;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// Registers every record with the node index
+	void RegisterRecords();
+
+	void MaterialiseTile(int32 TileIndex);
+
+	void DematerialiseTile(int32 TileIndex);
+
+	void OnNodeRemoved(int32 NodeId);
+
+	// Resolves a rule's node class, which the asset preloader normally has resident already
+	UClass* GetNodeClass(const FResourceScatterRule& Rule) const;
+
+	// Node id of each record, or INDEX_NONE once it is depleted
+	TArray<int32> RecordNodeIds;
+
+	TMap<int32, int32> NodeToRecord;
+
+	// Spawned actors per materialised tile
+	TMap<int32, TArray<TWeakObjectPtr<AResource_M>>> MaterialisedTiles;
+
+	FDelegateHandle NodeRemovedHandle;
+
+	UPROPERTY(Transient)
+		TObjectPtr<UResourceNodeSubsystem> NodeSubsystem;
+};
@@ -2,6 +2,7 @@
 
 
 #include "Resource_M.h"
+#include "ResourceNodeSubsystem.h"
 
 // Sets default values
 AResource_M::AResource_M()
@@ -9,12 +10,11 @@ AResource_M::AResource_M()
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
-	ResourceNameTxt = CreateDefaultSubobject<UTextRenderComponent>(TEXT("Text Render"));
 	Mesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Mesh"));
 
 	RootComponent = Mesh;
 
-	ResourceNameTxt->SetupAttachment(Mesh);
+	// The node's label is drawn by AGAM312HUD from the resource node index
 }
 
 // Called when the game starts or when spawned
@@ -22,7 +22,33 @@ void AResource_M::BeginPlay()
 {
 	Super::BeginPlay();
 
-	ResourceNameTxt->SetText(FText::FromString(resourceName));
+	if (UResourceNodeSubsystem* NodeSubsystem = GetWorld()->GetSubsystem<UResourceNodeSubsystem>())
+	{
+		// Nodes spawned by a scatterer already exist in the index
+		if (NodeId != INDEX_NONE)
+		{
+			NodeSubsystem->AttachActor(NodeId, this);
+		}
+		else
+		{
+			NodeId = NodeSubsystem->RegisterNode(GetActorLocation(), UResourceNodeSubsystem::ResourceTypeFromName(resourceName), totalResource, resourceAmount, this);
+		}
+	}
+}
+
+// Called when the actor is removed from the world
+void AResource_M::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (NodeId != INDEX_NONE)
+	{
+		if (UResourceNodeSubsystem* NodeSubsystem = GetWorld()->GetSubsystem<UResourceNodeSubsystem>())
+		{
+			NodeSubsystem->UnregisterNode(NodeId);
+		}
+		NodeId = INDEX_NONE;
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
@@ -19,6 +19,9 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Called when the actor is removed from the world
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -35,11 +38,15 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Resource")
 		int totalResource = 100;
 
-	// Displays the resource's name in front of the mesh
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Resource")
-		UTextRenderComponent* ResourceNameTxt;
+	// Deprecated: labels are drawn by AGAM312HUD. Kept so Blueprints that reference it still
+	// compile; it is never created, so it is always null.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Resource", meta = (DeprecatedProperty, DeprecationMessage = "Resource labels are drawn by AGAM312HUD"))
+		UTextRenderComponent* ResourceNameTxt = nullptr;
 
 	// Currently, the cube that represents the resource
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Resource")
 		UStaticMeshComponent* Mesh;
+
+	// Id of this node in the world's resource node index
+	int32 NodeId = INDEX_NONE;
 };
@@ -0,0 +1,396 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TelemetrySubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Compression.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Telemetry Events Written"), STAT_TelemetryEventsWritten, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Telemetry Events Dropped"), STAT_TelemetryEventsDropped, STATGROUP_GAM312);
+
+namespace GameplayTelemetry
+{
+	static constexpr uint32 FileMagic = 0x4D4C4554; // "TELM"
+	static constexpr int32 FileVersion = 1;
+
+	// Every thread that has recorded an event. Rings live until exit, since a thread
+	// may record again at any time and the writer reads them without a lock.
+	static FCriticalSection RingsLock;
+	static TArray<FTelemetryRing*> Rings;
+
+	// Running totals per player and event type, game thread only
+	static TMap<uint64, int64> Counters;
+
+	static uint64 CounterKey(uint32 Player, ETelemetryEvent Type)
+	{
+		return ((uint64)Player << 8) | (uint8)Type;
+	}
+}
+
+std::atomic<bool> FGameplayTelemetry::bEnabled { false };
+
+FTelemetryRing& FGameplayTelemetry::GetThreadRing()
+{
+	static thread_local FTelemetryRing* Ring = nullptr;
+	if (!Ring)
+	{
+		Ring = new FTelemetryRing();
+
+		FScopeLock Lock(&GameplayTelemetry::RingsLock);
+		GameplayTelemetry::Rings.Add(Ring);
+	}
+	return *Ring;
+}
+
+void FGameplayTelemetry::DrainRings(TArray<FTelemetryEvent>& Out, uint64& OutDropped)
+{
+	FScopeLock Lock(&GameplayTelemetry::RingsLock);
+
+	OutDropped = 0;
+	for (FTelemetryRing* Ring : GameplayTelemetry::Rings)
+	{
+		Ring->Drain(Out);
+		OutDropped += Ring->Dropped.load(std::memory_order_relaxed);
+	}
+}
+
+uint32 FGameplayTelemetry::GetNumPending()
+{
+	FScopeLock Lock(&GameplayTelemetry::RingsLock);
+
+	uint32 Pending = 0;
+	for (const FTelemetryRing* Ring : GameplayTelemetry::Rings)
+	{
+		Pending += Ring->NumPending();
+	}
+	return Pending;
+}
+
+uint64 FGameplayTelemetry::GetNumDropped()
+{
+	FScopeLock Lock(&GameplayTelemetry::RingsLock);
+
+	uint64 Dropped = 0;
+	for (const FTelemetryRing* Ring : GameplayTelemetry::Rings)
+	{
+		Dropped += Ring->Dropped.load(std::memory_order_relaxed);
+	}
+	return Dropped;
+}
+
+int64 FGameplayTelemetry::GetCounter(uint32 Player, ETelemetryEvent Type)
+{
+	check(IsInGameThread());
+	const int64* Total = GameplayTelemetry::Counters.Find(GameplayTelemetry::CounterKey(Player, Type));
+	return Total ? *Total : 0;
+}
+
+FOnTelemetryCounterChanged& FGameplayTelemetry::OnCounterChanged()
+{
+	static FOnTelemetryCounterChanged Delegate;
+	return Delegate;
+}
+
+/**
+ * Drains the recording rings on its own thread, writes compressed event blocks and
+ * gathers counter deltas for the game thread.
+ */
+class FTelemetryWriter : public FRunnable
+{
+public:
+	FTelemetryWriter(const UTelemetrySubsystem& Settings)
+		: FlushInterval(FMath::Max(Settings.FlushInterval, 0.001f))
+		, BlockBytes(FMath::Max(Settings.BlockBytes, (int32)sizeof(FTelemetryEvent)))
+		, MaxFileBytes(FMath::Max<int64>(Settings.MaxFileBytes, Settings.BlockBytes))
+		, MaxFiles(FMath::Max(Settings.MaxFiles, 1))
+		, Directory(FPaths::ProjectSavedDir() / TEXT("Telemetry"))
+	{
+		IFileManager::Get().MakeDirectory(*Directory, true);
+		WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+		Thread = FRunnableThread::Create(this, TEXT("TelemetryWriter"), 0, TPri_BelowNormal);
+	}
+
+	virtual ~FTelemetryWriter() override
+	{
+		if (Thread)
+		{
+			Thread->Kill(true);
+			delete Thread;
+		}
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	}
+
+	virtual uint32 Run() override
+	{
+		while (!bStopping)
+		{
+			WakeEvent->Wait(FTimespan::FromSeconds(FlushInterval));
+			Pump(false);
+		}
+
+		// Write whatever was recorded before shutdown
+		Pump(true);
+		CloseFile();
+		return 0;
+	}
+
+	virtual void Stop() override
+	{
+		bStopping = true;
+		WakeEvent->Trigger();
+	}
+
+	// Hands the counter changes gathered since the last call to the game thread
+	void TakeCounterDeltas(TMap<uint64, int64>& Out)
+	{
+		FScopeLock Lock(&DeltaLock);
+		Out = MoveTemp(PendingDeltas);
+		PendingDeltas.Reset();
+	}
+
+private:
+	void Pump(bool bFinal)
+	{
+		Batch.Reset();
+		uint64 Dropped = 0;
+		FGameplayTelemetry::DrainRings(Batch, Dropped);
+
+		if (Batch.Num() > 0)
+		{
+			FScopeLock Lock(&DeltaLock);
+			for (const FTelemetryEvent& Event : Batch)
+			{
+				if (Event.Type != ETelemetryEvent::Vitals)
+				{
+					PendingDeltas.FindOrAdd(GameplayTelemetry::CounterKey(Event.Player, Event.Type)) += Event.Amount;
+				}
+			}
+		}
+
+		Block.Append(reinterpret_cast<const uint8*>(Batch.GetData()), Batch.Num() * sizeof(FTelemetryEvent));
+		EventsWritten += Batch.Num();
+
+		if (Block.Num() >= BlockBytes || (bFinal && Block.Num() > 0))
+		{
+			WriteBlock();
+		}
+
+		SET_DWORD_STAT(STAT_TelemetryEventsWritten, EventsWritten);
+		SET_DWORD_STAT(STAT_TelemetryEventsDropped, Dropped);
+	}
+
+	void WriteBlock()
+	{
+		int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Oodle, Block.Num());
+		Compressed.SetNumUninitialized(CompressedSize, EAllowShrinking::No);
+
+		if (!FCompression::CompressMemory(NAME_Oodle, Compressed.GetData(), CompressedSize, Block.GetData(), Block.Num()))
+		{
+			UE_LOG(LogGAM312, Warning, TEXT("Telemetry block of %d bytes could not be compressed and was dropped"), Block.Num());
+			Block.Reset();
+			return;
+		}
+
+		if (!File || File->TotalSize() >= MaxFileBytes)
+		{
+			RotateFile();
+		}
+
+		if (File)
+		{
+			int32 RawSize = Block.Num();
+			*File << RawSize << CompressedSize;
+			File->Serialize(Compressed.GetData(), CompressedSize);
+			File->Flush();
+		}
+		Block.Reset();
+	}
+
+	void RotateFile()
+	{
+		CloseFile();
+
+		const FString Path = Directory / FString::Printf(TEXT("Telemetry_%s_%03d.bin"), *FDateTime::Now().ToString(), FileSequence++);
+		File = TUniquePtr<FArchive>(IFileManager::Get().CreateFileWriter(*Path));
+		if (!File)
+		{
+			UE_LOG(LogGAM312, Warning, TEXT("Could not open telemetry file %s"), *Path);
+			return;
+		}
+
+		uint32 Magic = GameplayTelemetry::FileMagic;
+		int32 Version = GameplayTelemetry::FileVersion;
+		int32 EventSize = sizeof(FTelemetryEvent);
+		double CyclesPerSecond = 1.0 / FPlatformTime::GetSecondsPerCycle64();
+		*File << Magic << Version << EventSize << CyclesPerSecond;
+
+		// Keep the newest MaxFiles; names sort by creation time
+		TArray<FString> Existing;
+		IFileManager::Get().FindFiles(Existing, *(Directory / TEXT("Telemetry_*.bin")), true, false);
+		Existing.Sort();
+		for (int32 i = 0; i < Existing.Num() - MaxFiles; ++i)
+		{
+			IFileManager::Get().Delete(*(Directory / Existing[i]), false, false, true);
+		}
+	}
+
+	void CloseFile()
+	{
+		if (File)
+		{
+			File->Close();
+			File.Reset();
+		}
+	}
+
+	const float FlushInterval;
+	const int32 BlockBytes;
+	const int64 MaxFileBytes;
+	const int32 MaxFiles;
+	const FString Directory;
+
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+	std::atomic<bool> bStopping { false };
+
+	// Writer thread only
+	TArray<FTelemetryEvent> Batch;
+	TArray<uint8> Block;
+	TArray<uint8> Compressed;
+	TUniquePtr<FArchive> File;
+	int32 FileSequence = 0;
+	uint32 EventsWritten = 0;
+
+	FCriticalSection DeltaLock;
+	TMap<uint64, int64> PendingDeltas;
+};
+
+// The process-wide writer belongs to whichever game instance started first
+static UTelemetrySubsystem* GTelemetryOwner = nullptr;
+
+void UTelemetrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	if (!bEnabled || GTelemetryOwner || !FPlatformProcess::SupportsMultithreading()) return;
+
+	GTelemetryOwner = this;
+	Writer = new FTelemetryWriter(*this);
+	TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UTelemetrySubsystem::TickCounters));
+	FGameplayTelemetry::bEnabled.store(true);
+}
+
+void UTelemetrySubsystem::Deinitialize()
+{
+	if (GTelemetryOwner == this)
+	{
+		FGameplayTelemetry::bEnabled.store(false);
+		FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+
+		// Stops the thread after a final drain and write
+		delete Writer;
+		Writer = nullptr;
+
+		GameplayTelemetry::Counters.Empty();
+		GTelemetryOwner = nullptr;
+	}
+
+	Super::Deinitialize();
+}
+
+bool UTelemetrySubsystem::TickCounters(float DeltaTime)
+{
+	TMap<uint64, int64> Deltas;
+	Writer->TakeCounterDeltas(Deltas);
+
+	for (const TPair<uint64, int64>& Delta : Deltas)
+	{
+		int64& Total = GameplayTelemetry::Counters.FindOrAdd(Delta.Key);
+		Total += Delta.Value;
+
+		FGameplayTelemetry::OnCounterChanged().Broadcast((uint32)(Delta.Key >> 8), (ETelemetryEvent)(Delta.Key & 0xFF), Total);
+	}
+	return true;
+}
+
+namespace GameplayTelemetry
+{
+	// Waits, untimed, for the writer to empty the rings between bench passes
+	static void WaitForDrain()
+	{
+		const double Deadline = FPlatformTime::Seconds() + 1.0;
+		while (FGameplayTelemetry::GetNumPending() > 0 && FPlatformTime::Seconds() < Deadline)
+		{
+			FPlatformProcess::Sleep(0.001f);
+		}
+	}
+}
+
+// Benchmark helper: "Telemetry.Bench <Events>" times Record on the game thread, then from
+// several worker threads at once, and reports the cost per event. Each timed pass records
+// at most a ring's capacity per ring and the writer drains between passes, so the timing is
+// of stored events; anything still dropped is reported alongside it.
+GAM312_BENCH_COMMAND(GTelemetryBenchCmd, "Telemetry.Bench",
+	"Times telemetry event recording. Usage: Telemetry.Bench <Events>")
+{
+	const int32 Count = GAM312Bench::Count(Args, 0, 100000);
+	const FVector3f Data(1.f, 2.f, 3.f);
+
+	GameplayTelemetry::WaitForDrain();
+	const uint64 DroppedBefore = FGameplayTelemetry::GetNumDropped();
+
+	double GameThreadSeconds = 0.0;
+	for (int32 Done = 0; Done < Count; )
+	{
+		const int32 Pass = FMath::Min<int32>(Count - Done, FTelemetryRing::Capacity);
+
+		const double Start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Pass; ++i)
+		{
+			FGameplayTelemetry::Record(ETelemetryEvent::Vitals, 0, 0, 0, Data);
+		}
+		GameThreadSeconds += FPlatformTime::Seconds() - Start;
+
+		Done += Pass;
+		GameplayTelemetry::WaitForDrain();
+	}
+	const double GameThreadNs = GameThreadSeconds * 1e9 / Count;
+	const uint64 GameThreadDropped = FGameplayTelemetry::GetNumDropped() - DroppedBefore;
+
+	// Tasks may share a thread, and so a ring, so each records a slice of one ring per pass
+	constexpr int32 NumThreads = 4;
+	double ParallelSeconds = 0.0;
+	for (int32 Done = 0; Done < Count; )
+	{
+		const int32 Pass = FMath::Min<int32>(Count - Done, FTelemetryRing::Capacity / NumThreads);
+
+		const double Start = FPlatformTime::Seconds();
+		ParallelFor(NumThreads, [Pass, &Data](int32)
+		{
+			for (int32 i = 0; i < Pass; ++i)
+			{
+				FGameplayTelemetry::Record(ETelemetryEvent::Vitals, 0, 0, 0, Data);
+			}
+		});
+		ParallelSeconds += FPlatformTime::Seconds() - Start;
+
+		Done += Pass;
+		GameplayTelemetry::WaitForDrain();
+	}
+	const double ParallelNs = ParallelSeconds * 1e9 / Count;
+	const uint64 ParallelDropped = FGameplayTelemetry::GetNumDropped() - DroppedBefore - GameThreadDropped;
+
+	// Record has to stay cheap enough to leave in every gameplay path
+	constexpr double TargetNs = 50.0;
+	UE_LOG(LogGAM312, Log, TEXT("Telemetry.Bench: %.1f ns per event on the game thread (%llu dropped), %.1f ns per event per thread with %d threads recording (%llu dropped) (%s the %.0f ns target)."),
+		GameThreadNs, GameThreadDropped, ParallelNs, NumThreads, ParallelDropped,
+		FMath::Max(GameThreadNs, ParallelNs) < TargetNs ? TEXT("within") : TEXT("over"), TargetNs);
+}
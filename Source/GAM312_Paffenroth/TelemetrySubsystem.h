@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Containers/Ticker.h"
+#include <atomic>
+#include "TelemetrySubsystem.generated.h"
+
+class FTelemetryWriter;
+
+// Gameplay events. Amount is summed into the player's counter for the event type.
+enum class ETelemetryEvent : uint8
+{
+	Harvest,         // Subtype: resource index. Amount: materials gained. Data: hit location.
+	Build,           // Subtype: part type. Amount: parts placed. Data: part location.
+	Vitals,          // Data: health, hunger, stamina. Not counted.
+	CraftQueued,     // Subtype: recipe index. Amount: items queued.
+	CraftCompleted,  // Subtype: building index. Amount: items granted.
+	Count
+};
+
+// One event as it is buffered and written to disk
+struct FTelemetryEvent
+{
+	uint64 Cycles = 0;
+	uint32 Player = 0;
+	ETelemetryEvent Type = ETelemetryEvent::Harvest;
+	uint8 Subtype = 0;
+	uint16 Reserved = 0;
+	int32 Amount = 0;
+	FVector3f Data = FVector3f::ZeroVector;
+};
+static_assert(sizeof(FTelemetryEvent) == 32, "Telemetry files assume 32-byte events");
+
+/**
+ * Single-producer single-consumer ring owned by one recording thread and drained by the
+ * telemetry writer. Events are dropped, and counted, when the ring is full.
+ */
+class FTelemetryRing
+{
+public:
+	static constexpr uint32 Capacity = 8192;
+
+	bool Push(const FTelemetryEvent& Event)
+	{
+		const uint32 CurrentHead = Head.load(std::memory_order_relaxed);
+
+		// Only look at the consumer's cache line when the stale copy says we are full
+		if (CurrentHead - CachedTail >= Capacity)
+		{
+			CachedTail = Tail.load(std::memory_order_acquire);
+			if (CurrentHead - CachedTail >= Capacity)
+			{
+				Dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+		}
+
+		Events[CurrentHead & (Capacity - 1)] = Event;
+		Head.store(CurrentHead + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side. Appends every pending event to Out.
+	void Drain(TArray<FTelemetryEvent>& Out)
+	{
+		const uint32 CurrentTail = Tail.load(std::memory_order_relaxed);
+		const uint32 CurrentHead = Head.load(std::memory_order_acquire);
+
+		for (uint32 i = CurrentTail; i != CurrentHead; ++i)
+		{
+			Out.Add(Events[i & (Capacity - 1)]);
+		}
+		Tail.store(CurrentHead, std::memory_order_release);
+	}
+
+	// Events pushed but not yet drained. Safe from any thread.
+	uint32 NumPending() const
+	{
+		return Head.load(std::memory_order_acquire) - Tail.load(std::memory_order_acquire);
+	}
+
+	std::atomic<uint64> Dropped { 0 };
+
+private:
+	// Written by the producer
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint32> Head { 0 };
+	uint32 CachedTail = 0;
+
+	// Written by the consumer
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint32> Tail { 0 };
+
+	FTelemetryEvent Events[Capacity];
+};
+
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnTelemetryCounterChanged, uint32 /*Player*/, ETelemetryEvent /*Type*/, int64 /*Total*/);
+
+/**
+ * Recording API for gameplay code. Record only writes into the calling thread's ring, so it
+ * is safe and cheap from any thread; the writer thread does everything else.
+ */
+class GAM312_PAFFENROTH_API FGameplayTelemetry
+{
+public:
+	static void Record(ETelemetryEvent Type, uint32 Player, int32 Amount, uint8 Subtype = 0, const FVector3f& Data = FVector3f::ZeroVector)
+	{
+		if (!bEnabled.load(std::memory_order_relaxed)) return;
+
+		FTelemetryEvent Event;
+		Event.Cycles = FPlatformTime::Cycles64();
+		Event.Player = Player;
+		Event.Type = Type;
+		Event.Subtype = Subtype;
+		Event.Amount = Amount;
+		Event.Data = Data;
+		GetThreadRing().Push(Event);
+	}
+
+	// Id events are recorded under for a player object
+	static uint32 PlayerId(const UObject* Player) { return Player ? Player->GetUniqueID() : 0; }
+
+	// Running total of a player's events of one type. Game thread only.
+	static int64 GetCounter(uint32 Player, ETelemetryEvent Type);
+
+	// Events waiting in any ring, and events dropped by every ring so far. Safe from any thread.
+	static uint32 GetNumPending();
+	static uint64 GetNumDropped();
+
+	// Fired on the game thread as written events update a counter. For tools and debug views;
+	// gameplay keeps its own counts, since events can be dropped.
+	static FOnTelemetryCounterChanged& OnCounterChanged();
+
+private:
+	friend class FTelemetryWriter;
+	friend class UTelemetrySubsystem;
+
+	static FTelemetryRing& GetThreadRing();
+
+	// Moves every ring's pending events into Out. Writer thread only.
+	static void DrainRings(TArray<FTelemetryEvent>& Out, uint64& OutDropped);
+
+	static std::atomic<bool> bEnabled;
+};
+
+/**
+ * Owns the telemetry writer thread, which drains every recording thread's ring, writes the
+ * events to rotating compressed files under Saved/Telemetry, and feeds the per-player
+ * counters that tools and debug views subscribe to. One instance per process writes; PIE
+ * clients share it.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UTelemetrySubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+// --- Settings ---
+
+	UPROPERTY(Config)
+		bool bEnabled = true;
+
+	// Seconds between writer passes
+	UPROPERTY(Config)
+		float FlushInterval = 0.05f;
+
+	// Uncompressed bytes gathered before a block is compressed and written
+	UPROPERTY(Config)
+		int32 BlockBytes = 65536;
+
+	// A new file is started once the current one passes this size
+	UPROPERTY(Config)
+		int32 MaxFileBytes = 16 * 1024 * 1024;
+
+	// Oldest files are deleted beyond this count
+	UPROPERTY(Config)
+		int32 MaxFiles = 8;
+
+private:
+	// Applies counter deltas from the writer and broadcasts them
+	bool TickCounters(float DeltaTime);
+
+	// Set on the instance that owns the writer thread, deleted in Deinitialize
+	FTelemetryWriter* Writer = nullptr;
+
+	FTSTicker::FDelegateHandle TickerHandle;
+};
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "BuildingDecaySubsystem.h"
+#include "BuildingRegistrySubsystem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBuildingDecayDamageTest, "GAM312.Building.Decay.DamageKillsPart", GAM312_TEST_FLAGS)
+
+bool FBuildingDecayDamageTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UBuildingDecaySubsystem* Decay = World.Subsystem<UBuildingDecaySubsystem>();
+	UBuildingRegistrySubsystem* Registry = World.Subsystem<UBuildingRegistrySubsystem>();
+	if (!TestNotNull(TEXT("Decay"), Decay) || !TestNotNull(TEXT("Registry"), Registry)) return false;
+
+	const FBuildingPartHandle Part = Registry->AddPartData(EBuildingPartType::Floor, FTransform::Identity, FVector(200.f, 200.f, 10.f), 100.f, 0.1f);
+
+	Decay->ApplyDamage(Part, 60.f);
+	TestTrue(TEXT("Survives partial damage"), Registry->IsValid(Part));
+
+	Decay->RepairPart(Part);
+	TestEqual(TEXT("Repair restores full health"), Registry->GetStore().Health[Registry->ToDense(Part)], 100.f);
+
+	Decay->ApplyDamage(Part, 60.f);
+	TestTrue(TEXT("Repaired part survives the same hit"), Registry->IsValid(Part));
+
+	// A part without an actor has nothing to collapse, but still leaves the registry
+	Decay->ApplyDamage(Part, 60.f);
+	TestFalse(TEXT("Killed by damage past its health"), Registry->IsValid(Part));
+	TestEqual(TEXT("Registry empty"), Registry->Num(), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBuildingDecaySliceTest, "GAM312.Building.Decay.SliceIsBounded", GAM312_TEST_FLAGS)
+
+bool FBuildingDecaySliceTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UBuildingDecaySubsystem* Decay = World.Subsystem<UBuildingDecaySubsystem>();
+	UBuildingRegistrySubsystem* Registry = World.Subsystem<UBuildingRegistrySubsystem>();
+	if (!TestNotNull(TEXT("Decay"), Decay) || !TestNotNull(TEXT("Registry"), Registry)) return false;
+
+	constexpr int32 NumParts = 5000;
+	Decay->AddSyntheticParts(NumParts, 100.f, 0.1f);
+	Decay->AmortisePeriod = 1.f;
+	Decay->MaxSlicePerFrame = 64;
+
+	// Every part is dead, so each part the slice reaches is removed and the slice can be counted
+	for (float& Health : Registry->GetStore().Health)
+	{
+		Health = 0.f;
+	}
+
+	Decay->Tick(1.f);
+	TestEqual(TEXT("One frame processes at most MaxSlicePerFrame parts"), Registry->Num(), NumParts - 64);
+
+	// A short frame asks for less than the cap
+	Decay->Tick(0.001f);
+	const int32 Wanted = FMath::CeilToInt((NumParts - 64) * 0.001f);
+	TestEqual(TEXT("Short frames process their share of the store"), Registry->Num(), NumParts - 64 - Wanted);
+	return true;
+}
+
+#endif
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "BuildingChunkSubsystem.h"
+#include "BuildingHibernationSubsystem.h"
+#include "BuildingRegistrySubsystem.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBuildingHibernationSoakTest, "GAM312.Building.Hibernation.ResidentPartsStayBounded", GAM312_TEST_FLAGS)
+
+bool FBuildingHibernationSoakTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UBuildingHibernationSubsystem* Hibernation = World.Subsystem<UBuildingHibernationSubsystem>();
+	UBuildingRegistrySubsystem* Registry = World.Subsystem<UBuildingRegistrySubsystem>();
+	UBuildingChunkSubsystem* Chunks = World.Subsystem<UBuildingChunkSubsystem>();
+	if (!TestNotNull(TEXT("Hibernation"), Hibernation) || !TestNotNull(TEXT("Registry"), Registry) || !TestNotNull(TEXT("Chunks"), Chunks)) return false;
+
+	// A short version of Building.HibernationSoak: with no players in the world, each day's
+	// parts must all go to sleep and none may stay resident
+	constexpr int32 Days = 5;
+	constexpr int32 PartsPerDay = 200;
+
+	FRandomStream Random(Days);
+	for (int32 Day = 0; Day < Days; ++Day)
+	{
+		const FVector Origin(Day * Chunks->ChunkSize * 8.f, 0.f, 0.f);
+		for (int32 i = 0; i < PartsPerDay; ++i)
+		{
+			const FVector Offset(Random.FRandRange(0.f, Chunks->ChunkSize * 2.f), Random.FRandRange(0.f, Chunks->ChunkSize * 2.f), 0.f);
+			Registry->AddPartData(EBuildingPartType::Floor, FTransform(Origin + Offset), FVector(200.f, 200.f, 10.f), 500.f, 0.1f);
+		}
+		TestEqual(FString::Printf(TEXT("Day %d resident before sleep"), Day + 1), Registry->Num(), PartsPerDay);
+
+		Hibernation->Tick(Hibernation->CheckInterval);
+		Hibernation->HibernateIdleChunks(0.0, MAX_int32);
+		Hibernation->FlushWrites();
+
+		TestEqual(FString::Printf(TEXT("Day %d resident after sleep"), Day + 1), Registry->Num(), 0);
+		TestEqual(FString::Printf(TEXT("Day %d hibernated parts"), Day + 1), Hibernation->GetNumHibernatedParts(), (Day + 1) * PartsPerDay);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBuildingHibernationClusterTest, "GAM312.Building.Hibernation.ClusterRoundTrip", GAM312_TEST_FLAGS)
+
+bool FBuildingHibernationClusterTest::RunTest(const FString& Parameters)
+{
+	FHibernatedCluster Cluster;
+	Cluster.Key = FIntVector(3, -2, 0);
+	Cluster.HibernatedAt = 1234.5;
+	Cluster.Classes.Add(TEXT("/Game/Blueprints/BP_Floor.BP_Floor_C"));
+	Cluster.Owners.Add(TEXT("PlayerA"));
+	Cluster.Owners.Add(TEXT("PlayerB"));
+
+	FHibernatedPart& Owned = Cluster.Parts.AddDefaulted_GetRef();
+	Owned.ClassIndex = 0;
+	Owned.OwnerIndex = 1;
+	Owned.Type = EBuildingPartType::Wall;
+	Owned.Transform = FTransform(FRotator(0.f, 90.f, 0.f), FVector(100.f, 200.f, 300.f));
+	Owned.Health = 250.f;
+	Owned.Supports[0] = 1;
+
+	FHibernatedPart& Unowned = Cluster.Parts.AddDefaulted_GetRef();
+	Unowned.Health = 80.f;
+
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	Writer << Cluster;
+
+	FHibernatedCluster Loaded;
+	FMemoryReader Reader(Bytes);
+	Reader << Loaded;
+
+	TestFalse(TEXT("Reads back cleanly"), Reader.IsError());
+	TestEqual(TEXT("Key"), Loaded.Key, Cluster.Key);
+	TestEqual(TEXT("Owner table"), Loaded.Owners, Cluster.Owners);
+	if (!TestEqual(TEXT("Part count"), Loaded.Parts.Num(), 2)) return false;
+
+	TestEqual(TEXT("Owner index"), Loaded.Parts[0].OwnerIndex, 1);
+	TestEqual(TEXT("Type"), (uint8)Loaded.Parts[0].Type, (uint8)EBuildingPartType::Wall);
+	TestEqual(TEXT("Location"), Loaded.Parts[0].Transform.GetLocation(), FVector(100.f, 200.f, 300.f));
+	TestEqual(TEXT("Support"), Loaded.Parts[0].Supports[0], 1);
+	TestEqual(TEXT("Unowned stays unowned"), Loaded.Parts[1].OwnerIndex, (int32)INDEX_NONE);
+	TestEqual(TEXT("Health"), Loaded.Parts[1].Health, 80.f);
+	return true;
+}
+
+#endif
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "BuildingPart.h"
+#include "BuildingPlacementSubsystem.h"
+#include "BuildingRegistrySubsystem.h"
+#include "BuildingSnapRules.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBuildingPlacementConflictTest, "GAM312.Building.Placement.OneWinnerPerSpot", GAM312_TEST_FLAGS)
+
+bool FBuildingPlacementConflictTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UBuildingPlacementSubsystem* Placement = World.Subsystem<UBuildingPlacementSubsystem>();
+	if (!TestNotNull(TEXT("Placement"), Placement)) return false;
+
+	// Flat ground with its top at zero. A part without a mesh is a 100 cm floor, so a floor
+	// centred 50 cm up stands on it.
+	World.SpawnBlockingBox(FVector(0.f, 0.f, -100.f), FVector(2000.f, 2000.f, 100.f));
+	const FTransform Spot(FVector(0.f, 0.f, 50.f));
+	const FTransform Overlapping(FVector(30.f, 0.f, 50.f));
+	const FTransform Apart(FVector(500.f, 0.f, 50.f));
+
+	// Two unowned requests for nearly the same spot in one batch: the earlier one wins
+	Placement->QueuePlacement(nullptr, ABuildingPart::StaticClass(), Spot, INDEX_NONE);
+	Placement->QueuePlacement(nullptr, ABuildingPart::StaticClass(), Overlapping, INDEX_NONE);
+	Placement->QueuePlacement(nullptr, ABuildingPart::StaticClass(), Apart, INDEX_NONE);
+
+	TArray<ABuildingPart*> Placed;
+	TestEqual(TEXT("Both non-overlapping requests placed"), Placement->ResolveBatch(&Placed), 2);
+	TestEqual(TEXT("Later overlapping request conflicts"), Placement->GetLastRejected(EPlacementRejectReason::Conflict), 1);
+	TestEqual(TEXT("Nothing left waiting"), Placement->GetNumPending(), 0);
+	if (TestEqual(TEXT("Placed parts returned"), Placed.Num(), 2))
+	{
+		TestEqual(TEXT("First request kept its spot"), Placed[0]->GetActorLocation(), Spot.GetLocation());
+	}
+
+	// The next batch cannot take the spot either, before or after chunk collision catches up
+	Placement->QueuePlacement(nullptr, ABuildingPart::StaticClass(), Overlapping, INDEX_NONE);
+	TestEqual(TEXT("Taken spot is not placed again"), Placement->ResolveBatch(), 0);
+	TestEqual(TEXT("Taken spot is blocked"), Placement->GetLastRejected(EPlacementRejectReason::Blocked), 1);
+
+	// A floor hanging in the air has no ground under it
+	Placement->QueuePlacement(nullptr, ABuildingPart::StaticClass(), FTransform(FVector(1000.f, 0.f, 800.f)), INDEX_NONE);
+	TestEqual(TEXT("Floating floor not placed"), Placement->ResolveBatch(), 0);
+	TestEqual(TEXT("Floating floor has no ground"), Placement->GetLastRejected(EPlacementRejectReason::NoGround), 1);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBuildingPlacementSocketTest, "GAM312.Building.Placement.SupportNeedsSocket", GAM312_TEST_FLAGS)
+
+bool FBuildingPlacementSocketTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UBuildingRegistrySubsystem* Registry = World.Subsystem<UBuildingRegistrySubsystem>();
+	if (!TestNotNull(TEXT("Registry"), Registry)) return false;
+
+	const FCompiledSnapTable& Table = GetDefault<UBuildingSnapRules>()->GetTable();
+	const int32 Wall = (int32)EBuildingPartType::Wall;
+	if (!TestTrue(TEXT("Default rules snap walls"), Table.GetCandidates(Wall).Num() > 0)) return false;
+
+	const FVector WallExtent(100.f, 10.f, 100.f);
+	const FBuildingPartHandle Floor = Registry->AddPartData(EBuildingPartType::Floor, FTransform::Identity, FVector(100.f, 100.f, 10.f), 100.f, 0.f);
+
+	// Where the wall rule puts a wall on the floor's first edge, as the preview solve does
+	const FCompiledSnapCandidate& Candidate = Table.GetCandidates(Wall)[0];
+	const FTransform SocketT = Registry->GetSnapTransform(Floor, Candidate.TargetSocket);
+	const FQuat Q = FRotator(0.f, SocketT.Rotator().Yaw + Candidate.YawOffset, 0.f).Quaternion();
+	const FVector PartSocket = ABuildingPart::GetSocketRelativeTransform(EBuildingPartType::Wall, WallExtent, Candidate.PartSocket).GetLocation();
+	const FTransform Snapped(Q, SocketT.GetLocation() + Q.RotateVector(Candidate.Offset - PartSocket));
+
+	FPlacementSupports Supports;
+	TestTrue(TEXT("Wall on the socket is supported"),
+		UBuildingPlacementSubsystem::FindSupports(*Registry, Table, Wall, Snapped, WallExtent, 300.f, Supports));
+
+	// Near the floor is not enough: an offset or turned wall matches no socket
+	FTransform Shifted = Snapped;
+	Shifted.AddToTranslation(Q.RotateVector(FVector(40.f, 0.f, 0.f)));
+	TestFalse(TEXT("Wall off the socket is not supported"),
+		UBuildingPlacementSubsystem::FindSupports(*Registry, Table, Wall, Shifted, WallExtent, 300.f, Supports));
+
+	FTransform Turned = Snapped;
+	Turned.SetRotation(Q * FRotator(0.f, 45.f, 0.f).Quaternion());
+	TestFalse(TEXT("Wall at the wrong yaw is not supported"),
+		UBuildingPlacementSubsystem::FindSupports(*Registry, Table, Wall, Turned, WallExtent, 300.f, Supports));
+	return true;
+}
+
+#endif
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "BuildingRegistrySubsystem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBuildingRegistryHandleTest, "GAM312.Building.Registry.HandlesGoStale", GAM312_TEST_FLAGS)
+
+bool FBuildingRegistryHandleTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UBuildingRegistrySubsystem* Registry = World.Subsystem<UBuildingRegistrySubsystem>();
+	if (!TestNotNull(TEXT("Registry"), Registry)) return false;
+
+	const FVector Extent(200.f, 200.f, 10.f);
+	const FBuildingPartHandle A = Registry->AddPartData(EBuildingPartType::Floor, FTransform(FVector(0.f, 0.f, 0.f)), Extent, 500.f, 0.1f);
+	const FBuildingPartHandle B = Registry->AddPartData(EBuildingPartType::Floor, FTransform(FVector(400.f, 0.f, 0.f)), Extent, 500.f, 0.1f);
+
+	int32 RemovedBroadcasts = 0;
+	Registry->OnPartRemoved.AddLambda([&](FBuildingPartHandle Handle) { RemovedBroadcasts += Handle == A ? 1 : 0; });
+
+	Registry->RemovePart(A);
+	TestEqual(TEXT("Removal is broadcast"), RemovedBroadcasts, 1);
+	TestFalse(TEXT("Removed handle is stale"), Registry->IsValid(A));
+
+	// Removing a stale handle again changes nothing
+	Registry->RemovePart(A);
+	TestEqual(TEXT("Stale removal ignored"), Registry->Num(), 1);
+	TestEqual(TEXT("Stale removal not broadcast"), RemovedBroadcasts, 1);
+
+	// The swap moved B into A's dense slot; its handle must still resolve to it
+	TestTrue(TEXT("Survivor still valid"), Registry->IsValid(B));
+	TestEqual(TEXT("Survivor kept its data"), Registry->GetStore().Location[Registry->ToDense(B)], FVector(400.f, 0.f, 0.f));
+
+	const FBuildingPartHandle C = Registry->AddPartData(EBuildingPartType::Wall, FTransform(FVector(800.f, 0.f, 0.f)), Extent, 500.f, 0.1f);
+	TestEqual(TEXT("Slot is reused"), C.GetIndex(), A.GetIndex());
+	TestNotEqual(TEXT("Reused slot has a new generation"), C.Value, A.Value);
+	TestFalse(TEXT("Old handle does not resolve to the new part"), Registry->IsValid(A));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBuildingRegistryNearestTest, "GAM312.Building.Registry.FindNearest", GAM312_TEST_FLAGS)
+
+bool FBuildingRegistryNearestTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UBuildingRegistrySubsystem* Registry = World.Subsystem<UBuildingRegistrySubsystem>();
+	if (!TestNotNull(TEXT("Registry"), Registry)) return false;
+
+	const FVector Extent(200.f, 200.f, 10.f);
+	const FBuildingPartHandle Near = Registry->AddPartData(EBuildingPartType::Floor, FTransform(FVector(100.f, 0.f, 0.f)), Extent, 500.f, 0.1f);
+	const FBuildingPartHandle Far = Registry->AddPartData(EBuildingPartType::Floor, FTransform(FVector(900.f, 0.f, 0.f)), Extent, 500.f, 0.1f);
+	Registry->AddPartData(EBuildingPartType::Wall, FTransform(FVector(0.f, 0.f, 0.f)), Extent, 500.f, 0.1f);
+
+	TestEqual(TEXT("Closest floor, walls ignored"), Registry->FindNearest(FVector::ZeroVector, EBuildingPartType::Floor, 2000.f).Value, Near.Value);
+	TestEqual(TEXT("Ignored part is skipped"), Registry->FindNearest(FVector::ZeroVector, EBuildingPartType::Floor, 2000.f, Near).Value, Far.Value);
+	TestFalse(TEXT("Nothing beyond the radius"), Registry->FindNearest(FVector::ZeroVector, EBuildingPartType::Floor, 50.f).IsValid());
+	return true;
+}
+
+#endif
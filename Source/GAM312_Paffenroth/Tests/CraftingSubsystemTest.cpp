@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "CraftingSubsystem.h"
+#include "PlayerChar.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCraftingRecipeCostTest, "GAM312.Crafting.ChargesRecipeCost", GAM312_TEST_FLAGS)
+
+bool FCraftingRecipeCostTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UCraftingSubsystem* Crafting = World.Subsystem<UCraftingSubsystem>();
+	APlayerChar* Player = World.Get()->SpawnActor<APlayerChar>();
+	if (!TestNotNull(TEXT("Crafting"), Crafting) || !TestNotNull(TEXT("Player"), Player)) return false;
+
+	FCraftingRecipe& Recipe = Crafting->Recipes.AddDefaulted_GetRef();
+	Recipe.Name = TEXT("TestFloor");
+	Recipe.WoodCost = 10;
+	Recipe.StoneCost = 5;
+
+	Player->ResourcesArray = { 100, 100, 0 };
+
+	// A client asking for a free part still pays what the recipe costs
+	Player->UpdateResources(0.f, 0.f, TEXT("TestFloor"));
+	TestEqual(TEXT("Wood charged at the recipe cost"), Player->ResourcesArray[0], 90);
+	TestEqual(TEXT("Stone charged at the recipe cost"), Player->ResourcesArray[1], 95);
+
+	// Negative amounts cannot pay the player either
+	Player->UpdateResources(-50.f, -50.f, TEXT("TestFloor"));
+	TestEqual(TEXT("Negative wood ignored"), Player->ResourcesArray[0], 80);
+	TestEqual(TEXT("Negative stone ignored"), Player->ResourcesArray[1], 90);
+
+	// The RPC body takes only the recipe name
+	Player->ServerUpdateResources_Implementation(TEXT("TestFloor"));
+	TestEqual(TEXT("RPC charged at the recipe cost"), Player->ResourcesArray[0], 70);
+
+	const FCraftQueue* Queue = Crafting->GetQueue(Player);
+	if (!TestNotNull(TEXT("Queue exists"), Queue)) return false;
+	TestEqual(TEXT("One order per request"), Queue->Orders.Num(), 3);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCraftingQueueSummaryTest, "GAM312.Crafting.SummaryFollowsQueue", GAM312_TEST_FLAGS)
+
+bool FCraftingQueueSummaryTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UCraftingSubsystem* Crafting = World.Subsystem<UCraftingSubsystem>();
+	APlayerChar* Player = World.Get()->SpawnActor<APlayerChar>();
+	if (!TestNotNull(TEXT("Crafting"), Crafting) || !TestNotNull(TEXT("Player"), Player)) return false;
+
+	FCraftingRecipe& Recipe = Crafting->Recipes.AddDefaulted_GetRef();
+	Recipe.Name = TEXT("TestFloor");
+	Recipe.Duration = 1.f;
+	Player->ResourcesArray = { 100, 100, 0 };
+
+	int32 Updates = 0;
+	Player->OnCraftQueueUpdated.AddLambda([&Updates]() { ++Updates; });
+
+	// The replicated summary is what a client's crafting widget reads
+	TestTrue(TEXT("Queued"), Crafting->QueueRecipe(Player, 0, 3));
+	TestEqual(TEXT("Queueing updates the summary"), Updates, 1);
+	if (!TestEqual(TEXT("One summary order"), Player->CraftQueue.Orders.Num(), 1)) return false;
+	TestEqual(TEXT("Summary count"), (int32)Player->CraftQueue.Orders[0].Remaining, 3);
+
+	// Progress alone does not change the summary; a finished item does
+	Crafting->Tick(0.5f);
+	TestEqual(TEXT("No update mid-item"), Updates, 1);
+	Crafting->Tick(0.75f);
+	TestEqual(TEXT("Completion updates the summary"), Updates, 2);
+	TestEqual(TEXT("One item done"), (int32)Player->CraftQueue.Orders[0].Remaining, 2);
+
+	Crafting->CancelOrder(Player, 0);
+	TestEqual(TEXT("Cancelled order leaves the summary"), Player->CraftQueue.Orders.Num(), 0);
+
+	// A player who leaves with an empty queue still takes it with them
+	TestEqual(TEXT("Empty queue kept while the player is here"), Crafting->GetNumQueues(), 1);
+	Player->Destroy();
+	Crafting->Tick(0.1f);
+	TestEqual(TEXT("Departed player's empty queue freed"), Crafting->GetNumQueues(), 0);
+	return true;
+}
+
+#endif
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "FrameBudgetSubsystem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFrameBudgetHysteresisTest, "GAM312.Gameplay.FrameBudget.Hysteresis", GAM312_TEST_FLAGS)
+
+bool FFrameBudgetHysteresisTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UFrameBudgetSubsystem* Governor = World.Subsystem<UFrameBudgetSubsystem>();
+	if (!TestNotNull(TEXT("Governor"), Governor)) return false;
+
+	Governor->bEnabled = true;
+	Governor->TargetMs = 16.f;
+	Governor->OverMargin = 0.1f;
+	Governor->UnderMargin = 0.25f;
+	Governor->DegradeDelay = 0.5f;
+	Governor->RecoverDelay = 3.f;
+	Governor->NumLevels = 4;
+	Governor->MinPreviewSolveScale = 0.25f;
+
+	// Frames an eighth of a second apart sum exactly, and a short time constant makes the
+	// average follow each frame, so every step below is one frame
+	Governor->SmoothingTime = 0.001f;
+	constexpr float Step = 0.125f;
+
+	for (int32 i = 0; i < 3; ++i)
+	{
+		Governor->AddFrame(30.f, Step);
+	}
+	TestEqual(TEXT("Not degraded before DegradeDelay"), Governor->GetLevel(), 0);
+
+	Governor->AddFrame(30.f, Step);
+	TestEqual(TEXT("Degraded after DegradeDelay over budget"), Governor->GetLevel(), 1);
+	TestEqual(TEXT("Knob scaled a quarter of the way to its minimum"), Governor->GetScale(EFrameBudgetKnob::PreviewSolve), 0.8125f);
+
+	// Inside the band around the target nothing changes, however long it lasts
+	for (int32 i = 0; i < 100; ++i)
+	{
+		Governor->AddFrame(16.f, Step);
+	}
+	TestEqual(TEXT("Holds its level near the target"), Governor->GetLevel(), 1);
+
+	// Three over-budget frames, one in the band, three more: the timer restarts, so no step
+	for (int32 i = 0; i < 3; ++i)
+	{
+		Governor->AddFrame(30.f, Step);
+	}
+	Governor->AddFrame(16.f, Step);
+	for (int32 i = 0; i < 3; ++i)
+	{
+		Governor->AddFrame(30.f, Step);
+	}
+	TestEqual(TEXT("Interrupted overload does not degrade"), Governor->GetLevel(), 1);
+
+	Governor->AddFrame(16.f, Step);
+	for (int32 i = 0; i < 23; ++i)
+	{
+		Governor->AddFrame(8.f, Step);
+	}
+	TestEqual(TEXT("Not recovered before RecoverDelay"), Governor->GetLevel(), 1);
+
+	Governor->AddFrame(8.f, Step);
+	TestEqual(TEXT("Recovered after RecoverDelay under budget"), Governor->GetLevel(), 0);
+	TestEqual(TEXT("Knob back at full fidelity"), Governor->GetScale(EFrameBudgetKnob::PreviewSolve), 1.f);
+
+	// Turning the governor off restores full fidelity at once
+	for (int32 i = 0; i < 4; ++i)
+	{
+		Governor->AddFrame(30.f, Step);
+	}
+	Governor->bEnabled = false;
+	Governor->AddFrame(30.f, Step);
+	TestEqual(TEXT("Disabled governor runs at level 0"), Governor->GetLevel(), 0);
+	return true;
+}
+
+#endif
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Components/BoxComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+
+// Flags shared by the module's behaviour tests ("Automation RunTests GAM312")
+#define GAM312_TEST_FLAGS (EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+/**
+ * An empty standalone game world for the length of a test, with its world subsystems
+ * created and play begun. Tickable subsystems are not ticked by the engine here; tests
+ * call Tick themselves so every step is deterministic.
+ */
+class FGAM312TestWorld
+{
+public:
+	FGAM312TestWorld()
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("GAM312TestWorld"));
+
+		FWorldContext& Context = GEngine->CreateNewWorldContext(EWorldType::Game);
+		Context.SetCurrentWorld(World);
+
+		World->InitializeActorsForPlay(FURL());
+		World->BeginPlay();
+	}
+
+	~FGAM312TestWorld()
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+	}
+
+	UWorld* Get() const { return World; }
+
+	template<typename T>
+	T* Subsystem() const { return World->GetSubsystem<T>(); }
+
+	// A blocking box for traces and overlaps to find, standing in for ground or a structure
+	AActor* SpawnBlockingBox(const FVector& Center, const FVector& Extent) const
+	{
+		AActor* Actor = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform(Center));
+		UBoxComponent* Box = NewObject<UBoxComponent>(Actor);
+		Box->SetBoxExtent(Extent);
+		Box->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+		Actor->SetRootComponent(Box);
+		Box->RegisterComponent();
+		Actor->SetActorLocation(Center);
+		return Actor;
+	}
+
+private:
+	UWorld* World = nullptr;
+};
+
+#endif
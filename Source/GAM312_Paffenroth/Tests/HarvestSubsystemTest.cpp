@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "HarvestSubsystem.h"
+#include "PlayerChar.h"
+#include "ResourceNodeSubsystem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHarvestSharedNodeTest, "GAM312.Harvest.SharedNodeIsCapped", GAM312_TEST_FLAGS)
+
+bool FHarvestSharedNodeTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UHarvestSubsystem* Harvest = World.Subsystem<UHarvestSubsystem>();
+	UResourceNodeSubsystem* Nodes = World.Subsystem<UResourceNodeSubsystem>();
+	if (!TestNotNull(TEXT("Harvest"), Harvest) || !TestNotNull(TEXT("Nodes"), Nodes)) return false;
+
+	// Two swings at a full node each get the full yield
+	const int32 Full = Nodes->RegisterNode(FVector(0.f, 0.f, 0.f), EResourceType::Wood, 100, 5);
+	Harvest->QueueHarvest(nullptr, Full, FVector::ZeroVector);
+	Harvest->QueueHarvest(nullptr, Full, FVector::ZeroVector);
+	TestEqual(TEXT("Full yield for every swing"), Harvest->ResolveHarvests(), 10);
+	TestEqual(TEXT("Node keeps the rest"), Nodes->GetNode(Full)->Remaining, 90);
+
+	// Three swings wanting 12 from a node with 10 left share the 10, and the node goes
+	const int32 Short = Nodes->RegisterNode(FVector(500.f, 0.f, 0.f), EResourceType::Stone, 10, 4);
+	for (int32 i = 0; i < 3; ++i)
+	{
+		Harvest->QueueHarvest(nullptr, Short, FVector::ZeroVector);
+	}
+	TestEqual(TEXT("Grants capped by what the node had"), Harvest->ResolveHarvests(), 10);
+	TestNull(TEXT("Depleted node removed"), Nodes->GetNode(Short));
+
+	// A swing at the removed node's id yields nothing, even once its slot is reused
+	const int32 Reused = Nodes->RegisterNode(FVector(1000.f, 0.f, 0.f), EResourceType::Berry, 10, 4);
+	Harvest->QueueHarvest(nullptr, Short, FVector::ZeroVector);
+	TestEqual(TEXT("Stale id grants nothing"), Harvest->ResolveHarvests(), 0);
+	TestEqual(TEXT("New node untouched"), Nodes->GetNode(Reused)->Remaining, 10);
+	TestEqual(TEXT("Queue drained"), Harvest->GetNumPending(), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHarvestSwingRateTest, "GAM312.Harvest.ServerCapsSwingRate", GAM312_TEST_FLAGS)
+
+bool FHarvestSwingRateTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UHarvestSubsystem* Harvest = World.Subsystem<UHarvestSubsystem>();
+	UResourceNodeSubsystem* Nodes = World.Subsystem<UResourceNodeSubsystem>();
+	APlayerChar* Player = World.Get()->SpawnActor<APlayerChar>();
+	if (!TestNotNull(TEXT("Harvest"), Harvest) || !TestNotNull(TEXT("Nodes"), Nodes) || !TestNotNull(TEXT("Player"), Player)) return false;
+
+	Nodes->RegisterNode(Player->GetActorLocation(), EResourceType::Wood, 100, 5);
+	Player->Stamina = 100.f;
+
+	// World time stands still here, so only the burst allowance is accepted
+	for (int32 i = 0; i < 5; ++i)
+	{
+		Player->ServerHarvestSwing_Implementation(EResourceType::Wood, Player->GetActorLocation(), Player->GetActorLocation());
+	}
+	TestEqual(TEXT("Swings beyond the burst rejected"), Harvest->GetNumPending(), (int32)APlayerChar::HarvestSwingBurst);
+	return true;
+}
+
+#endif
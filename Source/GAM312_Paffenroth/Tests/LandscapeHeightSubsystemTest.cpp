@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "LandscapeHeightSubsystem.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLandscapeHeightGroundTest, "GAM312.Landscape.GroundFollowsTrace", GAM312_TEST_FLAGS)
+
+bool FLandscapeHeightGroundTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	ULandscapeHeightSubsystem* Heights = World.Subsystem<ULandscapeHeightSubsystem>();
+	if (!TestNotNull(TEXT("Height subsystem"), Heights)) return false;
+
+	// A slab with its top at 100, with no landscape anywhere
+	World.SpawnBlockingBox(FVector(0.f, 0.f, 50.f), FVector(500.f, 500.f, 50.f));
+
+	const FCollisionQueryParams Params(SCENE_QUERY_STAT(GroundTest), false);
+	FFootprintHeights Ground;
+
+	TestTrue(TEXT("Finds the slab"), Heights->SampleGround(FVector(0.f, 0.f, 150.f), FVector2D(100.f), 0.f, Params, Ground));
+	TestEqual(TEXT("Slab top is the ground"), Ground.Max, 100.f, 0.5f);
+	TestEqual(TEXT("Single hit, no spread"), Ground.Min, Ground.Max);
+
+	TestFalse(TEXT("Nothing under open air"), Heights->SampleGround(FVector(50000.f, 0.f, 150.f), FVector2D(100.f), 0.f, Params, Ground));
+	TestFalse(TEXT("Nothing beyond the search depth"), Heights->SampleGround(FVector(0.f, 0.f, 100.f + Heights->GroundSearchDown + 100.f), FVector2D(100.f), 0.f, Params, Ground));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLandscapeHeightPrefetchTest, "GAM312.Landscape.PrefetchAroundPlayers", GAM312_TEST_FLAGS)
+
+bool FLandscapeHeightPrefetchTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	ULandscapeHeightSubsystem* Heights = World.Subsystem<ULandscapeHeightSubsystem>();
+	if (!TestNotNull(TEXT("Height subsystem"), Heights)) return false;
+
+	Heights->TileSize = 1000.f;
+	Heights->PrefetchRadius = 1000.f;
+	Heights->PrefetchMs = 1000.f;
+
+	Heights->Tick(0.1f);
+	TestEqual(TEXT("Nothing prefetched without players"), Heights->GetNumTiles(), 0);
+
+	APlayerController* Controller = World.Get()->SpawnActor<APlayerController>();
+	APawn* Pawn = World.Get()->SpawnActor<APawn>();
+	if (!TestNotNull(TEXT("Controller"), Controller) || !TestNotNull(TEXT("Pawn"), Pawn)) return false;
+	Controller->Possess(Pawn);
+
+	// The player's tile and every tile within one tile of it
+	Heights->Tick(0.1f);
+	TestEqual(TEXT("Tiles around the player are built"), Heights->GetNumTiles(), 9);
+
+	Heights->Tick(0.1f);
+	TestEqual(TEXT("Built tiles are not queued again"), Heights->GetNumTiles(), 9);
+	return true;
+}
+
+#endif
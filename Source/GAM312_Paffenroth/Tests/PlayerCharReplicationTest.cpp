@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "PlayerChar.h"
+#include "BuildJournalComponent.h"
+#include "Net/UnrealNetwork.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPlayerCharOwnerStateTest, "GAM312.Player.ServerStateReachesOwner", GAM312_TEST_FLAGS)
+
+bool FPlayerCharOwnerStateTest::RunTest(const FString& Parameters)
+{
+	const APlayerChar* Defaults = GetDefault<APlayerChar>();
+
+	TArray<FLifetimeProperty> Props;
+	Defaults->GetLifetimeReplicatedProps(Props);
+
+	// Inventory, objective counts and the crafting queue change on the server only, through
+	// placement, demolish, undo, redo, crafting and harvesting, so each must replicate to the owning client
+	const FName OwnerState[] = {
+		GET_MEMBER_NAME_CHECKED(APlayerChar, BuildingArray),
+		GET_MEMBER_NAME_CHECKED(APlayerChar, ResourcesArray),
+		GET_MEMBER_NAME_CHECKED(APlayerChar, objectsBuilt),
+		GET_MEMBER_NAME_CHECKED(APlayerChar, matsCollected),
+		GET_MEMBER_NAME_CHECKED(APlayerChar, CraftQueue)
+	};
+
+	for (const FName Name : OwnerState)
+	{
+		const FProperty* Property = FindFProperty<FProperty>(APlayerChar::StaticClass(), Name);
+		if (!TestNotNull(*FString::Printf(TEXT("%s exists"), *Name.ToString()), Property)) continue;
+
+		const FLifetimeProperty* Lifetime = Props.FindByPredicate([Property](const FLifetimeProperty& Prop) { return Prop.RepIndex == Property->RepIndex; });
+		if (!TestNotNull(*FString::Printf(TEXT("%s replicates"), *Name.ToString()), Lifetime)) continue;
+
+		TestEqual(*FString::Printf(TEXT("%s goes to the owner only"), *Name.ToString()), (uint8)Lifetime->Condition, (uint8)COND_OwnerOnly);
+	}
+
+	// Undo and redo from a remote client are server RPCs on the journal
+	TestTrue(TEXT("Journal replicates"), Defaults->BuildJournal && Defaults->BuildJournal->GetIsReplicated());
+	return true;
+}
+
+#endif
@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "ResourceNodeSubsystem.h"
+#include "GAM312GameState.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FResourceNodeStaleIdTest, "GAM312.ResourceNodes.StaleIdsMissReusedSlots", GAM312_TEST_FLAGS)
+
+bool FResourceNodeStaleIdTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UResourceNodeSubsystem* Nodes = World.Subsystem<UResourceNodeSubsystem>();
+	if (!TestNotNull(TEXT("Node subsystem"), Nodes)) return false;
+
+	const int32 Old = Nodes->RegisterNode(FVector(100.f, 0.f, 0.f), EResourceType::Wood, 10, 5);
+	Nodes->UnregisterNode(Old);
+
+	// The next node takes the freed slot under a new generation
+	const int32 New = Nodes->RegisterNode(FVector(200.f, 0.f, 0.f), EResourceType::Stone, 10, 5);
+	TestEqual(TEXT("Slot is reused"), New & UResourceNodeSubsystem::NodeIndexMask, Old & UResourceNodeSubsystem::NodeIndexMask);
+	TestNotEqual(TEXT("Ids differ"), New, Old);
+	TestNull(TEXT("Old id finds nothing"), Nodes->GetNode(Old));
+	TestEqual(TEXT("Consuming through the old id grants nothing"), Nodes->ConsumeFromNode(Old, 5), 0);
+
+	const FResourceNodeRecord* Node = Nodes->GetNode(New);
+	if (!TestNotNull(TEXT("New id finds its node"), Node)) return false;
+	TestEqual(TEXT("New node untouched"), Node->Remaining, 10);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FResourceNodeDepleteTest, "GAM312.ResourceNodes.ConsumeDepletesAndRemoves", GAM312_TEST_FLAGS)
+
+bool FResourceNodeDepleteTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UResourceNodeSubsystem* Nodes = World.Subsystem<UResourceNodeSubsystem>();
+	if (!TestNotNull(TEXT("Node subsystem"), Nodes)) return false;
+
+	const int32 NodeId = Nodes->RegisterNode(FVector::ZeroVector, EResourceType::Berry, 7, 5);
+	TestEqual(TEXT("Found by radius"), Nodes->FindNearestNode(FVector(50.f, 0.f, 0.f), 100.f, EResourceType::Berry), NodeId);
+
+	TestEqual(TEXT("First take is whole"), Nodes->ConsumeFromNode(NodeId, 5), 5);
+	TestEqual(TEXT("Second take is what was left"), Nodes->ConsumeFromNode(NodeId, 5), 2);
+	TestNull(TEXT("Depleted node is removed"), Nodes->GetNode(NodeId));
+	TestEqual(TEXT("Not found once removed"), Nodes->FindNearestNode(FVector::ZeroVector, 100.f, EResourceType::Berry), (int32)INDEX_NONE);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FResourceNodeSharedDepletionTest, "GAM312.ResourceNodes.DepletionIsShared", GAM312_TEST_FLAGS)
+
+bool FResourceNodeSharedDepletionTest::RunTest(const FString& Parameters)
+{
+	FGAM312TestWorld World;
+	UResourceNodeSubsystem* Nodes = World.Subsystem<UResourceNodeSubsystem>();
+	AGAM312GameState* GameState = World.Get()->SpawnActor<AGAM312GameState>();
+	if (!TestNotNull(TEXT("Node subsystem"), Nodes) || !TestNotNull(TEXT("Game state"), GameState)) return false;
+
+	// The server lists what it depletes, by type and location
+	const int32 Depleted = Nodes->RegisterNode(FVector(0.f, 0.f, 0.f), EResourceType::Wood, 5, 5);
+	Nodes->ConsumeFromNode(Depleted, 5);
+	TestEqual(TEXT("Depletion listed"), GameState->GetNumDepletedNodes(), 1);
+
+	// A client removes its own copy: the nearest node of that type, whatever its id
+	const int32 Wood = Nodes->RegisterNode(FVector(10.f, 0.f, 0.f), EResourceType::Wood, 5, 5);
+	const int32 Stone = Nodes->RegisterNode(FVector(0.f, 10.f, 0.f), EResourceType::Stone, 5, 5);
+	TestTrue(TEXT("Matching node removed"), Nodes->RemoveNodeAt(FVector(0.f, 0.f, 0.f), 50.f, EResourceType::Wood));
+	TestNull(TEXT("Local copy gone"), Nodes->GetNode(Wood));
+	TestNotNull(TEXT("Other type kept"), Nodes->GetNode(Stone));
+	TestFalse(TEXT("Nothing left to match"), Nodes->RemoveNodeAt(FVector(0.f, 0.f, 0.f), 50.f, EResourceType::Wood));
+	return true;
+}
+
+#endif
@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "Tests/GAM312TestWorld.h"
+#include "TelemetrySubsystem.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTelemetryRingTest, "GAM312.Telemetry.RingDropsWhenFull", GAM312_TEST_FLAGS)
+
+bool FTelemetryRingTest::RunTest(const FString& Parameters)
+{
+	// Too big for the stack
+	TUniquePtr<FTelemetryRing> Ring = MakeUnique<FTelemetryRing>();
+
+	FTelemetryEvent Event;
+	for (uint32 i = 0; i < FTelemetryRing::Capacity; ++i)
+	{
+		Event.Amount = (int32)i;
+		TestTrue(TEXT("Fits while there is room"), Ring->Push(Event));
+	}
+
+	Event.Amount = -1;
+	TestFalse(TEXT("Full ring refuses"), Ring->Push(Event));
+	TestEqual(TEXT("Refusal counted"), Ring->Dropped.load(), (uint64)1);
+
+	TArray<FTelemetryEvent> Drained;
+	Ring->Drain(Drained);
+	if (!TestEqual(TEXT("Everything accepted drains"), Drained.Num(), (int32)FTelemetryRing::Capacity)) return false;
+	TestEqual(TEXT("Oldest first"), Drained[0].Amount, 0);
+	TestEqual(TEXT("Newest last"), Drained.Last().Amount, (int32)FTelemetryRing::Capacity - 1);
+
+	// Draining frees the slots again, including across the wrap
+	Event.Amount = 7;
+	TestTrue(TEXT("Room again after draining"), Ring->Push(Event));
+	Drained.Reset();
+	Ring->Drain(Drained);
+	TestEqual(TEXT("Wrapped event drains"), Drained.Num(), 1);
+	TestEqual(TEXT("Wrapped event intact"), Drained.Num() > 0 ? Drained[0].Amount : 0, 7);
+	return true;
+}
+
+#endif
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ViewQueryComponent.h"
+#include "GAM312_Paffenroth.h"
+#include "Camera/CameraComponent.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("View Traces"), STAT_ViewTraces, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("View Trace Reuses"), STAT_ViewTraceReuses, STATGROUP_GAM312);
+
+// Camera movement below these is treated as standing still
+static constexpr float ViewReuseLocationTolerance = 0.1f;
+static constexpr float ViewReuseRotationTolerance = 1.e-5f;
+
+UViewQueryComponent::UViewQueryComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+void UViewQueryComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Camera = GetOwner()->FindComponentByClass<UCameraComponent>();
+}
+
+const FViewQueryResult& UViewQueryComponent::GetViewHit()
+{
+	// Everyone asking in the same frame shares one result
+	if (LastQueryFrame == GFrameCounter || !Camera)
+	{
+		return Result;
+	}
+	LastQueryFrame = GFrameCounter;
+
+	const FVector Start = Camera->GetComponentLocation();
+	const FQuat Rotation = Camera->GetComponentQuat();
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	if (LastTraceTime >= 0.0 && Now - LastTraceTime < MaxReuseTime
+		&& Start.Equals(Result.Start, ViewReuseLocationTolerance)
+		&& Rotation.Equals(LastRotation, ViewReuseRotationTolerance))
+	{
+		INC_DWORD_STAT(STAT_ViewTraceReuses);
+		return Result;
+	}
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(ViewQuery), true, GetOwner());
+	Params.bReturnFaceIndex = true;
+	if (AActor* Ignored = IgnoredActor.Get())
+	{
+		Params.AddIgnoredActor(Ignored);
+	}
+
+	Result.Start = Start;
+	Result.Direction = Rotation.GetForwardVector();
+	Result.Hit = FHitResult();
+	Result.bHit = GetWorld()->LineTraceSingleByChannel(Result.Hit, Start, Start + Result.Direction * TraceDistance, ECC_Visibility, Params);
+
+	LastRotation = Rotation;
+	LastTraceTime = Now;
+
+	INC_DWORD_STAT(STAT_ViewTraces);
+	return Result;
+}
@@ -0,0 +1,67 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "ViewQueryComponent.generated.h"
+
+class UCameraComponent;
+
+// Result of the player's view trace for one frame
+struct FViewQueryResult
+{
+	FVector Start = FVector::ZeroVector;
+	FVector Direction = FVector::ForwardVector;
+
+	bool bHit = false;
+	FHitResult Hit;
+
+	// Point the player is aiming at, the hit location or a point along the ray
+	FVector GetAimPoint(float MissDistance) const { return bHit ? Hit.Location : Start + Direction * MissDistance; }
+};
+
+/**
+ * Traces the player's view ray at most once per frame and shares the result with every
+ * consumer: the build preview, interaction and the HUD. When the camera has not moved the
+ * previous hit is reused for up to MaxReuseTime without tracing.
+ */
+UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
+class GAM312_PAFFENROTH_API UViewQueryComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UViewQueryComponent();
+
+	// Returns this frame's view hit, tracing if nothing has asked yet
+	const FViewQueryResult& GetViewHit();
+
+	// Actor the trace ignores besides the owner, such as the build preview
+	void SetIgnoredActor(AActor* Actor) { IgnoredActor = Actor; }
+
+	// Length of the view ray
+	UPROPERTY(EditAnywhere, Category = "View Query")
+		float TraceDistance = 800.0f;
+
+	// Longest a result is reused while the camera stays still, so moving objects are still picked up
+	UPROPERTY(EditAnywhere, Category = "View Query")
+		float MaxReuseTime = 0.1f;
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	UPROPERTY(Transient)
+		TObjectPtr<UCameraComponent> Camera;
+
+	TWeakObjectPtr<AActor> IgnoredActor;
+
+	FViewQueryResult Result;
+
+	// Camera rotation of the last trace
+	FQuat LastRotation = FQuat::Identity;
+
+	uint64 LastQueryFrame = 0;
+	double LastTraceTime = -1.0;
+};
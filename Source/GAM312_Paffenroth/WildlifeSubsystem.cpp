@@ -0,0 +1,294 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WildlifeSubsystem.h"
+#include "GAM312_Paffenroth.h"
+#include "GAM312Bench.h"
+#include "FrameBudgetSubsystem.h"
+#include "AIController.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Wildlife Tick"), STAT_WildlifeTick, STATGROUP_GAM312);
+DECLARE_CYCLE_STAT(TEXT("Wildlife Representation"), STAT_WildlifeRepresentation, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Wildlife Agents"), STAT_WildlifeAgents, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Wildlife Agents Processed"), STAT_WildlifeProcessed, STATGROUP_GAM312);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Wildlife Actors"), STAT_WildlifeActors, STATGROUP_GAM312);
+
+// FWildlifeAgents
+
+int32 FWildlifeAgents::Add(const FVector& InPosition, float InHunger, double Now)
+{
+	Position.Add(InPosition);
+	Hunger.Add(InHunger);
+	TargetNode.Add(INDEX_NONE);
+	LastUpdateTime.Add(Now);
+	return Actor.AddDefaulted();
+}
+
+void FWildlifeAgents::Reset()
+{
+	Position.Reset();
+	Hunger.Reset();
+	TargetNode.Reset();
+	LastUpdateTime.Reset();
+	Actor.Reset();
+}
+
+// UWildlifeSubsystem
+
+void UWildlifeSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	NodeSubsystem = Collection.InitializeDependency<UResourceNodeSubsystem>();
+}
+
+void UWildlifeSubsystem::Deinitialize()
+{
+	ClearAgents();
+	NodeSubsystem = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UWildlifeSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UWildlifeSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UWildlifeSubsystem, STATGROUP_Tickables);
+}
+
+int32 UWildlifeSubsystem::SpawnAgent(const FVector& Location, float InitialHunger)
+{
+	return Agents.Add(Location, InitialHunger, GetWorld()->GetTimeSeconds());
+}
+
+void UWildlifeSubsystem::ClearAgents()
+{
+	for (const TWeakObjectPtr<APawn>& Pawn : Agents.Actor)
+	{
+		if (Pawn.IsValid())
+		{
+			if (AController* Controller = Pawn->GetController())
+			{
+				Controller->Destroy();
+			}
+			Pawn->Destroy();
+		}
+	}
+
+	Agents.Reset();
+	Cursor = 0;
+}
+
+void UWildlifeSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_WildlifeTick);
+
+	const int32 NumAgents = Agents.Num();
+	SET_DWORD_STAT(STAT_WildlifeAgents, NumAgents);
+
+	if (!NodeSubsystem || NumAgents == 0) return;
+
+	// Process agents round-robin until everyone has been updated or the budget runs out.
+	// Agents track their own last update time so skipped agents catch up next frame.
+	const double Now = GetWorld()->GetTimeSeconds();
+	const float BudgetScale = UFrameBudgetSubsystem::GetScale(GetWorld(), EFrameBudgetKnob::Wildlife);
+	const double Deadline = FPlatformTime::Seconds() + FrameBudgetMs * BudgetScale / 1000.0;
+
+	int32 Processed = 0;
+	while (Processed < NumAgents)
+	{
+		if (Cursor >= Agents.Num())
+		{
+			Cursor = 0;
+		}
+
+		ProcessAgent(Cursor++, Now);
+		++Processed;
+
+		if ((Processed & 31) == 0 && FPlatformTime::Seconds() >= Deadline)
+		{
+			break;
+		}
+	}
+	SET_DWORD_STAT(STAT_WildlifeProcessed, Processed);
+
+	RepresentationTimer -= DeltaTime;
+	if (RepresentationTimer <= 0.f)
+	{
+		RepresentationTimer = RepresentationInterval;
+		UpdateRepresentation();
+	}
+}
+
+void UWildlifeSubsystem::ProcessAgent(int32 Index, double Now)
+{
+	const float Dt = float(Now - Agents.LastUpdateTime[Index]);
+	Agents.LastUpdateTime[Index] = Now;
+
+	// Hunger
+	float& Hunger = Agents.Hunger[Index];
+	Hunger = FMath::Min(Hunger + HungerRate * Dt, 100.f);
+
+	// Represented agents are moved by their controller, so read their position back
+	APawn* Pawn = Agents.Actor[Index].Get();
+	FVector& Position = Agents.Position[Index];
+	if (Pawn)
+	{
+		Position = Pawn->GetActorLocation();
+	}
+
+	// Targeting
+	int32& Target = Agents.TargetNode[Index];
+	const FResourceNodeRecord* Node = NodeSubsystem->GetNode(Target);
+	if (Node && Node->Type != FoodType)
+	{
+		Node = nullptr;
+	}
+
+	if (!Node)
+	{
+		Target = INDEX_NONE;
+
+		if (Hunger < HungerThreshold) return;
+
+		Target = NodeSubsystem->FindNearestNode(Position, SearchRadius, FoodType);
+		Node = NodeSubsystem->GetNode(Target);
+		if (!Node) return;
+
+		if (Pawn)
+		{
+			if (AAIController* AI = Cast<AAIController>(Pawn->GetController()))
+			{
+				AI->MoveToLocation(Node->Location, ArriveRadius * 0.5f);
+			}
+		}
+	}
+
+	// Movement and eating
+	const FVector ToTarget(Node->Location.X - Position.X, Node->Location.Y - Position.Y, 0.f);
+	const float Dist = ToTarget.Size();
+
+	if (Dist <= ArriveRadius)
+	{
+		const int32 Wanted = FMath::Max(1, FMath::CeilToInt(Hunger / Nutrition));
+		const int32 Granted = NodeSubsystem->ConsumeFromNode(Target, Wanted);
+		Hunger = FMath::Max(0.f, Hunger - Granted * Nutrition);
+		Target = INDEX_NONE;
+	}
+	else if (!Pawn)
+	{
+		Position += ToTarget / Dist * FMath::Min(MoveSpeed * Dt, Dist);
+	}
+}
+
+void UWildlifeSubsystem::UpdateRepresentation()
+{
+	SCOPE_CYCLE_COUNTER(STAT_WildlifeRepresentation);
+
+	UWorld* World = GetWorld();
+
+	TArray<FVector, TInlineAllocator<16>> PlayerLocations;
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		if (const APawn* PlayerPawn = It->Get() ? It->Get()->GetPawn() : nullptr)
+		{
+			PlayerLocations.Add(PlayerPawn->GetActorLocation());
+		}
+	}
+
+	if (!LoadedAgentClass && !AgentActorClass.IsNull())
+	{
+		LoadedAgentClass = AgentActorClass.LoadSynchronous();
+	}
+
+	// Release actors a little further out than they are spawned to avoid churn at the edge
+	const float SpawnRadiusSq = FMath::Square(ActorRadius);
+	const float ReleaseRadiusSq = FMath::Square(ActorRadius * 1.2f);
+
+	int32 NumActors = 0;
+	for (int32 Index = 0; Index < Agents.Num(); ++Index)
+	{
+		float ClosestSq = TNumericLimits<float>::Max();
+		for (const FVector& PlayerLocation : PlayerLocations)
+		{
+			ClosestSq = FMath::Min(ClosestSq, FVector::DistSquared(PlayerLocation, Agents.Position[Index]));
+		}
+
+		APawn* Pawn = Agents.Actor[Index].Get();
+		if (Pawn && ClosestSq > ReleaseRadiusSq)
+		{
+			Agents.Position[Index] = Pawn->GetActorLocation();
+			if (AController* Controller = Pawn->GetController())
+			{
+				Controller->Destroy();
+			}
+			Pawn->Destroy();
+			Agents.Actor[Index] = nullptr;
+		}
+		else if (!Pawn && LoadedAgentClass && ClosestSq <= SpawnRadiusSq)
+		{
+			FActorSpawnParameters SpawnParams;
+			SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+			Pawn = World->SpawnActor<APawn>(LoadedAgentClass, Agents.Position[Index], FRotator::ZeroRotator, SpawnParams);
+			if (Pawn)
+			{
+				if (!Pawn->GetController())
+				{
+					Pawn->SpawnDefaultController();
+				}
+				Agents.Actor[Index] = Pawn;
+
+				// Resume any walk the agent was already on
+				const FResourceNodeRecord* Node = NodeSubsystem->GetNode(Agents.TargetNode[Index]);
+				AAIController* AI = Cast<AAIController>(Pawn->GetController());
+				if (Node && AI)
+				{
+					AI->MoveToLocation(Node->Location, ArriveRadius * 0.5f);
+				}
+			}
+		}
+
+		if (Agents.Actor[Index].IsValid())
+		{
+			++NumActors;
+		}
+	}
+	SET_DWORD_STAT(STAT_WildlifeActors, NumActors);
+}
+
+// Benchmark helper: "Wildlife.SpawnAgents <Count> <Radius>" scatters agents around the first player.
+// Use with "stat GAM312" to check the per-frame cost stays inside FrameBudgetMs.
+GAM312_BENCH_COMMAND(GWildlifeSpawnAgentsCmd, "Wildlife.SpawnAgents",
+	"Spawns simulated wildlife agents around the first player. Usage: Wildlife.SpawnAgents <Count> <Radius>")
+{
+	UWildlifeSubsystem* Wildlife = World ? World->GetSubsystem<UWildlifeSubsystem>() : nullptr;
+	if (!Wildlife) return;
+
+	const int32 Count = GAM312Bench::Count(Args, 0, 1000);
+	const float Radius = GAM312Bench::Number(Args, 1, 20000.f);
+
+	FVector Center = FVector::ZeroVector;
+	if (APlayerController* PC = World->GetFirstPlayerController())
+	{
+		if (APawn* PlayerPawn = PC->GetPawn())
+		{
+			Center = PlayerPawn->GetActorLocation();
+		}
+	}
+
+	FRandomStream Stream(Count);
+	for (int32 i = 0; i < Count; ++i)
+	{
+		const FVector2D Offset = FVector2D(Stream.FRandRange(-1.f, 1.f), Stream.FRandRange(-1.f, 1.f)) * Radius;
+		Wildlife->SpawnAgent(Center + FVector(Offset, 0.f), Stream.FRandRange(0.f, 100.f));
+	}
+
+	UE_LOG(LogGAM312, Log, TEXT("Wildlife.SpawnAgents: spawned %d agents (%d total)"), Count, Wildlife->GetNumAgents());
+}
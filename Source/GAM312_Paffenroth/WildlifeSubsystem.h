@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ResourceNodeSubsystem.h"
+#include "WildlifeSubsystem.generated.h"
+
+/**
+ * Agent fragments stored as parallel arrays. Every agent owns one slot in each array.
+ */
+struct FWildlifeAgents
+{
+	// World position of each agent
+	TArray<FVector> Position;
+
+	// 0 = full, 100 = starving
+	TArray<float> Hunger;
+
+	// Resource node the agent is heading to, or INDEX_NONE
+	TArray<int32> TargetNode;
+
+	// World time the agent was last processed
+	TArray<double> LastUpdateTime;
+
+	// Actor representing the agent while it is near a player
+	TArray<TWeakObjectPtr<APawn>> Actor;
+
+	int32 Num() const { return Position.Num(); }
+
+	int32 Add(const FVector& InPosition, float InHunger, double Now);
+
+	void Reset();
+};
+
+/**
+ * Simulates wildlife that competes for resource nodes without a controller or
+ * behaviour tree per agent. Agents are processed round-robin under a per-frame
+ * time budget and only get a full actor while a player is nearby.
+ */
+UCLASS(Config = Game)
+class GAM312_PAFFENROTH_API UWildlifeSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Adds an agent to the simulation and returns its index
+	int32 SpawnAgent(const FVector& Location, float InitialHunger = 0.f);
+
+	// Removes every agent and its actor
+	void ClearAgents();
+
+	int32 GetNumAgents() const { return Agents.Num(); }
+
+// --- Settings ---
+
+	// Pawn class used to represent agents near players
+	UPROPERTY(Config)
+		TSoftClassPtr<APawn> AgentActorClass;
+
+	// Game thread time the simulation may use each frame, in milliseconds
+	UPROPERTY(Config)
+		float FrameBudgetMs = 0.5f;
+
+	// Hunger gained per second
+	UPROPERTY(Config)
+		float HungerRate = 2.0f;
+
+	// Hunger level at which an agent looks for food
+	UPROPERTY(Config)
+		float HungerThreshold = 50.0f;
+
+	// Hunger removed per unit of resource eaten
+	UPROPERTY(Config)
+		float Nutrition = 10.0f;
+
+	// How far an agent will look for a resource node
+	UPROPERTY(Config)
+		float SearchRadius = 5000.0f;
+
+	// Agent movement speed in units per second
+	UPROPERTY(Config)
+		float MoveSpeed = 300.0f;
+
+	// Distance at which an agent can eat from its target
+	UPROPERTY(Config)
+		float ArriveRadius = 150.0f;
+
+	// Resource type agents eat
+	UPROPERTY(Config)
+		EResourceType FoodType = EResourceType::Berry;
+
+	// Agents within this distance of a player get an actor
+	UPROPERTY(Config)
+		float ActorRadius = 4000.0f;
+
+	// Seconds between representation updates
+	UPROPERTY(Config)
+		float RepresentationInterval = 0.25f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	// Runs hunger, targeting and movement for one agent
+	void ProcessAgent(int32 Index, double Now);
+
+	// Spawns or releases agent actors depending on player proximity
+	void UpdateRepresentation();
+
+	FWildlifeAgents Agents;
+
+	// Next agent to process
+	int32 Cursor = 0;
+
+	float RepresentationTimer = 0.f;
+
+	// Loaded agent actor class
+	UPROPERTY(Transient)
+		TSubclassOf<APawn> LoadedAgentClass;
+
+	UPROPERTY(Transient)
+		TObjectPtr<UResourceNodeSubsystem> NodeSubsystem;
+};